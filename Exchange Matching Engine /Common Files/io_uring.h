@@ -0,0 +1,194 @@
+#pragma once
+
+#ifndef __APPLE__
+
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "macros.h"
+
+namespace Common {
+  /// Minimal io_uring over the raw system calls: a submission and a completion ring shared with the kernel,
+  /// plus provided buffer rings the kernel picks receive buffers from. Single threaded.
+  class IoUring final {
+  public:
+    explicit IoUring(unsigned entries) {
+      io_uring_params params{};
+      ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+      ASSERT(ring_fd_ >= 0, "io_uring_setup() failed. error:" + std::string(std::strerror(errno)));
+      ASSERT(params.features & IORING_FEAT_SINGLE_MMAP, "io_uring without IORING_FEAT_SINGLE_MMAP is not supported.");
+
+      ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned), params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+      ring_ = static_cast<char *>(mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING));
+      ASSERT(ring_ != MAP_FAILED, "mmap() failed on io_uring rings. error:" + std::string(std::strerror(errno)));
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+      ASSERT(sqes_ != MAP_FAILED, "mmap() failed on io_uring submission entries. error:" + std::string(std::strerror(errno)));
+
+      sq_head_ = reinterpret_cast<unsigned *>(ring_ + params.sq_off.head);
+      sq_tail_ = reinterpret_cast<unsigned *>(ring_ + params.sq_off.tail);
+      sq_mask_ = *reinterpret_cast<unsigned *>(ring_ + params.sq_off.ring_mask);
+      sq_entries_ = params.sq_entries;
+      cq_head_ = reinterpret_cast<unsigned *>(ring_ + params.cq_off.head);
+      cq_tail_ = reinterpret_cast<unsigned *>(ring_ + params.cq_off.tail);
+      cq_mask_ = *reinterpret_cast<unsigned *>(ring_ + params.cq_off.ring_mask);
+      cqes_ = reinterpret_cast<io_uring_cqe *>(ring_ + params.cq_off.cqes);
+
+      // Submission entry i always sits in slot i, so only the tail has to move to submit.
+      auto array = reinterpret_cast<unsigned *>(ring_ + params.sq_off.array);
+      for (unsigned i = 0; i < sq_entries_; ++i) {
+        array[i] = i;
+      }
+      sq_local_tail_ = *sq_tail_;
+    }
+
+    ~IoUring() {
+      munmap(sqes_, sqes_size_);
+      munmap(ring_, ring_size_);
+      for (const auto &buffer_ring : buffer_rings_) {
+        munmap(buffer_ring.ring_, buffer_ring.entries_ * sizeof(io_uring_buf));
+        munmap(buffer_ring.buffers_, buffer_ring.entries_ * buffer_ring.buffer_size_);
+      }
+      close(ring_fd_);
+    }
+
+    /// Next free submission entry, cleared, nullptr if the submission ring is full until submit() is called.
+    auto getSqe() noexcept -> io_uring_sqe * {
+      if (UNLIKELY(sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)) {
+        return nullptr;
+      }
+      auto sqe = &sqes_[sq_local_tail_++ & sq_mask_];
+      memset(sqe, 0, sizeof(*sqe));
+      return sqe;
+    }
+
+    /// Entries filled in since the last submit().
+    auto pending() const noexcept {
+      return sq_local_tail_ - *sq_tail_;
+    }
+
+    /// Hand the filled in entries to the kernel in one system call, and wait for wait_nr completions.
+    auto submit(unsigned wait_nr = 0) noexcept -> int {
+      const auto to_submit = pending();
+      __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+      if (!to_submit && !wait_nr) {
+        return 0;
+      }
+      ++num_enters_;
+      const auto ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+      return (ret < 0) ? -errno : ret;
+    }
+
+    /// Call visit on every completion available and release them back to the kernel. Makes no system call.
+    template<typename F>
+    auto forEachCqe(F &&visit) noexcept {
+      auto head = *cq_head_;
+      const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        visit(cqes_[head & cq_mask_]);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    /// Register a group of num_buffers buffers of buffer_size bytes the kernel picks from for requests with IOSQE_BUFFER_SELECT and
+    /// buf_group group_id. num_buffers must be a power of 2.
+    auto registerBufferRing(uint16_t group_id, unsigned num_buffers, unsigned buffer_size) -> void {
+      ASSERT((num_buffers & (num_buffers - 1)) == 0 && group_id == buffer_rings_.size(), "Bad io_uring buffer ring group:" + std::to_string(group_id));
+
+      BufferRing buffer_ring{group_id, num_buffers, buffer_size};
+      buffer_ring.ring_ = static_cast<io_uring_buf *>(mmap(nullptr, num_buffers * sizeof(io_uring_buf), PROT_READ | PROT_WRITE,
+                                                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+      buffer_ring.buffers_ = static_cast<char *>(mmap(nullptr, static_cast<size_t>(num_buffers) * buffer_size, PROT_READ | PROT_WRITE,
+                                                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+      ASSERT(buffer_ring.ring_ != MAP_FAILED && buffer_ring.buffers_ != MAP_FAILED, "mmap() failed on io_uring buffer ring.");
+
+      io_uring_buf_reg reg{};
+      reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring.ring_);
+      reg.ring_entries = num_buffers;
+      reg.bgid = group_id;
+      ASSERT(syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) == 0,
+             "IORING_REGISTER_PBUF_RING failed. error:" + std::string(std::strerror(errno)));
+
+      buffer_rings_.push_back(buffer_ring);
+      for (unsigned id = 0; id < num_buffers; ++id) {
+        recycleBuffer(group_id, id);
+      }
+      publishBuffers(group_id);
+    }
+
+    auto buffer(uint16_t group_id, unsigned id) noexcept -> char * {
+      const auto &buffer_ring = buffer_rings_[group_id];
+      return buffer_ring.buffers_ + static_cast<size_t>(id) * buffer_ring.buffer_size_;
+    }
+
+    /// Give a buffer the kernel filled back to it, visible to the kernel after publishBuffers().
+    auto recycleBuffer(uint16_t group_id, unsigned id) noexcept -> void {
+      auto &buffer_ring = buffer_rings_[group_id];
+      auto &buf = buffer_ring.ring_[buffer_ring.local_tail_++ & (buffer_ring.entries_ - 1)];
+      buf.addr = reinterpret_cast<uint64_t>(buffer(group_id, id));
+      buf.len = buffer_ring.buffer_size_;
+      buf.bid = static_cast<uint16_t>(id);
+    }
+
+    auto publishBuffers(uint16_t group_id) noexcept -> void {
+      auto &buffer_ring = buffer_rings_[group_id];
+      __atomic_store_n(&reinterpret_cast<io_uring_buf_ring *>(buffer_ring.ring_)->tail, buffer_ring.local_tail_, __ATOMIC_RELEASE);
+    }
+
+    /// io_uring_enter system calls made so far.
+    auto numEnters() const noexcept {
+      return num_enters_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    IoUring() = delete;
+
+    IoUring(const IoUring &) = delete;
+
+    IoUring(const IoUring &&) = delete;
+
+    IoUring &operator=(const IoUring &) = delete;
+
+    IoUring &operator=(const IoUring &&) = delete;
+
+  private:
+    int ring_fd_ = -1;
+
+    char *ring_ = nullptr;
+    size_t ring_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+
+    struct BufferRing {
+      uint16_t group_id_ = 0;
+      unsigned entries_ = 0;
+      unsigned buffer_size_ = 0;
+      /// The entries of the io_uring_buf_ring, indexed directly: in C++ its bufs member sits past the empty struct the header puts in front of it.
+      io_uring_buf *ring_ = nullptr;
+      char *buffers_ = nullptr;
+      uint16_t local_tail_ = 0;
+    };
+    std::vector<BufferRing> buffer_rings_;
+
+    size_t num_enters_ = 0;
+  };
+}
+
+#endif
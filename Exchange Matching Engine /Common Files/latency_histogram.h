@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdio>
+#include <sstream>
+#include <algorithm>
+
+#include "time_utils.h"
+
+namespace Common {
+  /// Power of 2 buckets of latencies, bucket i counts latencies in [2^(i-1), 2^i) nanoseconds.
+  /// Single writer and cheap enough to update on every message, unlike LatencyTracker it is not shared across threads.
+  struct LatencyHistogram {
+    std::array<size_t, 48> buckets_ = {};
+    size_t count_ = 0;
+    Nanos max_ = 0;
+
+    auto add(Nanos latency) noexcept {
+      latency = std::max(latency, static_cast<Nanos>(0)); // clocks stepping backwards count as no delay.
+      const auto bucket = latency ? std::min(static_cast<size_t>(64 - __builtin_clzll(latency)), buckets_.size() - 1) : 0;
+      ++buckets_[bucket];
+      ++count_;
+      max_ = std::max(max_, latency);
+    }
+
+    /// Upper bound of the bucket containing the given percentile, 0 if nothing was added.
+    auto percentile(double percentile) const noexcept -> Nanos {
+      const auto target = static_cast<size_t>(count_ * percentile / 100.0);
+      size_t cumulative = 0;
+      for (size_t i = 0; i < buckets_.size(); ++i) {
+        cumulative += buckets_[i];
+        if (buckets_[i] && cumulative >= target) {
+          return static_cast<Nanos>(1) << i;
+        }
+      }
+      return 0;
+    }
+
+    /// One line summary with the non-empty buckets as upper-bound:count.
+    auto toString() const {
+      std::stringstream ss;
+      ss << "LatencyHistogram{"
+         << "count:" << count_ << " "
+         << "p50<" << percentile(50) << " "
+         << "p99<" << percentile(99) << " "
+         << "p99.9<" << percentile(99.9) << " "
+         << "max:" << max_ << " "
+         << "buckets:[";
+      for (size_t i = 0; i < buckets_.size(); ++i) {
+        if (buckets_[i]) {
+          ss << " <" << (static_cast<Nanos>(1) << i) << ":" << buckets_[i];
+        }
+      }
+      ss << " ]}";
+
+      return ss.str();
+    }
+
+    /// One row per non-empty bucket with its share and the cumulative share of total.
+    auto print(size_t total) const {
+      size_t cumulative = 0;
+      for (size_t i = 0; i < buckets_.size(); ++i) {
+        if (!buckets_[i]) {
+          continue;
+        }
+        cumulative += buckets_[i];
+        printf("  <%12luns %12lu %6.2f%% %7.3f%%\n", (1ul << i), buckets_[i], 100.0 * buckets_[i] / total, 100.0 * cumulative / total);
+      }
+    }
+  };
+}
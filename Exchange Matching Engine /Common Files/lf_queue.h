@@ -17,23 +17,56 @@ namespace Common {
       ASSERT((num_elems & (num_elems - 1)) == 0, "LFQueue size must be power of 2");
     }
 
+    /// Positions are ever increasing counters, they are only reduced modulo the capacity when indexing into store_.
     auto getNextToWriteTo() noexcept -> T* {
       auto current_write = write_pos_.load(std::memory_order_relaxed);
-      auto next_write = (current_write + 1) & (store_.size() - 1); // Fast modulo for power of 2
-      
+
       // Check if queue is full
-      if (next_write == read_pos_.load(std::memory_order_acquire)) {
+      if (current_write - read_pos_.load(std::memory_order_acquire) >= store_.size()) {
         return nullptr; // Queue full
       }
-      
-      return &store_[current_write];
+
+      return &store_[current_write & (store_.size() - 1)]; // Fast modulo for power of 2
     }
 
     auto updateWriteIndex() noexcept -> bool {
-      write_pos_.fetch_add(1, std::memory_order_release);
+      write_pos_.store(write_pos_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
       return true;
     }
 
+    /// Reserve the slot after any slots already reserved but not yet published, so the producer can construct the element in place.
+    /// Reserved slots are invisible to the consumer until commitWriteIndex() is called, returns nullptr if the queue is full.
+    /// Must not be mixed with getNextToWriteTo() / updateWriteIndex() while there are reserved slots.
+    auto reserveNextToWriteTo() noexcept -> T* {
+      const auto next_write = write_pos_.load(std::memory_order_relaxed) + num_reserved_;
+
+      if (next_write - read_pos_.load(std::memory_order_acquire) >= store_.size()) {
+        return nullptr; // Queue full
+      }
+
+      ++num_reserved_;
+      return &store_[next_write & (store_.size() - 1)];
+    }
+
+    /// Number of reserved slots not yet published, and access to them in the order in which they were reserved.
+    auto numReserved() const noexcept {
+      return num_reserved_;
+    }
+
+    auto getReserved(size_t index) const noexcept -> const T * {
+      return &store_[(write_pos_.load(std::memory_order_relaxed) + index) & (store_.size() - 1)];
+    }
+
+    /// Publish all reserved slots to the consumer with a single release store, returns the number of elements published.
+    auto commitWriteIndex() noexcept -> size_t {
+      const auto num_committed = num_reserved_;
+      if (num_committed) {
+        write_pos_.store(write_pos_.load(std::memory_order_relaxed) + num_committed, std::memory_order_release);
+        num_reserved_ = 0;
+      }
+      return num_committed;
+    }
+
     auto getNextToRead() const noexcept -> const T * {
       auto current_read = read_pos_.load(std::memory_order_relaxed);
       
@@ -41,7 +74,23 @@ namespace Common {
         return nullptr; // Queue empty
       }
       
-      return &store_[current_read];
+      return &store_[current_read & (store_.size() - 1)];
+    }
+
+    /// Look ahead at the element offset positions after the next one to read, nullptr if it has not been published yet.
+    auto getNextToRead(size_t offset) const noexcept -> const T * {
+      auto current_read = read_pos_.load(std::memory_order_relaxed);
+
+      if (write_pos_.load(std::memory_order_acquire) - current_read <= offset) {
+        return nullptr; // Not published yet
+      }
+
+      return &store_[(current_read + offset) & (store_.size() - 1)];
+    }
+
+    /// Release count elements back to the producer with a single release store, count must not exceed size().
+    auto updateReadIndex(size_t count) noexcept -> void {
+      read_pos_.store(read_pos_.load(std::memory_order_relaxed) + count, std::memory_order_release);
     }
 
     auto updateReadIndex() noexcept -> bool {
@@ -51,14 +100,14 @@ namespace Common {
         return false; // Queue empty
       }
       
-      read_pos_.fetch_add(1, std::memory_order_release);
+      read_pos_.store(current_read + 1, std::memory_order_release);
       return true;
     }
 
     auto size() const noexcept -> size_t {
       auto write_pos = write_pos_.load(std::memory_order_relaxed);
       auto read_pos = read_pos_.load(std::memory_order_relaxed);
-      return (write_pos - read_pos) & (store_.size() - 1);
+      return write_pos - read_pos;
     }
 
     /// Deleted default, copy & move constructors and assignment-operators.
@@ -79,5 +128,8 @@ namespace Common {
     /// Atomic trackers for write and read positions with proper memory alignment
     alignas(64) std::atomic<size_t> write_pos_ = {0};
     alignas(64) std::atomic<size_t> read_pos_ = {0};
+
+    /// Producer side count of slots handed out by reserveNextToWriteTo() and not yet published.
+    alignas(64) size_t num_reserved_ = 0;
   };
 }
@@ -113,7 +113,12 @@ namespace Common {
     /// Overloaded methods to write different log entry types to the lock free queue.
     /// Creates a LogElement of the correct type and writes it to the lock free queue.
     auto pushValue(const LogElement &log_element) noexcept {
-      *(queue_.getNextToWriteTo()) = log_element;
+      auto next_write = queue_.getNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // queue is full, wait for the flusher thread to catch up.
+        std::this_thread::yield();
+        next_write = queue_.getNextToWriteTo();
+      }
+      *next_write = log_element;
       queue_.updateWriteIndex();
     }
 
@@ -23,29 +23,52 @@ namespace Common {
   /// Publish outgoing data and read incoming data.
   auto McastSocket::sendAndRecv() noexcept -> bool {
     // Read data and dispatch callbacks if data is available - non blocking.
-    const ssize_t n_rcv = recv(socket_fd_, inbound_data_.data() + next_rcv_valid_index_, McastBufferSize - next_rcv_valid_index_, MSG_DONTWAIT);
+    const ssize_t n_rcv = recv(socket_fd_, inbound_.writeData(), inbound_.freeSpace(), MSG_DONTWAIT);
     if (n_rcv > 0) {
-      next_rcv_valid_index_ += n_rcv;
+      inbound_.commitWrite(n_rcv);
       logger_.log("%:% %() % read socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_,
-                  next_rcv_valid_index_);
+                  inbound_.size());
       recv_callback_(this);
     }
 
-    // Publish market data in the send buffer to the multicast stream.
-    if (next_send_valid_index_ > 0) {
-      ssize_t n = ::send(socket_fd_, outbound_data_.data(), next_send_valid_index_, MSG_DONTWAIT | MSG_NOSIGNAL);
+    // Publish the queued datagrams to the multicast stream, they are contiguous in the send ring.
+    if (!outbound_datagrams_.empty()) {
+      auto data = outbound_.readData();
+      const auto num_datagrams = outbound_datagrams_.size();
+#ifdef __APPLE__
+      size_t n = 0;
+      for (; n < num_datagrams; ++n) {
+        if (::send(socket_fd_, data, outbound_datagrams_[n], MSG_DONTWAIT) < 0) {
+          break;
+        }
+        data += outbound_datagrams_[n];
+      }
+#else
+      for (size_t i = 0; i < num_datagrams; ++i) {
+        send_iovecs_[i] = {data, outbound_datagrams_[i]};
+        send_msgs_[i] = {};
+        send_msgs_[i].msg_hdr.msg_iov = &send_iovecs_[i];
+        send_msgs_[i].msg_hdr.msg_iovlen = 1;
+        data += outbound_datagrams_[i];
+      }
+      const auto n = sendmmsg(socket_fd_, send_msgs_.data(), num_datagrams, MSG_DONTWAIT | MSG_NOSIGNAL);
+#endif
 
-      logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_, n);
+      logger_.log("%:% %() % send socket:% len:% datagrams:% sent:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  socket_fd_, outbound_.size(), num_datagrams, n);
     }
-    next_send_valid_index_ = 0;
+    outbound_.clear(); // datagrams the kernel did not take are lost, like any other dropped packet.
+    outbound_datagrams_.clear();
 
     return (n_rcv > 0);
   }
 
-  /// Copy data to send buffers - does not send them out yet.
+  /// Queue data to be published as one datagram - does not send it out yet unless the send ring or the datagram queue is full.
   auto McastSocket::send(const void *data, size_t len) noexcept -> void {
-    memcpy(outbound_data_.data() + next_send_valid_index_, data, len);
-    next_send_valid_index_ += len;
-    ASSERT(next_send_valid_index_ < McastBufferSize, "Mcast socket buffer filled up and sendAndRecv() not called.");
+    if (UNLIKELY(outbound_.freeSpace() < len || outbound_datagrams_.size() == McastMaxQueuedDatagrams)) { // publish what is queued rather than growing.
+      sendAndRecv();
+    }
+    outbound_.write(data, len);
+    outbound_datagrams_.push_back(len);
   }
 }
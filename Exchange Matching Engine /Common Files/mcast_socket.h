@@ -1,20 +1,28 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 
 #include "socket_utils.h"
 
 #include "logging.h"
+#include "mirrored_ring.h"
 
 namespace Common {
-  /// Size of send and receive buffers in bytes.
-  constexpr size_t McastBufferSize = 64 * 1024 * 1024;
+  /// Size of send and receive rings in bytes, a power of 2 and a multiple of the page size.
+  constexpr size_t McastBufferSize = 1024 * 1024;
+
+  /// Most datagrams queued for one sendmmsg() call, a longer burst goes out in batches of this many as it is queued.
+  constexpr size_t McastMaxQueuedDatagrams = 64;
 
   struct McastSocket {
     McastSocket(Logger &logger)
-        : logger_(logger) {
-      outbound_data_.resize(McastBufferSize);
-      inbound_data_.resize(McastBufferSize);
+        : outbound_(McastBufferSize), inbound_(McastBufferSize), logger_(logger) {
+      outbound_datagrams_.reserve(McastMaxQueuedDatagrams);
+#ifndef __APPLE__
+      send_iovecs_.resize(McastMaxQueuedDatagrams);
+      send_msgs_.resize(McastMaxQueuedDatagrams);
+#endif
     }
 
     /// Initialize multicast socket to read from or publish to a stream.
@@ -27,19 +35,25 @@ namespace Common {
     /// Remove / Leave membership / subscription to a multicast stream.
     auto leave(const std::string &ip, int port) -> void;
 
-    /// Publish outgoing data and read incoming data.
+    /// Publish outgoing data and read incoming data. Every queued datagram goes out in a single sendmmsg() call.
     auto sendAndRecv() noexcept -> bool;
 
-    /// Copy data to send buffers - does not send them out yet.
+    /// Queue data to be published as one datagram - does not send it out yet unless the send ring or the datagram queue is full.
     auto send(const void *data, size_t len) noexcept -> void;
 
     int socket_fd_ = -1;
 
-    /// Send and receive buffers, typically only one or the other is needed, not both.
-    std::vector<char> outbound_data_;
-    size_t next_send_valid_index_ = 0;
-    std::vector<char> inbound_data_;
-    size_t next_rcv_valid_index_ = 0;
+    /// Send and receive rings, typically only one or the other is needed, not both.
+    /// recv_callback_ parses frames in place from inbound_.readData() and consumes the complete ones.
+    MirroredRing outbound_;
+    MirroredRing inbound_;
+
+    /// Length of every datagram queued in outbound_, in order, and the scratch vectors handed to sendmmsg().
+    std::vector<size_t> outbound_datagrams_;
+#ifndef __APPLE__
+    std::vector<iovec> send_iovecs_;
+    std::vector<mmsghdr> send_msgs_;
+#endif
 
     /// Function wrapper for the method to call when data is read.
     std::function<void(McastSocket *s)> recv_callback_ = nullptr;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <thread>
@@ -20,29 +21,23 @@ namespace Common {
     }
 
     /// Allocate a new object of type T, use placement new to initialize the object, mark the block as in-use and return the object.
+    /// Blocks are freed in any order, so scan forward from the last allocation to the next free block.
     template<typename... Args>
     T *allocate(Args... args) noexcept {
-      // Lock-free allocation with exponential backoff
-      for (int retry = 0; retry < 1000; ++retry) {
-        auto current = next_free_.load(std::memory_order_relaxed);
-        auto next = (current + 1) & (store_.size() - 1); // Fast modulo for power of 2
-        
-        if (store_[current].is_free_.exchange(false, std::memory_order_acquire)) {
-          next_free_.store(next, std::memory_order_relaxed);
-          
+      auto current = next_free_.load(std::memory_order_relaxed);
+      for (size_t scanned = 0; scanned < store_.size(); ++scanned, current = (current + 1) & (store_.size() - 1)) { // Fast modulo for power of 2
+        if (LIKELY(store_[current].is_free_.exchange(false, std::memory_order_acquire))) {
+          next_free_.store((current + 1) & (store_.size() - 1), std::memory_order_relaxed);
+
           T *ret = &(store_[current].object_);
           ret = new(ret) T(args...); // placement new.
-          
+
           return ret;
         }
-        
-        // Exponential backoff on contention
-        if (retry > 10) {
-          std::this_thread::yield();
-        }
       }
-      
-      return nullptr; // Pool exhausted
+
+      FATAL("Memory Pool out of space.");
+      return nullptr;
     }
 
     /// Return the object back to the pool by marking the block as free again.
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "macros.h"
+
+namespace Common {
+  /// Byte ring buffer whose pages are mapped twice, back to back, so that the bytes between the read and write positions are always
+  /// contiguous in memory even when they wrap around the end of the ring. Socket reads and writes go straight into / out of it with a
+  /// single call, and frames are parsed in place with no copying to move a partial frame back to the start.
+  /// Single threaded, the positions only ever increase and are masked to index into the ring.
+  class MirroredRing final {
+  public:
+    /// Capacity must be a power of 2 and a multiple of the page size.
+    explicit MirroredRing(size_t capacity)
+        : capacity_(capacity) {
+      ASSERT((capacity_ & (capacity_ - 1)) == 0 && capacity_ % sysconf(_SC_PAGESIZE) == 0,
+             "MirroredRing capacity:" + std::to_string(capacity_) + " must be a power of 2 and a multiple of the page size.");
+
+#ifdef __APPLE__
+      static std::atomic<size_t> num_rings = 0;
+      const auto name = "/mirrored_ring_" + std::to_string(getpid()) + "_" + std::to_string(num_rings++);
+      const auto fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      shm_unlink(name.c_str());
+#else
+      const auto fd = memfd_create("mirrored_ring", MFD_CLOEXEC);
+#endif
+      ASSERT(fd >= 0, "Could not create MirroredRing memory. error:" + std::string(std::strerror(errno)));
+      ASSERT(ftruncate(fd, capacity_) == 0, "ftruncate() failed on MirroredRing. error:" + std::string(std::strerror(errno)));
+
+      // Reserve twice the address space, then map the same memory into both halves.
+      data_ = static_cast<char *>(mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+      ASSERT(data_ != MAP_FAILED, "mmap() reserve failed on MirroredRing. error:" + std::string(std::strerror(errno)));
+      for (auto half : {data_, data_ + capacity_}) {
+        ASSERT(mmap(half, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == half,
+               "mmap() failed on MirroredRing. error:" + std::string(std::strerror(errno)));
+      }
+      close(fd); // the mappings keep the memory alive.
+    }
+
+    ~MirroredRing() {
+      munmap(data_, 2 * capacity_);
+    }
+
+    auto capacity() const noexcept {
+      return capacity_;
+    }
+
+    /// Bytes written and not consumed yet, starting at readData().
+    auto size() const noexcept {
+      return tail_ - head_;
+    }
+
+    /// Bytes that can be written starting at writeData().
+    auto freeSpace() const noexcept {
+      return capacity_ - size();
+    }
+
+    auto readData() noexcept {
+      return data_ + (head_ & (capacity_ - 1));
+    }
+
+    auto writeData() noexcept {
+      return data_ + (tail_ & (capacity_ - 1));
+    }
+
+    /// Make len bytes written directly to writeData() readable.
+    auto commitWrite(size_t len) noexcept {
+      tail_ += len;
+    }
+
+    /// Copy len bytes in at the write position, there must be freeSpace() for them.
+    auto write(const void *data, size_t len) noexcept {
+      memcpy(writeData(), data, len);
+      tail_ += len;
+    }
+
+    /// Release len bytes from the read position.
+    auto consume(size_t len) noexcept {
+      head_ += len;
+    }
+
+    /// Discard everything not consumed yet.
+    auto clear() noexcept {
+      head_ = tail_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MirroredRing() = delete;
+
+    MirroredRing(const MirroredRing &) = delete;
+
+    MirroredRing(const MirroredRing &&) = delete;
+
+    MirroredRing &operator=(const MirroredRing &) = delete;
+
+    MirroredRing &operator=(const MirroredRing &&) = delete;
+
+  private:
+    const size_t capacity_;
+    char *data_ = nullptr;
+
+    size_t head_ = 0;
+    size_t tail_ = 0;
+  };
+}
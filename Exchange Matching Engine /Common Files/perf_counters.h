@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <sstream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Common {
+  /// User space hardware counters of the calling thread, read through perf_event_open().
+  /// Each counter is opened on its own so that whatever the machine provides is still reported when the rest is not,
+  /// e.g. in virtual machines, containers or with a restrictive perf_event_paranoid.
+  class PerfCounters final {
+  public:
+    enum Counter : size_t {
+      CYCLES = 0,
+      INSTRUCTIONS = 1,
+      CACHE_REFERENCES = 2,
+      CACHE_MISSES = 3,
+      L1D_READ_MISSES = 4,
+      NUM_COUNTERS = 5
+    };
+
+    PerfCounters() {
+      constexpr std::array<std::pair<uint32_t, uint64_t>, NUM_COUNTERS> events = {{
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+          {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+          {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)}
+      }};
+
+      for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+        perf_event_attr attr = {};
+        attr.size = sizeof(attr);
+        attr.type = events[i].first;
+        attr.config = events[i].second;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+      }
+    }
+
+    ~PerfCounters() {
+      for (auto fd : fds_) {
+        if (fd >= 0) {
+          close(fd);
+        }
+      }
+    }
+
+    /// Reset and start / stop counting on every available counter.
+    auto start() noexcept {
+      for (auto fd : fds_) {
+        if (fd >= 0) {
+          ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+          ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+      }
+    }
+
+    auto stop() noexcept {
+      for (auto fd : fds_) {
+        if (fd >= 0) {
+          ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+      }
+    }
+
+    /// Counter value since the last start(), -1 if the counter is not available.
+    auto value(Counter counter) const noexcept -> int64_t {
+      int64_t count = 0;
+      if (fds_[counter] < 0 || read(fds_[counter], &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+      }
+      return count;
+    }
+
+    auto toString() const {
+      static constexpr std::array<const char *, NUM_COUNTERS> names = {"cycles", "instructions", "cache-references", "cache-misses", "l1d-read-misses"};
+
+      std::stringstream ss;
+      ss << "PerfCounters{";
+      for (size_t i = 0; i < NUM_COUNTERS; ++i) {
+        const auto count = value(static_cast<Counter>(i));
+        ss << (i ? " " : "") << names[i] << ":";
+        if (count < 0) {
+          ss << "unavailable";
+        } else {
+          ss << count;
+        }
+      }
+      ss << "}";
+
+      return ss.str();
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    PerfCounters(const PerfCounters &) = delete;
+
+    PerfCounters(const PerfCounters &&) = delete;
+
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    PerfCounters &operator=(const PerfCounters &&) = delete;
+
+  private:
+    std::array<int, NUM_COUNTERS> fds_;
+  };
+}
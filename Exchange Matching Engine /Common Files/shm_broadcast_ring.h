@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "macros.h"
+#include "time_utils.h"
+
+namespace Common {
+  /// Identifies an initialized ShmBroadcastRing segment.
+  constexpr uint64_t SHM_BROADCAST_RING_MAGIC = 0x474e495254534342; // "BCSTRING"
+
+  /// Single producer, any number of consumers ring of variable sized messages in a POSIX shared memory segment.
+  /// The producer never waits: it overwrites the oldest slot, and every consumer reads at its own pace straight out of the segment.
+  /// Each slot carries the number of the message in it, so a consumer that fell a whole ring behind, or whose message was overwritten
+  /// while it was reading it, finds out and can resynchronize. Messages are numbered from 0 in the order they were published.
+  /// Messages are copied in and read with plain memory accesses inside a sequence lock, which is only safe with x86 memory ordering.
+  class ShmBroadcastRing final {
+  public:
+    /// The producer creates the segment with num_slots slots of up to slot_size bytes, replacing any segment of the same name.
+    ShmBroadcastRing(const std::string &name, size_t num_slots, size_t slot_size)
+        : name_(name) {
+      ASSERT((num_slots & (num_slots - 1)) == 0, "ShmBroadcastRing size must be power of 2");
+
+      shm_unlink(name_.c_str());
+      const auto fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+      ASSERT(fd >= 0, "shm_open() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+
+      // Slots start on cache lines, so the producer writing one does not disturb consumers reading its neighbours.
+      const auto slot_bytes = (sizeof(Slot) + slot_size + 63) / 64 * 64;
+      map_bytes_ = sizeof(Header) + num_slots * slot_bytes;
+      ASSERT(ftruncate(fd, map_bytes_) == 0, "ftruncate() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      map(fd, PROT_READ | PROT_WRITE);
+
+      header_->num_slots_ = num_slots;
+      header_->slot_size_ = slot_size;
+      header_->slot_bytes_ = slot_bytes;
+      header_->producer_pid_ = getpid();
+      owner_ = true;
+
+      // Consumers only use the segment once the magic is visible.
+      header_->magic_.store(SHM_BROADCAST_RING_MAGIC, std::memory_order_release);
+    }
+
+    /// A consumer attaches read only to an existing segment, valid() is false if the producer has not created it yet.
+    explicit ShmBroadcastRing(const std::string &name)
+        : name_(name) {
+      const auto fd = shm_open(name_.c_str(), O_RDONLY, 0);
+      if (fd < 0) {
+        ASSERT(errno == ENOENT, "shm_open() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+        return;
+      }
+
+      struct stat shm_stat;
+      ASSERT(fstat(fd, &shm_stat) == 0, "fstat() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      if (static_cast<size_t>(shm_stat.st_size) < sizeof(Header)) {
+        close(fd);
+        return;
+      }
+
+      map_bytes_ = shm_stat.st_size;
+      map(fd, PROT_READ);
+      if (header_->magic_.load(std::memory_order_acquire) != SHM_BROADCAST_RING_MAGIC) {
+        unmap();
+        return;
+      }
+      ASSERT(map_bytes_ == sizeof(Header) + header_->num_slots_ * header_->slot_bytes_, "ShmBroadcastRing:" + name_ + " has an unexpected size.");
+    }
+
+    /// The producer removes the segment name, the memory goes away once every consumer detaches as well.
+    ~ShmBroadcastRing() {
+      if (owner_) {
+        shm_unlink(name_.c_str());
+      }
+      unmap();
+    }
+
+    auto valid() const noexcept {
+      return header_ != nullptr;
+    }
+
+    /// Copy len bytes, at most slotSize(), into the oldest slot as the next message.
+    auto publish(const void *data, size_t len) noexcept {
+      const auto seq = header_->published_.load(std::memory_order_relaxed);
+      auto slot = slotAt(seq);
+
+      // Readers of the slot's previous message see it change before any of its bytes do. The message is copied in with plain stores,
+      // which the C++ memory model only orders after the INVALID_SEQ store if they were atomic. This relies on x86 not reordering stores
+      // with other stores, and on the fence keeping the compiler from moving the copy above it. Consumers read the message in place
+      // with plain loads and rely on the same guarantee for loads, see read().
+      slot->seq_.store(INVALID_SEQ, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot->len_ = len;
+      memcpy(reinterpret_cast<char *>(slot + 1), data, len);
+      slot->seq_.store(seq, std::memory_order_release);
+
+      header_->published_.store(seq + 1, std::memory_order_release);
+    }
+
+    /// Number of messages published so far, the next one published is numbered published().
+    auto published() const noexcept {
+      return header_->published_.load(std::memory_order_acquire);
+    }
+
+    auto numSlots() const noexcept {
+      return header_->num_slots_;
+    }
+
+    auto slotSize() const noexcept {
+      return header_->slot_size_;
+    }
+
+    /// Call visit(data, len) on message seq in place, and return whether it was intact: false if it was overwritten before or while visit
+    /// read it, in which case visit must discard everything it read. The slot is readable slotSize() bytes past data.
+    /// visit reads the message with plain loads, which x86 keeps in order with the sequence number loads around them, see publish().
+    template<typename F>
+    auto read(size_t seq, F &&visit) const noexcept {
+      const auto slot = slotAt(seq);
+      if (slot->seq_.load(std::memory_order_acquire) != seq) {
+        return false;
+      }
+      visit(reinterpret_cast<const char *>(slot + 1), std::min(slot->len_, header_->slot_size_));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return slot->seq_.load(std::memory_order_relaxed) == seq;
+    }
+
+    auto producerPid() const noexcept {
+      return header_->producer_pid_;
+    }
+
+    /// False once the producer process has exited.
+    auto producerAlive() const noexcept {
+      return kill(header_->producer_pid_, 0) == 0 || errno != ESRCH;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    ShmBroadcastRing() = delete;
+
+    ShmBroadcastRing(const ShmBroadcastRing &) = delete;
+
+    ShmBroadcastRing(const ShmBroadcastRing &&) = delete;
+
+    ShmBroadcastRing &operator=(const ShmBroadcastRing &) = delete;
+
+    ShmBroadcastRing &operator=(const ShmBroadcastRing &&) = delete;
+
+  private:
+    /// Start of the shared memory segment, followed by num_slots_ slots of slot_bytes_ each.
+    struct Header {
+      std::atomic<uint64_t> magic_ = {0};
+      size_t num_slots_ = 0;
+      size_t slot_size_ = 0;
+      size_t slot_bytes_ = 0;
+      pid_t producer_pid_ = 0;
+
+      alignas(64) std::atomic<size_t> published_ = {0};
+    };
+
+    /// Start of a slot, followed by its message.
+    struct alignas(64) Slot {
+      std::atomic<size_t> seq_ = {0};
+      size_t len_ = 0;
+    };
+    static_assert(std::atomic<size_t>::is_always_lock_free, "ShmBroadcastRing sequence numbers must be lock free to be shared between processes.");
+    static_assert(sizeof(Header) % 64 == 0, "ShmBroadcastRing slots must start on cache lines.");
+
+    /// Marks a slot being written, and a slot never written is zero filled and so holds message 0 as far as its sequence number goes -
+    /// published() tells the two apart, as message 0 is only readable once published() is past it.
+    static constexpr size_t INVALID_SEQ = std::numeric_limits<size_t>::max();
+
+    const std::string name_;
+    size_t map_bytes_ = 0;
+    Header *header_ = nullptr;
+
+    /// Set in the producer that created the segment.
+    bool owner_ = false;
+
+  private:
+    auto slotAt(size_t seq) const noexcept -> Slot * {
+      return reinterpret_cast<Slot *>(reinterpret_cast<char *>(header_ + 1) + (seq & (header_->num_slots_ - 1)) * header_->slot_bytes_);
+    }
+
+    auto map(int fd, int prot) -> void {
+      const auto map = mmap(nullptr, map_bytes_, prot, MAP_SHARED, fd, 0);
+      ASSERT(map != MAP_FAILED, "mmap() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      close(fd);
+
+      header_ = static_cast<Header *>(map);
+    }
+
+    auto unmap() noexcept -> void {
+      if (header_) {
+        munmap(header_, map_bytes_);
+        header_ = nullptr;
+      }
+    }
+  };
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "macros.h"
+#include "time_utils.h"
+
+namespace Common {
+  /// Identifies an initialized ShmQueue segment.
+  constexpr uint64_t SHM_QUEUE_MAGIC = 0x45554555514d4853; // "SHMQUEUE"
+
+  /// Single producer single consumer lock free queue in a POSIX shared memory segment, for passing trivially copyable
+  /// elements between two processes on the same box. It mirrors LFQueue, the positions live in the segment so either side can restart,
+  /// and the producer also publishes its pid and a heartbeat so the consumer can tell a quiet producer from a dead or hung one.
+  template<typename T>
+  class ShmQueue final {
+  public:
+    /// The producer creates the segment with capacity num_elems, replacing any segment of the same name.
+    /// A consumer still attached to the replaced segment keeps its mapping until it attaches again.
+    ShmQueue(const std::string &name, std::size_t num_elems)
+        : name_(name) {
+      ASSERT((num_elems & (num_elems - 1)) == 0, "ShmQueue size must be power of 2");
+
+      shm_unlink(name_.c_str());
+      const auto fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      ASSERT(fd >= 0, "shm_open() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+
+      map_bytes_ = sizeof(Header) + num_elems * sizeof(T);
+      ASSERT(ftruncate(fd, map_bytes_) == 0, "ftruncate() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      map(fd);
+
+      header_->capacity_ = num_elems;
+      header_->elem_size_ = sizeof(T);
+      header_->producer_pid_ = getpid();
+      header_->heartbeat_.store(getCurrentNanos(), std::memory_order_relaxed);
+      owner_ = true;
+
+      // Consumers only use the segment once the magic is visible.
+      header_->magic_.store(SHM_QUEUE_MAGIC, std::memory_order_release);
+    }
+
+    /// The consumer attaches to an existing segment, valid() is false if the producer has not created it yet.
+    explicit ShmQueue(const std::string &name)
+        : name_(name) {
+      const auto fd = shm_open(name_.c_str(), O_RDWR, 0600);
+      if (fd < 0) {
+        ASSERT(errno == ENOENT, "shm_open() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+        return;
+      }
+
+      struct stat shm_stat;
+      ASSERT(fstat(fd, &shm_stat) == 0, "fstat() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      if (static_cast<size_t>(shm_stat.st_size) < sizeof(Header)) {
+        close(fd);
+        return;
+      }
+
+      map_bytes_ = shm_stat.st_size;
+      map(fd);
+      if (header_->magic_.load(std::memory_order_acquire) != SHM_QUEUE_MAGIC) {
+        unmap();
+        return;
+      }
+      ASSERT(header_->elem_size_ == sizeof(T) && map_bytes_ == sizeof(Header) + header_->capacity_ * sizeof(T),
+             "ShmQueue:" + name_ + " has a different element type.");
+    }
+
+    /// The producer removes the segment name, the memory goes away once the consumer detaches as well.
+    ~ShmQueue() {
+      if (owner_) {
+        shm_unlink(name_.c_str());
+      }
+      unmap();
+    }
+
+    auto valid() const noexcept {
+      return header_ != nullptr;
+    }
+
+    /// Positions are ever increasing counters, they are only reduced modulo the capacity when indexing into the elements.
+    auto getNextToWriteTo() noexcept -> T * {
+      const auto current_write = header_->write_pos_.load(std::memory_order_relaxed);
+
+      if (current_write - header_->read_pos_.load(std::memory_order_acquire) >= header_->capacity_) {
+        return nullptr; // Queue full
+      }
+
+      return &store_[current_write & (header_->capacity_ - 1)];
+    }
+
+    auto updateWriteIndex() noexcept {
+      header_->write_pos_.store(header_->write_pos_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /// Reserve the slot after any slots already reserved, they are invisible to the consumer until commitWriteIndex() is called.
+    auto reserveNextToWriteTo() noexcept -> T * {
+      const auto next_write = header_->write_pos_.load(std::memory_order_relaxed) + num_reserved_;
+
+      if (next_write - header_->read_pos_.load(std::memory_order_acquire) >= header_->capacity_) {
+        return nullptr; // Queue full
+      }
+
+      ++num_reserved_;
+      return &store_[next_write & (header_->capacity_ - 1)];
+    }
+
+    /// Publish all reserved slots to the consumer with a single release store, returns the number of elements published.
+    auto commitWriteIndex() noexcept {
+      const auto num_committed = num_reserved_;
+      if (num_committed) {
+        header_->write_pos_.store(header_->write_pos_.load(std::memory_order_relaxed) + num_committed, std::memory_order_release);
+        num_reserved_ = 0;
+      }
+      return num_committed;
+    }
+
+    auto getNextToRead() const noexcept -> const T * {
+      const auto current_read = header_->read_pos_.load(std::memory_order_relaxed);
+
+      if (current_read == header_->write_pos_.load(std::memory_order_acquire)) {
+        return nullptr; // Queue empty
+      }
+
+      return &store_[current_read & (header_->capacity_ - 1)];
+    }
+
+    auto updateReadIndex() noexcept {
+      header_->read_pos_.store(header_->read_pos_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    auto size() const noexcept -> size_t {
+      return header_->write_pos_.load(std::memory_order_relaxed) - header_->read_pos_.load(std::memory_order_relaxed);
+    }
+
+    /// Called periodically by the producer to show it is alive.
+    auto heartbeat(Nanos now) noexcept {
+      header_->heartbeat_.store(now, std::memory_order_relaxed);
+    }
+
+    auto lastHeartbeat() const noexcept {
+      return header_->heartbeat_.load(std::memory_order_relaxed);
+    }
+
+    auto producerPid() const noexcept {
+      return header_->producer_pid_;
+    }
+
+    /// False once the producer process has exited, a hung producer is still alive - compare lastHeartbeat() against a timeout for that.
+    auto producerAlive() const noexcept {
+      return kill(header_->producer_pid_, 0) == 0 || errno != ESRCH;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    ShmQueue() = delete;
+
+    ShmQueue(const ShmQueue &) = delete;
+
+    ShmQueue(const ShmQueue &&) = delete;
+
+    ShmQueue &operator=(const ShmQueue &) = delete;
+
+    ShmQueue &operator=(const ShmQueue &&) = delete;
+
+  private:
+    /// Start of the shared memory segment, followed by capacity_ elements.
+    struct Header {
+      std::atomic<uint64_t> magic_ = {0};
+      size_t capacity_ = 0;
+      size_t elem_size_ = 0;
+      pid_t producer_pid_ = 0;
+
+      alignas(64) std::atomic<Nanos> heartbeat_ = {0};
+      alignas(64) std::atomic<size_t> write_pos_ = {0};
+      alignas(64) std::atomic<size_t> read_pos_ = {0};
+    };
+    static_assert(std::atomic<size_t>::is_always_lock_free && std::atomic<Nanos>::is_always_lock_free,
+                  "ShmQueue positions must be lock free to be shared between processes.");
+
+    const std::string name_;
+    size_t map_bytes_ = 0;
+    Header *header_ = nullptr;
+    T *store_ = nullptr;
+
+    /// Set in the producer that created the segment.
+    bool owner_ = false;
+
+    /// Producer side count of slots handed out by reserveNextToWriteTo() and not yet published.
+    size_t num_reserved_ = 0;
+
+  private:
+    auto map(int fd) -> void {
+      const auto map = mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      ASSERT(map != MAP_FAILED, "mmap() failed on:" + name_ + " error:" + std::string(std::strerror(errno)));
+      close(fd);
+
+      header_ = static_cast<Header *>(map);
+      store_ = reinterpret_cast<T *>(static_cast<char *>(map) + sizeof(Header));
+    }
+
+    auto unmap() noexcept -> void {
+      if (header_) {
+        munmap(header_, map_bytes_);
+        header_ = nullptr;
+        store_ = nullptr;
+      }
+    }
+  };
+}
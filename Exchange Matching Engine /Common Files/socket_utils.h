@@ -34,6 +34,9 @@ namespace Common {
     bool is_listening_ = false;
     bool needs_so_timestamp_ =  false;
 
+    /// Let several listening sockets bind the same port, the kernel spreads new connections across them.
+    bool reuse_port_ = false;
+
     auto toString() const {
       std::stringstream ss;
       ss << "SocketCfg[ip:" << ip_
@@ -42,6 +45,7 @@ namespace Common {
       << " is_udp:" << is_udp_
       << " is_listening:" << is_listening_
       << " needs_SO_timestamp:" << needs_so_timestamp_
+      << " reuse_port:" << reuse_port_
       << "]";
 
       return ss.str();
@@ -83,10 +87,14 @@ namespace Common {
     return (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<void *>(&one), sizeof(one)) != -1);
   }
 
-  /// Allow software receive timestamps on incoming packets.
+  /// Allow software receive timestamps on incoming packets, nanosecond SCM_TIMESTAMPNS where supported and microsecond SCM_TIMESTAMP otherwise.
   inline auto setSOTimestamp(int fd) -> bool {
     int one = 1;
+#ifdef SO_TIMESTAMPNS
+    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, reinterpret_cast<void *>(&one), sizeof(one)) != -1);
+#else
     return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, reinterpret_cast<void *>(&one), sizeof(one)) != -1);
+#endif
   }
 
   /// Add / Join membership / subscription to the multicast stream specified and on the interface specified.
@@ -130,6 +138,10 @@ namespace Common {
         ASSERT(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&one), sizeof(one)) == 0, "setsockopt() SO_REUSEADDR failed. errno:" + std::string(strerror(errno)));
       }
 
+      if (socket_cfg.is_listening_ && socket_cfg.reuse_port_) {
+        ASSERT(setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char *>(&one), sizeof(one)) == 0, "setsockopt() SO_REUSEPORT failed. errno:" + std::string(strerror(errno)));
+      }
+
       if (socket_cfg.is_listening_) {
         // bind to the specified port number.
         sockaddr_in addr{};
@@ -13,8 +13,79 @@ namespace Common {
 #endif
   }
 
+  /// Ask for EPOLLOUT on a socket only while it has data the kernel did not take, and stop sending to it until then.
+  auto TCPServer::updateWriteInterest(TCPSocket *socket) noexcept -> void {
+    if (UNLIKELY(socket->disconnected())) {
+      return;
+    }
+
+    // A socket that was allowed to send and still has a backlog filled its kernel send buffer.
+    const auto want_write = (socket->sendBacklog() > 0);
+    socket->send_blocked_ = want_write;
+    if (want_write == socket->write_interest_) {
+      return;
+    }
+
+#ifdef __APPLE__
+    struct kevent ev;
+    EV_SET(&ev, socket->socket_fd_, EVFILT_WRITE, want_write ? (EV_ADD | EV_ENABLE | EV_CLEAR) : EV_DELETE, 0, 0, socket);
+    const auto ok = (kevent(kqueue_fd_, &ev, 1, nullptr, 0, nullptr) != -1);
+#else
+    epoll_event ev{EPOLLET | EPOLLIN | (want_write ? EPOLLOUT : 0u), {reinterpret_cast<void *>(socket)}};
+    const auto ok = !epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket->socket_fd_, &ev);
+#endif
+    ASSERT(ok, "Unable to update write interest on socket:" + std::to_string(socket->socket_fd_) + " error:" + std::string(std::strerror(errno)));
+    socket->write_interest_ = want_write;
+
+    logger_.log("%:% %() % socket:% write-interest:% backlog:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, want_write, socket->sendBacklog());
+  }
+
+  /// Queue a socket to be read from / flushed on the next sendAndRecv(), each socket is queued at most once.
+  auto TCPServer::markReadReady(TCPSocket *socket) noexcept -> void {
+    if (!socket->read_ready_) {
+      socket->read_ready_ = true;
+      receive_sockets_.push_back(socket);
+    }
+  }
+
+  auto TCPServer::markFlushReady(TCPSocket *socket) noexcept -> void {
+    if (!socket->flush_ready_) {
+      socket->flush_ready_ = true;
+      send_sockets_.push_back(socket);
+    }
+  }
+
+  /// Stop tracking sockets closed since the last call and return them to the pool.
+  auto TCPServer::removeDisconnected() noexcept -> void {
+    const auto disconnected = [](auto socket) { return socket->disconnected(); };
+    receive_sockets_.erase(std::remove_if(receive_sockets_.begin(), receive_sockets_.end(), disconnected), receive_sockets_.end());
+    send_sockets_.erase(std::remove_if(send_sockets_.begin(), send_sockets_.end(), disconnected), send_sockets_.end());
+
+    for (auto socket : disconnected_sockets_) {
+      const auto session = std::find(sessions_.begin(), sessions_.end(), socket);
+      if (UNLIKELY(session == sessions_.end())) { // reported more than once, already returned to the pool.
+        continue;
+      }
+      sessions_.erase(session);
+      if (disconnected_callback_) {
+        disconnected_callback_(socket);
+      }
+      socket->reset();
+#ifndef __APPLE__
+      if (socket->uring_ops_) { // the kernel still holds requests naming this socket, it is reused once they complete.
+        closing_sessions_.push_back(socket);
+        continue;
+      }
+#endif
+      free_sessions_.push_back(socket);
+    }
+    disconnected_sockets_.clear();
+  }
+
   /// Start listening for connections on the provided interface and port.
-  auto TCPServer::listen(const std::string &iface, int port) -> void {
+  auto TCPServer::listen(const std::string &iface, int port, bool reuse_port) -> void {
+    logger_.log("%:% %() % backend:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), tcpServerBackendToString(backend_));
 #ifdef __APPLE__
     kqueue_fd_ = kqueue();
     ASSERT(kqueue_fd_ >= 0, "kqueue() failed error:" + std::string(std::strerror(errno)));
@@ -23,32 +94,66 @@ namespace Common {
     ASSERT(epoll_fd_ >= 0, "epoll_create() failed error:" + std::string(std::strerror(errno)));
 #endif
 
-    ASSERT(listener_socket_.connect("", iface, port, true) >= 0,
+    ASSERT(listener_socket_.connect("", iface, port, true, reuse_port) >= 0,
            "Listener socket failed to connect. iface:" + iface + " port:" + std::to_string(port) + " error:" +
            std::string(std::strerror(errno)));
 
+#ifndef __APPLE__
+    if (backend_ == TCPServerBackend::IO_URING) {
+      uringListen();
+      return;
+    }
+#endif
     ASSERT(addToEpollList(&listener_socket_), "event list add failed. error:" + std::string(std::strerror(errno)));
   }
 
-  /// Publish outgoing data from the send buffer and read incoming data from the receive buffer.
+  /// Read incoming data from the sockets epoll reported as readable and publish outgoing data on the sockets that have some queued.
+  /// Only those sockets are serviced, idle sessions cost nothing.
   auto TCPServer::sendAndRecv() noexcept -> void {
+#ifndef __APPLE__
+    if (backend_ == TCPServerBackend::IO_URING) {
+      uringSendAndRecv();
+      return;
+    }
+#endif
     auto recv = false;
 
-    std::for_each(receive_sockets_.begin(), receive_sockets_.end(), [&recv](auto socket) {
+    // Each socket is read until the kernel has no more data, since EPOLLET will not report the data already there again.
+    // One whose receive ring filled up first stays queued for the next call.
+    size_t still_ready = 0;
+    for (auto socket : receive_sockets_) {
       recv |= socket->sendAndRecv();
-    });
+      updateWriteInterest(socket);
+      if (UNLIKELY(socket->read_ready_ && !socket->disconnected())) {
+        receive_sockets_[still_ready++] = socket;
+      }
+    }
+    receive_sockets_.resize(still_ready);
 
     if (recv) // There were some events and they have all been dispatched, inform listener.
       recv_finished_callback_();
 
-    std::for_each(send_sockets_.begin(), send_sockets_.end(), [](auto socket) {
-      socket->sendAndRecv();
-    });
+    for (auto socket : send_sockets_) {
+      socket->flush_ready_ = false;
+      socket->flush();
+      updateWriteInterest(socket);
+    }
+    send_sockets_.clear();
+
+    if (UNLIKELY(!disconnected_sockets_.empty())) {
+      removeDisconnected();
+    }
   }
 
   /// Check for new connections or dead connections and update containers that track the sockets.
   auto TCPServer::poll() noexcept -> void {
-    const int max_events = 1 + send_sockets_.size() + receive_sockets_.size();
+#ifndef __APPLE__
+    if (backend_ == TCPServerBackend::IO_URING) {
+      uringPoll();
+      return;
+    }
+#endif
+    const int max_events = std::min(1 + sessions_.size(), sizeof(events_) / sizeof(events_[0]));
 
 #ifdef __APPLE__
     struct timespec timeout = {0, 0}; // Non-blocking
@@ -68,22 +173,21 @@ namespace Common {
         }
         logger_.log("%:% %() % EVFILT_READ socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-          receive_sockets_.push_back(socket);
+        markReadReady(socket);
       }
 
       if (event.filter == EVFILT_WRITE) {
         logger_.log("%:% %() % EVFILT_WRITE socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(send_sockets_.begin(), send_sockets_.end(), socket) == send_sockets_.end())
-          send_sockets_.push_back(socket);
+        socket->send_blocked_ = false;
+        markFlushReady(socket);
       }
 
+      // Reading a closed or failed connection returns 0 or the error, which closes the socket and removes it.
       if (event.flags & (EV_EOF | EV_ERROR)) {
         logger_.log("%:% %() % EV_ERROR socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-          receive_sockets_.push_back(socket);
+        markReadReady(socket);
       }
     }
 #else
@@ -103,22 +207,21 @@ namespace Common {
         }
         logger_.log("%:% %() % EPOLLIN socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-          receive_sockets_.push_back(socket);
+        markReadReady(socket);
       }
 
       if (event.events & EPOLLOUT) {
         logger_.log("%:% %() % EPOLLOUT socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(send_sockets_.begin(), send_sockets_.end(), socket) == send_sockets_.end())
-          send_sockets_.push_back(socket);
+        socket->send_blocked_ = false;
+        markFlushReady(socket);
       }
 
+      // Reading a closed or failed connection returns 0 or the error, which closes the socket and removes it.
       if (event.events & (EPOLLERR | EPOLLHUP)) {
         logger_.log("%:% %() % EPOLLERR socket:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), socket->socket_fd_);
-        if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-          receive_sockets_.push_back(socket);
+        markReadReady(socket);
       }
     }
 #endif
@@ -133,19 +236,40 @@ namespace Common {
       if (fd == -1)
         break;
 
-      ASSERT(setNonBlocking(fd) && disableNagle(fd),
-             "Failed to set non-blocking or no-delay on socket:" + std::to_string(fd));
-
-      logger_.log("%:% %() % accepted socket:%\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), fd);
-
-      auto socket = new TCPSocket(logger_);
-      socket->socket_fd_ = fd;
-      socket->recv_callback_ = recv_callback_;
+      ASSERT(setNonBlocking(fd), "Failed to set non-blocking on socket:" + std::to_string(fd));
+      auto socket = addSession(fd);
+      if (UNLIKELY(!socket)) {
+        continue;
+      }
       ASSERT(addToEpollList(socket), "Unable to add socket. error:" + std::string(std::strerror(errno)));
 
-      if (std::find(receive_sockets_.begin(), receive_sockets_.end(), socket) == receive_sockets_.end())
-        receive_sockets_.push_back(socket);
+      markReadReady(socket); // anything sent before it was added to the epoll list.
     }
   }
+
+  /// Take a socket from the pool for a newly accepted connection and start tracking it, returns nullptr and closes fd if the pool is empty.
+  auto TCPServer::addSession(int fd) noexcept -> TCPSocket * {
+    if (UNLIKELY(free_sessions_.empty())) {
+      logger_.log("%:% %() % refusing socket:%, all % sessions in use.\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), fd, sessions_.size());
+      close(fd);
+      return nullptr;
+    }
+
+    ASSERT(disableNagle(fd) && setSOTimestamp(fd), "Failed to set no-delay or receive timestamps on socket:" + std::to_string(fd));
+
+    logger_.log("%:% %() % accepted socket:% backend:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), fd, tcpServerBackendToString(backend_));
+
+    auto socket = free_sessions_.back();
+    free_sessions_.pop_back();
+    socket->socket_fd_ = fd;
+    socket->recv_callback_ = recv_callback_;
+    socket->send_queue_cfg_ = send_queue_cfg_;
+    socket->send_queued_callback_ = [this](auto socket) { markFlushReady(socket); };
+    socket->disconnected_callback_ = [this](auto socket) { disconnected_sockets_.push_back(socket); };
+    sessions_.push_back(socket);
+
+    return socket;
+  }
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "tcp_socket.h"
 
 #ifdef __APPLE__
@@ -7,28 +9,90 @@
 #define MAX_EVENTS 1024
 #else
 #include <sys/epoll.h>
+#include "io_uring.h"
 #endif
 
 namespace Common {
+  /// How a TCPServer waits for and moves socket data.
+  enum class TCPServerBackend : uint8_t {
+    EPOLL = 0, // readiness from epoll / kqueue, then one recvmsg / send system call per socket.
+    IO_URING = 1 // multishot accept and recvmsg into kernel picked buffers, sends submitted in one batch per loop. Linux only.
+  };
+
+  inline auto tcpServerBackendToString(TCPServerBackend backend) -> std::string {
+    switch (backend) {
+      case TCPServerBackend::EPOLL:
+        return "EPOLL";
+      case TCPServerBackend::IO_URING:
+        return "IO_URING";
+    }
+
+    return "UNKNOWN";
+  }
+
   struct TCPServer {
-    explicit TCPServer(Logger &logger)
-        : listener_socket_(logger), logger_(logger) {
+    /// Sessions come from a pool of max_sessions sockets created up front, connections beyond that are refused.
+    TCPServer(Logger &logger, size_t max_sessions, TCPServerBackend backend = TCPServerBackend::EPOLL)
+        : backend_(backend), listener_socket_(logger), logger_(logger) {
+#ifdef __APPLE__
+      ASSERT(backend_ == TCPServerBackend::EPOLL, "TCPServer backend " + tcpServerBackendToString(backend_) + " is not supported on this platform.");
+#endif
+      free_sessions_.reserve(max_sessions);
+      for (size_t i = 0; i < max_sessions; ++i) {
+        free_sessions_.push_back(new TCPSocket(logger_));
+      }
     }
 
-    /// Start listening for connections on the provided interface and port.
-    auto listen(const std::string &iface, int port) -> void;
+    /// Start listening for connections on the provided interface and port, with reuse_port alongside other servers listening on the same port.
+    auto listen(const std::string &iface, int port, bool reuse_port = false) -> void;
 
     /// Check for new connections or dead connections and update containers that track the sockets.
     auto poll() noexcept -> void;
 
-    /// Publish outgoing data from the send buffer and read incoming data from the receive buffer.
+    /// Read incoming data from the sockets epoll reported as readable and publish outgoing data on the sockets that have some queued.
     auto sendAndRecv() noexcept -> void;
 
   private:
     /// Add and remove socket file descriptors to and from the EPOLL/KQUEUE list.
     auto addToEpollList(TCPSocket *socket);
 
+    /// Ask for EPOLLOUT on a socket only while it has data the kernel did not take, and stop sending to it until then.
+    auto updateWriteInterest(TCPSocket *socket) noexcept -> void;
+
+    /// Queue a socket to be read from / flushed on the next sendAndRecv(), each socket is queued at most once.
+    auto markReadReady(TCPSocket *socket) noexcept -> void;
+
+    auto markFlushReady(TCPSocket *socket) noexcept -> void;
+
+    /// Take a socket from the pool for a newly accepted connection and start tracking it, returns nullptr and closes fd if the pool is empty.
+    auto addSession(int fd) noexcept -> TCPSocket *;
+
+    /// Stop tracking sockets closed since the last call and return them to the pool.
+    auto removeDisconnected() noexcept -> void;
+
+#ifndef __APPLE__
+    /// The io_uring backend, in tcp_server_io_uring.cpp.
+    auto uringListen() -> void;
+
+    auto uringPoll() noexcept -> void;
+
+    auto uringSendAndRecv() noexcept -> void;
+
+    /// Next submission entry for an operation of type op on socket, submitting what is queued first if the submission ring is full.
+    auto uringSqe(TCPSocket *socket, uint64_t op) noexcept -> io_uring_sqe *;
+
+    auto uringArmAccept() noexcept -> void;
+
+    auto uringArmRecv(TCPSocket *socket) noexcept -> void;
+
+    auto uringRecvCompleted(TCPSocket *socket, const io_uring_cqe &cqe) noexcept -> void;
+
+    auto uringSendCompleted(TCPSocket *socket, const io_uring_cqe &cqe) noexcept -> void;
+#endif
+
   public:
+    const TCPServerBackend backend_;
+
     /// Socket on which this server is listening for new connections on.
 #ifdef __APPLE__
     int kqueue_fd_ = -1;
@@ -39,14 +103,36 @@ namespace Common {
 #endif
     TCPSocket listener_socket_;
 
-    /// Collection of all sockets, sockets for incoming data, sockets for outgoing data and dead connections.
-    std::vector<TCPSocket *> receive_sockets_, send_sockets_;
+    /// Every connected socket, sockets with incoming data to read, sockets with outgoing data to publish and sockets closed since the last sendAndRecv().
+    std::vector<TCPSocket *> sessions_, receive_sockets_, send_sockets_, disconnected_sockets_;
+
+    /// Send queue limits and slow consumer policy of every accepted socket.
+    SendQueueCfg send_queue_cfg_;
 
     /// Function wrapper to call back when data is available.
     std::function<void(TCPSocket *s, Nanos rx_time)> recv_callback_ = nullptr;
     /// Function wrapper to call back when all data across all TCPSockets has been read and dispatched this round.
     std::function<void()> recv_finished_callback_ = nullptr;
 
+    /// Function wrapper to call back when a socket was closed, just before it goes back to the pool to be reused for another connection.
+    std::function<void(TCPSocket *s)> disconnected_callback_ = nullptr;
+
+    /// Sockets not in use by a connection.
+    std::vector<TCPSocket *> free_sessions_;
+
+#ifndef __APPLE__
+    std::unique_ptr<IoUring> uring_;
+
+    /// recvmsg template for every multishot receive: no address, room for the receive timestamp.
+    msghdr uring_recv_msg_{};
+
+    /// Set when poll() dispatched data, so sendAndRecv() calls recv_finished_callback_.
+    bool uring_received_ = false;
+
+    /// Closed sockets with requests still in flight, they go back to the pool once the kernel completed all of them.
+    std::vector<TCPSocket *> closing_sessions_;
+#endif
+
     std::string time_str_;
     Logger &logger_;
   };
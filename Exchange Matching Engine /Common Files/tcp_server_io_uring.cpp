@@ -0,0 +1,210 @@
+#include "tcp_server.h"
+
+#ifndef __APPLE__
+
+/// The io_uring backend of TCPServer. The listener has one multishot accept and every session one multishot recvmsg armed at all times,
+/// the kernel receives into buffers it picks from a shared buffer ring and posts a completion per read, so nothing is polled per socket.
+/// Sends are queued as submission entries and handed over together with everything else in a single io_uring_enter per loop.
+
+namespace Common {
+  /// Entries in the submission ring, completions get twice as many.
+  constexpr unsigned URING_ENTRIES = 1024;
+
+  /// Receive buffers the kernel picks from, a read never returns more than one buffer minus the recvmsg header.
+  constexpr uint16_t URING_RECV_BUFFER_GROUP = 0;
+  constexpr unsigned URING_NUM_RECV_BUFFERS = 1024;
+  constexpr unsigned URING_RECV_BUFFER_SIZE = 16 * 1024;
+
+  /// Type of operation in the low bits of a request's user_data, the rest is the TCPSocket it is for.
+  constexpr uint64_t URING_OP_ACCEPT = 1;
+  constexpr uint64_t URING_OP_RECV = 2;
+  constexpr uint64_t URING_OP_SEND = 3;
+  constexpr uint64_t URING_OP_MASK = 7;
+
+  auto TCPServer::uringListen() -> void {
+    uring_ = std::make_unique<IoUring>(URING_ENTRIES);
+    uring_->registerBufferRing(URING_RECV_BUFFER_GROUP, URING_NUM_RECV_BUFFERS, URING_RECV_BUFFER_SIZE);
+
+    // Only the lengths of the template are used, the kernel lays the control messages out in each picked buffer.
+    uring_recv_msg_.msg_controllen = CMSG_SPACE(sizeof(struct timespec));
+
+    uringArmAccept();
+    uring_->submit();
+  }
+
+  /// Next submission entry for an operation of type op on socket, submitting what is queued first if the submission ring is full.
+  auto TCPServer::uringSqe(TCPSocket *socket, uint64_t op) noexcept -> io_uring_sqe * {
+    auto sqe = uring_->getSqe();
+    if (UNLIKELY(!sqe)) {
+      uring_->submit();
+      sqe = uring_->getSqe();
+      ASSERT(sqe, "io_uring submission ring still full after submitting.");
+    }
+    sqe->user_data = reinterpret_cast<uint64_t>(socket) | op;
+    ++socket->uring_ops_;
+
+    return sqe;
+  }
+
+  auto TCPServer::uringArmAccept() noexcept -> void {
+    auto sqe = uringSqe(&listener_socket_, URING_OP_ACCEPT);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener_socket_.socket_fd_;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  }
+
+  auto TCPServer::uringArmRecv(TCPSocket *socket) noexcept -> void {
+    auto sqe = uringSqe(socket, URING_OP_RECV);
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket->socket_fd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&uring_recv_msg_);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_RECV_BUFFER_GROUP;
+  }
+
+  /// A read into a kernel picked buffer: recvmsg header, the control messages with the receive timestamp, then the data.
+  auto TCPServer::uringRecvCompleted(TCPSocket *socket, const io_uring_cqe &cqe) noexcept -> void {
+    const auto more = (cqe.flags & IORING_CQE_F_MORE);
+    size_t payload_len = 0;
+
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      const auto buffer_id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+      auto buffer = uring_->buffer(URING_RECV_BUFFER_GROUP, buffer_id);
+
+      if (cqe.res > 0 && !socket->disconnected()) {
+        const auto out = reinterpret_cast<const io_uring_recvmsg_out *>(buffer);
+        const auto control = buffer + sizeof(io_uring_recvmsg_out) + uring_recv_msg_.msg_namelen;
+        const auto payload = control + uring_recv_msg_.msg_controllen;
+        payload_len = out->payloadlen;
+
+        if (UNLIKELY(payload_len > socket->inbound_.freeSpace())) { // there is no backpressure on a multishot receive.
+          socket->disconnect("receive ring overflow");
+        } else if (payload_len) {
+          msghdr msg{};
+          msg.msg_control = const_cast<char *>(control);
+          msg.msg_controllen = out->controllen;
+
+          memcpy(socket->inbound_.writeData(), payload, payload_len);
+          socket->inbound_.commitWrite(payload_len);
+          uring_received_ = true;
+          socket->dispatchRead(payload_len, kernelRxTime(&msg));
+        }
+      }
+      uring_->recycleBuffer(URING_RECV_BUFFER_GROUP, buffer_id);
+    }
+
+    if (socket->disconnected()) {
+      return;
+    }
+    if (cqe.res >= 0 && !payload_len) { // a read of 0 bytes is the end of the stream.
+      socket->disconnect("closed by peer");
+    } else if (!more) {
+      if (cqe.res > 0 || cqe.res == -ENOBUFS) { // the kernel ended it, ran out of buffers or will not stay armed: arm another.
+        uringArmRecv(socket);
+      } else {
+        socket->disconnect(strerror(-cqe.res));
+      }
+    }
+  }
+
+  auto TCPServer::uringSendCompleted(TCPSocket *socket, const io_uring_cqe &cqe) noexcept -> void {
+    socket->uring_send_in_flight_ = false;
+    if (socket->disconnected()) {
+      return;
+    }
+
+    logger_.log("%:% %() % send socket:% backlog:% sent:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                socket->socket_fd_, socket->sendBacklog(), cqe.res);
+    if (cqe.res > 0) {
+      socket->outbound_.consume(cqe.res);
+    } else if (cqe.res != -EAGAIN && cqe.res != -EINTR) {
+      socket->disconnect(strerror(-cqe.res));
+      return;
+    }
+    if (socket->sendBacklog()) { // a short send, queue the rest for the next submission.
+      markFlushReady(socket);
+    }
+  }
+
+  /// Dispatch every completion the kernel posted, this makes no system call.
+  auto TCPServer::uringPoll() noexcept -> void {
+    uring_->forEachCqe([this](const io_uring_cqe &cqe) {
+      auto socket = reinterpret_cast<TCPSocket *>(cqe.user_data & ~URING_OP_MASK);
+      const auto op = cqe.user_data & URING_OP_MASK;
+      if (!(cqe.flags & IORING_CQE_F_MORE)) { // the request is finished.
+        --socket->uring_ops_;
+      }
+
+      switch (op) {
+        case URING_OP_ACCEPT: {
+          if (cqe.res >= 0) {
+            if (auto session = addSession(cqe.res)) {
+              uringArmRecv(session);
+            }
+          } else {
+            logger_.log("%:% %() % accept failed error:%\n", __FILE__, __LINE__, __FUNCTION__,
+                        Common::getCurrentTimeStr(&time_str_), strerror(-cqe.res));
+          }
+          if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            uringArmAccept();
+          }
+        }
+          break;
+        case URING_OP_RECV:
+          uringRecvCompleted(socket, cqe);
+          break;
+        case URING_OP_SEND:
+          uringSendCompleted(socket, cqe);
+          break;
+      }
+    });
+    uring_->publishBuffers(URING_RECV_BUFFER_GROUP);
+
+    if (UNLIKELY(!closing_sessions_.empty())) {
+      size_t still_closing = 0;
+      for (auto socket : closing_sessions_) {
+        if (socket->uring_ops_) {
+          closing_sessions_[still_closing++] = socket;
+        } else {
+          free_sessions_.push_back(socket);
+        }
+      }
+      closing_sessions_.resize(still_closing);
+    }
+  }
+
+  /// Queue a send for every socket with data and none in flight, then submit all the queued requests with one system call.
+  auto TCPServer::uringSendAndRecv() noexcept -> void {
+    if (uring_received_) {
+      uring_received_ = false;
+      recv_finished_callback_();
+    }
+
+    for (auto socket : send_sockets_) {
+      socket->flush_ready_ = false;
+      if (socket->uring_send_in_flight_ || !socket->sendBacklog() || socket->disconnected()) {
+        continue; // the completion of the send in flight queues the socket again if more is left.
+      }
+
+      // The queued bytes are contiguous in the send ring and stay put until the completion consumes them.
+      auto sqe = uringSqe(socket, URING_OP_SEND);
+      sqe->opcode = IORING_OP_SEND;
+      sqe->fd = socket->socket_fd_;
+      sqe->addr = reinterpret_cast<uint64_t>(socket->outbound_.readData());
+      sqe->len = socket->sendBacklog();
+      sqe->msg_flags = MSG_NOSIGNAL;
+      socket->uring_send_in_flight_ = true;
+    }
+    send_sockets_.clear();
+
+    if (UNLIKELY(!disconnected_sockets_.empty())) {
+      removeDisconnected();
+    }
+
+    uring_->submit();
+  }
+}
+
+#endif
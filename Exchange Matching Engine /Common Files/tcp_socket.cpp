@@ -2,9 +2,9 @@
 
 namespace Common {
   /// Create TCPSocket with provided attributes to either listen-on / connect-to.
-  auto TCPSocket::connect(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int {
+  auto TCPSocket::connect(const std::string &ip, const std::string &iface, int port, bool is_listening, bool reuse_port) -> int {
     // Note that needs_so_timestamp=true for FIFOSequencer.
-    const SocketCfg socket_cfg{ip, iface, port, false, is_listening, true};
+    const SocketCfg socket_cfg{ip, iface, port, false, is_listening, true, reuse_port};
     socket_fd_ = createSocket(logger_, socket_cfg);
 
     socket_attrib_.sin_addr.s_addr = INADDR_ANY;
@@ -14,48 +14,170 @@ namespace Common {
     return socket_fd_;
   }
 
-  /// Called to publish outgoing data from the buffers as well as check for and callback if data is available in the read buffers.
-  auto TCPSocket::sendAndRecv() noexcept -> bool {
-    char ctrl[CMSG_SPACE(sizeof(struct timeval))];
-    auto cmsg = reinterpret_cast<struct cmsghdr *>(&ctrl);
-
-    iovec iov{inbound_data_.data() + next_rcv_valid_index_, TCPBufferSize - next_rcv_valid_index_};
-    msghdr msg{&socket_attrib_, sizeof(socket_attrib_), &iov, 1, ctrl, sizeof(ctrl), 0};
-
-    // Non-blocking call to read available data.
-    const auto read_size = recvmsg(socket_fd_, &msg, MSG_DONTWAIT);
-    if (read_size > 0) {
-      next_rcv_valid_index_ += read_size;
-
-      Nanos kernel_time = 0;
-      timeval time_kernel;
-      if (cmsg->cmsg_level == SOL_SOCKET &&
-          cmsg->cmsg_type == SCM_TIMESTAMP &&
-          cmsg->cmsg_len == CMSG_LEN(sizeof(time_kernel))) {
+  /// Kernel receive timestamp in the control messages of a recvmsg, 0 if there is none.
+  auto kernelRxTime(msghdr *msg) noexcept -> Nanos {
+    Nanos kernel_time = 0;
+    for (auto cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET) {
+        continue;
+      }
+#ifdef SCM_TIMESTAMPNS
+      if (cmsg->cmsg_type == SCM_TIMESTAMPNS && cmsg->cmsg_len == CMSG_LEN(sizeof(timespec))) {
+        timespec time_kernel;
+        memcpy(&time_kernel, CMSG_DATA(cmsg), sizeof(time_kernel));
+        kernel_time = time_kernel.tv_sec * NANOS_TO_SECS + time_kernel.tv_nsec;
+      }
+#endif
+      if (cmsg->cmsg_type == SCM_TIMESTAMP && cmsg->cmsg_len == CMSG_LEN(sizeof(timeval))) {
+        timeval time_kernel;
         memcpy(&time_kernel, CMSG_DATA(cmsg), sizeof(time_kernel));
         kernel_time = time_kernel.tv_sec * NANOS_TO_SECS + time_kernel.tv_usec * NANOS_TO_MICROS; // convert timestamp to nanoseconds.
       }
+    }
+
+    return kernel_time;
+  }
+
+  /// Call back for read_size bytes just added to inbound_ by a read the kernel stamped with kernel_time, 0 if it was not stamped.
+  auto TCPSocket::dispatchRead(size_t read_size, Nanos kernel_time) noexcept -> void {
+    const auto user_time = getCurrentNanos();
+    if (kernel_time) {
+      rx_delay_.add(user_time - kernel_time);
+    } else { // timestamps are not enabled on this socket, the time it was read at is the best we have.
+      kernel_time = user_time;
+    }
+    last_rx_time_ = kernel_time;
+
+    logger_.log("%:% %() % read socket:% len:% utime:% ktime:% diff:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), socket_fd_, inbound_.size(), user_time, kernel_time, (user_time - kernel_time));
+    recv_callback_(this, kernel_time);
 
-      const auto user_time = getCurrentNanos();
+    // Whatever the callback left is the start of a message still arriving. TCP stamps a read with the time its newest segment
+    // was received, so remember the stamp of the read its first bytes came in with.
+    if (inbound_.size() <= read_size) {
+      carried_rx_time_ = kernel_time;
+    }
+    carried_rcv_bytes_ = inbound_.size();
+  }
 
-      logger_.log("%:% %() % read socket:% len:% utime:% ktime:% diff:%\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), socket_fd_, next_rcv_valid_index_, user_time, kernel_time, (user_time - kernel_time));
-      recv_callback_(this, kernel_time);
+  /// Called to publish outgoing data from the buffers as well as check for and callback if data is available in the read buffers.
+  auto TCPSocket::sendAndRecv() noexcept -> bool {
+    if (UNLIKELY(disconnected())) {
+      return false;
     }
 
-    if (next_send_valid_index_ > 0) {
-      // Non-blocking call to send data.
-      const auto n = ::send(socket_fd_, outbound_data_.data(), next_send_valid_index_, MSG_DONTWAIT | MSG_NOSIGNAL);
-      logger_.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_, n);
+    auto received = false;
+    while (true) {
+      alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(struct timespec))];
+
+      iovec iov{inbound_.writeData(), inbound_.freeSpace()};
+      msghdr msg{&socket_attrib_, sizeof(socket_attrib_), &iov, 1, ctrl, sizeof(ctrl), 0};
+      if (UNLIKELY(!iov.iov_len)) { // the kernel buffers the rest until the callback consumes some of the receive ring.
+        break;
+      }
+
+      // Non-blocking call to read available data.
+      const auto read_size = recvmsg(socket_fd_, &msg, MSG_DONTWAIT);
+      if (read_size == 0) {
+        disconnect("closed by peer");
+        break;
+      }
+      if (read_size < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) { // drained.
+          read_ready_ = false;
+        } else {
+          disconnect(strerror(errno));
+        }
+        break;
+      }
+
+      inbound_.commitWrite(read_size);
+      received = true;
+      dispatchRead(read_size, kernelRxTime(&msg));
+      if (disconnected()) { // the callback dropped the connection, nothing more to read from it.
+        break;
+      }
     }
-    next_send_valid_index_ = 0;
 
-    return (read_size > 0);
+    flush();
+
+    return received;
   }
 
-  /// Write outgoing data to the send buffers.
+  /// Hand as much of the send ring to the kernel as it takes without blocking.
+  auto TCPSocket::flush() noexcept -> void {
+    if (!sendBacklog() || send_blocked_ || disconnected()) {
+      return;
+    }
+
+    // Non-blocking call to send data, the pending bytes are contiguous even when they wrap around the end of the ring.
+    const auto backlog = sendBacklog();
+    const auto n = ::send(socket_fd_, outbound_.readData(), backlog, MSG_DONTWAIT | MSG_NOSIGNAL);
+    logger_.log("%:% %() % send socket:% len:% sent:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket_fd_, backlog, n);
+
+    if (n > 0) {
+      outbound_.consume(n); // anything left stays queued for the next call.
+    } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      disconnect(strerror(errno));
+    }
+  }
+
+  /// Queue outgoing data at the end of the send ring, applying the slow consumer policy if it does not fit in the backlog.
   auto TCPSocket::send(const void *data, size_t len) noexcept -> void {
-    memcpy(outbound_data_.data() + next_send_valid_index_, data, len);
-    next_send_valid_index_ += len;
+    if (UNLIKELY(disconnected())) {
+      return;
+    }
+
+    if (UNLIKELY(sendBacklog() + len > std::min(send_queue_cfg_.max_backlog_, TCPBufferSize))) {
+      if (send_queue_cfg_.slow_consumer_policy_ == SlowConsumerPolicy::DISCONNECT) {
+        disconnect("slow consumer");
+      } else if (!(num_dropped_sends_++ & 1023)) {
+        logger_.log("%:% %() % Slow consumer socket:% backlog:% dropped-sends:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), socket_fd_, sendBacklog(), num_dropped_sends_);
+      }
+      return;
+    }
+
+    if (!sendBacklog() && send_queued_callback_) {
+      send_queued_callback_(this);
+    }
+    outbound_.write(data, len);
+  }
+
+  /// Forget everything about the previous connection so the socket can be reused for a new one.
+  auto TCPSocket::reset() noexcept -> void {
+    socket_fd_ = -1;
+    outbound_.clear();
+    inbound_.clear();
+    num_dropped_sends_ = 0;
+    send_blocked_ = false;
+    write_interest_ = false;
+    read_ready_ = false;
+    flush_ready_ = false;
+    uring_send_in_flight_ = false;
+    last_rx_time_ = 0;
+    carried_rcv_bytes_ = 0;
+    carried_rx_time_ = 0;
+    rx_delay_ = {};
+  }
+
+  auto TCPSocket::disconnect(const char *reason) noexcept -> void {
+    if (disconnected()) { // already closed, its owner was told then.
+      return;
+    }
+
+    logger_.log("%:% %() % Disconnecting socket:% reason:% unsent:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                socket_fd_, reason, sendBacklog(), send_queue_cfg_.toString());
+    shutdown(socket_fd_, SHUT_RDWR); // also ends any io_uring requests still in flight on it.
+    close(socket_fd_);
+    socket_fd_ = -1;
+    outbound_.clear();
+
+    if (disconnected_callback_) {
+      disconnected_callback_(this);
+    }
   }
 }
@@ -4,27 +4,91 @@
 
 #include "socket_utils.h"
 #include "logging.h"
+#include "latency_histogram.h"
+#include "mirrored_ring.h"
 
 namespace Common {
-  /// Size of our send and receive buffers in bytes.
-  constexpr size_t TCPBufferSize = 64 * 1024 * 1024;
+  /// Size of our send and receive rings in bytes, a power of 2 and a multiple of the page size.
+  constexpr size_t TCPBufferSize = 1024 * 1024;
+
+  /// What to do with a session whose unsent data would grow past SendQueueCfg::max_backlog_.
+  enum class SlowConsumerPolicy : uint8_t {
+    DISCONNECT = 0, // close the connection and discard what it had pending.
+    DROP = 1 // discard the data that does not fit and keep the connection, the peer sees a gap in its sequence numbers.
+  };
+
+  inline auto slowConsumerPolicyToString(SlowConsumerPolicy policy) -> std::string {
+    switch (policy) {
+      case SlowConsumerPolicy::DISCONNECT:
+        return "DISCONNECT";
+      case SlowConsumerPolicy::DROP:
+        return "DROP";
+    }
+
+    return "UNKNOWN";
+  }
+
+  struct SendQueueCfg {
+    /// Most bytes queued for a peer that is not reading them, capped at TCPBufferSize.
+    size_t max_backlog_ = TCPBufferSize;
+    SlowConsumerPolicy slow_consumer_policy_ = SlowConsumerPolicy::DISCONNECT;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "SendQueueCfg[max_backlog:" << max_backlog_
+         << " slow_consumer_policy:" << slowConsumerPolicyToString(slow_consumer_policy_)
+         << "]";
+
+      return ss.str();
+    }
+  };
+
+  /// Kernel receive timestamp in the control messages of a recvmsg, 0 if there is none.
+  auto kernelRxTime(msghdr *msg) noexcept -> Nanos;
 
   struct TCPSocket {
     explicit TCPSocket(Logger &logger)
-        : logger_(logger) {
-      outbound_data_.resize(TCPBufferSize);
-      inbound_data_.resize(TCPBufferSize);
+        : outbound_(TCPBufferSize), inbound_(TCPBufferSize), logger_(logger) {
     }
 
-    /// Create TCPSocket with provided attributes to either listen-on / connect-to.
-    auto connect(const std::string &ip, const std::string &iface, int port, bool is_listening) -> int;
+    /// Create TCPSocket with provided attributes to either listen-on / connect-to, a listener can share its port with others with reuse_port.
+    auto connect(const std::string &ip, const std::string &iface, int port, bool is_listening, bool reuse_port = false) -> int;
 
     /// Called to publish outgoing data from the buffers as well as check for and callback if data is available in the read buffers.
+    /// Reads until the kernel has no more data or the receive ring is full, calling back once per read.
     auto sendAndRecv() noexcept -> bool;
 
-    /// Write outgoing data to the send buffers.
+    /// Hand as much of the send ring to the kernel as it takes without blocking.
+    auto flush() noexcept -> void;
+
+    /// Call back for read_size bytes just added to inbound_ by a read the kernel stamped with kernel_time, 0 if it was not stamped.
+    auto dispatchRead(size_t read_size, Nanos kernel_time) noexcept -> void;
+
+    /// Close the connection, discarding anything not sent yet.
+    auto disconnect(const char *reason) noexcept -> void;
+
+    /// Queue outgoing data at the end of the send ring, applying the slow consumer policy if it does not fit in the backlog.
     auto send(const void *data, size_t len) noexcept -> void;
 
+    /// Bytes queued but not yet accepted by the kernel.
+    auto sendBacklog() const noexcept {
+      return outbound_.size();
+    }
+
+    /// Forget everything about the previous connection so the socket can be reused for a new one.
+    auto reset() noexcept -> void;
+
+    /// True once the connection was closed, by the peer, the slow consumer policy or a socket error.
+    auto disconnected() const noexcept {
+      return socket_fd_ == -1;
+    }
+
+    /// Kernel receive time of the message starting at offset from inbound_.readData(), for use inside recv_callback_.
+    /// A message that started arriving in an earlier read keeps that read's timestamp, everything else has the latest read's.
+    auto rxTime(size_t offset) const noexcept {
+      return (offset < carried_rcv_bytes_) ? carried_rx_time_ : last_rx_time_;
+    }
+
     /// Deleted default, copy & move constructors and assignment-operators.
     TCPSocket() = delete;
 
@@ -39,11 +103,33 @@ namespace Common {
     /// File descriptor for the socket.
     int socket_fd_ = -1;
 
-    /// Send and receive buffers and trackers for read/write indices.
-    std::vector<char> outbound_data_;
-    size_t next_send_valid_index_ = 0;
-    std::vector<char> inbound_data_;
-    size_t next_rcv_valid_index_ = 0;
+    /// Unsent data, queued by send() and handed to the kernel by sendAndRecv().
+    MirroredRing outbound_;
+    SendQueueCfg send_queue_cfg_;
+    size_t num_dropped_sends_ = 0;
+
+    /// Set by a TCPServer while it waits for EPOLLOUT on this socket, no send is attempted until the socket is writable again.
+    bool send_blocked_ = false;
+    bool write_interest_ = false;
+
+    /// Set by a TCPServer while the socket is queued to be read from / flushed. read_ready_ is cleared once a read finds no more data.
+    bool read_ready_ = false;
+    bool flush_ready_ = false;
+
+    /// io_uring requests in flight on this socket and whether one of them is a send, when a TCPServer uses the io_uring backend.
+    size_t uring_ops_ = 0;
+    bool uring_send_in_flight_ = false;
+
+    /// Received data not consumed yet, recv_callback_ parses frames in place from inbound_.readData() and consumes the complete ones.
+    MirroredRing inbound_;
+
+    /// Kernel receive time of the latest read, and of the bytes left in the receive buffer from before it.
+    Nanos last_rx_time_ = 0;
+    size_t carried_rcv_bytes_ = 0;
+    Nanos carried_rx_time_ = 0;
+
+    /// Delay from the kernel timestamping incoming data to this socket reading it.
+    LatencyHistogram rx_delay_;
 
     /// Socket attributes.
     struct sockaddr_in socket_attrib_{};
@@ -51,7 +137,12 @@ namespace Common {
     /// Function wrapper to callback when there is data to be processed.
     std::function<void(TCPSocket *s, Nanos rx_time)> recv_callback_ = nullptr;
 
+    /// Function wrappers to callback when send() queues data with nothing else pending, and when the socket is closed.
+    std::function<void(TCPSocket *s)> send_queued_callback_ = nullptr;
+    std::function<void(TCPSocket *s)> disconnected_callback_ = nullptr;
+
     std::string time_str_;
     Logger &logger_;
+
   };
 }
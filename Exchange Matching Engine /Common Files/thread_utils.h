@@ -3,6 +3,7 @@
 #include <iostream>
 #include <atomic>
 #include <thread>
+#include <tuple>
 #include <unistd.h>
 
 #include <sys/syscall.h>
@@ -16,21 +17,19 @@ namespace Common {
 
   /// Creates a thread instance, sets affinity on it, assigns it a name and
   /// passes the function to be run on that thread as well as the arguments to the function.
+  /// Everything is copied into the new thread, so the caller does not have to wait for the thread to pick its arguments up.
   template<typename T, typename... A>
   inline auto createAndStartThread(int core_id, const std::string &name, T &&func, A &&... args) noexcept {
-    auto t = new std::thread([&]() {
+    auto t = new std::thread([core_id, name, func = std::forward<T>(func), args = std::make_tuple(std::forward<A>(args)...)]() mutable {
       if (core_id >= 0 && !setThreadCore(core_id)) {
         std::cerr << "Failed to set core affinity for " << name << " " << pthread_self() << " to " << core_id << std::endl;
         exit(EXIT_FAILURE);
       }
       std::cerr << "Set core affinity for " << name << " " << pthread_self() << " to " << core_id << std::endl;
 
-      std::forward<T>(func)((std::forward<A>(args))...);
+      std::apply(func, std::move(args));
     });
 
-    using namespace std::literals::chrono_literals;
-    std::this_thread::sleep_for(1s);
-
     return t;
   }
 }
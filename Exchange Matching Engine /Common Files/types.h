@@ -6,6 +6,7 @@
 #include <array>
 
 #include "macros.h"
+#include "time_utils.h"
 
 namespace Common {
   /// Constants used across the ecosystem to represent upper bounds on various containers.
@@ -202,4 +203,125 @@ namespace Common {
 
   /// Hash map from TickerId -> TradeEngineCfg.
   typedef std::array<TradeEngineCfg, ME_MAX_TICKERS> TradeEngineCfgHashMap;
+
+  /// Configuration for the MatchingEngine and the MEOrderBook instances it owns.
+  struct MatchingEngineCfg {
+    /// Publish a single EXECUTION market update per passive order hit instead of a TRADE followed by a CANCEL / MODIFY.
+    bool coalesce_executions_ = false;
+
+    /// Send the aggressor one FILLED response per price level swept instead of one per passive order hit.
+    bool aggregate_aggressor_fills_ = false;
+
+    /// Upper bound on the number of client requests processed before their responses and market updates are published.
+    /// The batch limit starts at 1 and doubles towards this bound only while requests are backing up, so 1 disables batching.
+    size_t max_request_batch_ = 1;
+
+    /// Every checkpoint_interval_nanos_ each book is checkpointed into checkpoint_dir_, one book at a time between batches.
+    /// An empty checkpoint_dir_ disables checkpoints.
+    std::string checkpoint_dir_;
+    Nanos checkpoint_interval_nanos_ = 0;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MatchingEngineCfg{"
+         << "coalesce-executions:" << coalesce_executions_ << " "
+         << "aggregate-aggressor-fills:" << aggregate_aggressor_fills_ << " "
+         << "max-request-batch:" << max_request_batch_ << " "
+         << "checkpoint-dir:" << checkpoint_dir_ << " "
+         << "checkpoint-interval-nanos:" << checkpoint_interval_nanos_
+         << "}";
+
+      return ss.str();
+    }
+  };
+
+  /// Bytes of IPv4 and UDP headers in every datagram, the UDP payload is at most the link MTU less these.
+  constexpr size_t IP_UDP_HEADER_SIZE = 28;
+
+  /// Configuration for the market data publisher and snapshot synthesizer.
+  struct MarketDataCfg {
+    /// Link MTU, market updates are packed into datagrams that fit in one frame of this size without IP fragmentation.
+    size_t mtu_ = 1500;
+
+    /// Longest a partly filled datagram waits for more updates once the matching engine has none queued, 0 sends it right away.
+    Nanos flush_budget_nanos_ = 1000;
+
+    /// Also write every incremental datagram into a shared memory broadcast ring, for consumers on the same box, see MDP_SHM_RING_NAME.
+    bool shm_ring_ = false;
+
+    /// Datagrams the ring holds, a consumer further behind than this is overrun and recovers from the snapshot stream.
+    size_t shm_ring_slots_ = 16 * 1024;
+
+    /// Most recent incremental updates the retransmit server keeps for consumers to fill gaps from, per incremental channel, a power of 2.
+    size_t retransmit_history_ = 64 * 1024;
+
+    /// How often a snapshot cycle starts, and the most datagrams per second it is published at so it does not burst onto the network, 0 for no cap.
+    Nanos snapshot_period_nanos_ = 60 * NANOS_TO_SECS;
+    size_t snapshot_max_packets_per_sec_ = 20 * 1000;
+
+    /// Split snapshot cycles by instrument into this many channels, each with its own cycles on its own port, so a consumer recovers only
+    /// the instruments it trades. 0 publishes a single cycle of every instrument on the snapshot port. See mdpChannel().
+    size_t snapshot_channels_ = 0;
+
+    /// Split the incremental stream by instrument into this many channels, each with its own port, shared memory ring and sequence numbers,
+    /// so a consumer only reads, and recovers gaps in, the channels of the instruments it trades. Snapshot cycles are then split the same
+    /// way whatever snapshot_channels_ is. 0 publishes every instrument on the incremental port with a single sequence.
+    size_t incremental_channels_ = 0;
+
+    /// Also publish a market by price feed of the changes to the top this many price levels of every book, 0 for none.
+    size_t price_level_depth_ = 0;
+
+    /// Also publish a feed of the best bid and offer of every book, at most once per interval however often it changes.
+    bool bbo_feed_ = false;
+    Nanos bbo_interval_nanos_ = 10 * NANOS_TO_MILLIS;
+
+    /// Number of snapshot channels published, 0 for a single cycle on the snapshot port.
+    auto numSnapshotChannels() const noexcept {
+      return incremental_channels_ ? incremental_channels_ : snapshot_channels_;
+    }
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MarketDataCfg{"
+         << "mtu:" << mtu_ << " "
+         << "flush-budget-nanos:" << flush_budget_nanos_ << " "
+         << "shm-ring:" << shm_ring_ << " "
+         << "shm-ring-slots:" << shm_ring_slots_ << " "
+         << "retransmit-history:" << retransmit_history_ << " "
+         << "snapshot-period-nanos:" << snapshot_period_nanos_ << " "
+         << "snapshot-max-packets-per-sec:" << snapshot_max_packets_per_sec_ << " "
+         << "snapshot-channels:" << snapshot_channels_ << " "
+         << "incremental-channels:" << incremental_channels_ << " "
+         << "price-level-depth:" << price_level_depth_ << " "
+         << "bbo-feed:" << bbo_feed_ << " "
+         << "bbo-interval-nanos:" << bbo_interval_nanos_
+         << "}";
+
+      return ss.str();
+    }
+  };
+
+  /// Configuration for the order server.
+  struct OrderServerCfg {
+    /// Longest a client response is held to go out in one frame with later responses to the same client, 0 sends every loop's responses right away.
+    Nanos response_flush_budget_nanos_ = 0;
+
+    /// Threads accepting, reading and writing order entry sessions, each with its own share of them. More than one adds a sequencer stage
+    /// merging their requests in receive time order.
+    size_t num_io_threads_ = 1;
+
+    /// Also serve clients on the same box over shared memory rings, see om_shm_session.h.
+    bool shm_sessions_ = false;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "OrderServerCfg{"
+         << "response-flush-budget-nanos:" << response_flush_budget_nanos_
+         << " io-threads:" << num_io_threads_
+         << " shm-sessions:" << shm_sessions_
+         << "}";
+
+      return ss.str();
+    }
+  };
 }
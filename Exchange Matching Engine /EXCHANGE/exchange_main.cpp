@@ -1,6 +1,7 @@
 #include <csignal>
 
 #include "matching_engine.h"
+#include "me_standby.h"
 #include "market_data_publisher.h"
 #include "order_server.h"
 #include "performance_dashboard.h"
@@ -11,6 +12,8 @@ Common::Logger *logger = nullptr;
 Exchange::MatchingEngine *matching_engine = nullptr;
 Exchange::MarketDataPublisher *market_data_publisher = nullptr;
 Exchange::OrderServer *order_server = nullptr;
+Exchange::RequestJournal *request_journal = nullptr;
+Exchange::JournalRecordShmQueue *replication = nullptr;
 
 /// Shut down gracefully on external signals to this server.
 void signal_handler(int) {
@@ -24,13 +27,78 @@ void signal_handler(int) {
   market_data_publisher = nullptr;
   delete order_server;
   order_server = nullptr;
+  delete request_journal;
+  request_journal = nullptr;
+  delete replication;
+  replication = nullptr;
 
   // Removed 10 second sleep - using event-driven shutdown for nanosecond performance
 
   exit(EXIT_SUCCESS);
 }
 
-int main(int, char **) {
+/// Usage: exchange_main [--standby] [--data-dir DIR] [--max-send-backlog BYTES] [--slow-consumer disconnect|drop] [--tcp-backend epoll|io_uring] [--md-mtu BYTES] [--md-flush-budget NANOS] [--response-flush-budget NANOS] [--order-io-threads N] [--order-shm] [--md-shm] [--md-snapshot-period NANOS] [--md-snapshot-rate PACKETS_PER_SEC] [--md-snapshot-channels N] [--md-incremental-channels N] [--md-l2-depth N] [--md-bbo-interval NANOS]
+/// The journal and checkpoints live in DIR, so a primary and a standby on the same box share them while logging to their own working directories.
+/// A standby follows the primary through shared memory and takes over once the primary exits or stops heartbeating.
+/// A client that lets more than BYTES of responses queue up unread is disconnected, or has the responses that do not fit dropped.
+/// Order entry connections are served through epoll by default, or through io_uring on Linux.
+/// Market updates are packed into datagrams of up to the MTU, a partly filled one is sent once no update has come for the flush budget.
+/// A client's responses go out as one frame per order server loop, or are held for up to the response flush budget to join later ones.
+/// Order entry sessions are spread across N I/O threads sharing the port, whose requests are merged in receive time order.
+/// Clients on the same box can also enter orders through shared memory rings instead of TCP.
+/// Consumers on the same box can also read the incremental market data stream from a shared memory ring instead of multicast.
+/// Besides the order by order stream, the top N price levels of every book and its best bid and offer conflated to an interval can be
+/// published on feeds of their own.
+int main(int argc, char **argv) {
+  bool standby = false;
+  std::string data_dir = ".";
+  Common::SendQueueCfg send_queue_cfg;
+  auto tcp_backend = Common::TCPServerBackend::EPOLL;
+  Common::MarketDataCfg md_cfg;
+  Common::OrderServerCfg order_server_cfg;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--standby") {
+      standby = true;
+    } else if (arg == "--data-dir" && i + 1 < argc) {
+      data_dir = argv[++i];
+    } else if (arg == "--max-send-backlog" && i + 1 < argc) {
+      send_queue_cfg.max_backlog_ = std::stoul(argv[++i]);
+    } else if (arg == "--slow-consumer" && i + 1 < argc && (std::string(argv[i + 1]) == "disconnect" || std::string(argv[i + 1]) == "drop")) {
+      send_queue_cfg.slow_consumer_policy_ = (std::string(argv[++i]) == "drop") ? Common::SlowConsumerPolicy::DROP : Common::SlowConsumerPolicy::DISCONNECT;
+    } else if (arg == "--tcp-backend" && i + 1 < argc && (std::string(argv[i + 1]) == "epoll" || std::string(argv[i + 1]) == "io_uring")) {
+      tcp_backend = (std::string(argv[++i]) == "io_uring") ? Common::TCPServerBackend::IO_URING : Common::TCPServerBackend::EPOLL;
+    } else if (arg == "--md-mtu" && i + 1 < argc) {
+      md_cfg.mtu_ = std::stoul(argv[++i]);
+    } else if (arg == "--md-flush-budget" && i + 1 < argc) {
+      md_cfg.flush_budget_nanos_ = std::stol(argv[++i]);
+    } else if (arg == "--response-flush-budget" && i + 1 < argc) {
+      order_server_cfg.response_flush_budget_nanos_ = std::stol(argv[++i]);
+    } else if (arg == "--order-io-threads" && i + 1 < argc) {
+      order_server_cfg.num_io_threads_ = std::stoul(argv[++i]);
+    } else if (arg == "--order-shm") {
+      order_server_cfg.shm_sessions_ = true;
+    } else if (arg == "--md-shm") {
+      md_cfg.shm_ring_ = true;
+    } else if (arg == "--md-snapshot-period" && i + 1 < argc) {
+      md_cfg.snapshot_period_nanos_ = std::stol(argv[++i]);
+    } else if (arg == "--md-snapshot-rate" && i + 1 < argc) {
+      md_cfg.snapshot_max_packets_per_sec_ = std::stoul(argv[++i]);
+    } else if (arg == "--md-snapshot-channels" && i + 1 < argc) {
+      md_cfg.snapshot_channels_ = std::stoul(argv[++i]);
+    } else if (arg == "--md-incremental-channels" && i + 1 < argc) {
+      md_cfg.incremental_channels_ = std::stoul(argv[++i]);
+    } else if (arg == "--md-l2-depth" && i + 1 < argc) {
+      md_cfg.price_level_depth_ = std::stoul(argv[++i]);
+    } else if (arg == "--md-bbo-interval" && i + 1 < argc) {
+      md_cfg.bbo_feed_ = true;
+      md_cfg.bbo_interval_nanos_ = std::stol(argv[++i]);
+    } else {
+      std::cerr << "USAGE exchange_main [--standby] [--data-dir DIR] [--max-send-backlog BYTES] [--slow-consumer disconnect|drop] [--tcp-backend epoll|io_uring] [--md-mtu BYTES] [--md-flush-budget NANOS] [--response-flush-budget NANOS] [--order-io-threads N] [--order-shm] [--md-shm] [--md-snapshot-period NANOS] [--md-snapshot-rate PACKETS_PER_SEC] [--md-snapshot-channels N] [--md-incremental-channels N] [--md-l2-depth N] [--md-bbo-interval NANOS]" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
   logger = new Common::Logger("exchange_main.log");
 
   std::signal(SIGINT, signal_handler);
@@ -48,30 +116,92 @@ int main(int, char **) {
   Exchange::ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
   Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
 
+  // Report each passive fill as a single EXECUTION market update, aggressors still receive one FILLED per passive order hit.
+  Common::MatchingEngineCfg me_cfg;
+  me_cfg.coalesce_executions_ = true;
+  me_cfg.aggregate_aggressor_fills_ = false;
+  me_cfg.max_request_batch_ = 64;
+
+  // Checkpoint every book every 10 seconds, a restart resumes from the checkpoints and replays only the journal after them.
+  me_cfg.checkpoint_dir_ = data_dir + "/exchange_checkpoints";
+  me_cfg.checkpoint_interval_nanos_ = 10 * Common::NANOS_TO_SECS;
+
+  // Journal every sequenced request, forcing them to disk in groups of up to 256 or at least every millisecond.
+  Exchange::JournalCfg journal_cfg;
+  journal_cfg.path_ = data_dir + "/exchange_requests.journal";
+  journal_cfg.sync_policy_ = Exchange::JournalSyncPolicy::GROUP_COMMIT;
+  journal_cfg.group_commit_records_ = 256;
+  journal_cfg.group_commit_nanos_ = Common::NANOS_TO_MILLIS;
+
   logger->log("%:% %() % Starting Nanosecond-Precision Matching Engine...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  matching_engine = new Exchange::MatchingEngine(&client_requests, &client_responses, &market_updates);
-  matching_engine->start();
+  matching_engine = new Exchange::MatchingEngine(me_cfg, &client_requests, &client_responses, &market_updates);
+  matching_engine->recover(journal_cfg.path_, /*live_journal*/ standby);
 
   const std::string mkt_pub_iface = "lo";
   const std::string snap_pub_ip = "233.252.14.1", inc_pub_ip = "233.252.14.3";
-  const int snap_pub_port = 20000, inc_pub_port = 20001;
+  const int snap_pub_port = 20000, inc_pub_port = 20001, retransmit_port = 20002;
+
+  logger->log("%:% %() % Creating Market Data Publisher... %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), md_cfg.toString());
+  market_data_publisher = new Exchange::MarketDataPublisher(&market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port, retransmit_port, md_cfg);
+
+  // Stay in step with the primary without publishing anything, then carry on from exactly where it stopped.
+  // Everything that is slow to construct already exists at this point, only starting the threads is left for the takeover.
+  Exchange::StandbyCfg standby_cfg;
+  standby_cfg.journal_path_ = journal_cfg.path_;
+  Exchange::StandbyReplica *standby_replica = nullptr;
+  if (standby) {
+    logger->log("%:% %() % Following primary as standby...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
+    standby_replica = new Exchange::StandbyReplica(standby_cfg, matching_engine);
+    standby_replica->follow();
+    logger->log("%:% %() % Taking over from primary at seq:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                matching_engine->lastSeqNum());
+  }
 
-  logger->log("%:% %() % Starting Market Data Publisher...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  market_data_publisher = new Exchange::MarketDataPublisher(&market_updates, mkt_pub_iface, snap_pub_ip, snap_pub_port, inc_pub_ip, inc_pub_port);
-  market_data_publisher->start();
+  logger->log("%:% %() % Starting Request Journal...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
+  request_journal = new Exchange::RequestJournal(journal_cfg);
+  request_journal->start();
+  if (standby_replica) {
+    standby_replica->completeJournal(request_journal);
+  }
+  ASSERT(request_journal->lastSeqNum() == matching_engine->lastSeqNum(),
+         "Journal ends at seq:" + std::to_string(request_journal->lastSeqNum()) + " but the books recovered to seq:" +
+         std::to_string(matching_engine->lastSeqNum()));
+  matching_engine->setJournal(request_journal);
 
   const std::string order_gw_iface = "lo";
   const int order_gw_port = 12345;
 
-  logger->log("%:% %() % Starting Order Server...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  order_server = new Exchange::OrderServer(&client_requests, &client_responses, order_gw_iface, order_gw_port);
+  // Replicate to the next standby, replacing the ring of a primary we took over from.
+  replication = new Exchange::JournalRecordShmQueue(standby_cfg.replication_shm_name_, Exchange::ME_MAX_REPLICATION_RECORDS);
+
+  logger->log("%:% %() % Starting Order Server... % backend:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+              send_queue_cfg.toString(), Common::tcpServerBackendToString(tcp_backend), order_server_cfg.toString());
+  order_server = new Exchange::OrderServer(&client_requests, &client_responses, request_journal, replication, order_gw_iface, order_gw_port,
+                                           send_queue_cfg, tcp_backend, order_server_cfg);
+
+  // The threads are started last, on a takeover they would otherwise compete with the main thread for the cores while it is still getting ready.
+  matching_engine->start();
+  market_data_publisher->start();
   order_server->start();
 
+  if (standby_replica) {
+    const auto failover_nanos = Common::getCurrentNanos() - standby_replica->failureDetectedTime();
+    logger->log("%:% %() % Took over in %ns from failure detection to accepting orders. %\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str), failover_nanos, standby_replica->stats());
+    std::cout << "Took over at seq:" << matching_engine->lastSeqNum() << " failover-ns:" << failover_nanos << " "
+              << standby_replica->stats() << std::endl;
+    delete standby_replica;
+    standby_replica = nullptr;
+  }
+
   logger->log("%:% %() % NANOSECOND HFT Engine started successfully! Performance monitoring active.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
   
   while (true) {
     // Event-driven main loop - no sleep for nanosecond performance
     // Performance dashboard runs in separate thread and reports metrics
     std::this_thread::yield(); // Minimal yield instead of blocking sleep
+
+    // Lets a standby tell this process hanging apart from it being idle.
+    replication->heartbeat(Common::getCurrentNanos());
   }
 }
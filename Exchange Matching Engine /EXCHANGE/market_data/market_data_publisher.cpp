@@ -1,17 +1,33 @@
 #include "market_data_publisher.h"
 
 namespace Exchange {
+  MarketDataPublisher::IncrementalChannel::IncrementalChannel(Logger &logger, const std::string &shm_ring_name, const MarketDataCfg &cfg)
+      : socket_(logger),
+        shm_ring_(cfg.shm_ring_ ? new Common::ShmBroadcastRing(shm_ring_name, cfg.shm_ring_slots_,
+                                                               MDPPacketWriter::maxPacketSize(cfg) + sizeof(MDPWireMessage)) : nullptr),
+        writer_(&socket_, cfg, shm_ring_) {
+  }
+
   MarketDataPublisher::MarketDataPublisher(MEMarketUpdateLFQueue *market_updates, const std::string &iface,
                                            const std::string &snapshot_ip, int snapshot_port,
-                                           const std::string &incremental_ip, int incremental_port)
-      : outgoing_md_updates_(market_updates), snapshot_md_updates_(ME_MAX_MARKET_UPDATES),
-        run_(false), logger_("exchange_market_data_publisher.log"), incremental_socket_(logger_) {
-    ASSERT(incremental_socket_.init(incremental_ip, iface, incremental_port, /*is_listening*/ false) >= 0,
-           "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
-    snapshot_synthesizer_ = new SnapshotSynthesizer(&snapshot_md_updates_, iface, snapshot_ip, snapshot_port);
+                                           const std::string &incremental_ip, int incremental_port, int retransmit_port, const MarketDataCfg &cfg)
+      : outgoing_md_updates_(market_updates), snapshot_md_updates_(ME_MAX_MARKET_UPDATES), retransmit_md_updates_(ME_MAX_MARKET_UPDATES),
+        run_(false), logger_("exchange_market_data_publisher.log") {
+    ASSERT(cfg.incremental_channels_ <= ME_MAX_TICKERS, "More incremental channels than instruments. " + cfg.toString());
+    for (size_t channel = 0; channel < std::max<size_t>(cfg.incremental_channels_, 1); ++channel) {
+      const auto port = cfg.incremental_channels_ ? mdpIncrementalChannelPort(incremental_port, channel) : incremental_port;
+      incremental_channels_.push_back(new IncrementalChannel(logger_, mdpShmRingName(cfg.incremental_channels_, channel), cfg));
+      ASSERT(incremental_channels_.back()->socket_.init(incremental_ip, iface, port, /*is_listening*/ false) >= 0,
+             "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+    }
+    snapshot_synthesizer_ = new SnapshotSynthesizer(&snapshot_md_updates_, iface, snapshot_ip, snapshot_port, cfg);
+    retransmit_server_ = new RetransmitServer(&retransmit_md_updates_, iface, retransmit_port, cfg);
+    if (cfg.price_level_depth_ || cfg.bbo_feed_) {
+      price_level_publisher_ = new PriceLevelPublisher(logger_, iface, incremental_ip, incremental_port, cfg);
+    }
   }
 
-  /// Main run loop for this thread - consumes market updates from the lock free queue from the matching engine, publishes them on the incremental multicast stream and forwards them to the snapshot synthesizer.
+  /// Main run loop for this thread - consumes market updates from the lock free queue from the matching engine, publishes them on the incremental multicast stream, forwards them to the snapshot synthesizer and the retransmit server, and derives the price level feeds from them.
   auto MarketDataPublisher::run() noexcept -> void {
     logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
     while (run_) {
@@ -19,28 +35,57 @@ namespace Exchange {
            outgoing_md_updates_->size() && market_update; market_update = outgoing_md_updates_->getNextToRead()) {
         TTT_MEASURE(T5_MarketDataPublisher_LFQueue_read, logger_);
 
-        logger_.log("%:% %() % Sending seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), next_inc_seq_num_,
+        auto channel = incremental_channels_[mdpChannel(market_update->ticker_id_, incremental_channels_.size())];
+        const auto next_inc_seq_num = channel->next_inc_seq_num_;
+
+        logger_.log("%:% %() % Sending seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), next_inc_seq_num,
                     market_update->toString().c_str());
 
+        // Into the retransmit history first, so a consumer that sees a gap in the datagrams below finds the updates there.
+        auto retransmit_write = retransmit_md_updates_.getNextToWriteTo();
+        while (UNLIKELY(!retransmit_write)) { // queue is full while the retransmit server builds replies, wait for it rather than lose the update.
+          std::this_thread::yield();
+          retransmit_write = retransmit_md_updates_.getNextToWriteTo();
+        }
+        *retransmit_write = MDPMarketUpdate{next_inc_seq_num, *market_update};
+        retransmit_md_updates_.updateWriteIndex();
+
         START_MEASURE(Exchange_McastSocket_send);
-        incremental_socket_.send(&next_inc_seq_num_, sizeof(next_inc_seq_num_));
-        incremental_socket_.send(market_update, sizeof(MEMarketUpdate));
+        channel->writer_.add(MDPMarketUpdate{next_inc_seq_num, *market_update});
         END_MEASURE(Exchange_McastSocket_send, logger_);
 
-        outgoing_md_updates_->updateReadIndex();
         TTT_MEASURE(T6_MarketDataPublisher_UDP_write, logger_);
 
         // Forward this incremental market data update the snapshot synthesizer.
         auto next_write = snapshot_md_updates_.getNextToWriteTo();
-        next_write->seq_num_ = next_inc_seq_num_;
+        while (UNLIKELY(!next_write)) { // queue is full while the snapshot synthesizer starts a cycle, wait for it rather than lose the update.
+          std::this_thread::yield();
+          next_write = snapshot_md_updates_.getNextToWriteTo();
+        }
+        next_write->seq_num_ = next_inc_seq_num;
         next_write->me_market_update_ = *market_update;
         snapshot_md_updates_.updateWriteIndex();
 
-        ++next_inc_seq_num_;
+        // The price level feeds only after the order by order stream, which they must not hold up.
+        if (price_level_publisher_) {
+          price_level_publisher_->onMarketUpdate(*market_update);
+        }
+
+        ++channel->next_inc_seq_num_;
+
+        // Only hand the slot back to the matching engine once nothing reads the update in it any more.
+        outgoing_md_updates_->updateReadIndex();
       }
 
-      // Publish to the multicast stream.
-      incremental_socket_.sendAndRecv();
+      // Publish the full datagrams and, once its flush budget ran out, the partly filled one of every channel to the multicast stream - the
+      // shared memory rings already have them.
+      for (auto channel: incremental_channels_) {
+        channel->writer_.flushIfDue();
+        channel->socket_.sendAndRecv();
+      }
+      if (price_level_publisher_) {
+        price_level_publisher_->flushIfDue();
+      }
     }
   }
 }
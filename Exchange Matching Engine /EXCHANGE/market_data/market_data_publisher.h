@@ -3,13 +3,16 @@
 #include <functional>
 
 #include "market_data/snapshot_synthesizer.h"
+#include "market_data/retransmit_server.h"
+#include "market_data/price_level_publisher.h"
+#include "market_data/md_packet_writer.h"
 
 namespace Exchange {
   class MarketDataPublisher {
   public:
     MarketDataPublisher(MEMarketUpdateLFQueue *market_updates, const std::string &iface,
                         const std::string &snapshot_ip, int snapshot_port,
-                        const std::string &incremental_ip, int incremental_port);
+                        const std::string &incremental_ip, int incremental_port, int retransmit_port, const MarketDataCfg &cfg);
 
     ~MarketDataPublisher() {
       stop();
@@ -19,24 +22,37 @@ namespace Exchange {
 
       delete snapshot_synthesizer_;
       snapshot_synthesizer_ = nullptr;
+
+      delete retransmit_server_;
+      retransmit_server_ = nullptr;
+
+      delete price_level_publisher_;
+      price_level_publisher_ = nullptr;
+
+      for (auto channel: incremental_channels_) {
+        delete channel;
+      }
+      incremental_channels_.clear();
     }
 
-    /// Start and stop the market data publisher main thread, as well as the internal snapshot synthesizer thread.
+    /// Start and stop the market data publisher main thread, as well as the internal snapshot synthesizer and retransmit server threads.
     auto start() {
       run_ = true;
 
       ASSERT(Common::createAndStartThread(-1, "Exchange/MarketDataPublisher", [this]() { run(); }) != nullptr, "Failed to start MarketData thread.");
 
       snapshot_synthesizer_->start();
+      retransmit_server_->start();
     }
 
     auto stop() -> void {
       run_ = false;
 
       snapshot_synthesizer_->stop();
+      retransmit_server_->stop();
     }
 
-    /// Main run loop for this thread - consumes market updates from the lock free queue from the matching engine, publishes them on the incremental multicast stream and forwards them to the snapshot synthesizer.
+    /// Main run loop for this thread - consumes market updates from the lock free queue from the matching engine, publishes them on the incremental multicast stream, forwards them to the snapshot synthesizer and the retransmit server, and derives the price level feeds from them.
     auto run() noexcept -> void;
 
     // Deleted default, copy & move constructors and assignment-operators.
@@ -51,8 +67,21 @@ namespace Exchange {
     MarketDataPublisher &operator=(const MarketDataPublisher &&) = delete;
 
   private:
-    /// Sequencer number tracker on the incremental market data stream.
-    size_t next_inc_seq_num_ = 1;
+    /// An incremental channel - the multicast socket it is published on, the shared memory ring it is also written to for local consumers
+    /// if configured, the writer packing updates into its datagrams and the sequence number of its next update.
+    struct IncrementalChannel {
+      IncrementalChannel(Logger &logger, const std::string &shm_ring_name, const MarketDataCfg &cfg);
+
+      ~IncrementalChannel() {
+        delete shm_ring_;
+        shm_ring_ = nullptr;
+      }
+
+      Common::McastSocket socket_;
+      Common::ShmBroadcastRing *shm_ring_ = nullptr;
+      MDPPacketWriter writer_;
+      size_t next_inc_seq_num_ = 1;
+    };
 
     /// Lock free queue from which we consume market data updates sent by the matching engine.
     MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr;
@@ -60,15 +89,24 @@ namespace Exchange {
     /// Lock free queue on which we forward the incremental market data updates to send to the snapshot synthesizer.
     MDPMarketUpdateLFQueue snapshot_md_updates_;
 
+    /// Lock free queue on which we forward the incremental market data updates to the retransmit server.
+    MDPMarketUpdateLFQueue retransmit_md_updates_;
+
     volatile bool run_ = false;
 
     std::string time_str_;
     Logger logger_;
 
-    /// Multicast socket to represent the incremental market data stream.
-    Common::McastSocket incremental_socket_;
+    /// A single channel with every instrument on the incremental port, or MarketDataCfg::incremental_channels_ of them, see mdpChannel().
+    std::vector<IncrementalChannel *> incremental_channels_;
 
     /// Snapshot synthesizer which synthesizes and publishes limit order book snapshots on the snapshot multicast stream.
     SnapshotSynthesizer *snapshot_synthesizer_ = nullptr;
+
+    /// Retransmit server which keeps the recent incremental updates and serves them to consumers filling gaps.
+    RetransmitServer *retransmit_server_ = nullptr;
+
+    /// Publisher of the market by price and best bid and offer feeds, nullptr if neither is configured.
+    PriceLevelPublisher *price_level_publisher_ = nullptr;
   };
 }
@@ -17,7 +17,10 @@ namespace Exchange {
     CANCEL = 4,
     TRADE = 5,
     SNAPSHOT_START = 6,
-    SNAPSHOT_END = 7
+    SNAPSHOT_END = 7,
+    EXECUTION = 8,
+    PRICE_LEVEL = 9,
+    BBO = 10
   };
 
   inline std::string marketUpdateTypeToString(MarketUpdateType type) {
@@ -36,6 +39,12 @@ namespace Exchange {
         return "SNAPSHOT_START";
       case MarketUpdateType::SNAPSHOT_END:
         return "SNAPSHOT_END";
+      case MarketUpdateType::EXECUTION:
+        return "EXECUTION";
+      case MarketUpdateType::PRICE_LEVEL:
+        return "PRICE_LEVEL";
+      case MarketUpdateType::BBO:
+        return "BBO";
       case MarketUpdateType::INVALID:
         return "INVALID";
     }
@@ -46,6 +55,12 @@ namespace Exchange {
 #pragma pack(push, 1)
 
   /// Market update structure used internally by the matching engine.
+  /// An EXECUTION combines a TRADE with the resulting CANCEL / MODIFY of the passive order it hit:
+  /// order_id_ is the passive order, side_ / price_ / qty_ describe the trade exactly like a TRADE message,
+  /// and priority_ carries the passive order's leaves quantity (0 if it was fully filled and removed).
+  /// A PRICE_LEVEL or BBO describes a whole price level instead of an order: qty_ is the quantity of every order at side_ / price_,
+  /// and order_id_ carries their number. A PRICE_LEVEL without orders is a level that was removed or fell out of the published depth,
+  /// a BBO without orders a side of the book that is empty.
   struct MEMarketUpdate {
     MarketUpdateType type_ = MarketUpdateType::INVALID;
 
@@ -56,6 +71,21 @@ namespace Exchange {
     Qty qty_ = Qty_INVALID;
     Priority priority_ = Priority_INVALID;
 
+    /// Leaves quantity of the passive order on an EXECUTION message.
+    auto passiveLeavesQty() const noexcept {
+      return static_cast<Qty>(priority_);
+    }
+
+    /// Number of orders at the price level on a PRICE_LEVEL or BBO message.
+    auto levelNumOrders() const noexcept {
+      return static_cast<size_t>(order_id_);
+    }
+
+    /// Side of the book the passive order rests on for an EXECUTION message.
+    auto passiveSide() const noexcept {
+      return (side_ == Side::BUY ? Side::SELL : Side::BUY);
+    }
+
     auto toString() const {
       std::stringstream ss;
       ss << "MEMarketUpdate"
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+
+#include "macros.h"
+#include "time_utils.h"
+#include "mcast_socket.h"
+#include "shm_broadcast_ring.h"
+
+#include "market_data/md_wire_format.h"
+
+namespace Exchange {
+  /// Encodes market updates into datagrams of the wire format in md_wire_format.h, as many as fit in the MTU.
+  /// A datagram is queued on the socket once the next update does not fit it, its deltas or its sequence numbers, or by flushIfDue() once
+  /// it has been open for the flush budget, and the socket publishes every queued datagram with a single sendmmsg() on its next sendAndRecv().
+  /// Given a shm_ring, every datagram is also published into it as soon as it is queued.
+  class MDPPacketWriter final {
+  public:
+    MDPPacketWriter(Common::McastSocket *socket, const MarketDataCfg &cfg, Common::ShmBroadcastRing *shm_ring = nullptr)
+        : socket_(socket), shm_ring_(shm_ring), flush_budget_nanos_(cfg.flush_budget_nanos_), max_packet_size_(maxPacketSize(cfg)) {
+      ASSERT(cfg.mtu_ >= IP_UDP_HEADER_SIZE + sizeof(MDPPacketHeader) + sizeof(MDPWireMessage),
+             "MTU too small for a single market update. " + cfg.toString());
+      // Encoding always writes a whole MDPWireMessage, so the last message of a full datagram needs the slack past its end.
+      packet_.resize(max_packet_size_ + sizeof(MDPWireMessage));
+      ASSERT(!shm_ring_ || shm_ring_->slotSize() >= packet_.size(), "Shared memory ring slots too small for the MTU. " + cfg.toString());
+    }
+
+    /// Longest datagram for the configured MTU.
+    static auto maxPacketSize(const MarketDataCfg &cfg) noexcept -> size_t {
+      return std::min<size_t>(cfg.mtu_ - IP_UDP_HEADER_SIZE, std::numeric_limits<uint16_t>::max());
+    }
+
+    /// Encode an update into the open datagram, queueing the datagram first if the update does not fit it.
+    auto add(const MDPMarketUpdate &market_update) noexcept {
+      if (num_updates_ && (market_update.seq_num_ != seq_num_ + num_updates_ ||
+                           packet_size_ + MDP_MESSAGE_SIZES[static_cast<uint8_t>(market_update.me_market_update_.type_)] > max_packet_size_)) {
+        closePacket();
+      }
+
+      auto size = mdpEncode(market_update.me_market_update_, &bases_, packet_.data() + packet_size_);
+      if (UNLIKELY(!size)) { // a delta does not fit against this datagram's bases, an empty datagram takes the update's own.
+        closePacket();
+        size = mdpEncode(market_update.me_market_update_, &bases_, packet_.data() + packet_size_);
+      }
+
+      if (!num_updates_) {
+        open_time_ = Common::getCurrentNanos();
+        seq_num_ = market_update.seq_num_;
+      }
+      packet_size_ += size;
+      ++num_updates_;
+    }
+
+    /// Queue the open datagram if it has waited for more updates for the flush budget.
+    auto flushIfDue() noexcept {
+      if (num_updates_ && Common::getCurrentNanos() - open_time_ >= flush_budget_nanos_) {
+        closePacket();
+      }
+    }
+
+    /// Queue the open datagram and publish everything queued on the socket.
+    auto flush() noexcept {
+      closePacket();
+      socket_->sendAndRecv();
+    }
+
+    /// Datagrams and bytes queued so far, headers included.
+    auto numPackets() const noexcept {
+      return num_packets_;
+    }
+
+    auto numBytes() const noexcept {
+      return num_bytes_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    MDPPacketWriter() = delete;
+
+    MDPPacketWriter(const MDPPacketWriter &) = delete;
+
+    MDPPacketWriter(const MDPPacketWriter &&) = delete;
+
+    MDPPacketWriter &operator=(const MDPPacketWriter &) = delete;
+
+    MDPPacketWriter &operator=(const MDPPacketWriter &&) = delete;
+
+  private:
+    auto closePacket() noexcept -> void {
+      if (!num_updates_) {
+        return;
+      }
+      MDPPacketHeader header;
+      header.size_ = static_cast<uint16_t>(packet_size_);
+      header.num_updates_ = num_updates_;
+      header.seq_num_ = seq_num_;
+      header.send_time_ = Common::getCurrentNanos();
+#define MDP_COPY_BASE(name, wire_type, member, absent) header.name##_base_ = bases_.name##_base_;
+      MDP_WIRE_FIELDS(MDP_IGNORE_FIELD, MDP_COPY_BASE)
+#undef MDP_COPY_BASE
+      memcpy(packet_.data(), &header, sizeof(header));
+      socket_->send(packet_.data(), packet_size_);
+      if (shm_ring_) {
+        shm_ring_->publish(packet_.data(), packet_size_);
+      }
+
+      ++num_packets_;
+      num_bytes_ += packet_size_;
+      packet_size_ = sizeof(MDPPacketHeader);
+      num_updates_ = 0;
+      bases_ = {};
+    }
+
+    Common::McastSocket *socket_ = nullptr;
+    Common::ShmBroadcastRing *shm_ring_ = nullptr;
+    const Nanos flush_budget_nanos_;
+    const size_t max_packet_size_;
+
+    /// The datagram being filled, its header is written when it is queued.
+    std::vector<char> packet_;
+    size_t packet_size_ = sizeof(MDPPacketHeader);
+    uint16_t num_updates_ = 0;
+    size_t seq_num_ = 0;
+    MDPPacketBases bases_;
+    Nanos open_time_ = 0;
+
+    size_t num_packets_ = 0;
+    size_t num_bytes_ = 0;
+  };
+}
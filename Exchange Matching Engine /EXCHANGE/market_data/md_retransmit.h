@@ -0,0 +1,58 @@
+#pragma once
+
+#include <sstream>
+
+#include "market_data/market_update.h"
+
+/// Retransmission of the incremental market data stream, served over TCP by the exchange's RetransmitServer.
+///
+/// A consumer that detects a gap asks for the updates it missed with an MDPRetransmitRequest, and gets back an MDPRetransmitResponse
+/// followed, if the server still has all of them in its history, by the updates themselves as MDPMarketUpdates in sequence.
+/// Gaps longer than MDP_MAX_RETRANSMIT_UPDATES, or older than the history, are recovered from the snapshot stream instead.
+
+namespace Exchange {
+  /// Most updates a single request can ask for.
+  constexpr size_t MDP_MAX_RETRANSMIT_UPDATES = 8 * 1024;
+
+#pragma pack(push, 1)
+
+  /// Ask for the incremental updates numbered [begin_seq_, end_seq_) on incremental channel channel_, see mdpChannel().
+  struct MDPRetransmitRequest {
+    size_t begin_seq_ = 0;
+    size_t end_seq_ = 0;
+    size_t channel_ = 0;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MDPRetransmitRequest"
+         << " ["
+         << "begin:" << begin_seq_
+         << " end:" << end_seq_
+         << " channel:" << channel_
+         << "]";
+      return ss.str();
+    }
+  };
+
+  /// Answer to the request for [begin_seq_, end_seq_) on channel_, followed by its end_seq_ - begin_seq_ updates if accepted_.
+  struct MDPRetransmitResponse {
+    size_t begin_seq_ = 0;
+    size_t end_seq_ = 0;
+    bool accepted_ = false;
+    size_t channel_ = 0;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MDPRetransmitResponse"
+         << " ["
+         << "begin:" << begin_seq_
+         << " end:" << end_seq_
+         << " accepted:" << accepted_
+         << " channel:" << channel_
+         << "]";
+      return ss.str();
+    }
+  };
+
+#pragma pack(pop)
+}
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+#include "market_data/market_update.h"
+
+/// Wire format of the market data streams, version MDP_VERSION.
+///
+/// A datagram is an MDPPacketHeader followed by num_updates_ messages. Every message is a type byte followed by the leading fields of
+/// MDPWireMessage its type carries, so each type has its own layout and size without any per-message length or presence bits.
+/// Prices, order ids and priorities are sent as 32 bit deltas against bases in the packet header, and the updates in a packet have
+/// consecutive sequence numbers starting at the header's seq_num_.
+///
+/// Both layouts and codecs are generated from the two lists below: change the schema there, and bump MDP_VERSION.
+
+namespace Exchange {
+  constexpr uint8_t MDP_VERSION = 3;
+
+  /// Shared memory ShmBroadcastRing the publisher also writes the incremental datagrams to when MarketDataCfg::shm_ring_ is set,
+  /// one datagram per slot, each slot readable sizeof(MDPWireMessage) bytes past the longest datagram so it decodes in place.
+  constexpr auto MDP_SHM_RING_NAME = "/exchange_md_incremental";
+
+  /// Instruments are partitioned into channels by TickerId: with MarketDataCfg::incremental_channels_ set, each channel has its own
+  /// incremental stream with its own sequence numbers, and with it or MarketDataCfg::snapshot_channels_ set, its own snapshot cycles.
+  /// Every channel is published to the incremental or snapshot multicast group on a port of its own past the stream's port - its own port
+  /// rather than group, so a socket only ever receives the channels it joined whatever else the host joined.
+  constexpr int MDP_SNAPSHOT_CHANNEL_PORT_OFFSET = 10;
+  constexpr int MDP_INCREMENTAL_CHANNEL_PORT_OFFSET = 20;
+
+  /// The market by price and best bid and offer feeds derived from the books, with MarketDataCfg::price_level_depth_ and
+  /// MarketDataCfg::bbo_feed_ set, are each published with sequence numbers of their own to the incremental multicast group, on ports
+  /// of their own past the incremental port.
+  constexpr int MDP_PRICE_LEVEL_PORT_OFFSET = 40;
+  constexpr int MDP_BBO_PORT_OFFSET = 41;
+
+  /// Channel of an instrument, out of num_channels.
+  inline auto mdpChannel(TickerId ticker_id, size_t num_channels) noexcept -> size_t {
+    return ticker_id % num_channels;
+  }
+
+  /// Port a snapshot channel is published on.
+  inline auto mdpSnapshotChannelPort(int snapshot_port, size_t channel) noexcept -> int {
+    return snapshot_port + MDP_SNAPSHOT_CHANNEL_PORT_OFFSET + static_cast<int>(channel);
+  }
+
+  /// Port an incremental channel is published on.
+  inline auto mdpIncrementalChannelPort(int incremental_port, size_t channel) noexcept -> int {
+    return incremental_port + MDP_INCREMENTAL_CHANNEL_PORT_OFFSET + static_cast<int>(channel);
+  }
+
+  /// Shared memory ring of an incremental channel, MDP_SHM_RING_NAME without incremental channels.
+  inline auto mdpShmRingName(size_t num_channels, size_t channel) -> std::string {
+    return num_channels ? std::string(MDP_SHM_RING_NAME) + "_" + std::to_string(channel) : std::string(MDP_SHM_RING_NAME);
+  }
+
+  /// Fields in wire order - PLAIN(name, wire type, MEMarketUpdate member, value when absent) are sent as is, narrowed to the wire type,
+  /// DELTA(...) are sent as the difference to the packet's base for that field.
+  /// TickerIds are sign extended back so that the 0xFF of TickerId_INVALID round trips.
+#define MDP_WIRE_FIELDS(PLAIN, DELTA) \
+  PLAIN(ticker_id, int8_t, ticker_id_, TickerId_INVALID) \
+  PLAIN(side, int8_t, side_, Side::INVALID) \
+  DELTA(price, int32_t, price_, Price_INVALID) \
+  PLAIN(qty, uint32_t, qty_, Qty_INVALID) \
+  DELTA(order_id, int32_t, order_id_, OrderId_INVALID) \
+  DELTA(priority, int32_t, priority_, Priority_INVALID)
+
+  /// MESSAGE(type, number of leading fields it carries). A TRADE has no order or priority, a CANCEL or MODIFY no priority,
+  /// SNAPSHOT_START / SNAPSHOT_END only need order_id_ for the incremental sequence number they refer to, PRICE_LEVEL / BBO only need
+  /// order_id_ for the number of orders at the level.
+#define MDP_WIRE_MESSAGES(MESSAGE) \
+  MESSAGE(INVALID, 0) \
+  MESSAGE(CLEAR, 1) \
+  MESSAGE(ADD, 6) \
+  MESSAGE(MODIFY, 5) \
+  MESSAGE(CANCEL, 5) \
+  MESSAGE(TRADE, 4) \
+  MESSAGE(SNAPSHOT_START, 5) \
+  MESSAGE(SNAPSHOT_END, 5) \
+  MESSAGE(EXECUTION, 6) \
+  MESSAGE(PRICE_LEVEL, 5) \
+  MESSAGE(BBO, 5)
+
+#define MDP_IGNORE_FIELD(name, wire_type, member, absent)
+
+  static_assert(ME_MAX_TICKERS < 128, "TickerIds are sent as an int8_t.");
+
+#pragma pack(push, 1)
+
+  /// A message with every field, messages on the wire are prefixes of it.
+  struct MDPWireMessage {
+    MarketUpdateType type_ = MarketUpdateType::INVALID;
+#define MDP_DECLARE_FIELD(name, wire_type, member, absent) wire_type name##_ = 0;
+    MDP_WIRE_FIELDS(MDP_DECLARE_FIELD, MDP_DECLARE_FIELD)
+#undef MDP_DECLARE_FIELD
+  };
+
+  struct MDPPacketHeader {
+    uint8_t version_ = MDP_VERSION;
+
+    /// Bytes in the datagram, this header included.
+    uint16_t size_ = 0;
+    uint16_t num_updates_ = 0;
+
+    /// Sequence number of the first update, the i-th update has seq_num_ + i.
+    size_t seq_num_ = 0;
+    Nanos send_time_ = 0;
+
+#define MDP_DECLARE_BASE(name, wire_type, member, absent) decltype(MEMarketUpdate::member) name##_base_ = 0;
+    MDP_WIRE_FIELDS(MDP_IGNORE_FIELD, MDP_DECLARE_BASE)
+#undef MDP_DECLARE_BASE
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "MDPPacketHeader"
+         << " ["
+         << " version:" << static_cast<int>(version_)
+         << " size:" << size_
+         << " updates:" << num_updates_
+         << " seq:" << seq_num_
+         << " send_time:" << send_time_
+         << "]";
+      return ss.str();
+    }
+  };
+
+#pragma pack(pop)
+
+  /// Index of every field in wire order.
+  enum MDPWireField : uint8_t {
+#define MDP_FIELD_INDEX(name, wire_type, member, absent) MDP_FIELD_##name,
+    MDP_WIRE_FIELDS(MDP_FIELD_INDEX, MDP_FIELD_INDEX)
+#undef MDP_FIELD_INDEX
+    MDP_NUM_FIELDS
+  };
+
+  /// Fields carried and wire size of each message type, indexed by the type byte. Unknown types carry nothing.
+  inline constexpr auto mdpMessageFields() {
+    std::array<uint8_t, 256> fields{};
+#define MDP_MESSAGE_FIELDS(type, num_fields) \
+    static_assert(num_fields <= MDP_NUM_FIELDS, #type " carries more fields than there are."); \
+    fields[static_cast<uint8_t>(MarketUpdateType::type)] = num_fields;
+    MDP_WIRE_MESSAGES(MDP_MESSAGE_FIELDS)
+#undef MDP_MESSAGE_FIELDS
+    return fields;
+  }
+
+  constexpr auto MDP_MESSAGE_FIELDS = mdpMessageFields();
+
+  inline constexpr auto mdpMessageSizes() {
+    constexpr std::array<size_t, MDP_NUM_FIELDS + 1> prefix_size = {
+        sizeof(MarketUpdateType),
+#define MDP_FIELD_END(name, wire_type, member, absent) offsetof(MDPWireMessage, name##_) + sizeof(wire_type),
+        MDP_WIRE_FIELDS(MDP_FIELD_END, MDP_FIELD_END)
+#undef MDP_FIELD_END
+    };
+    std::array<uint8_t, 256> sizes{};
+    for (size_t type = 0; type < sizes.size(); ++type) {
+      sizes[type] = prefix_size[MDP_MESSAGE_FIELDS[type]];
+    }
+    return sizes;
+  }
+
+  constexpr auto MDP_MESSAGE_SIZES = mdpMessageSizes();
+
+  /// Bases of the packet being encoded, each set by the first update that carries its field.
+  struct MDPPacketBases {
+#define MDP_DECLARE_BASE(name, wire_type, member, absent) decltype(MEMarketUpdate::member) name##_base_ = 0; bool name##_set_ = false;
+    MDP_WIRE_FIELDS(MDP_IGNORE_FIELD, MDP_DECLARE_BASE)
+#undef MDP_DECLARE_BASE
+  };
+
+  /// value if present, absent otherwise, as a mask select rather than a branch.
+  template<typename T>
+  inline auto mdpSelect(bool present, T value, T absent) noexcept {
+    using Bits = std::conditional_t<sizeof(T) == 8, uint64_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint8_t>>;
+    static_assert(sizeof(T) == sizeof(Bits), "mdpSelect of an unsupported width.");
+    Bits value_bits, absent_bits;
+    memcpy(&value_bits, &value, sizeof(T));
+    memcpy(&absent_bits, &absent, sizeof(T));
+    const auto mask = static_cast<Bits>(-static_cast<Bits>(present));
+    const Bits bits = (value_bits & mask) | (absent_bits & ~mask);
+    T result;
+    memcpy(&result, &bits, sizeof(T));
+    return result;
+  }
+
+  /// Deltas are taken and applied modulo 2^64, so any two values whose wrapped difference fits the wire type round trip, INVALIDs included.
+  template<typename T>
+  inline auto mdpDelta(T value, T base) noexcept {
+    return static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(base));
+  }
+
+  template<typename T, typename D>
+  inline auto mdpUndelta(T base, D delta) noexcept {
+    return static_cast<T>(static_cast<uint64_t>(base) + static_cast<uint64_t>(static_cast<int64_t>(delta)));
+  }
+
+  /// Encode market_update at out against the packet's bases.
+  /// Returns the message size, or 0 without touching the bases if a delta does not fit the wire type: the update needs a new packet.
+  /// Writes a whole MDPWireMessage, out must have room for one even if the message is shorter.
+  inline auto mdpEncode(const MEMarketUpdate &market_update, MDPPacketBases *bases, char *out) noexcept -> size_t {
+    const auto num_fields = MDP_MESSAGE_FIELDS[static_cast<uint8_t>(market_update.type_)];
+    MDPWireMessage wire;
+    wire.type_ = market_update.type_;
+
+#define MDP_CHECK_DELTA(name, wire_type, member, absent) \
+    if (MDP_FIELD_##name < num_fields) { \
+      const auto base = bases->name##_set_ ? bases->name##_base_ : market_update.member; \
+      const auto delta = mdpDelta(market_update.member, base); \
+      if (delta < std::numeric_limits<wire_type>::min() || delta > std::numeric_limits<wire_type>::max()) { \
+        return 0; \
+      } \
+    }
+    MDP_WIRE_FIELDS(MDP_IGNORE_FIELD, MDP_CHECK_DELTA)
+#undef MDP_CHECK_DELTA
+
+#define MDP_ENCODE_PLAIN(name, wire_type, member, absent) wire.name##_ = static_cast<wire_type>(market_update.member);
+#define MDP_ENCODE_DELTA(name, wire_type, member, absent) \
+    if (MDP_FIELD_##name < num_fields) { \
+      if (!bases->name##_set_) { \
+        bases->name##_base_ = market_update.member; \
+        bases->name##_set_ = true; \
+      } \
+      wire.name##_ = static_cast<wire_type>(mdpDelta(market_update.member, bases->name##_base_)); \
+    }
+    MDP_WIRE_FIELDS(MDP_ENCODE_PLAIN, MDP_ENCODE_DELTA)
+#undef MDP_ENCODE_PLAIN
+#undef MDP_ENCODE_DELTA
+
+    memcpy(out, &wire, sizeof(wire));
+    return MDP_MESSAGE_SIZES[static_cast<uint8_t>(wire.type_)];
+  }
+
+  /// Decode the message at in into market_update, returns its size. Branch free: every field is loaded and the ones its type does not
+  /// carry are replaced by their absent value with a mask. Reads a whole MDPWireMessage, in must be readable that far.
+  inline auto mdpDecode(const char *in, const MDPPacketHeader &header, MEMarketUpdate *market_update) noexcept -> size_t {
+    MDPWireMessage wire;
+    memcpy(&wire, in, sizeof(wire));
+    const auto num_fields = MDP_MESSAGE_FIELDS[static_cast<uint8_t>(wire.type_)];
+    market_update->type_ = wire.type_;
+
+#define MDP_DECODE_PLAIN(name, wire_type, member, absent) \
+    market_update->member = mdpSelect(MDP_FIELD_##name < num_fields, static_cast<decltype(MEMarketUpdate::member)>(wire.name##_), \
+                                      static_cast<decltype(MEMarketUpdate::member)>(absent));
+#define MDP_DECODE_DELTA(name, wire_type, member, absent) \
+    market_update->member = mdpSelect(MDP_FIELD_##name < num_fields, \
+                                      mdpUndelta(header.name##_base_, wire.name##_), \
+                                      static_cast<decltype(MEMarketUpdate::member)>(absent));
+    MDP_WIRE_FIELDS(MDP_DECODE_PLAIN, MDP_DECODE_DELTA)
+#undef MDP_DECODE_PLAIN
+#undef MDP_DECODE_DELTA
+
+    return MDP_MESSAGE_SIZES[static_cast<uint8_t>(wire.type_)];
+  }
+
+  /// Decode every update of the packet at in, calling visit with each as an MDPMarketUpdate.
+  /// in must be readable sizeof(MDPWireMessage) bytes past the end of the packet. Decoding stops at the first message that does not fit
+  /// in the packet whatever num_updates_ says, so a truncated message is never decoded.
+  template<typename F>
+  inline auto mdpDecodePacket(const char *in, F &&visit) noexcept {
+    MDPPacketHeader header;
+    memcpy(&header, in, sizeof(header));
+    const auto end = in + header.size_;
+    auto message = in + sizeof(MDPPacketHeader);
+    MDPMarketUpdate market_update;
+    for (uint16_t i = 0; i < header.num_updates_ && message + MDP_MESSAGE_SIZES[static_cast<uint8_t>(*message)] <= end; ++i) {
+      market_update.seq_num_ = header.seq_num_ + i;
+      message += mdpDecode(message, header, &market_update.me_market_update_);
+      visit(market_update);
+    }
+  }
+}
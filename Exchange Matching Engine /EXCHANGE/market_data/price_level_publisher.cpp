@@ -0,0 +1,184 @@
+#include "price_level_publisher.h"
+
+#include <algorithm>
+
+namespace Exchange {
+  PriceLevelPublisher::PriceLevelPublisher(Logger &logger, const std::string &iface, const std::string &incremental_ip, int incremental_port,
+                                           const MarketDataCfg &cfg)
+      : logger_(logger), price_level_depth_(cfg.price_level_depth_), bbo_interval_nanos_(cfg.bbo_interval_nanos_) {
+    for (auto &order_qtys: order_qtys_) {
+      order_qtys.resize(ME_MAX_ORDER_IDS, 0);
+    }
+    for (auto &book: books_) {
+      for (auto &book_side: book) {
+        book_side.levels_.reserve(ME_MAX_PRICE_LEVELS);
+      }
+    }
+
+    if (price_level_depth_) {
+      price_level_feed_ = new Feed(logger_, cfg);
+      ASSERT(price_level_feed_->socket_.init(incremental_ip, iface, incremental_port + MDP_PRICE_LEVEL_PORT_OFFSET, /*is_listening*/ false) >= 0,
+             "Unable to create price level mcast socket. error:" + std::string(std::strerror(errno)));
+    }
+    if (cfg.bbo_feed_) {
+      bbo_feed_ = new Feed(logger_, cfg);
+      ASSERT(bbo_feed_->socket_.init(incremental_ip, iface, incremental_port + MDP_BBO_PORT_OFFSET, /*is_listening*/ false) >= 0,
+             "Unable to create BBO mcast socket. error:" + std::string(std::strerror(errno)));
+    }
+
+    logger_.log("%:% %() % Publishing price level depth:% bbo:% interval:%\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_),
+                price_level_depth_, cfg.bbo_feed_, bbo_interval_nanos_);
+  }
+
+  PriceLevelPublisher::~PriceLevelPublisher() {
+    delete price_level_feed_;
+    price_level_feed_ = nullptr;
+
+    delete bbo_feed_;
+    bbo_feed_ = nullptr;
+  }
+
+  /// Apply an update from the matching engine to the price levels, publishing the changes to the top levels on the market by price feed.
+  auto PriceLevelPublisher::onMarketUpdate(const MEMarketUpdate &market_update) noexcept -> void {
+    auto &order_qtys = order_qtys_.at(market_update.ticker_id_);
+    switch (market_update.type_) {
+      case MarketUpdateType::ADD: {
+        auto &order_qty = order_qtys.at(market_update.order_id_);
+        if (UNLIKELY(order_qty)) {
+          FATAL("Received:" + market_update.toString() + " but order already exists.");
+        }
+        order_qty = market_update.qty_;
+        updateLevel(market_update.ticker_id_, market_update.side_, market_update.price_, market_update.qty_, 1);
+      }
+        break;
+      case MarketUpdateType::MODIFY: {
+        auto &order_qty = order_qtys.at(market_update.order_id_);
+        if (UNLIKELY(!order_qty)) {
+          FATAL("Received:" + market_update.toString() + " but order does not exist.");
+        }
+        updateLevel(market_update.ticker_id_, market_update.side_, market_update.price_,
+                    static_cast<int64_t>(market_update.qty_) - order_qty, 0);
+        order_qty = market_update.qty_;
+      }
+        break;
+      case MarketUpdateType::CANCEL: {
+        auto &order_qty = order_qtys.at(market_update.order_id_);
+        if (UNLIKELY(!order_qty)) {
+          FATAL("Received:" + market_update.toString() + " but order does not exist.");
+        }
+        updateLevel(market_update.ticker_id_, market_update.side_, market_update.price_, -static_cast<int64_t>(order_qty), -1);
+        order_qty = 0;
+      }
+        break;
+      case MarketUpdateType::EXECUTION: { // the passive order is either reduced or fully filled and removed.
+        auto &order_qty = order_qtys.at(market_update.order_id_);
+        if (UNLIKELY(!order_qty)) {
+          FATAL("Received:" + market_update.toString() + " but order does not exist.");
+        }
+        const auto leaves_qty = market_update.passiveLeavesQty();
+        updateLevel(market_update.ticker_id_, market_update.passiveSide(), market_update.price_,
+                    static_cast<int64_t>(leaves_qty) - order_qty, leaves_qty ? 0 : -1);
+        order_qty = leaves_qty;
+      }
+        break;
+      case MarketUpdateType::CLEAR:
+      case MarketUpdateType::TRADE:
+      case MarketUpdateType::SNAPSHOT_START:
+      case MarketUpdateType::SNAPSHOT_END:
+      case MarketUpdateType::PRICE_LEVEL:
+      case MarketUpdateType::BBO:
+      case MarketUpdateType::INVALID:
+        break;
+    }
+  }
+
+  /// Add qty and num_orders to the level at price of a side, which may be negative to take them off, creating or removing the level as needed.
+  auto PriceLevelPublisher::updateLevel(TickerId ticker_id, Side side, Price price, int64_t qty, int64_t num_orders) noexcept -> void {
+    auto &levels = books_.at(ticker_id).at(sideToIndex(side)).levels_;
+
+    // Levels are worst first, the first one not worse than price is either at price or where a level at price goes.
+    auto itr = std::lower_bound(levels.begin(), levels.end(), price, [side](const PriceLevel &level, Price level_price) {
+      return (side == Side::BUY) ? level.price_ < level_price : level.price_ > level_price;
+    });
+    const auto exists = (itr != levels.end() && itr->price_ == price);
+    if (UNLIKELY(!exists && (qty <= 0 || num_orders <= 0))) {
+      FATAL("No price level to take qty:" + std::to_string(qty) + " orders:" + std::to_string(num_orders) + " off of ticker:" +
+            tickerIdToString(ticker_id) + " side:" + sideToString(side) + " price:" + priceToString(price));
+    }
+
+    // Levels are ranked from the best one, 0, down, only those ranked within the depth are published.
+    const auto index = static_cast<size_t>(itr - levels.begin());
+    const auto rank = exists ? levels.size() - 1 - index : levels.size() - index;
+    const auto published = (price_level_feed_ && rank < price_level_depth_);
+
+    if (!exists) {
+      levels.insert(itr, PriceLevel{price, static_cast<Qty>(qty), static_cast<size_t>(num_orders)});
+      if (published) {
+        publishLevel(ticker_id, side, levels[index]);
+
+        // The level that was last within the depth was pushed out of it.
+        if (levels.size() > price_level_depth_) {
+          publishLevel(ticker_id, side, PriceLevel{levels[levels.size() - 1 - price_level_depth_].price_, 0, 0});
+        }
+      }
+      return;
+    }
+
+    itr->qty_ = static_cast<Qty>(itr->qty_ + qty);
+    itr->num_orders_ = static_cast<size_t>(static_cast<int64_t>(itr->num_orders_) + num_orders);
+    if (itr->num_orders_) {
+      if (published) {
+        publishLevel(ticker_id, side, *itr);
+      }
+      return;
+    }
+
+    levels.erase(itr);
+    if (published) {
+      publishLevel(ticker_id, side, PriceLevel{price, 0, 0});
+
+      // The level that was first past the depth moved into it.
+      if (levels.size() >= price_level_depth_) {
+        publishLevel(ticker_id, side, levels[levels.size() - price_level_depth_]);
+      }
+    }
+  }
+
+  /// Publish a level of a side on the market by price feed, without any orders or quantity if it left the published depth.
+  auto PriceLevelPublisher::publishLevel(TickerId ticker_id, Side side, const PriceLevel &level) noexcept -> void {
+    publish(price_level_feed_, MEMarketUpdate{MarketUpdateType::PRICE_LEVEL, level.num_orders_, ticker_id, side, level.price_, level.qty_,
+                                              Priority_INVALID});
+  }
+
+  /// Publish the best bids and offers that changed once the interval is up, and the datagrams of both feeds that are due.
+  auto PriceLevelPublisher::flushIfDue() noexcept -> void {
+    if (price_level_feed_) {
+      price_level_feed_->writer_.flushIfDue();
+      price_level_feed_->socket_.sendAndRecv();
+    }
+
+    if (bbo_feed_ && Common::getCurrentNanos() >= next_bbo_time_) {
+      next_bbo_time_ = Common::getCurrentNanos() + bbo_interval_nanos_;
+
+      // Only the last state of every side within the interval is published, and only if it differs from the one published before.
+      for (TickerId ticker_id = 0; ticker_id < ME_MAX_TICKERS; ++ticker_id) {
+        for (const auto side: {Side::BUY, Side::SELL}) {
+          auto &book_side = books_[ticker_id][sideToIndex(side)];
+          const auto best = book_side.levels_.empty() ? PriceLevel{} : book_side.levels_.back();
+          if (best.price_ != book_side.published_bbo_.price_ || best.qty_ != book_side.published_bbo_.qty_ ||
+              best.num_orders_ != book_side.published_bbo_.num_orders_) {
+            book_side.published_bbo_ = best;
+            publish(bbo_feed_, MEMarketUpdate{MarketUpdateType::BBO, best.num_orders_, ticker_id, side, best.price_, best.qty_, Priority_INVALID});
+          }
+        }
+      }
+      bbo_feed_->writer_.flush();
+    }
+  }
+
+  /// Publish an update on a feed with the feed's next sequence number.
+  auto PriceLevelPublisher::publish(Feed *feed, const MEMarketUpdate &market_update) noexcept -> void {
+    feed->writer_.add(MDPMarketUpdate{feed->next_seq_num_, market_update});
+    ++feed->next_seq_num_;
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <vector>
+
+#include "types.h"
+#include "macros.h"
+#include "mcast_socket.h"
+#include "logging.h"
+
+#include "market_data/market_update.h"
+#include "market_data/md_packet_writer.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Aggregates the order by order updates of the matching engine into the quantity and number of orders at every price level of every
+  /// book, and publishes two lighter feeds derived from them, each on its own port with its own sequence numbers, see md_wire_format.h:
+  /// - with MarketDataCfg::price_level_depth_ set, a PRICE_LEVEL for every change to the top that many levels of a side, including the
+  ///   levels that move into that depth, and one without orders for every level that is removed or moves out of it.
+  /// - with MarketDataCfg::bbo_feed_ set, a BBO for every side of a book whose best level changed since the last one, at most once per
+  ///   MarketDataCfg::bbo_interval_nanos_ however often it changes in between.
+  /// Driven from the market data publisher's thread.
+  class PriceLevelPublisher {
+  public:
+    PriceLevelPublisher(Logger &logger, const std::string &iface, const std::string &incremental_ip, int incremental_port, const MarketDataCfg &cfg);
+
+    ~PriceLevelPublisher();
+
+    /// Apply an update from the matching engine to the price levels, publishing the changes to the top levels on the market by price feed.
+    auto onMarketUpdate(const MEMarketUpdate &market_update) noexcept -> void;
+
+    /// Publish the best bids and offers that changed once the interval is up, and the datagrams of both feeds that are due.
+    auto flushIfDue() noexcept -> void;
+
+    /// Updates published on the market by price and best bid and offer feeds so far.
+    auto numPriceLevelUpdates() const noexcept {
+      return price_level_feed_ ? price_level_feed_->next_seq_num_ - 1 : 0;
+    }
+
+    auto numBBOUpdates() const noexcept {
+      return bbo_feed_ ? bbo_feed_->next_seq_num_ - 1 : 0;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    PriceLevelPublisher() = delete;
+
+    PriceLevelPublisher(const PriceLevelPublisher &) = delete;
+
+    PriceLevelPublisher(const PriceLevelPublisher &&) = delete;
+
+    PriceLevelPublisher &operator=(const PriceLevelPublisher &) = delete;
+
+    PriceLevelPublisher &operator=(const PriceLevelPublisher &&) = delete;
+
+  private:
+    /// Quantity and number of orders at a price.
+    struct PriceLevel {
+      Price price_ = Price_INVALID;
+      Qty qty_ = 0;
+      size_t num_orders_ = 0;
+    };
+
+    /// A feed - the multicast socket it is published on, the writer packing updates into its datagrams and the sequence number of its next update.
+    struct Feed {
+      Feed(Logger &logger, const MarketDataCfg &cfg)
+          : socket_(logger), writer_(&socket_, cfg) {
+      }
+
+      McastSocket socket_;
+      MDPPacketWriter writer_;
+      size_t next_seq_num_ = 1;
+    };
+
+    /// The price levels of a side of a book, worst first so the levels that change most, close to the top, are the cheapest to insert
+    /// and remove, and the best level as last published on the best bid and offer feed.
+    struct BookSide {
+      std::vector<PriceLevel> levels_;
+      PriceLevel published_bbo_;
+    };
+
+    std::string time_str_;
+    Logger &logger_;
+
+    /// Remaining quantity of every live order, indexed by TickerId and OrderId, for the level to take it off when it is modified or executed.
+    std::array<std::vector<Qty>, ME_MAX_TICKERS> order_qtys_;
+
+    /// Every side of every book, indexed by TickerId and sideToIndex().
+    std::array<std::array<BookSide, sideToIndex(Side::MAX)>, ME_MAX_TICKERS> books_;
+
+    /// Levels of a side published on the market by price feed, and the feed, nullptr without it.
+    const size_t price_level_depth_;
+    Feed *price_level_feed_ = nullptr;
+
+    /// The best bid and offer feed, nullptr without it, the interval it is conflated to and when it is next published.
+    Feed *bbo_feed_ = nullptr;
+    const Nanos bbo_interval_nanos_;
+    Nanos next_bbo_time_ = 0;
+
+  private:
+    /// Add qty and num_orders to the level at price of a side, which may be negative to take them off, creating or removing the level as needed.
+    auto updateLevel(TickerId ticker_id, Side side, Price price, int64_t qty, int64_t num_orders) noexcept -> void;
+
+    /// Publish a level of a side on the market by price feed, without any orders or quantity if it left the published depth.
+    auto publishLevel(TickerId ticker_id, Side side, const PriceLevel &level) noexcept -> void;
+
+    /// Publish an update on a feed with the feed's next sequence number.
+    auto publish(Feed *feed, const MEMarketUpdate &market_update) noexcept -> void;
+  };
+}
@@ -0,0 +1,97 @@
+#include "retransmit_server.h"
+
+namespace Exchange {
+  RetransmitServer::RetransmitServer(MDPMarketUpdateLFQueue *market_updates, const std::string &iface, int port, const MarketDataCfg &cfg)
+      : retransmit_md_updates_(market_updates), logger_("exchange_retransmit_server.log"), iface_(iface), port_(port),
+        incremental_channels_(cfg.incremental_channels_),
+        histories_(std::max<size_t>(cfg.incremental_channels_, 1), ChannelHistory{std::vector<MEMarketUpdate>(cfg.retransmit_history_)}),
+        tcp_server_(logger_, ME_MAX_NUM_CLIENTS) {
+    ASSERT((cfg.retransmit_history_ & (cfg.retransmit_history_ - 1)) == 0, "Retransmit history size must be power of 2. " + cfg.toString());
+    response_.reserve(sizeof(MDPRetransmitResponse) + MDP_MAX_RETRANSMIT_UPDATES * sizeof(MDPMarketUpdate));
+
+    tcp_server_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
+    tcp_server_.recv_finished_callback_ = []() {};
+  }
+
+  RetransmitServer::~RetransmitServer() {
+    stop();
+  }
+
+  /// Start listening and the retransmit server thread, and stop it.
+  auto RetransmitServer::start() -> void {
+    run_ = true;
+    listen();
+
+    ASSERT(Common::createAndStartThread(-1, "Exchange/RetransmitServer", [this]() { run(); }) != nullptr,
+           "Failed to start RetransmitServer thread.");
+  }
+
+  auto RetransmitServer::stop() -> void {
+    run_ = false;
+  }
+
+  /// Start accepting consumers without a thread of its own, when poll() is driven from elsewhere.
+  auto RetransmitServer::listen() -> void {
+    tcp_server_.listen(iface_, port_);
+  }
+
+  /// Main method for this thread - records incremental updates from the market data publisher into the history and answers requests.
+  auto RetransmitServer::run() noexcept -> void {
+    logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_));
+    while (run_) {
+      poll();
+    }
+  }
+
+  /// One round of run(), for driving the server from another thread's loop.
+  auto RetransmitServer::poll() noexcept -> void {
+    // The publisher queues every update here before sending its datagram, so a gap a consumer asks about is in the history by the time
+    // its request is read below.
+    for (auto market_update = retransmit_md_updates_->getNextToRead(); retransmit_md_updates_->size() && market_update;
+         market_update = retransmit_md_updates_->getNextToRead()) {
+      auto &history = histories_[incremental_channels_ ? mdpChannel(market_update->me_market_update_.ticker_id_, incremental_channels_) : 0];
+      if (UNLIKELY(market_update->seq_num_ != history.next_seq_)) {
+        FATAL("Unexpected incremental update, expected seq:" + std::to_string(history.next_seq_) + " " + market_update->toString());
+      }
+      history.updates_[history.next_seq_ & (history.updates_.size() - 1)] = market_update->me_market_update_;
+      ++history.next_seq_;
+
+      retransmit_md_updates_->updateReadIndex();
+    }
+
+    tcp_server_.poll();
+    tcp_server_.sendAndRecv();
+  }
+
+  /// Answer every complete request read from a consumer.
+  auto RetransmitServer::recvCallback(TCPSocket *socket, Nanos) noexcept -> void {
+    size_t i = 0;
+    for (; i + sizeof(MDPRetransmitRequest) <= socket->inbound_.size(); i += sizeof(MDPRetransmitRequest)) {
+      const auto request = reinterpret_cast<const MDPRetransmitRequest *>(socket->inbound_.readData() + i);
+
+      // Only ranges still wholly in the history of a channel that exists are served, anything else is left to the snapshot stream.
+      MDPRetransmitResponse response{request->begin_seq_, request->end_seq_, false, request->channel_};
+      const auto history = (request->channel_ < histories_.size()) ? &histories_[request->channel_] : nullptr;
+      response.accepted_ = (history && request->begin_seq_ && request->begin_seq_ < request->end_seq_ && request->end_seq_ <= history->next_seq_ &&
+                            request->end_seq_ - request->begin_seq_ <= MDP_MAX_RETRANSMIT_UPDATES &&
+                            request->begin_seq_ + history->updates_.size() >= history->next_seq_);
+      logger_.log("%:% %() % socket:% % next:% %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_),
+                  socket->socket_fd_, request->toString(), history ? history->next_seq_ : 0, response.toString());
+
+      response_.resize(sizeof(response));
+      memcpy(response_.data(), &response, sizeof(response));
+      if (response.accepted_) {
+        response_.resize(sizeof(response) + (response.end_seq_ - response.begin_seq_) * sizeof(MDPMarketUpdate));
+        auto next_update = reinterpret_cast<MDPMarketUpdate *>(response_.data() + sizeof(response));
+        for (auto seq = response.begin_seq_; seq < response.end_seq_; ++seq, ++next_update) {
+          *next_update = MDPMarketUpdate{seq, history->updates_[seq & (history->updates_.size() - 1)]};
+        }
+      }
+      socket->send(response_.data(), response_.size());
+      if (UNLIKELY(socket->disconnected())) { // a consumer not reading its responses was dropped by the slow consumer policy.
+        return;
+      }
+    }
+    socket->inbound_.consume(i);
+  }
+}
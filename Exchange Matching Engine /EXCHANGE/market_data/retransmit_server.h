@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.h"
+#include "thread_utils.h"
+#include "lf_queue.h"
+#include "macros.h"
+#include "tcp_server.h"
+#include "logging.h"
+
+#include "market_data/market_update.h"
+#include "market_data/md_retransmit.h"
+#include "market_data/md_wire_format.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Keeps the most recent incremental updates and serves them to consumers filling gaps in the incremental stream, see md_retransmit.h.
+  /// Runs on its own thread, fed by the market data publisher through a lock free queue the same way the snapshot synthesizer is.
+  class RetransmitServer {
+  public:
+    RetransmitServer(MDPMarketUpdateLFQueue *market_updates, const std::string &iface, int port, const MarketDataCfg &cfg);
+
+    ~RetransmitServer();
+
+    /// Start listening and the retransmit server thread, and stop it.
+    auto start() -> void;
+
+    /// Start accepting consumers without a thread of its own, when poll() is driven from elsewhere.
+    auto listen() -> void;
+
+    auto stop() -> void;
+
+    /// Main method for this thread - records incremental updates from the market data publisher into the history and answers requests.
+    auto run() noexcept -> void;
+
+    /// One round of run(), for driving the server from another thread's loop.
+    auto poll() noexcept -> void;
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    RetransmitServer() = delete;
+
+    RetransmitServer(const RetransmitServer &) = delete;
+
+    RetransmitServer(const RetransmitServer &&) = delete;
+
+    RetransmitServer &operator=(const RetransmitServer &) = delete;
+
+    RetransmitServer &operator=(const RetransmitServer &&) = delete;
+
+  private:
+    /// Lock free queue containing incremental market data updates coming in from the market data publisher.
+    MDPMarketUpdateLFQueue *retransmit_md_updates_ = nullptr;
+
+    Logger logger_;
+
+    volatile bool run_ = false;
+
+    std::string time_str_;
+
+    const std::string iface_;
+    const int port_;
+
+    /// The most recent incremental updates of an incremental channel, update seq at updates_[seq & (updates_.size() - 1)], and the
+    /// sequence number of the next one.
+    struct ChannelHistory {
+      std::vector<MEMarketUpdate> updates_;
+      size_t next_seq_ = 1;
+    };
+
+    /// Number of incremental channels, see mdpChannel(), and the history of each - a single one without incremental channels.
+    const size_t incremental_channels_;
+    std::vector<ChannelHistory> histories_;
+
+    /// Response being sent, header and updates.
+    std::vector<char> response_;
+
+    TCPServer tcp_server_;
+
+  private:
+    /// Answer every complete request read from a consumer.
+    auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void;
+  };
+}
@@ -1,17 +1,39 @@
 #include "snapshot_synthesizer.h"
 
+#include <algorithm>
+
 namespace Exchange {
   SnapshotSynthesizer::SnapshotSynthesizer(MDPMarketUpdateLFQueue *market_updates, const std::string &iface,
-                                           const std::string &snapshot_ip, int snapshot_port)
-      : snapshot_md_updates_(market_updates), logger_("exchange_snapshot_synthesizer.log"), snapshot_socket_(logger_), order_pool_(ME_MAX_ORDER_IDS) {
-    ASSERT(snapshot_socket_.init(snapshot_ip, iface, snapshot_port, /*is_listening*/ false) >= 0,
-           "Unable to create snapshot mcast socket. error:" + std::string(std::strerror(errno)));
-    for(auto& orders : ticker_orders_)
-      orders.fill(nullptr);
+                                           const std::string &snapshot_ip, int snapshot_port, const MarketDataCfg &cfg)
+      : snapshot_md_updates_(market_updates), logger_("exchange_snapshot_synthesizer.log"),
+        snapshot_period_nanos_(cfg.snapshot_period_nanos_), snapshot_max_packets_per_sec_(cfg.snapshot_max_packets_per_sec_),
+        incremental_channels_(cfg.incremental_channels_), last_inc_seq_nums_(std::max<size_t>(cfg.incremental_channels_, 1), 0) {
+    const auto num_snapshot_channels = cfg.numSnapshotChannels();
+    ASSERT(num_snapshot_channels <= ME_MAX_TICKERS, "More snapshot channels than instruments. " + cfg.toString());
+    for (size_t channel = 0; channel < std::max<size_t>(num_snapshot_channels, 1); ++channel) {
+      const auto port = num_snapshot_channels ? mdpSnapshotChannelPort(snapshot_port, channel) : snapshot_port;
+      snapshot_channels_.push_back(new SnapshotChannel(logger_, cfg));
+      ASSERT(snapshot_channels_.back()->socket_.init(snapshot_ip, iface, port, /*is_listening*/ false) >= 0,
+             "Unable to create snapshot mcast socket. port:" + std::to_string(port) + " error:" + std::string(std::strerror(errno)));
+    }
+    snapshot_channel_ = snapshot_channels_.size();
+
+    // Reserved rather than grown so adding an order never reallocates, the pages are only touched as the books fill up.
+    for (auto &orders: ticker_orders_) {
+      orders.reserve(ME_MAX_ORDER_IDS);
+    }
+    for (auto &order_index: ticker_order_index_) {
+      order_index.resize(ME_MAX_ORDER_IDS, NO_ORDER_INDEX);
+    }
   }
 
   SnapshotSynthesizer::~SnapshotSynthesizer() {
     stop();
+
+    for (auto channel: snapshot_channels_) {
+      delete channel;
+    }
+    snapshot_channels_.clear();
   }
 
   /// Start and stop the snapshot synthesizer thread.
@@ -26,107 +48,195 @@ namespace Exchange {
   }
 
   /// Process an incremental market update and update the limit order book snapshot.
-  auto SnapshotSynthesizer::addToSnapshot(const MDPMarketUpdate *market_update) {
+  auto SnapshotSynthesizer::addToSnapshot(const MDPMarketUpdate *market_update) -> void {
     const auto &me_market_update = market_update->me_market_update_;
-    auto *orders = &ticker_orders_.at(me_market_update.ticker_id_);
+    auto &orders = ticker_orders_.at(me_market_update.ticker_id_);
+    auto &order_index = ticker_order_index_.at(me_market_update.ticker_id_);
     switch (me_market_update.type_) {
       case MarketUpdateType::ADD: {
-        auto order = orders->at(me_market_update.order_id_);
-        ASSERT(order == nullptr, "Received:" + me_market_update.toString() + " but order already exists:" + (order ? order->toString() : ""));
-        orders->at(me_market_update.order_id_) = order_pool_.allocate(me_market_update);
+        auto &index = order_index.at(me_market_update.order_id_);
+        if (UNLIKELY(index != NO_ORDER_INDEX)) {
+          FATAL("Received:" + me_market_update.toString() + " but order already exists:" + orders[index].toString());
+        }
+        index = orders.size();
+        orders.push_back(me_market_update);
       }
         break;
       case MarketUpdateType::MODIFY: {
-        auto order = orders->at(me_market_update.order_id_);
-        ASSERT(order != nullptr, "Received:" + me_market_update.toString() + " but order does not exist.");
-        ASSERT(order->order_id_ == me_market_update.order_id_, "Expecting existing order to match new one.");
-        ASSERT(order->side_ == me_market_update.side_, "Expecting existing order to match new one.");
+        const auto index = order_index.at(me_market_update.order_id_);
+        if (UNLIKELY(index == NO_ORDER_INDEX || orders[index].side_ != me_market_update.side_)) {
+          FATAL("Received:" + me_market_update.toString() + " but order does not exist or does not match.");
+        }
 
-        order->qty_ = me_market_update.qty_;
-        order->price_ = me_market_update.price_;
+        orders[index].qty_ = me_market_update.qty_;
+        orders[index].price_ = me_market_update.price_;
       }
         break;
       case MarketUpdateType::CANCEL: {
-        auto order = orders->at(me_market_update.order_id_);
-        ASSERT(order != nullptr, "Received:" + me_market_update.toString() + " but order does not exist.");
-        ASSERT(order->order_id_ == me_market_update.order_id_, "Expecting existing order to match new one.");
-        ASSERT(order->side_ == me_market_update.side_, "Expecting existing order to match new one.");
+        const auto index = order_index.at(me_market_update.order_id_);
+        if (UNLIKELY(index == NO_ORDER_INDEX || orders[index].side_ != me_market_update.side_)) {
+          FATAL("Received:" + me_market_update.toString() + " but order does not exist or does not match.");
+        }
+
+        removeOrder(me_market_update.ticker_id_, index);
+      }
+        break;
+      case MarketUpdateType::EXECUTION: { // the passive order is either reduced or fully filled and removed.
+        const auto index = order_index.at(me_market_update.order_id_);
+        if (UNLIKELY(index == NO_ORDER_INDEX || orders[index].side_ != me_market_update.passiveSide())) {
+          FATAL("Received:" + me_market_update.toString() + " but order does not exist or is not on the passive side.");
+        }
 
-        order_pool_.deallocate(order);
-        orders->at(me_market_update.order_id_) = nullptr;
+        if (me_market_update.passiveLeavesQty()) {
+          orders[index].qty_ = me_market_update.passiveLeavesQty();
+        } else {
+          removeOrder(me_market_update.ticker_id_, index);
+        }
       }
         break;
       case MarketUpdateType::SNAPSHOT_START:
       case MarketUpdateType::CLEAR:
       case MarketUpdateType::SNAPSHOT_END:
       case MarketUpdateType::TRADE:
+      case MarketUpdateType::PRICE_LEVEL:
+      case MarketUpdateType::BBO:
       case MarketUpdateType::INVALID:
         break;
     }
 
-    ASSERT(market_update->seq_num_ == last_inc_seq_num_ + 1, "Expected incremental seq_nums to increase.");
-    last_inc_seq_num_ = market_update->seq_num_;
+    auto &last_inc_seq_num = last_inc_seq_nums_[incremental_channels_ ? mdpChannel(me_market_update.ticker_id_, incremental_channels_) : 0];
+    if (UNLIKELY(market_update->seq_num_ != last_inc_seq_num + 1)) {
+      FATAL("Expected incremental seq_nums to increase, last:" + std::to_string(last_inc_seq_num) + " " + market_update->toString());
+    }
+    last_inc_seq_num = market_update->seq_num_;
   }
 
-  /// Publish a full snapshot cycle on the snapshot multicast stream.
-  auto SnapshotSynthesizer::publishSnapshot() {
-    size_t snapshot_size = 0;
+  /// Remove the live order at index of an instrument, moving the last live order into its place.
+  auto SnapshotSynthesizer::removeOrder(size_t ticker_id, uint32_t index) noexcept -> void {
+    auto &orders = ticker_orders_[ticker_id];
+    auto &order_index = ticker_order_index_[ticker_id];
 
-    // The snapshot cycle starts with a SNAPSHOT_START message and order_id_ contains the last sequence number from the incremental market data stream used to build this snapshot.
-    const MDPMarketUpdate start_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_START, last_inc_seq_num_}};
-    logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), start_market_update.toString());
-    snapshot_socket_.send(&start_market_update, sizeof(MDPMarketUpdate));
+    order_index[orders[index].order_id_] = NO_ORDER_INDEX;
+    if (index != orders.size() - 1) {
+      orders[index] = orders.back();
+      order_index[orders[index].order_id_] = index;
+    }
+    orders.pop_back();
+  }
+
+  /// Begin a snapshot cycle from the live orders as of the last incremental update processed.
+  auto SnapshotSynthesizer::startSnapshot() -> void {
+    snapshot_channel_ = 0;
+    snapshot_next_ = 0;
+    last_snapshot_time_ = getCurrentNanos();
+    snapshot_packets_ = 0;
 
-    // Publish order information for each order in the limit order book for each instrument.
+    for (size_t channel = 0; channel < snapshot_channels_.size(); ++channel) {
+      auto &updates = snapshot_channels_[channel]->updates_;
+      updates.clear();
+
+      // The snapshot cycle starts with a SNAPSHOT_START message and order_id_ contains the last sequence number from the incremental market data stream used to build this snapshot.
+      updates.push_back(MDPMarketUpdate{updates.size(), {MarketUpdateType::SNAPSHOT_START, last_inc_seq_nums_[incremental_channels_ ? channel : 0]}});
+    }
+
+    // Order information for each instrument starts with a CLEAR message so the downstream consumer can clear the order book, then each live order.
     for (size_t ticker_id = 0; ticker_id < ticker_orders_.size(); ++ticker_id) {
-      const auto &orders = ticker_orders_.at(ticker_id);
+      auto &updates = snapshot_channels_[mdpChannel(ticker_id, snapshot_channels_.size())]->updates_;
 
       MEMarketUpdate me_market_update;
       me_market_update.type_ = MarketUpdateType::CLEAR;
       me_market_update.ticker_id_ = ticker_id;
+      updates.push_back(MDPMarketUpdate{updates.size(), me_market_update});
 
-      // We start order information for each instrument by first publishing a CLEAR message so the downstream consumer can clear the order book.
-      const MDPMarketUpdate clear_market_update{snapshot_size++, me_market_update};
-      logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), clear_market_update.toString());
-      snapshot_socket_.send(&clear_market_update, sizeof(MDPMarketUpdate));
-
-      // Publish each order.
-      for (const auto order: orders) {
-        if (order) {
-          const MDPMarketUpdate market_update{snapshot_size++, *order};
-          logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), market_update.toString());
-          snapshot_socket_.send(&market_update, sizeof(MDPMarketUpdate));
-          snapshot_socket_.sendAndRecv();
+      // Live orders are kept packed in no particular order, but a consumer rebuilds each price level in the order the orders are added,
+      // so they are published bids then asks, each side from the best price and each level in priority order.
+      const auto first_order = updates.size();
+      for (const auto &order: ticker_orders_[ticker_id]) {
+        updates.push_back(MDPMarketUpdate{updates.size(), order});
+      }
+      std::sort(updates.begin() + first_order, updates.end(), [](const MDPMarketUpdate &lhs, const MDPMarketUpdate &rhs) {
+        const auto &lhs_order = lhs.me_market_update_, &rhs_order = rhs.me_market_update_;
+        if (lhs_order.side_ != rhs_order.side_) {
+          return lhs_order.side_ == Side::BUY;
+        }
+        if (lhs_order.price_ != rhs_order.price_) {
+          return (lhs_order.side_ == Side::BUY) ? lhs_order.price_ > rhs_order.price_ : lhs_order.price_ < rhs_order.price_;
         }
+        return lhs_order.priority_ < rhs_order.priority_;
+      });
+      for (auto i = first_order; i < updates.size(); ++i) {
+        updates[i].seq_num_ = i;
       }
     }
 
-    // The snapshot cycle ends with a SNAPSHOT_END message and order_id_ contains the last sequence number from the incremental market data stream used to build this snapshot.
-    const MDPMarketUpdate end_market_update{snapshot_size++, {MarketUpdateType::SNAPSHOT_END, last_inc_seq_num_}};
-    logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), end_market_update.toString());
-    snapshot_socket_.send(&end_market_update, sizeof(MDPMarketUpdate));
-    snapshot_socket_.sendAndRecv();
+    size_t snapshot_size = 0;
+    for (size_t channel = 0; channel < snapshot_channels_.size(); ++channel) {
+      auto &updates = snapshot_channels_[channel]->updates_;
+
+      // The snapshot cycle ends with a SNAPSHOT_END message and order_id_ contains the last sequence number from the incremental market data stream used to build this snapshot.
+      updates.push_back(MDPMarketUpdate{updates.size(), {MarketUpdateType::SNAPSHOT_END, last_inc_seq_nums_[incremental_channels_ ? channel : 0]}});
+      snapshot_size += updates.size();
+    }
 
-    logger_.log("%:% %() % Published snapshot of % orders.\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), snapshot_size - 1);
+    logger_.log("%:% %() % Started snapshot of % updates on % channels at incremental seq:%\n", __FILE__, __LINE__, __FUNCTION__,
+                getCurrentTimeStr(&time_str_), snapshot_size, snapshot_channels_.size(), last_inc_seq_nums_[0]);
+  }
+
+  /// Publish the next datagram of the snapshot cycle in progress, if the rate cap allows another one by now.
+  auto SnapshotSynthesizer::publishSnapshot() -> void {
+    if (snapshot_max_packets_per_sec_ &&
+        snapshot_packets_ >= static_cast<size_t>(getCurrentNanos() - last_snapshot_time_) * snapshot_max_packets_per_sec_ / NANOS_TO_SECS + 1) {
+      return;
+    }
+
+    // The writer queues the open datagram once the next update does not fit it.
+    auto channel = snapshot_channels_[snapshot_channel_];
+    const auto packets = channel->writer_.numPackets();
+    while (snapshot_next_ < channel->updates_.size() && channel->writer_.numPackets() == packets) {
+      channel->writer_.add(channel->updates_[snapshot_next_++]);
+    }
+
+    if (snapshot_next_ < channel->updates_.size()) {
+      channel->socket_.sendAndRecv();
+    } else { // this channel's cycle is complete, on to the next one's.
+      channel->writer_.flush();
+      logger_.log("%:% %() % Published snapshot channel % of % updates.\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_),
+                  snapshot_channel_, channel->updates_.size());
+      ++snapshot_channel_;
+      snapshot_next_ = 0;
+    }
+    snapshot_packets_ += channel->writer_.numPackets() - packets;
+
+    if (!publishing()) {
+      logger_.log("%:% %() % Published snapshot in % datagrams.\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_), snapshot_packets_);
+    }
   }
 
   /// Main method for this thread - processes incremental updates from the market data publisher, updates the snapshot and publishes the snapshot periodically.
   void SnapshotSynthesizer::run() {
     logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_));
     while (run_) {
-      for (auto market_update = snapshot_md_updates_->getNextToRead(); snapshot_md_updates_->size() && market_update; market_update = snapshot_md_updates_->getNextToRead()) {
-        logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_),
-                    market_update->toString().c_str());
+      poll();
+    }
+  }
 
-        addToSnapshot(market_update);
+  /// One round of run(), for driving the synthesizer from another thread's loop.
+  auto SnapshotSynthesizer::poll() -> void {
+    for (auto market_update = snapshot_md_updates_->getNextToRead(); snapshot_md_updates_->size() && market_update; market_update = snapshot_md_updates_->getNextToRead()) {
+      logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str_),
+                  market_update->toString().c_str());
 
-        snapshot_md_updates_->updateReadIndex();
-      }
+      addToSnapshot(market_update);
 
-      if (getCurrentNanos() - last_snapshot_time_ > 60 * NANOS_TO_SECS) {
-        last_snapshot_time_ = getCurrentNanos();
-        publishSnapshot();
-      }
+      snapshot_md_updates_->updateReadIndex();
+    }
+
+    // A cycle publishes from its own copy of the live orders, so the incremental updates above can go on changing them in between datagrams.
+    if (publishing()) {
+      publishSnapshot();
+    } else if (getCurrentNanos() - last_snapshot_time_ > snapshot_period_nanos_) {
+      startSnapshot();
+      publishSnapshot();
     }
   }
 }
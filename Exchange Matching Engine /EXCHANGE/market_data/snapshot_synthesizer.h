@@ -1,23 +1,29 @@
 #pragma once
 
+#include <limits>
+#include <vector>
+
 #include "types.h"
 #include "thread_utils.h"
 #include "lf_queue.h"
 #include "macros.h"
 #include "mcast_socket.h"
-#include "mem_pool.h"
 #include "logging.h"
 
 #include "market_data/market_update.h"
-#include "matcher/me_order.h"
+#include "market_data/md_packet_writer.h"
 
 using namespace Common;
 
 namespace Exchange {
+  /// Keeps the live orders of every instrument from the incremental stream and publishes them periodically on the snapshot stream.
+  /// A snapshot cycle is a copy of the live orders taken between two incremental updates, published a datagram at a time under a rate cap
+  /// in between draining the incremental updates, so neither the copy nor the publishing holds up the queue from the publisher for long.
+  /// With snapshot channels, every channel publishes a cycle of its own instruments from the same copy, one channel after the other.
   class SnapshotSynthesizer {
   public:
     SnapshotSynthesizer(MDPMarketUpdateLFQueue *market_updates, const std::string &iface,
-                        const std::string &snapshot_ip, int snapshot_port);
+                        const std::string &snapshot_ip, int snapshot_port, const MarketDataCfg &cfg);
 
     ~SnapshotSynthesizer();
 
@@ -27,14 +33,25 @@ namespace Exchange {
     auto stop() -> void;
 
     /// Process an incremental market update and update the limit order book snapshot.
-    auto addToSnapshot(const MDPMarketUpdate *market_update);
+    auto addToSnapshot(const MDPMarketUpdate *market_update) -> void;
+
+    /// Begin a snapshot cycle from the live orders as of the last incremental update processed.
+    auto startSnapshot() -> void;
 
-    /// Publish a full snapshot cycle on the snapshot multicast stream.
-    auto publishSnapshot();
+    /// Publish the next datagram of the snapshot cycle in progress, if the rate cap allows another one by now.
+    auto publishSnapshot() -> void;
 
     /// Main method for this thread - processes incremental updates from the market data publisher, updates the snapshot and publishes the snapshot periodically.
     auto run() -> void;
 
+    /// One round of run(), for driving the synthesizer from another thread's loop.
+    auto poll() -> void;
+
+    /// Whether a snapshot cycle is being published.
+    auto publishing() const noexcept {
+      return snapshot_channel_ < snapshot_channels_.size();
+    }
+
     /// Deleted default, copy & move constructors and assignment-operators.
     SnapshotSynthesizer() = delete;
 
@@ -56,15 +73,46 @@ namespace Exchange {
 
     std::string time_str_;
 
-    /// Multicast socket for the snapshot multicast stream.
-    McastSocket snapshot_socket_;
-
-    /// Hash map from TickerId -> Full limit order book snapshot containing information for every live order.
-    std::array<std::array<MEMarketUpdate *, ME_MAX_ORDER_IDS>, ME_MAX_TICKERS> ticker_orders_;
-    size_t last_inc_seq_num_ = 0;
+    /// A snapshot stream: the multicast socket it is published on, the writer packing updates into its datagrams, and its part of the
+    /// snapshot cycle being published.
+    struct SnapshotChannel {
+      SnapshotChannel(Logger &logger, const MarketDataCfg &cfg)
+          : socket_(logger), writer_(&socket_, cfg) {
+      }
+
+      McastSocket socket_;
+      MDPPacketWriter writer_;
+      std::vector<MDPMarketUpdate> updates_;
+    };
+
+    /// A single channel with every instrument on the snapshot port, or MarketDataCfg::numSnapshotChannels() of them, see mdpChannel().
+    std::vector<SnapshotChannel *> snapshot_channels_;
+
+    /// Snapshot cycle period and most datagrams per second it is published at, 0 for no cap.
+    const Nanos snapshot_period_nanos_;
+    const size_t snapshot_max_packets_per_sec_;
+
+    /// Live orders of every instrument packed together, so a snapshot cycle copies only those, and where each one is in them by OrderId.
+    std::array<std::vector<MEMarketUpdate>, ME_MAX_TICKERS> ticker_orders_;
+    std::array<std::vector<uint32_t>, ME_MAX_TICKERS> ticker_order_index_;
+
+    /// Number of incremental channels, and the last sequence number processed from each - a single one without incremental channels.
+    /// Snapshot channels are then the same as the incremental ones, so each snapshot channel's cycle refers to its own sequence.
+    const size_t incremental_channels_;
+    std::vector<size_t> last_inc_seq_nums_;
+
+    /// Channel and next update of the snapshot cycle being published, when the cycle started and how many datagrams it published so far.
+    size_t snapshot_channel_ = 0;
+    size_t snapshot_next_ = 0;
     Nanos last_snapshot_time_ = 0;
+    size_t snapshot_packets_ = 0;
+
+    /// Marks an OrderId without a live order in ticker_order_index_.
+    static constexpr uint32_t NO_ORDER_INDEX = std::numeric_limits<uint32_t>::max();
+    static_assert(ME_MAX_ORDER_IDS < NO_ORDER_INDEX, "Live order indices must fit ticker_order_index_.");
 
-    /// Memory pool to manage MEMarketUpdate messages for the orders in the snapshot limit order books.
-    MemPool<MEMarketUpdate> order_pool_;
+  private:
+    /// Remove the live order at index of an instrument, moving the last live order into its place.
+    auto removeOrder(size_t ticker_id, uint32_t index) noexcept -> void;
   };
 }
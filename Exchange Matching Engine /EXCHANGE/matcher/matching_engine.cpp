@@ -1,12 +1,22 @@
 #include "matching_engine.h"
 
+#include <algorithm>
+#include <unistd.h>
+
 namespace Exchange {
-  MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses,
+  MatchingEngine::MatchingEngine(const MatchingEngineCfg &cfg, ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses,
                                  MEMarketUpdateLFQueue *market_updates)
       : incoming_requests_(client_requests), outgoing_ogw_responses_(client_responses), outgoing_md_updates_(market_updates),
+        max_request_batch_(std::max(cfg.max_request_batch_, static_cast<size_t>(1))), checkpoint_interval_nanos_(cfg.checkpoint_interval_nanos_),
         logger_("exchange_matching_engine.log") {
+    logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), cfg.toString());
+
     for(size_t i = 0; i < ticker_order_book_.size(); ++i) {
-      ticker_order_book_[i] = new MEOrderBook(i, &logger_, this);
+      ticker_order_book_[i] = new MEOrderBook(i, cfg, &logger_, this);
+    }
+
+    if (!cfg.checkpoint_dir_.empty()) {
+      checkpoint_writer_ = new CheckpointWriter(cfg.checkpoint_dir_);
     }
   }
 
@@ -20,6 +30,9 @@ namespace Exchange {
     outgoing_ogw_responses_ = nullptr;
     outgoing_md_updates_ = nullptr;
 
+    delete checkpoint_writer_;
+    checkpoint_writer_ = nullptr;
+
     for(auto& order_book : ticker_order_book_) {
       delete order_book;
       order_book = nullptr;
@@ -28,6 +41,10 @@ namespace Exchange {
 
   /// Start and stop the matching engine main thread.
   auto MatchingEngine::start() -> void {
+    if (checkpoint_writer_) {
+      checkpoint_writer_->start();
+    }
+
     run_ = true;
     ASSERT(Common::createAndStartThread(-1, "Exchange/MatchingEngine", [this]() { run(); }) != nullptr, "Failed to start MatchingEngine thread.");
   }
@@ -35,4 +52,55 @@ namespace Exchange {
   auto MatchingEngine::stop() -> void {
     run_ = false;
   }
+
+  auto MatchingEngine::recover(const std::string &journal_path, bool live_journal) -> void {
+    const auto start = Common::getCurrentNanos();
+
+    // Each book resumes from its own checkpoint, books without one start empty and replay the whole journal.
+    std::array<size_t, ME_MAX_TICKERS> book_seq_num = {};
+    size_t num_orders = 0;
+    if (checkpoint_writer_) {
+      for (size_t i = 0; i < ticker_order_book_.size(); ++i) {
+        const CheckpointImage image(checkpointPath(checkpoint_writer_->dir(), i));
+        if (image.valid()) {
+          ticker_order_book_[i]->restore(image);
+          book_seq_num[i] = image.header()->seq_num_;
+          num_orders += image.header()->num_orders_;
+        }
+      }
+    }
+    const auto restored = Common::getCurrentNanos();
+    last_seq_num_ = *std::max_element(book_seq_num.begin(), book_seq_num.end());
+
+    // Only the journal tail after the oldest checkpoint is read, requests a book has already seen are skipped.
+    size_t num_replayed = 0;
+    if (access(journal_path.c_str(), F_OK) == 0) {
+      RequestJournalReader journal(journal_path, live_journal);
+      journal.seek(*std::min_element(book_seq_num.begin(), book_seq_num.end()) + 1);
+
+      for (auto record = journal.next(); record; record = journal.next()) {
+        // The outputs of these requests were published before the restart.
+        if (record->request_.ticker_id_ < ticker_order_book_.size() && record->seq_num_ > book_seq_num[record->request_.ticker_id_]) {
+          replayClientRequest(record->seq_num_, &record->request_);
+          ++num_replayed;
+        }
+        last_seq_num_ = record->seq_num_;
+      }
+    }
+    publish_recovered_orders_ = true;
+
+    logger_.log("%:% %() % Recovered last-seq:% checkpointed-orders:% restore-ns:% replayed-requests:% replay-ns:%\n", __FILE__, __LINE__,
+                __FUNCTION__, Common::getCurrentTimeStr(&time_str_), last_seq_num_, num_orders, restored - start, num_replayed,
+                Common::getCurrentNanos() - restored);
+  }
+
+  auto MatchingEngine::checkpoint() noexcept -> void {
+    ASSERT(checkpoint_writer_ != nullptr, "MatchingEngine::checkpoint() needs a checkpoint-dir.");
+
+    for (size_t i = 0; i < ticker_order_book_.size(); ++i) {
+      const auto start = Common::getCurrentNanos();
+      ticker_order_book_[i]->checkpoint(last_seq_num_, checkpoint_writer_->image());
+      checkpoint_writer_->writeCheckpoint(i, Common::getCurrentNanos() - start);
+    }
+  }
 }
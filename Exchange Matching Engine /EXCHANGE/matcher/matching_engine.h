@@ -9,13 +9,16 @@
 #include "order_server/client_request.h"
 #include "order_server/client_response.h"
 #include "market_data/market_update.h"
+#include "order_server/request_journal.h"
 
 #include "me_order_book.h"
+#include "me_checkpoint.h"
 
 namespace Exchange {
   class MatchingEngine final {
   public:
-    MatchingEngine(ClientRequestLFQueue *client_requests,
+    MatchingEngine(const MatchingEngineCfg &cfg,
+                   ClientRequestLFQueue *client_requests,
                    ClientResponseLFQueue *client_responses,
                    MEMarketUpdateLFQueue *market_updates);
 
@@ -26,10 +29,45 @@ namespace Exchange {
 
     auto stop() -> void;
 
+    /// Restore every book from its checkpoint and replay the requests journaled after it, must be called before start().
+    /// Outputs generated while replaying were already published before the restart and are dropped,
+    /// instead every live order is published as an ADD market update once the matching engine thread starts.
+    /// live_journal is set when another exchange is still appending to the journal, e.g. for a standby.
+    auto recover(const std::string &journal_path, bool live_journal = false) -> void;
+
+    /// Apply a request another matching engine has already processed, e.g. from the journal or a primary exchange, before start().
+    /// Its outputs were published by the other matching engine and are dropped.
+    auto replayClientRequest(size_t seq_num, const MEClientRequest *client_request) noexcept {
+      processClientRequest(client_request);
+      last_seq_num_ = seq_num;
+
+      // Published only to be dropped, so skip the logging commitOutputs() does.
+      outgoing_ogw_responses_->commitWriteIndex();
+      outgoing_md_updates_->commitWriteIndex();
+      for (; outgoing_ogw_responses_->getNextToRead(); outgoing_ogw_responses_->updateReadIndex());
+      for (; outgoing_md_updates_->getNextToRead(); outgoing_md_updates_->updateReadIndex());
+    }
+
+    /// Checkpoint every book on the calling thread, must not be called while the matching engine thread is running.
+    auto checkpoint() noexcept -> void;
+
+    /// Only write checkpoints of requests the journal has synced, must be called before start().
+    auto setJournal(const RequestJournal *journal) noexcept {
+      ASSERT(checkpoint_writer_ != nullptr, "MatchingEngine::setJournal() needs a checkpoint-dir.");
+      checkpoint_writer_->setJournal(journal);
+    }
+
+    /// Journal sequence number of the last client request processed.
+    auto lastSeqNum() const noexcept {
+      return last_seq_num_;
+    }
+
     /// Called to process a client request read from the lock free queue sent by the order server.
-    auto processClientRequest(const MEClientRequest *client_request) noexcept {
+    /// The responses and market updates it generates are not visible downstream until commitOutputs() is called.
+    auto processClientRequest(const MEClientRequest *client_request) noexcept -> void {
       MEASURE_LATENCY("processClientRequest");
-      
+      ++last_seq_num_;
+
       auto order_book = ticker_order_book_[client_request->ticker_id_];
       switch (client_request->type_) {
         case ClientRequestType::NEW: {
@@ -54,22 +92,66 @@ namespace Exchange {
       }
     }
 
-    /// Write client responses to the lock free queue for the order server to consume.
-    auto sendClientResponse(const MEClientResponse *client_response) noexcept {
-      logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), client_response->toString());
-      auto next_write = outgoing_ogw_responses_->getNextToWriteTo();
-      *next_write = std::move(*client_response);
-      outgoing_ogw_responses_->updateWriteIndex();
-      TTT_MEASURE(T4t_MatchingEngine_LFQueue_write, logger_);
+    /// Reserve the next slot in the client response ring, the order book constructs the response directly in it.
+    /// Nothing is visible to the order server until commitOutputs() is called.
+    auto nextClientResponse() noexcept -> MEClientResponse * {
+      auto next_write = outgoing_ogw_responses_->reserveNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // ring is full, publish what we have so far and wait for the order server to catch up.
+        commitOutputs();
+        std::this_thread::yield();
+        next_write = outgoing_ogw_responses_->reserveNextToWriteTo();
+      }
+      return next_write;
+    }
+
+    /// Reserve the next slot in the market update ring, the order book constructs the update directly in it.
+    /// Nothing is visible to the market data publisher until commitOutputs() is called.
+    auto nextMarketUpdate() noexcept -> MEMarketUpdate * {
+      auto next_write = outgoing_md_updates_->reserveNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // ring is full, publish what we have so far and wait for the market data publisher to catch up.
+        commitOutputs();
+        std::this_thread::yield();
+        next_write = outgoing_md_updates_->reserveNextToWriteTo();
+      }
+      return next_write;
+    }
+
+    /// Reserve the next slot in the checkpoint writer's ring of changes to live orders, nullptr while they are not being tracked.
+    /// Nothing is visible to the checkpoint writer until commitOutputs() is called.
+    auto nextCheckpointChange() noexcept -> CheckpointChange * {
+      if (!checkpoint_changes_) {
+        return nullptr;
+      }
+
+      auto next_write = checkpoint_changes_->reserveNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // ring is full, publish what we have so far and wait for the checkpoint writer to catch up.
+        commitOutputs();
+        std::this_thread::yield();
+        next_write = checkpoint_changes_->reserveNextToWriteTo();
+      }
+      return next_write;
     }
 
-    /// Write market data update to the lock free queue for the market data publisher to consume.
-    auto sendMarketUpdate(const MEMarketUpdate *market_update) noexcept {
-      logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), market_update->toString());
-      auto next_write = outgoing_md_updates_->getNextToWriteTo();
-      *next_write = *market_update;
-      outgoing_md_updates_->updateWriteIndex();
-      TTT_MEASURE(T4_MatchingEngine_LFQueue_write, logger_);
+    /// Publish all client responses and market updates constructed since the last commit, with one release store per lock free queue.
+    auto commitOutputs() noexcept -> void {
+      for (size_t i = 0; i < outgoing_ogw_responses_->numReserved(); ++i) {
+        logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    outgoing_ogw_responses_->getReserved(i)->toString());
+      }
+      for (size_t i = 0; i < outgoing_md_updates_->numReserved(); ++i) {
+        logger_.log("%:% %() % Sending %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    outgoing_md_updates_->getReserved(i)->toString());
+      }
+
+      if (outgoing_ogw_responses_->commitWriteIndex()) {
+        TTT_MEASURE(T4t_MatchingEngine_LFQueue_write, logger_);
+      }
+      if (outgoing_md_updates_->commitWriteIndex()) {
+        TTT_MEASURE(T4_MatchingEngine_LFQueue_write, logger_);
+      }
+      if (checkpoint_changes_) {
+        checkpoint_changes_->commitWriteIndex();
+      }
     }
 
     /// Main loop for this thread - processes incoming client requests which in turn generates client responses and market updates.
@@ -78,23 +160,66 @@ namespace Exchange {
       
       // Initialize nanosecond timer
       Common::NanosecondTimer::calibrate();
-      
+
+      if (publish_recovered_orders_) {
+        for (auto order_book : ticker_order_book_) {
+          order_book->publishOrders();
+        }
+        commitOutputs();
+        publish_recovered_orders_ = false;
+      }
+
+      // From here on the checkpoint writer follows every change to the books, starting from a copy of them as they are now.
+      if (checkpoint_writer_) {
+        checkpoint_changes_ = checkpoint_writer_->changes();
+        for (auto order_book : ticker_order_book_) {
+          order_book->checkpointOrders();
+        }
+        commitOutputs();
+      }
+
       while (run_) {
-        const auto me_client_request = incoming_requests_->getNextToRead();
-        if (LIKELY(me_client_request)) {
+        // Take everything available up to the current batch limit, a lone request under light load is still published on its own.
+        size_t num_processed = 0;
+        for (auto me_client_request = incoming_requests_->getNextToRead(); me_client_request && num_processed < batch_limit_;
+             me_client_request = incoming_requests_->getNextToRead(num_processed)) {
           START_LATENCY_MEASURE(LFQueue_read);
           END_LATENCY_MEASURE(LFQueue_read, logger_);
 
+          // Warm the book the next request in this batch will touch while we process this one.
+          if (num_processed + 1 < batch_limit_) {
+            const auto next_client_request = incoming_requests_->getNextToRead(num_processed + 1);
+            if (next_client_request && LIKELY(next_client_request->ticker_id_ < ticker_order_book_.size())) {
+              ticker_order_book_[next_client_request->ticker_id_]->prefetch(next_client_request->client_id_, next_client_request->order_id_);
+            }
+          }
+
           logger_.log("%:% %() % Processing %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
                       me_client_request->toString());
           START_LATENCY_MEASURE(Exchange_MatchingEngine_processClientRequest);
           processClientRequest(me_client_request);
           END_LATENCY_MEASURE(Exchange_MatchingEngine_processClientRequest, logger_);
-          incoming_requests_->updateReadIndex();
+          ++num_processed;
+        }
+
+        if (LIKELY(num_processed)) {
+          commitOutputs();
+          incoming_requests_->updateReadIndex(num_processed);
+
+          // Grow the batch while requests are backing up, fall back towards single request batches once the queue drains.
+          if (num_processed == batch_limit_ && incoming_requests_->getNextToRead()) {
+            batch_limit_ = std::min(batch_limit_ * 2, max_request_batch_);
+          } else if (num_processed < batch_limit_ / 2) {
+            batch_limit_ = std::max(batch_limit_ / 2, static_cast<size_t>(1));
+          }
         } else {
           // No work available, yield to avoid busy waiting
           std::this_thread::yield();
         }
+
+        if (checkpoint_writer_) {
+          checkpointIfDue();
+        }
       }
     }
 
@@ -110,6 +235,26 @@ namespace Exchange {
     MatchingEngine &operator=(const MatchingEngine &&) = delete;
 
   private:
+    /// Checkpointing every book only queues a CUT per book behind the changes that led up to it, the checkpoint writer serializes its
+    /// own copy of the books, so matching never pauses to serialize one. A new round starts once the last one has been written.
+    auto checkpointIfDue() noexcept -> void {
+      if (!checkpoint_writer_->idle()) {
+        return;
+      }
+
+      const auto now = Common::getCurrentNanos();
+      if (now < next_checkpoint_time_) {
+        return;
+      }
+      next_checkpoint_time_ = now + checkpoint_interval_nanos_;
+
+      checkpoint_writer_->cutsQueued(ticker_order_book_.size());
+      for (auto order_book : ticker_order_book_) {
+        order_book->checkpointCut(last_seq_num_);
+      }
+      commitOutputs();
+    }
+
     /// Hash map container from TickerId -> MEOrderBook.
     OrderBookHashMap ticker_order_book_;
 
@@ -121,6 +266,24 @@ namespace Exchange {
     ClientResponseLFQueue *outgoing_ogw_responses_ = nullptr;
     MEMarketUpdateLFQueue *outgoing_md_updates_ = nullptr;
 
+    /// Adaptive number of client requests processed per published batch, between 1 and max_request_batch_.
+    const size_t max_request_batch_ = 1;
+    size_t batch_limit_ = 1;
+
+    /// Journal sequence number of the last client request processed, the FIFO sequencer numbers requests in the order we receive them.
+    size_t last_seq_num_ = 0;
+
+    /// Writes book checkpoints when checkpoint_dir_ is configured, and when the next round starts.
+    CheckpointWriter *checkpoint_writer_ = nullptr;
+    const Nanos checkpoint_interval_nanos_ = 0;
+    Nanos next_checkpoint_time_ = 0;
+
+    /// The checkpoint writer's ring of changes to live orders, set once the matching engine thread starts tracking them.
+    CheckpointChangeLFQueue *checkpoint_changes_ = nullptr;
+
+    /// Set by recover() so the matching engine thread publishes the recovered books when it starts.
+    bool publish_recovered_orders_ = false;
+
     volatile bool run_ = false;
 
     std::string time_str_;
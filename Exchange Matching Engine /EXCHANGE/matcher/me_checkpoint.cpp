@@ -0,0 +1,199 @@
+#include "me_checkpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Exchange {
+  CheckpointImage::CheckpointImage(const std::string &path) {
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      ASSERT(errno == ENOENT, "Could not open checkpoint:" + path + " error:" + std::string(std::strerror(errno)));
+      return;
+    }
+
+    struct stat file_stat;
+    ASSERT(fstat(fd, &file_stat) == 0, "fstat() failed on checkpoint:" + path + " error:" + std::string(std::strerror(errno)));
+    file_bytes_ = file_stat.st_size;
+    ASSERT(file_bytes_ >= sizeof(CheckpointHeader), "Checkpoint:" + path + " is too short for a header.");
+
+    // The whole image is read once front to back, so fault it all in up front.
+    map_ = static_cast<const char *>(mmap(nullptr, file_bytes_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0));
+    ASSERT(map_ != MAP_FAILED, "mmap() failed on checkpoint:" + path + " error:" + std::string(std::strerror(errno)));
+    close(fd);
+
+    ASSERT(header()->magic_ == CHECKPOINT_MAGIC && header()->version_ == CHECKPOINT_VERSION, "Checkpoint:" + path + " has an unknown header.");
+    ASSERT(file_bytes_ == sizeof(CheckpointHeader) + header()->num_orders_ * sizeof(CheckpointOrder),
+           "Checkpoint:" + path + " size does not match its order count.");
+  }
+
+  CheckpointImage::~CheckpointImage() {
+    if (map_) {
+      munmap(const_cast<char *>(map_), file_bytes_);
+    }
+  }
+
+  CheckpointWriter::CheckpointWriter(const std::string &dir)
+      : dir_(dir), changes_(ME_MAX_CHECKPOINT_CHANGES), logger_("exchange_checkpoint_writer.log") {
+    ASSERT(mkdir(dir_.c_str(), 0755) == 0 || errno == EEXIST, "Could not create checkpoint directory:" + dir_ + " error:" + std::string(std::strerror(errno)));
+
+    // Sized for a large book up front so neither the writer's copy of the books nor serializing them allocates in the common case.
+    for (auto &book: books_) {
+      book.reserve(64 * 1024);
+    }
+    sorted_orders_.reserve(64 * 1024);
+    image_.reserve(sizeof(CheckpointHeader) + 64 * 1024 * sizeof(CheckpointOrder));
+  }
+
+  CheckpointWriter::~CheckpointWriter() {
+    stop();
+    if (writer_thread_) {
+      writer_thread_->join();
+      delete writer_thread_;
+      writer_thread_ = nullptr;
+    }
+
+    // CUTs still queued are dropped, the journal may be gone by now and the previous checkpoints of those books stay valid.
+  }
+
+  /// Start and stop the checkpoint writer thread.
+  auto CheckpointWriter::start() -> void {
+    run_ = true;
+    writer_thread_ = Common::createAndStartThread(-1, "Exchange/CheckpointWriter", [this]() { run(); });
+    ASSERT(writer_thread_ != nullptr, "Failed to start CheckpointWriter thread.");
+  }
+
+  auto CheckpointWriter::stop() -> void {
+    run_ = false;
+  }
+
+  auto CheckpointWriter::applyChanges() noexcept -> size_t {
+    size_t num_applied = 0;
+    for (auto change = changes_.getNextToRead(); change; change = changes_.getNextToRead()) {
+      auto &book = books_.at(change->ticker_id_);
+      switch (change->type_) {
+        case CheckpointChangeType::ADD: {
+          if (UNLIKELY(!book.emplace(change->order_.market_order_id_, change->order_).second)) {
+            FATAL("Checkpoint ADD of ticker:" + tickerIdToString(change->ticker_id_) + " market-order-id:" +
+                  orderIdToString(change->order_.market_order_id_) + " but order already exists.");
+          }
+        }
+          break;
+        case CheckpointChangeType::MODIFY: {
+          const auto order = book.find(change->order_.market_order_id_);
+          if (UNLIKELY(order == book.end())) {
+            FATAL("Checkpoint MODIFY of ticker:" + tickerIdToString(change->ticker_id_) + " market-order-id:" +
+                  orderIdToString(change->order_.market_order_id_) + " but order does not exist.");
+          }
+          order->second.qty_ = change->order_.qty_;
+        }
+          break;
+        case CheckpointChangeType::REMOVE: {
+          if (UNLIKELY(!book.erase(change->order_.market_order_id_))) {
+            FATAL("Checkpoint REMOVE of ticker:" + tickerIdToString(change->ticker_id_) + " market-order-id:" +
+                  orderIdToString(change->order_.market_order_id_) + " but order does not exist.");
+          }
+        }
+          break;
+        case CheckpointChangeType::CUT: {
+          // Never write a checkpoint ahead of the journal, recovering from it would skip requests the journal lost. Stop here and
+          // leave the CUT and every later change queued until the journal catches up.
+          if (journal_ && journal_->syncedSeqNum() < change->seq_num_) {
+            return num_applied;
+          }
+
+          const auto start = Common::getCurrentNanos();
+          serialize(*change);
+          writeImage(change->ticker_id_, Common::getCurrentNanos() - start);
+          pending_cuts_.fetch_sub(1, std::memory_order_release);
+        }
+          break;
+        case CheckpointChangeType::INVALID:
+          FATAL("Invalid checkpoint change for ticker:" + tickerIdToString(change->ticker_id_));
+          break;
+      }
+
+      changes_.updateReadIndex();
+      ++num_applied;
+    }
+    return num_applied;
+  }
+
+  auto CheckpointWriter::serialize(const CheckpointChange &cut) noexcept -> void {
+    const auto &book = books_.at(cut.ticker_id_);
+    sorted_orders_.clear();
+    for (const auto &order: book) {
+      sorted_orders_.push_back(order.second);
+    }
+
+    // Bids then asks, each side from the best price level and each level in FIFO order, which is increasing priority.
+    std::sort(sorted_orders_.begin(), sorted_orders_.end(), [](const CheckpointOrder &lhs, const CheckpointOrder &rhs) {
+      if (lhs.side_ != rhs.side_) {
+        return lhs.side_ == Side::BUY;
+      }
+      if (lhs.price_ != rhs.price_) {
+        return (lhs.side_ == Side::BUY) ? lhs.price_ > rhs.price_ : lhs.price_ < rhs.price_;
+      }
+      return lhs.priority_ < rhs.priority_;
+    });
+
+    CheckpointHeader header;
+    header.ticker_id_ = cut.ticker_id_;
+    header.seq_num_ = cut.seq_num_;
+    header.next_market_order_id_ = cut.next_market_order_id_;
+    header.num_orders_ = sorted_orders_.size();
+
+    image_.resize(sizeof(CheckpointHeader) + sorted_orders_.size() * sizeof(CheckpointOrder));
+    memcpy(image_.data(), &header, sizeof(CheckpointHeader));
+    memcpy(image_.data() + sizeof(CheckpointHeader), sorted_orders_.data(), sorted_orders_.size() * sizeof(CheckpointOrder));
+  }
+
+  auto CheckpointWriter::writeImage(TickerId ticker_id, Nanos serialize_nanos) noexcept -> void {
+    const auto start = Common::getCurrentNanos();
+    const auto path = checkpointPath(dir_, ticker_id);
+    const auto tmp_path = path + ".tmp";
+
+    const auto fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      logger_.log("%:% %() % Could not open % error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  tmp_path, std::strerror(errno));
+      return;
+    }
+
+    size_t written = 0;
+    while (written < image_.size()) {
+      const auto n = write(fd, image_.data() + written, image_.size() - written);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        logger_.log("%:% %() % Could not write % error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    tmp_path, std::strerror(errno));
+        close(fd);
+        return;
+      }
+      written += n;
+    }
+
+    // The new checkpoint must be on disk before it replaces the old one.
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp_path.c_str(), path.c_str()) != 0) {
+      logger_.log("%:% %() % Could not commit % error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  path, std::strerror(errno));
+      return;
+    }
+
+    // Sync the directory as well so the rename itself survives a crash.
+    const auto dir_fd = open(dir_.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd >= 0) {
+      fsync(dir_fd);
+      close(dir_fd);
+    }
+
+    const auto header = reinterpret_cast<const CheckpointHeader *>(image_.data());
+    logger_.log("%:% %() % Checkpointed ticker:% seq:% orders:% bytes:% serialize-ns:% write-ns:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), ticker_id, header->seq_num_, header->num_orders_, image_.size(), serialize_nanos,
+                Common::getCurrentNanos() - start);
+  }
+}
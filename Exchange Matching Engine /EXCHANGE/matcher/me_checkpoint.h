@@ -0,0 +1,221 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <unordered_map>
+
+#include "thread_utils.h"
+#include "lf_queue.h"
+#include "macros.h"
+#include "logging.h"
+#include "types.h"
+
+#include "order_server/request_journal.h"
+
+using namespace Common;
+
+namespace Exchange {
+  /// Identifies a book checkpoint file and the layout of the records in it.
+  constexpr uint64_t CHECKPOINT_MAGIC = 0x54504b434b4f4f42; // "BOOKCKPT"
+  constexpr uint32_t CHECKPOINT_VERSION = 1;
+
+  /// These structures are written to disk as is, so the binary structures are packed to remove system dependent extra padding.
+#pragma pack(push, 1)
+
+  /// Start of the checkpoint of one order book, followed by num_orders_ CheckpointOrder records.
+  /// Orders are written bid levels first then ask levels, each side from the best price level and each level in FIFO order,
+  /// so adding them back in file order rebuilds the same book.
+  struct CheckpointHeader {
+    uint64_t magic_ = CHECKPOINT_MAGIC;
+    uint32_t version_ = CHECKPOINT_VERSION;
+    TickerId ticker_id_ = TickerId_INVALID;
+
+    /// Journal sequence number of the last request applied to the book.
+    size_t seq_num_ = 0;
+
+    OrderId next_market_order_id_ = 1;
+    size_t num_orders_ = 0;
+  };
+
+  struct CheckpointOrder {
+    ClientId client_id_ = ClientId_INVALID;
+    OrderId client_order_id_ = OrderId_INVALID;
+    OrderId market_order_id_ = OrderId_INVALID;
+    Side side_ = Side::INVALID;
+    Price price_ = Price_INVALID;
+    Qty qty_ = Qty_INVALID;
+    Priority priority_ = Priority_INVALID;
+  };
+
+#pragma pack(pop) // Undo the packed binary structure directive moving forward.
+
+  /// Capacity of the ring of changes to live orders between the matching engine and the checkpoint writer.
+  constexpr size_t ME_MAX_CHECKPOINT_CHANGES = 262144; // 2^18 = 256K (power of 2)
+
+  enum class CheckpointChangeType : uint8_t {
+    INVALID = 0,
+    ADD = 1,    // order_ started resting in the book.
+    MODIFY = 2, // the order with order_.market_order_id_ now has order_.qty_ left.
+    REMOVE = 3, // the order with order_.market_order_id_ left the book.
+    CUT = 4     // checkpoint the book as it is after the request with sequence number seq_num_.
+  };
+
+  /// A change to the live orders of a book, in the order the matching engine made them, or a checkpoint of it.
+  struct CheckpointChange {
+    CheckpointChangeType type_ = CheckpointChangeType::INVALID;
+    TickerId ticker_id_ = TickerId_INVALID;
+    CheckpointOrder order_;
+
+    /// Only set on a CUT.
+    size_t seq_num_ = 0;
+    OrderId next_market_order_id_ = OrderId_INVALID;
+  };
+
+  typedef LFQueue<CheckpointChange> CheckpointChangeLFQueue;
+
+  /// Every book is checkpointed to its own file in the checkpoint directory.
+  inline auto checkpointPath(const std::string &dir, TickerId ticker_id) {
+    return dir + "/book_" + std::to_string(ticker_id) + ".ckpt";
+  }
+
+  /// Read only mapping of a book checkpoint file.
+  class CheckpointImage final {
+  public:
+    /// Maps the checkpoint at path, valid() is false if there is no checkpoint there.
+    explicit CheckpointImage(const std::string &path);
+
+    ~CheckpointImage();
+
+    auto valid() const noexcept {
+      return map_ != nullptr;
+    }
+
+    auto header() const noexcept {
+      return reinterpret_cast<const CheckpointHeader *>(map_);
+    }
+
+    auto orders() const noexcept {
+      return reinterpret_cast<const CheckpointOrder *>(map_ + sizeof(CheckpointHeader));
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    CheckpointImage() = delete;
+
+    CheckpointImage(const CheckpointImage &) = delete;
+
+    CheckpointImage(const CheckpointImage &&) = delete;
+
+    CheckpointImage &operator=(const CheckpointImage &) = delete;
+
+    CheckpointImage &operator=(const CheckpointImage &&) = delete;
+
+  private:
+    const char *map_ = nullptr;
+    size_t file_bytes_ = 0;
+  };
+
+  /// Writes book checkpoints to disk on its own thread.
+  /// The writer keeps its own copy of the live orders of every book, from the changes the matching engine queues on changes() as it
+  /// makes them, so taking a checkpoint only costs the matching engine queueing a CUT. The writer serializes its copy of the book at the
+  /// CUT, and once the journal has synced every request the CUT includes, writes it to a temporary file, syncs it and renames it over
+  /// the previous checkpoint of that book, so a crash at any point leaves either the old or the new checkpoint in place, and never one
+  /// ahead of the journal.
+  class CheckpointWriter final {
+  public:
+    explicit CheckpointWriter(const std::string &dir);
+
+    ~CheckpointWriter();
+
+    /// Start and stop the checkpoint writer thread.
+    auto start() -> void;
+
+    auto stop() -> void;
+
+    auto dir() const noexcept -> const std::string & {
+      return dir_;
+    }
+
+    /// Only write checkpoints of requests the journal has synced, must be called before start().
+    auto setJournal(const RequestJournal *journal) noexcept {
+      journal_ = journal;
+    }
+
+    /// Ring the matching engine queues changes to live orders and CUTs on, only read by the writer thread.
+    auto changes() noexcept {
+      return &changes_;
+    }
+
+    /// Count CUTs about to be committed to changes(), and whether every CUT queued so far has been written.
+    auto cutsQueued(size_t num_cuts) noexcept {
+      pending_cuts_.fetch_add(num_cuts, std::memory_order_release);
+    }
+
+    auto idle() const noexcept {
+      return !pending_cuts_.load(std::memory_order_acquire);
+    }
+
+    /// Buffer to serialize a checkpoint into directly, for checkpoints taken while the writer thread is not running.
+    auto image() noexcept -> std::vector<char> * {
+      return &image_;
+    }
+
+    /// Write image() out as the checkpoint of ticker_id on the calling thread, only while the writer thread is not running.
+    auto writeCheckpoint(TickerId ticker_id, Nanos serialize_nanos) noexcept {
+      writeImage(ticker_id, serialize_nanos);
+    }
+
+    /// Main loop for this thread - applies the queued changes to its copy of the books and writes the checkpoints.
+    auto run() noexcept {
+      logger_.log("%:% %() % Writing checkpoints to %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), dir_);
+      while (run_) {
+        if (!applyChanges()) {
+          using namespace std::literals::chrono_literals;
+          std::this_thread::sleep_for(100us);
+        }
+      }
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    CheckpointWriter() = delete;
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+
+    CheckpointWriter(const CheckpointWriter &&) = delete;
+
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    CheckpointWriter &operator=(const CheckpointWriter &&) = delete;
+
+  private:
+    const std::string dir_;
+
+    /// Changes to live orders and CUTs from the matching engine, and the number of CUTs queued and not yet written.
+    CheckpointChangeLFQueue changes_;
+    std::atomic<size_t> pending_cuts_ = {0};
+
+    /// The writer's copy of the live orders of every book, by market order id.
+    std::array<std::unordered_map<OrderId, CheckpointOrder>, ME_MAX_TICKERS> books_;
+
+    /// Journal a CUT waits for to have synced the requests it includes, nullptr to write it right away.
+    const RequestJournal *journal_ = nullptr;
+
+    /// Live orders of the book being checkpointed in the order they are written, and the checkpoint serialized from them.
+    std::vector<CheckpointOrder> sorted_orders_;
+    std::vector<char> image_;
+
+    volatile bool run_ = false;
+    std::thread *writer_thread_ = nullptr;
+
+    std::string time_str_;
+    Logger logger_;
+
+  private:
+    /// Apply the queued changes up to the first CUT the journal has not synced yet, returns the number of changes applied.
+    auto applyChanges() noexcept -> size_t;
+
+    /// Serialize the writer's copy of a book into image_, as the checkpoint of a CUT.
+    auto serialize(const CheckpointChange &cut) noexcept -> void;
+
+    auto writeImage(TickerId ticker_id, Nanos serialize_nanos) noexcept -> void;
+  };
+}
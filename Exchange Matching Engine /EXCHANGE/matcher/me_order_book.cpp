@@ -5,8 +5,8 @@
 #include "matching_engine.h"
 
 namespace Exchange {
-  MEOrderBook::MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine)
-      : ticker_id_(ticker_id), matching_engine_(matching_engine), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS),
+  MEOrderBook::MEOrderBook(TickerId ticker_id, const MatchingEngineCfg &cfg, Logger *logger, MatchingEngine *matching_engine)
+      : ticker_id_(ticker_id), cfg_(cfg), matching_engine_(matching_engine), orders_at_price_pool_(ME_MAX_PRICE_LEVELS), order_pool_(ME_MAX_ORDER_IDS),
         logger_(logger) {
   }
 
@@ -16,9 +16,6 @@ namespace Exchange {
 
     matching_engine_ = nullptr;
     bids_by_price_ = asks_by_price_ = nullptr;
-    for (auto &itr: cid_oid_to_order_) {
-      itr.fill(nullptr);
-    }
   }
 
   /// Match a new aggressive order with the provided parameters against a passive order held in the bid_itr object and generate client responses and market updates for the match.
@@ -31,94 +28,100 @@ namespace Exchange {
 
     *leaves_qty -= fill_qty;
     order->qty_ -= fill_qty;
+    checkpointChange(order->qty_ ? CheckpointChangeType::MODIFY : CheckpointChangeType::REMOVE, order);
+
+    if (!cfg_.aggregate_aggressor_fills_) {
+      *matching_engine_->nextClientResponse() = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
+                                                 new_market_order_id, side, itr->price_, fill_qty, *leaves_qty};
+    }
 
-    client_response_ = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
-                        new_market_order_id, side, itr->price_, fill_qty, *leaves_qty};
-    matching_engine_->sendClientResponse(&client_response_);
+    *matching_engine_->nextClientResponse() = {ClientResponseType::FILLED, order->client_id_, ticker_id, order->client_order_id_,
+                                               order->market_order_id_, order->side_, itr->price_, fill_qty, order->qty_};
 
-    client_response_ = {ClientResponseType::FILLED, order->client_id_, ticker_id, order->client_order_id_,
-                        order->market_order_id_, order->side_, itr->price_, fill_qty, order->qty_};
-    matching_engine_->sendClientResponse(&client_response_);
+    if (cfg_.coalesce_executions_) {
+      // One message carries both the trade and the new state of the passive order.
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::EXECUTION, order->market_order_id_, ticker_id, side, itr->price_, fill_qty, order->qty_};
 
-    market_update_ = {MarketUpdateType::TRADE, OrderId_INVALID, ticker_id, side, itr->price_, fill_qty, Priority_INVALID};
-    matching_engine_->sendMarketUpdate(&market_update_);
+      if (!order->qty_) {
+        START_MEASURE(Exchange_MEOrderBook_removeOrder);
+        removeOrder(order);
+        END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger_));
+      }
+      return;
+    }
+
+    *matching_engine_->nextMarketUpdate() = {MarketUpdateType::TRADE, OrderId_INVALID, ticker_id, side, itr->price_, fill_qty, Priority_INVALID};
 
     if (!order->qty_) {
-      market_update_ = {MarketUpdateType::CANCEL, order->market_order_id_, ticker_id, order->side_,
-                        order->price_, order_qty, Priority_INVALID};
-      matching_engine_->sendMarketUpdate(&market_update_);
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::CANCEL, order->market_order_id_, ticker_id, order->side_,
+                                               order->price_, order_qty, Priority_INVALID};
 
       START_MEASURE(Exchange_MEOrderBook_removeOrder);
       removeOrder(order);
       END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger_));
     } else {
-      market_update_ = {MarketUpdateType::MODIFY, order->market_order_id_, ticker_id, order->side_,
-                        order->price_, order->qty_, order->priority_};
-      matching_engine_->sendMarketUpdate(&market_update_);
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::MODIFY, order->market_order_id_, ticker_id, order->side_,
+                                               order->price_, order->qty_, order->priority_};
+    }
+  }
+
+  /// Send the aggressive order a single FILLED response for everything it executed at one price level, used when aggregate_aggressor_fills_ is set.
+  auto MEOrderBook::sendAggressorFill(ClientId client_id, TickerId ticker_id, OrderId client_order_id, OrderId new_market_order_id, Side side,
+                                      Price price, Qty exec_qty, Qty leaves_qty) noexcept {
+    *matching_engine_->nextClientResponse() = {ClientResponseType::FILLED, client_id, ticker_id, client_order_id,
+                                               new_market_order_id, side, price, exec_qty, leaves_qty};
+  }
+
+  /// Queue a change to a live order for the checkpoint writer, if the matching engine is tracking them.
+  auto MEOrderBook::checkpointChange(CheckpointChangeType type, const MEOrder *order) noexcept -> void {
+    const auto change = matching_engine_->nextCheckpointChange();
+    if (change) {
+      *change = {type, ticker_id_, CheckpointOrder{order->client_id_, order->client_order_id_, order->market_order_id_, order->side_,
+                                                   order->price_, order->qty_, order->priority_}};
     }
   }
 
   /// Check if a new order with the provided attributes would match against existing passive orders on the other side of the order book.
   /// This will call the match() method to perform the match if there is a match to be made and return the quantity remaining if any on this new order.
-  auto MEOrderBook::checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept {
+  auto MEOrderBook::checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, OrderId new_market_order_id) noexcept {
     auto leaves_qty = qty;
 
-    if (side == Side::BUY) {
-      // BUY order matches against ASK orders (sell orders)
-      while (leaves_qty > 0 && asks_by_price_) {
-        const auto ask_itr = asks_by_price_->first_me_order_;
-        if (UNLIKELY(!ask_itr)) {
-          logger_->log("ERROR: No first order in ask price level\n");
-          break;
-        }
-        
-        // BUY can only match if our price >= ask price
-        if (price < ask_itr->price_) {
-          break; // No more matches possible
-        }
+    // BUY orders match against the asks, SELL orders against the bids.
+    // removeOrder() advances this pointer to the next price level (or nullptr) whenever a level is emptied.
+    auto &passive_by_price = (side == Side::BUY ? asks_by_price_ : bids_by_price_);
 
-        START_LATENCY_MEASURE(Exchange_MEOrderBook_match);
-        match(ticker_id, client_id, side, client_order_id, new_market_order_id, ask_itr, &leaves_qty);
-        END_LATENCY_MEASURE(Exchange_MEOrderBook_match, (*logger_));
-        
-        // If this price level is empty, move to next level
-        if (!asks_by_price_->first_me_order_) {
-          auto next_ask = asks_by_price_->next_entry_;
-          if (next_ask == asks_by_price_) {
-            asks_by_price_ = nullptr; // No more ask levels
-          } else {
-            asks_by_price_ = next_ask;
-          }
-        }
+    // Quantity executed at the current price level that has not been reported to the aggressor yet.
+    auto level_price = Price_INVALID;
+    Qty level_exec_qty = 0;
+
+    while (leaves_qty && passive_by_price) {
+      const auto passive_itr = passive_by_price->first_me_order_;
+      if (UNLIKELY(!passive_itr)) {
+        logger_->log("ERROR: No first order in % price level\n", sideToString(passive_by_price->side_));
+        break;
+      }
+
+      // BUY can only match if our price >= ask price, SELL can only match if our price <= bid price.
+      if ((side == Side::BUY && price < passive_itr->price_) || (side == Side::SELL && price > passive_itr->price_)) {
+        break; // No more matches possible
       }
-    } else if (side == Side::SELL) {
-      // SELL order matches against BID orders (buy orders)
-      while (leaves_qty > 0 && bids_by_price_) {
-        const auto bid_itr = bids_by_price_->first_me_order_;
-        if (UNLIKELY(!bid_itr)) {
-          logger_->log("ERROR: No first order in bid price level\n");
-          break;
-        }
-        
-        // SELL can only match if our price <= bid price
-        if (price > bid_itr->price_) {
-          break; // No more matches possible
-        }
 
-        START_LATENCY_MEASURE(Exchange_MEOrderBook_match);
-        match(ticker_id, client_id, side, client_order_id, new_market_order_id, bid_itr, &leaves_qty);
-        END_LATENCY_MEASURE(Exchange_MEOrderBook_match, (*logger_));
-        
-        // If this price level is empty, move to next level
-        if (!bids_by_price_->first_me_order_) {
-          auto next_bid = bids_by_price_->next_entry_;
-          if (next_bid == bids_by_price_) {
-            bids_by_price_ = nullptr; // No more bid levels
-          } else {
-            bids_by_price_ = next_bid;
-          }
+      if (cfg_.aggregate_aggressor_fills_) {
+        if (level_exec_qty && passive_itr->price_ != level_price) {
+          sendAggressorFill(client_id, ticker_id, client_order_id, new_market_order_id, side, level_price, level_exec_qty, leaves_qty);
+          level_exec_qty = 0;
         }
+        level_price = passive_itr->price_;
+        level_exec_qty += std::min(leaves_qty, passive_itr->qty_);
       }
+
+      START_LATENCY_MEASURE(Exchange_MEOrderBook_match);
+      match(ticker_id, client_id, side, client_order_id, new_market_order_id, passive_itr, &leaves_qty);
+      END_LATENCY_MEASURE(Exchange_MEOrderBook_match, (*logger_));
+    }
+
+    if (level_exec_qty) {
+      sendAggressorFill(client_id, ticker_id, client_order_id, new_market_order_id, side, level_price, level_exec_qty, leaves_qty);
     }
 
     return leaves_qty;
@@ -128,8 +131,7 @@ namespace Exchange {
   /// It will check to see if this new order matches an existing passive order with opposite side, and perform the matching if that is the case.
   auto MEOrderBook::add(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty) noexcept -> void {
     const auto new_market_order_id = generateNewMarketOrderId();
-    client_response_ = {ClientResponseType::ACCEPTED, client_id, ticker_id, client_order_id, new_market_order_id, side, price, 0, qty};
-    matching_engine_->sendClientResponse(&client_response_);
+    *matching_engine_->nextClientResponse() = {ClientResponseType::ACCEPTED, client_id, ticker_id, client_order_id, new_market_order_id, side, price, 0, qty};
 
     START_LATENCY_MEASURE(Exchange_MEOrderBook_checkForMatch);
     const auto leaves_qty = checkForMatch(client_id, client_order_id, ticker_id, side, price, qty, new_market_order_id);
@@ -143,9 +145,9 @@ namespace Exchange {
       START_LATENCY_MEASURE(Exchange_MEOrderBook_addOrder);
       addOrder(order);
       END_LATENCY_MEASURE(Exchange_MEOrderBook_addOrder, (*logger_));
+      checkpointChange(CheckpointChangeType::ADD, order);
 
-      market_update_ = {MarketUpdateType::ADD, new_market_order_id, ticker_id, side, price, leaves_qty, priority};
-      matching_engine_->sendMarketUpdate(&market_update_);
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::ADD, new_market_order_id, ticker_id, side, price, leaves_qty, priority};
     }
   }
 
@@ -160,22 +162,77 @@ namespace Exchange {
     }
 
     if (UNLIKELY(!is_cancelable)) {
-      client_response_ = {ClientResponseType::CANCEL_REJECTED, client_id, ticker_id, order_id, OrderId_INVALID,
-                          Side::INVALID, Price_INVALID, Qty_INVALID, Qty_INVALID};
+      *matching_engine_->nextClientResponse() = {ClientResponseType::CANCEL_REJECTED, client_id, ticker_id, order_id, OrderId_INVALID,
+                                                 Side::INVALID, Price_INVALID, Qty_INVALID, Qty_INVALID};
     } else {
-      client_response_ = {ClientResponseType::CANCELED, client_id, ticker_id, order_id, exchange_order->market_order_id_,
-                          exchange_order->side_, exchange_order->price_, Qty_INVALID, exchange_order->qty_};
-      market_update_ = {MarketUpdateType::CANCEL, exchange_order->market_order_id_, ticker_id, exchange_order->side_, exchange_order->price_, 0,
-                        exchange_order->priority_};
+      *matching_engine_->nextClientResponse() = {ClientResponseType::CANCELED, client_id, ticker_id, order_id, exchange_order->market_order_id_,
+                                                 exchange_order->side_, exchange_order->price_, Qty_INVALID, exchange_order->qty_};
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::CANCEL, exchange_order->market_order_id_, ticker_id, exchange_order->side_,
+                                               exchange_order->price_, 0, exchange_order->priority_};
+      checkpointChange(CheckpointChangeType::REMOVE, exchange_order);
 
       START_LATENCY_MEASURE(Exchange_MEOrderBook_removeOrder);
       removeOrder(exchange_order);
       END_LATENCY_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger_));
+    }
+  }
 
-      matching_engine_->sendMarketUpdate(&market_update_);
+  auto MEOrderBook::checkpoint(size_t seq_num, std::vector<char> *image) const noexcept -> void {
+    CheckpointHeader header;
+    header.ticker_id_ = ticker_id_;
+    header.seq_num_ = seq_num;
+    header.next_market_order_id_ = next_market_order_id_;
+
+    image->resize(sizeof(CheckpointHeader));
+    forEachOrder([&](const MEOrder *order) {
+      const CheckpointOrder checkpoint_order{order->client_id_, order->client_order_id_, order->market_order_id_, order->side_,
+                                             order->price_, order->qty_, order->priority_};
+      const auto offset = image->size();
+      image->resize(offset + sizeof(CheckpointOrder));
+      memcpy(image->data() + offset, &checkpoint_order, sizeof(CheckpointOrder));
+      ++header.num_orders_;
+    });
+    memcpy(image->data(), &header, sizeof(CheckpointHeader));
+  }
+
+  auto MEOrderBook::restore(const CheckpointImage &image) noexcept -> void {
+    const auto header = image.header();
+    ASSERT(header->ticker_id_ == ticker_id_, "Checkpoint of ticker:" + tickerIdToString(header->ticker_id_) + " restored into book of ticker:" +
+                                             tickerIdToString(ticker_id_));
+    ASSERT(!bids_by_price_ && !asks_by_price_, "Checkpoint restored into a non-empty book of ticker:" + tickerIdToString(ticker_id_));
+
+    // Orders are stored best level first and in FIFO order within a level, so every order is appended to the end of its level
+    // and every new level is the worst on its side so far.
+    const auto orders = image.orders();
+    for (size_t i = 0; i < header->num_orders_; ++i) {
+      const auto &checkpoint_order = orders[i];
+      addOrder(order_pool_.allocate(ticker_id_, checkpoint_order.client_id_, checkpoint_order.client_order_id_, checkpoint_order.market_order_id_,
+                                    checkpoint_order.side_, checkpoint_order.price_, checkpoint_order.qty_, checkpoint_order.priority_, nullptr, nullptr));
     }
+    next_market_order_id_ = header->next_market_order_id_;
+
+    logger_->log("%:% %() % Restored ticker:% seq:% orders:% next-market-order-id:%\n", __FILE__, __LINE__, __FUNCTION__,
+                 Common::getCurrentTimeStr(&time_str_), ticker_id_, header->seq_num_, header->num_orders_, next_market_order_id_);
+  }
+
+  auto MEOrderBook::publishOrders() noexcept -> void {
+    forEachOrder([this](const MEOrder *order) {
+      *matching_engine_->nextMarketUpdate() = {MarketUpdateType::ADD, order->market_order_id_, ticker_id_, order->side_, order->price_,
+                                               order->qty_, order->priority_};
+    });
+  }
+
+  auto MEOrderBook::checkpointOrders() noexcept -> void {
+    forEachOrder([this](const MEOrder *order) {
+      checkpointChange(CheckpointChangeType::ADD, order);
+    });
+  }
 
-    matching_engine_->sendClientResponse(&client_response_);
+  auto MEOrderBook::checkpointCut(size_t seq_num) noexcept -> void {
+    const auto change = matching_engine_->nextCheckpointChange();
+    if (change) {
+      *change = {CheckpointChangeType::CUT, ticker_id_, CheckpointOrder{}, seq_num, next_market_order_id_};
+    }
   }
 
   auto MEOrderBook::toString(bool detailed, bool validity_check) const -> std::string {
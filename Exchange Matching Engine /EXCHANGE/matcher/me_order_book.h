@@ -7,6 +7,7 @@
 #include "market_data/market_update.h"
 
 #include "me_order.h"
+#include "me_checkpoint.h"
 
 using namespace Common;
 
@@ -15,7 +16,7 @@ namespace Exchange {
 
   class MEOrderBook final {
   public:
-    explicit MEOrderBook(TickerId ticker_id, Logger *logger, MatchingEngine *matching_engine);
+    explicit MEOrderBook(TickerId ticker_id, const MatchingEngineCfg &cfg, Logger *logger, MatchingEngine *matching_engine);
 
     ~MEOrderBook();
 
@@ -26,6 +27,37 @@ namespace Exchange {
     /// Attempt to cancel an order in the order book, issue a cancel-rejection if order does not exist.
     auto cancel(ClientId client_id, OrderId order_id, TickerId ticker_id) noexcept -> void;
 
+    /// Prefetch the book state a request from this client for this order id is about to touch - the client order map slot and the top of book.
+    auto prefetch(ClientId client_id, OrderId order_id) const noexcept {
+      if (LIKELY(client_id < cid_oid_to_order_.size() && order_id < cid_oid_to_order_[client_id].size())) {
+        __builtin_prefetch(&cid_oid_to_order_[client_id][order_id]);
+      }
+      if (bids_by_price_) {
+        __builtin_prefetch(bids_by_price_);
+        __builtin_prefetch(bids_by_price_->first_me_order_);
+      }
+      if (asks_by_price_) {
+        __builtin_prefetch(asks_by_price_);
+        __builtin_prefetch(asks_by_price_->first_me_order_);
+      }
+    }
+
+    /// Serialize every live order into image, as the checkpoint of this book after the request with journal sequence number seq_num.
+    auto checkpoint(size_t seq_num, std::vector<char> *image) const noexcept -> void;
+
+    /// Rebuild this book, which must be empty, from a checkpoint image.
+    auto restore(const CheckpointImage &image) noexcept -> void;
+
+    /// Publish an ADD market update for every live order, used to bring market data in line with a recovered book.
+    auto publishOrders() noexcept -> void;
+
+    /// Queue an ADD checkpoint change for every live order, to seed the checkpoint writer's copy of this book.
+    auto checkpointOrders() noexcept -> void;
+
+    /// Queue a CUT checkpoint change, the checkpoint writer then checkpoints its copy of this book as of the request with journal
+    /// sequence number seq_num.
+    auto checkpointCut(size_t seq_num) noexcept -> void;
+
     auto toString(bool detailed, bool validity_check) const -> std::string;
 
     /// Deleted default, copy & move constructors and assignment-operators.
@@ -42,6 +74,9 @@ namespace Exchange {
   private:
     TickerId ticker_id_ = TickerId_INVALID;
 
+    /// Controls how executions are reported, see MatchingEngineCfg.
+    const MatchingEngineCfg cfg_;
+
     /// The parent matching engine instance, used to publish market data and client responses.
     MatchingEngine *matching_engine_ = nullptr;
 
@@ -61,10 +96,6 @@ namespace Exchange {
     /// Memory pool to manage MEOrder objects.
     MemPool<MEOrder> order_pool_;
 
-    /// These are used to publish client responses and market updates.
-    MEClientResponse client_response_;
-    MEMarketUpdate market_update_;
-
     OrderId next_market_order_id_ = 1;
 
     std::string time_str_;
@@ -166,6 +197,25 @@ namespace Exchange {
       orders_at_price_pool_.deallocate(orders_at_price);
     }
 
+    /// Visit every live order, bid levels then ask levels, each side from the best price level and each level in FIFO order.
+    template<typename F>
+    auto forEachOrder(F &&visit) const noexcept {
+      for (const auto best_orders_by_price : {bids_by_price_, asks_by_price_}) {
+        if (!best_orders_by_price) {
+          continue;
+        }
+        auto orders_at_price = best_orders_by_price;
+        do {
+          auto order = orders_at_price->first_me_order_;
+          do {
+            visit(order);
+            order = order->next_order_;
+          } while (order != orders_at_price->first_me_order_);
+          orders_at_price = orders_at_price->next_entry_;
+        } while (orders_at_price != best_orders_by_price);
+      }
+    }
+
     auto getNextPriority(Price price) noexcept -> Priority {
       const auto orders_at_price = getOrdersAtPrice(price);
       if (!orders_at_price)
@@ -181,7 +231,14 @@ namespace Exchange {
 
     /// Check if a new order with the provided attributes would match against existing passive orders on the other side of the order book.
     /// This will call the match() method to perform the match if there is a match to be made and return the quantity remaining if any on this new order.
-    auto checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, Qty new_market_order_id) noexcept;
+    auto checkForMatch(ClientId client_id, OrderId client_order_id, TickerId ticker_id, Side side, Price price, Qty qty, OrderId new_market_order_id) noexcept;
+
+    /// Send the aggressive order a single FILLED response for everything it executed at one price level, used when aggregate_aggressor_fills_ is set.
+    auto sendAggressorFill(ClientId client_id, TickerId ticker_id, OrderId client_order_id, OrderId new_market_order_id, Side side,
+                           Price price, Qty exec_qty, Qty leaves_qty) noexcept;
+
+    /// Queue a change to a live order for the checkpoint writer, if the matching engine is tracking them.
+    auto checkpointChange(CheckpointChangeType type, const MEOrder *order) noexcept -> void;
 
     /// Remove and de-allocate provided order from the containers.
     auto removeOrder(MEOrder *order) noexcept {
@@ -0,0 +1,183 @@
+#include "me_standby.h"
+
+#include <csignal>
+
+namespace Exchange {
+  StandbyReplica::StandbyReplica(const StandbyCfg &cfg, MatchingEngine *matching_engine)
+      : cfg_(cfg), matching_engine_(matching_engine), history_(ME_MAX_REPLICATION_RECORDS), logger_("exchange_standby.log") {
+    logger_.log("%:% %() % % last-seq:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), cfg_.toString(),
+                matching_engine_->lastSeqNum());
+  }
+
+  auto StandbyReplica::apply(const JournalRecord &record) noexcept -> void {
+    matching_engine_->replayClientRequest(record.seq_num_, &record.request_);
+    history_[record.seq_num_ & (history_.size() - 1)] = record;
+  }
+
+  auto StandbyReplica::catchUpFromJournal(size_t seq_num) -> bool {
+    while (matching_engine_->lastSeqNum() < seq_num) {
+      // The primary keeps appending, so map the journal again each time to see its current end, and only read the records it has
+      // finished writing.
+      {
+        RequestJournalReader journal(cfg_.journal_path_, /*live*/ true);
+        journal.seek(matching_engine_->lastSeqNum() + 1);
+        for (auto record = journal.next(); record && record->seq_num_ <= seq_num; record = journal.next()) {
+          apply(*record);
+          ++num_from_journal_;
+        }
+      }
+
+      if (matching_engine_->lastSeqNum() < seq_num) {
+        if (!replication_->producerAlive()) {
+          return false;
+        }
+        using namespace std::literals::chrono_literals;
+        std::this_thread::sleep_for(1ms); // the primary's journal writer is behind.
+      }
+    }
+    return true;
+  }
+
+  auto StandbyReplica::attach() -> void {
+    while (true) {
+      replication_ = new JournalRecordShmQueue(cfg_.replication_shm_name_);
+      if (replication_->valid()) {
+        break;
+      }
+      delete replication_;
+
+      using namespace std::literals::chrono_literals;
+      std::this_thread::sleep_for(1ms);
+    }
+
+    last_primary_activity_ = replication_->lastHeartbeat();
+    logger_.log("%:% %() % Attached to % primary-pid:% queued:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                cfg_.replication_shm_name_, replication_->producerPid(), replication_->size());
+  }
+
+  auto StandbyReplica::primaryFailed(Nanos now) -> bool {
+    if (replication_->producerAlive()) {
+      last_primary_activity_ = std::max(last_primary_activity_, replication_->lastHeartbeat());
+      if (now - last_primary_activity_ < cfg_.heartbeat_timeout_nanos_) {
+        return false;
+      }
+
+      // Hung rather than dead. Fence it off before taking over so there are never two exchanges sequencing requests.
+      failure_detected_time_ = now;
+      failure_reason_ = "heartbeat-timeout";
+      logger_.log("%:% %() % No heartbeat from primary-pid:% for %ns, killing it.\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), replication_->producerPid(), now - last_primary_activity_);
+      kill(replication_->producerPid(), SIGKILL);
+      const auto kill_deadline = Common::getCurrentNanos() + NANOS_TO_SECS;
+      while (replication_->producerAlive() && Common::getCurrentNanos() < kill_deadline) {
+        std::this_thread::yield();
+      }
+      return true;
+    }
+
+    // A primary that was restarted replaces the ring, follow the new one instead of taking over from it.
+    auto replacement = new JournalRecordShmQueue(cfg_.replication_shm_name_);
+    if (replacement->valid() && replacement->producerPid() != replication_->producerPid() && replacement->producerAlive()) {
+      logger_.log("%:% %() % primary-pid:% replaced by primary-pid:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  replication_->producerPid(), replacement->producerPid());
+      delete replication_;
+      replication_ = replacement;
+      last_primary_activity_ = replication_->lastHeartbeat();
+      return false;
+    }
+    delete replacement;
+
+    failure_detected_time_ = now;
+    failure_reason_ = "exited";
+    return true;
+  }
+
+  auto StandbyReplica::follow() -> void {
+    attach();
+
+    auto next_stats_time = Common::getCurrentNanos() + cfg_.stats_interval_nanos_;
+    while (true) {
+      const auto record = replication_->getNextToRead();
+      const auto now = Common::getCurrentNanos();
+
+      if (record) {
+        const auto last_seq_num = matching_engine_->lastSeqNum();
+        if (record->seq_num_ > last_seq_num) {
+          // The primary dropped what it could not fit in the ring while we were behind, those requests are in its journal.
+          if (UNLIKELY(record->seq_num_ > last_seq_num + 1)) {
+            ASSERT(catchUpFromJournal(record->seq_num_ - 1), "Primary is gone and its journal is missing requests after seq:" +
+                                                                std::to_string(matching_engine_->lastSeqNum()));
+          }
+          apply(*record);
+          ++num_from_ring_;
+          lag_.record_latency(now - record->recv_time_);
+          max_records_behind_ = std::max(max_records_behind_, replication_->size());
+          last_primary_activity_ = now;
+        }
+        replication_->updateReadIndex();
+      } else {
+        if (primaryFailed(now)) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+
+      if (now >= next_stats_time) {
+        next_stats_time = now + cfg_.stats_interval_nanos_;
+        logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), stats());
+      }
+    }
+
+    // Whatever the primary replicated before it went away, then whatever else made it into its journal.
+    for (auto record = replication_->getNextToRead(); record; record = replication_->getNextToRead()) {
+      if (record->seq_num_ > matching_engine_->lastSeqNum()) {
+        ASSERT(record->seq_num_ == matching_engine_->lastSeqNum() + 1 || catchUpFromJournal(record->seq_num_ - 1),
+               "Primary is gone and its journal is missing requests after seq:" + std::to_string(matching_engine_->lastSeqNum()));
+        apply(*record);
+        ++num_from_ring_;
+      }
+      replication_->updateReadIndex();
+    }
+    catchUpFromJournal(SIZE_MAX);
+    caught_up_time_ = Common::getCurrentNanos();
+
+    logger_.log("%:% %() % Primary failed (%), caught up to seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                failure_reason_, matching_engine_->lastSeqNum(), stats());
+
+    delete replication_;
+    replication_ = nullptr;
+  }
+
+  auto StandbyReplica::completeJournal(RequestJournal *journal) -> void {
+    const auto journal_seq_num = journal->lastSeqNum();
+    ASSERT(matching_engine_->lastSeqNum() - journal_seq_num <= history_.size(),
+           "Journal ends at seq:" + std::to_string(journal_seq_num) + " too far behind the books at seq:" + std::to_string(matching_engine_->lastSeqNum()));
+
+    for (auto seq_num = journal_seq_num + 1; seq_num <= matching_engine_->lastSeqNum(); ++seq_num) {
+      const auto &record = history_[seq_num & (history_.size() - 1)];
+      ASSERT(record.seq_num_ == seq_num, "Standby history does not have seq:" + std::to_string(seq_num));
+      journal->append(record.seq_num_, record.recv_time_, record.request_);
+    }
+
+    logger_.log("%:% %() % Journaled seq:% to seq:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                journal_seq_num + 1, matching_engine_->lastSeqNum());
+  }
+
+  auto StandbyReplica::stats() const -> std::string {
+    std::stringstream ss;
+    ss << "StandbyStats{"
+       << "seq:" << matching_engine_->lastSeqNum() << " "
+       << "from-ring:" << num_from_ring_ << " "
+       << "from-journal:" << num_from_journal_ << " "
+       << "max-records-behind:" << max_records_behind_ << " "
+       << "lag:" << lag_.get_stats_string();
+    if (failure_detected_time_) {
+      ss << " failure:" << failure_reason_
+         << " detect-ns:" << failure_detected_time_ - last_primary_activity_
+         << " catch-up-ns:" << caught_up_time_ - failure_detected_time_;
+    }
+    ss << "}";
+
+    return ss.str();
+  }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <sstream>
+
+#include "macros.h"
+#include "logging.h"
+#include "latency_tracker.h"
+
+#include "order_server/request_journal.h"
+
+#include "matching_engine.h"
+
+namespace Exchange {
+  struct StandbyCfg {
+    /// Shared memory ring the primary's FIFO sequencer replicates to, and the primary's request journal.
+    std::string replication_shm_name_ = "/exchange_replication";
+    std::string journal_path_ = "exchange_requests.journal";
+
+    /// A primary that is still running but has not heartbeat for this long is killed and taken over from.
+    Nanos heartbeat_timeout_nanos_ = 100 * NANOS_TO_MILLIS;
+
+    /// How often the steady state statistics are logged.
+    Nanos stats_interval_nanos_ = NANOS_TO_SECS;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "StandbyCfg{"
+         << "shm:" << replication_shm_name_ << " "
+         << "journal:" << journal_path_ << " "
+         << "heartbeat-timeout:" << heartbeat_timeout_nanos_ << " "
+         << "stats-interval:" << stats_interval_nanos_
+         << "}";
+
+      return ss.str();
+    }
+  };
+
+  /// Keeps a recovered but not started MatchingEngine in step with a primary exchange on the same box,
+  /// by applying the requests the primary's FIFO sequencer replicates through shared memory, in sequence number order.
+  /// Requests the primary had to drop because the ring was full are read back from its journal.
+  /// Nothing is published while following, every book and market order id evolves exactly as in the primary,
+  /// so once the primary is gone the matching engine can be started and carry on from the same sequence number.
+  class StandbyReplica final {
+  public:
+    StandbyReplica(const StandbyCfg &cfg, MatchingEngine *matching_engine);
+
+    /// Apply the primary's requests until the primary has exited or been fenced off after missing its heartbeat,
+    /// then apply everything it sequenced before it went away. Returns once it is safe to take over.
+    auto follow() -> void;
+
+    /// Append the requests the primary sequenced but had not journaled yet, journal must be opened after follow() returned
+    /// and its writer thread started. Afterwards the journal ends at the matching engine's last sequence number.
+    auto completeJournal(RequestJournal *journal) -> void;
+
+    /// When the primary's failure was detected.
+    auto failureDetectedTime() const noexcept {
+      return failure_detected_time_;
+    }
+
+    /// Steady state lag and failover statistics.
+    auto stats() const -> std::string;
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    StandbyReplica() = delete;
+
+    StandbyReplica(const StandbyReplica &) = delete;
+
+    StandbyReplica(const StandbyReplica &&) = delete;
+
+    StandbyReplica &operator=(const StandbyReplica &) = delete;
+
+    StandbyReplica &operator=(const StandbyReplica &&) = delete;
+
+  private:
+    const StandbyCfg cfg_;
+    MatchingEngine *matching_engine_ = nullptr;
+
+    JournalRecordShmQueue *replication_ = nullptr;
+
+    /// Every record applied, indexed by sequence number modulo the capacity, to complete the journal on takeover.
+    std::vector<JournalRecord> history_;
+
+    /// Time from the primary receiving a request to it being applied here, and how many records were queued behind it.
+    LatencyTracker lag_;
+    size_t max_records_behind_ = 0;
+    size_t num_from_ring_ = 0;
+    size_t num_from_journal_ = 0;
+
+    /// Failover timeline: last sign of life from the primary, failure detected, caught up with everything it sequenced.
+    Nanos last_primary_activity_ = 0;
+    Nanos failure_detected_time_ = 0;
+    Nanos caught_up_time_ = 0;
+    std::string failure_reason_;
+
+    std::string time_str_;
+    Logger logger_;
+
+  private:
+    auto apply(const JournalRecord &record) noexcept -> void;
+
+    /// Apply journaled requests up to and including seq_num, waiting for the primary to journal them while it is alive.
+    /// Returns false if the primary is gone and its journal ends before seq_num.
+    auto catchUpFromJournal(size_t seq_num) -> bool;
+
+    /// Attach to the replication ring, waiting for the primary to create it.
+    auto attach() -> void;
+
+    /// True once the primary has exited or has been fenced off, sets failure_detected_time_.
+    auto primaryFailed(Nanos now) -> bool;
+  };
+}
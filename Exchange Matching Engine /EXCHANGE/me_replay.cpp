@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matching_engine.h"
+#include "request_journal.h"
+#include "perf_counters.h"
+#include "latency_histogram.h"
+
+/// Replays a request journal straight into a MatchingEngine, with no sockets and no other threads in the way.
+/// The client responses and market updates generated can be recorded, or verified byte for byte against an earlier recording
+/// to check that a change to the book or the allocators did not change behaviour.
+///
+/// Usage: me_replay JOURNAL [--record FILE | --verify FILE] [--coalesce-executions 0|1] [--aggregate-aggressor-fills 0|1]
+///
+/// A recording is the sequence of outputs in the order the engine generated them, each one a 1 byte OutputType followed by
+/// the packed MEClientResponse or MEMarketUpdate.
+
+using namespace Exchange;
+
+namespace {
+  enum class OutputType : uint8_t {
+    CLIENT_RESPONSE = 1,
+    MARKET_UPDATE = 2
+  };
+
+  /// Read only mapping of an earlier recording, compared against as the replay progresses.
+  struct Recording {
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+  };
+
+  auto mapRecording(const std::string &path) {
+    Recording recording;
+    const auto fd = open(path.c_str(), O_RDONLY);
+    ASSERT(fd >= 0, "Could not open recording:" + path + " error:" + std::string(std::strerror(errno)));
+
+    struct stat file_stat;
+    ASSERT(fstat(fd, &file_stat) == 0, "fstat() failed on recording:" + path);
+    recording.size_ = file_stat.st_size;
+    if (recording.size_) {
+      recording.data_ = static_cast<const char *>(mmap(nullptr, recording.size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0));
+      ASSERT(recording.data_ != MAP_FAILED, "mmap() failed on recording:" + path);
+    }
+    close(fd);
+
+    return recording;
+  }
+
+  auto outputToString(const char *output) -> std::string {
+    switch (static_cast<OutputType>(output[0])) {
+      case OutputType::CLIENT_RESPONSE:
+        return reinterpret_cast<const MEClientResponse *>(output + 1)->toString();
+      case OutputType::MARKET_UPDATE:
+        return reinterpret_cast<const MEMarketUpdate *>(output + 1)->toString();
+    }
+    return "UNKNOWN";
+  }
+
+  auto usage() {
+    std::cerr << "USAGE me_replay JOURNAL [--record FILE | --verify FILE] [--coalesce-executions 0|1] [--aggregate-aggressor-fills 0|1]" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+  }
+
+  const std::string journal_path = argv[1];
+  std::string record_path, verify_path;
+
+  // Default to the configuration exchange_main runs with.
+  MatchingEngineCfg cfg;
+  cfg.coalesce_executions_ = true;
+  cfg.aggregate_aggressor_fills_ = false;
+
+  for (int i = 2; i < argc; i += 2) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+    }
+    if (arg == "--record") {
+      record_path = argv[i + 1];
+    } else if (arg == "--verify") {
+      verify_path = argv[i + 1];
+    } else if (arg == "--coalesce-executions") {
+      cfg.coalesce_executions_ = atoi(argv[i + 1]);
+    } else if (arg == "--aggregate-aggressor-fills") {
+      cfg.aggregate_aggressor_fills_ = atoi(argv[i + 1]);
+    } else {
+      usage();
+    }
+  }
+  if (!record_path.empty() && !verify_path.empty()) {
+    usage();
+  }
+
+  ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+
+  // The matching engine thread is not started, requests are fed to it directly from this thread.
+  auto matching_engine = new MatchingEngine(cfg, &client_requests, &client_responses, &market_updates);
+  std::cout << cfg.toString() << std::endl;
+
+  FILE *record_file = nullptr;
+  if (!record_path.empty()) {
+    record_file = fopen(record_path.c_str(), "wb");
+    ASSERT(record_file, "Could not open recording:" + record_path + " error:" + std::string(std::strerror(errno)));
+  }
+  auto recording = verify_path.empty() ? Recording{} : mapRecording(verify_path);
+
+  RequestJournalReader journal(journal_path);
+
+  std::vector<Nanos> latencies;
+  LatencyHistogram histogram;
+  size_t num_responses = 0, num_updates = 0;
+
+  // Outputs of the current request, in the format of the recording.
+  std::vector<char> outputs;
+  outputs.reserve(64 * 1024);
+  auto drain = [&](auto *queue, OutputType type, size_t *count) {
+    for (auto output = queue->getNextToRead(); output; output = queue->getNextToRead()) {
+      outputs.push_back(static_cast<char>(type));
+      outputs.insert(outputs.end(), reinterpret_cast<const char *>(output), reinterpret_cast<const char *>(output) + sizeof(*output));
+      queue->updateReadIndex();
+      ++*count;
+    }
+  };
+
+  Common::PerfCounters perf_counters;
+  perf_counters.start();
+  const auto start = Common::getCurrentNanos();
+
+  for (auto record = journal.next(); record; record = journal.next()) {
+    const auto request_start = Common::getCurrentNanos();
+    matching_engine->processClientRequest(&record->request_);
+    matching_engine->commitOutputs();
+    const auto latency = Common::getCurrentNanos() - request_start;
+    latencies.push_back(latency);
+    histogram.add(latency);
+
+    // Responses before market updates, the same order for the recording and the replay.
+    outputs.clear();
+    drain(&client_responses, OutputType::CLIENT_RESPONSE, &num_responses);
+    drain(&market_updates, OutputType::MARKET_UPDATE, &num_updates);
+
+    if (record_file) {
+      ASSERT(fwrite(outputs.data(), 1, outputs.size(), record_file) == outputs.size(), "Could not write recording:" + record_path);
+    } else if (!verify_path.empty()) {
+      if (UNLIKELY(recording.offset_ + outputs.size() > recording.size_ ||
+                   memcmp(recording.data_ + recording.offset_, outputs.data(), outputs.size()))) {
+        // Walk the outputs of this request to report the first one that differs.
+        size_t i = 0;
+        while (i < outputs.size() && recording.offset_ + i < recording.size_ && recording.data_[recording.offset_ + i] == outputs[i]) {
+          ++i;
+        }
+        const auto output_size = [](const char *output) {
+          return 1 + (static_cast<OutputType>(output[0]) == OutputType::CLIENT_RESPONSE ? sizeof(MEClientResponse) : sizeof(MEMarketUpdate));
+        };
+        size_t output_start = 0;
+        while (output_start < outputs.size() && output_start + output_size(outputs.data() + output_start) <= i) {
+          output_start += output_size(outputs.data() + output_start);
+        }
+
+        std::cerr << "MISMATCH at " << record->toString() << " recording-offset:" << recording.offset_ + output_start << std::endl;
+        std::cerr << "  replayed: " << outputToString(outputs.data() + output_start) << std::endl;
+        if (recording.offset_ + output_start < recording.size_) {
+          std::cerr << "  recorded: " << outputToString(recording.data_ + recording.offset_ + output_start) << std::endl;
+        } else {
+          std::cerr << "  recorded: end of recording" << std::endl;
+        }
+        exit(EXIT_FAILURE);
+      }
+      recording.offset_ += outputs.size();
+    }
+  }
+
+  const auto elapsed = Common::getCurrentNanos() - start;
+  perf_counters.stop();
+
+  const auto num_requests = latencies.size();
+  std::cout << "Replayed " << num_requests << " requests from " << journal_path << " in " << elapsed / NANOS_TO_MILLIS << "ms, "
+            << (elapsed ? num_requests * NANOS_TO_SECS / elapsed : 0) << " requests/s, "
+            << num_responses << " responses, " << num_updates << " market updates." << std::endl;
+
+  if (num_requests) {
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p) { return latencies[std::min(num_requests - 1, static_cast<size_t>(num_requests * p / 100.0))]; };
+    std::cout << "Per request latency ns: min:" << latencies.front() << " p50:" << percentile(50) << " p90:" << percentile(90)
+              << " p99:" << percentile(99) << " p99.9:" << percentile(99.9) << " max:" << latencies.back() << std::endl;
+    histogram.print(num_requests);
+  }
+  std::cout << perf_counters.toString() << std::endl;
+
+  if (record_file) {
+    fclose(record_file);
+    std::cout << "Recorded outputs to " << record_path << std::endl;
+  } else if (!verify_path.empty()) {
+    if (recording.offset_ != recording.size_) {
+      std::cerr << "MISMATCH recording has " << recording.size_ - recording.offset_ << " more bytes of outputs than the replay." << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << "Outputs identical to " << verify_path << std::endl;
+  }
+
+  delete matching_engine;
+
+  exit(EXIT_SUCCESS);
+}
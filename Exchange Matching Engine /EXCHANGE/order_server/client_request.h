@@ -57,22 +57,6 @@ namespace Exchange {
     }
   };
 
-  /// Client request structure published over the network by the order gateway client.
-  struct OMClientRequest {
-    size_t seq_num_ = 0;
-    MEClientRequest me_client_request_;
-
-    auto toString() const {
-      std::stringstream ss;
-      ss << "OMClientRequest"
-         << " ["
-         << "seq:" << seq_num_
-         << " " << me_client_request_.toString()
-         << "]";
-      return ss.str();
-    }
-  };
-
 #pragma pack(pop) // Undo the packed binary structure directive moving forward.
 
   /// Lock free queues of matching engine client order request messages.
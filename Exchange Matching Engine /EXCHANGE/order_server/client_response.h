@@ -66,22 +66,6 @@ namespace Exchange {
     }
   };
 
-  /// Client response structure published over the network by the order server.
-  struct OMClientResponse {
-    size_t seq_num_ = 0;
-    MEClientResponse me_client_response_;
-
-    auto toString() const {
-      std::stringstream ss;
-      ss << "OMClientResponse"
-         << " ["
-         << "seq:" << seq_num_
-         << " " << me_client_response_.toString()
-         << "]";
-      return ss.str();
-    }
-  };
-
 #pragma pack(pop) // Undo the packed binary structure directive moving forward.
 
   /// Lock free queues of matching engine client order response messages.
@@ -4,50 +4,73 @@
 #include "macros.h"
 
 #include "order_server/client_request.h"
+#include "order_server/request_journal.h"
+#include "order_server/session_run_merger.h"
 
 namespace Exchange {
-  /// Maximum number of unprocessed client request messages across all TCP connections in the order server / FIFO sequencer.
-  constexpr size_t ME_MAX_PENDING_REQUESTS = 1024;
+  /// Default maximum number of unprocessed client request messages across all TCP connections in the order server / FIFO sequencer.
+  constexpr size_t ME_MAX_PENDING_REQUESTS = 64 * 1024;
 
   class FIFOSequencer {
   public:
-    FIFOSequencer(ClientRequestLFQueue *client_requests, Logger *logger)
-        : incoming_requests_(client_requests), logger_(logger) {
+    /// journal is optional, when provided every published request is journaled and sequence numbers continue from the journal.
+    /// replication is optional, when provided every journaled request is also offered to a standby exchange.
+    /// At most max_pending requests are held between calls to sequenceAndPublish().
+    FIFOSequencer(ClientRequestLFQueue *client_requests, RequestJournal *journal, JournalRecordShmQueue *replication, Logger *logger,
+                  size_t max_pending = ME_MAX_PENDING_REQUESTS)
+        : incoming_requests_(client_requests), journal_(journal), replication_(replication),
+          next_seq_num_(journal ? journal->lastSeqNum() + 1 : 1), logger_(logger), pending_client_requests_(max_pending) {
     }
 
     ~FIFOSequencer() {
     }
 
-    /// Queue up a client request, not processed immediately, processed when sequenceAndPublish() is called.
-    auto addClientRequest(Nanos rx_time, const MEClientRequest &request) {
-      if (pending_size_ >= pending_client_requests_.size()) {
-        FATAL("Too many pending requests");
-      }
-      pending_client_requests_.at(pending_size_++) = std::move(RecvTimeClientRequest{rx_time, request});
+    /// Queue up a client request received on session (the socket fd), not processed immediately, processed when sequenceAndPublish() is called.
+    /// Requests of one session must be added in the order they were received.
+    /// Returns false without queueing the request when the sequencer is full, the caller must sequenceAndPublish() and add it again.
+    auto addClientRequest(size_t session, Nanos rx_time, const MEClientRequest &request) noexcept {
+      return pending_client_requests_.add(session, rx_time, request);
     }
 
-    /// Sort pending client requests in ascending receive time order and then write them to the lock free queue for the matching engine to consume from.
-    auto sequenceAndPublish() {
-      if (UNLIKELY(!pending_size_))
-        return;
+    auto pending() const noexcept {
+      return pending_client_requests_.size();
+    }
 
-      logger_->log("%:% %() % Processing % requests.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), pending_size_);
+    /// Merge the pending client requests of all sessions received before the time limit in ascending receive time order and then write
+    /// them to the lock free queue for the matching engine to consume from, waiting for the matching engine if the queue is full.
+    /// Later requests stay pending, an order server with several I/O threads publishes only up to the time all of them have read up to.
+    auto sequenceAndPublish(Nanos before = std::numeric_limits<Nanos>::max()) {
+      if (UNLIKELY(!pending_client_requests_.size()))
+        return;
 
-      std::sort(pending_client_requests_.begin(), pending_client_requests_.begin() + pending_size_);
+      logger_->log("%:% %() % Processing % requests before:%.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   pending_client_requests_.size(), before);
 
-      for (size_t i = 0; i < pending_size_; ++i) {
-        const auto &client_request = pending_client_requests_.at(i);
+      pending_client_requests_.merge([this](const RecvTimeClientRequest &client_request) {
+        logger_->log("%:% %() % Writing Seq:% RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                     next_seq_num_, client_request.recv_time_, client_request.request_.toString());
 
-        logger_->log("%:% %() % Writing RX:% Req:% to FIFO.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
-                     client_request.recv_time_, client_request.request_.toString());
+        if (journal_) {
+          journal_->append(next_seq_num_, client_request.recv_time_, client_request.request_);
+        }
+        if (replication_) {
+          replicate(client_request);
+        }
+        ++next_seq_num_;
 
         auto next_write = incoming_requests_->getNextToWriteTo();
-        *next_write = std::move(client_request.request_);
+        while (UNLIKELY(!next_write)) { // queue is full, wait for the matching engine to catch up.
+          std::this_thread::yield();
+          next_write = incoming_requests_->getNextToWriteTo();
+        }
+        *next_write = client_request.request_;
         incoming_requests_->updateWriteIndex();
         TTT_MEASURE(T2_OrderServer_LFQueue_write, (*logger_));
-      }
+      }, before);
 
-      pending_size_ = 0;
+      if (replication_) {
+        replication_->commitWriteIndex();
+      }
     }
 
     /// Deleted default, copy & move constructors and assignment-operators.
@@ -65,21 +88,37 @@ namespace Exchange {
     /// Lock free queue used to publish client requests to, so that the matching engine can consume them.
     ClientRequestLFQueue *incoming_requests_ = nullptr;
 
+    /// Optional write-ahead journal of the sequenced requests.
+    RequestJournal *journal_ = nullptr;
+
+    /// Optional ring to a standby exchange, and the number of requests it had no room for.
+    JournalRecordShmQueue *replication_ = nullptr;
+    size_t num_replication_drops_ = 0;
+
+    /// Global sequence number assigned to the next request published.
+    size_t next_seq_num_ = 1;
+
     std::string time_str_;
     Logger *logger_ = nullptr;
 
-    /// A structure that encapsulates the software receive time as well as the client request.
-    struct RecvTimeClientRequest {
-      Nanos recv_time_ = 0;
-      MEClientRequest request_;
+    /// Pending client requests, one run per session.
+    SessionRunMerger pending_client_requests_;
 
-      auto operator<(const RecvTimeClientRequest &rhs) const {
-        return (recv_time_ < rhs.recv_time_);
+  private:
+    /// The standby must never slow down sequencing, if it has fallen a full ring behind the request is dropped
+    /// and the standby reads it back from the journal instead.
+    auto replicate(const RecvTimeClientRequest &client_request) noexcept -> void {
+      auto next_write = replication_->reserveNextToWriteTo();
+      if (UNLIKELY(!next_write)) {
+        if (!(num_replication_drops_++ % 4096)) {
+          logger_->log("%:% %() % Replication ring full, standby is behind. drops:%\n", __FILE__, __LINE__, __FUNCTION__,
+                       Common::getCurrentTimeStr(&time_str_), num_replication_drops_);
+        }
+        return;
       }
-    };
-
-    /// Queue of pending client requests, not sorted.
-    std::array<RecvTimeClientRequest, ME_MAX_PENDING_REQUESTS> pending_client_requests_;
-    size_t pending_size_ = 0;
+      next_write->seq_num_ = next_seq_num_;
+      next_write->recv_time_ = client_request.recv_time_;
+      next_write->request_ = client_request.request_;
+    }
   };
 }
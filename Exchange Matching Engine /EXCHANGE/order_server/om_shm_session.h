@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+
+#include "shm_queue.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+
+/// Order entry over shared memory, for clients on the same box as the exchange.
+///
+/// A client's session is a pair of ShmQueues named after its ClientId: the client creates the request ring and the order server attaches
+/// to it, then creates the response ring for the client to attach to. Messages are the requests and responses themselves with their
+/// sequence numbers, the order server checks them and sequences the requests exactly as it does those of a TCP session.
+/// The session ends when the client process exits, or when either side replaces its ring.
+
+namespace Exchange {
+  /// Capacity of either ring of a session.
+  constexpr size_t OM_SHM_QUEUE_SIZE = 16 * 1024;
+
+  /// How often an order server looks for new sessions and for clients that exited, and a client for the order server's response ring.
+  constexpr Nanos OM_SHM_SCAN_INTERVAL_NANOS = 10 * NANOS_TO_MILLIS;
+
+#pragma pack(push, 1)
+
+  struct OMShmRequest {
+    size_t seq_num_ = 0;
+    MEClientRequest request_;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "OMShmRequest"
+         << " ["
+         << "seq:" << seq_num_
+         << " " << request_.toString()
+         << "]";
+      return ss.str();
+    }
+  };
+
+  struct OMShmResponse {
+    size_t seq_num_ = 0;
+    MEClientResponse response_;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "OMShmResponse"
+         << " ["
+         << "seq:" << seq_num_
+         << " " << response_.toString()
+         << "]";
+      return ss.str();
+    }
+  };
+
+#pragma pack(pop)
+
+  typedef Common::ShmQueue<OMShmRequest> OMShmRequestQueue;
+  typedef Common::ShmQueue<OMShmResponse> OMShmResponseQueue;
+
+  /// Names of the two rings of client_id's session.
+  inline auto omShmRequestsName(ClientId client_id) {
+    return "/exchange_order_entry_" + std::to_string(client_id) + "_requests";
+  }
+
+  inline auto omShmResponsesName(ClientId client_id) {
+    return "/exchange_order_entry_" + std::to_string(client_id) + "_responses";
+  }
+}
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "macros.h"
+#include "tcp_socket.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+
+/// Wire format of the order entry sessions, version OM_VERSION, the same both ways.
+///
+/// The stream is a sequence of frames: an OMFrameHeader followed by num_messages_ messages of one client. Messages carry no sequence
+/// number or client id of their own, the i-th message of a frame has sequence number seq_num_ + i and the frame's client id.
+/// Every message starts with its type, which decides its layout - a cancel or a cancel reject carries no side, price or quantity.
+
+namespace Exchange {
+  constexpr uint8_t OM_VERSION = 1;
+
+  /// Largest frame a writer produces and a reader accepts, headers included.
+  constexpr size_t OM_MAX_FRAME_SIZE = 4096;
+
+#pragma pack(push, 1)
+
+  struct OMFrameHeader {
+    uint8_t version_ = OM_VERSION;
+
+    /// Bytes in the frame, this header included.
+    uint16_t size_ = 0;
+    uint16_t num_messages_ = 0;
+    ClientId client_id_ = ClientId_INVALID;
+
+    /// Sequence number of the first message.
+    size_t seq_num_ = 0;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "OMFrameHeader"
+         << " ["
+         << "version:" << static_cast<int>(version_)
+         << " size:" << size_
+         << " messages:" << num_messages_
+         << " client:" << clientIdToString(client_id_)
+         << " seq:" << seq_num_
+         << "]";
+      return ss.str();
+    }
+  };
+
+  /// ClientRequestType::NEW.
+  struct OMNewOrderMessage {
+    ClientRequestType type_ = ClientRequestType::NEW;
+    TickerId ticker_id_ = TickerId_INVALID;
+    OrderId order_id_ = OrderId_INVALID;
+    Side side_ = Side::INVALID;
+    Price price_ = Price_INVALID;
+    Qty qty_ = Qty_INVALID;
+  };
+
+  /// ClientRequestType::CANCEL.
+  struct OMCancelOrderMessage {
+    ClientRequestType type_ = ClientRequestType::CANCEL;
+    TickerId ticker_id_ = TickerId_INVALID;
+    OrderId order_id_ = OrderId_INVALID;
+  };
+
+  /// ClientResponseType::ACCEPTED, CANCELED and FILLED.
+  struct OMOrderResponseMessage {
+    ClientResponseType type_ = ClientResponseType::INVALID;
+    TickerId ticker_id_ = TickerId_INVALID;
+    OrderId client_order_id_ = OrderId_INVALID;
+    OrderId market_order_id_ = OrderId_INVALID;
+    Side side_ = Side::INVALID;
+    Price price_ = Price_INVALID;
+    Qty exec_qty_ = Qty_INVALID;
+    Qty leaves_qty_ = Qty_INVALID;
+  };
+
+  /// ClientResponseType::CANCEL_REJECTED.
+  struct OMCancelRejectMessage {
+    ClientResponseType type_ = ClientResponseType::CANCEL_REJECTED;
+    TickerId ticker_id_ = TickerId_INVALID;
+    OrderId client_order_id_ = OrderId_INVALID;
+  };
+
+#pragma pack(pop)
+
+  /// Room a writer keeps for the next message of either direction.
+  constexpr size_t OM_MAX_MESSAGE_SIZE = std::max(sizeof(OMNewOrderMessage), sizeof(OMOrderResponseMessage));
+
+  /// Encode a request or a response at out, returns the message size.
+  inline auto omEncode(const MEClientRequest &request, char *out) noexcept -> size_t {
+    if (request.type_ == ClientRequestType::CANCEL) {
+      const OMCancelOrderMessage message{request.type_, request.ticker_id_, request.order_id_};
+      memcpy(out, &message, sizeof(message));
+      return sizeof(message);
+    }
+    const OMNewOrderMessage message{request.type_, request.ticker_id_, request.order_id_, request.side_, request.price_, request.qty_};
+    memcpy(out, &message, sizeof(message));
+    return sizeof(message);
+  }
+
+  inline auto omEncode(const MEClientResponse &response, char *out) noexcept -> size_t {
+    if (response.type_ == ClientResponseType::CANCEL_REJECTED) {
+      const OMCancelRejectMessage message{response.type_, response.ticker_id_, response.client_order_id_};
+      memcpy(out, &message, sizeof(message));
+      return sizeof(message);
+    }
+    const OMOrderResponseMessage message{response.type_, response.ticker_id_, response.client_order_id_, response.market_order_id_,
+                                         response.side_, response.price_, response.exec_qty_, response.leaves_qty_};
+    memcpy(out, &message, sizeof(message));
+    return sizeof(message);
+  }
+
+  /// Decode the message at in, at most len bytes long, for client_id. Returns its size, or 0 if it is of an unknown type or truncated.
+  inline auto omDecode(const char *in, size_t len, ClientId client_id, MEClientRequest *request) noexcept -> size_t {
+    switch (static_cast<ClientRequestType>(in[0])) {
+      case ClientRequestType::NEW: {
+        if (UNLIKELY(len < sizeof(OMNewOrderMessage))) {
+          return 0;
+        }
+        const auto message = reinterpret_cast<const OMNewOrderMessage *>(in);
+        *request = {message->type_, client_id, message->ticker_id_, message->order_id_, message->side_, message->price_, message->qty_};
+        return sizeof(OMNewOrderMessage);
+      }
+      case ClientRequestType::CANCEL: {
+        if (UNLIKELY(len < sizeof(OMCancelOrderMessage))) {
+          return 0;
+        }
+        const auto message = reinterpret_cast<const OMCancelOrderMessage *>(in);
+        *request = {message->type_, client_id, message->ticker_id_, message->order_id_, Side::INVALID, Price_INVALID, Qty_INVALID};
+        return sizeof(OMCancelOrderMessage);
+      }
+      default:
+        return 0;
+    }
+  }
+
+  inline auto omDecode(const char *in, size_t len, ClientId client_id, MEClientResponse *response) noexcept -> size_t {
+    switch (static_cast<ClientResponseType>(in[0])) {
+      case ClientResponseType::ACCEPTED:
+      case ClientResponseType::CANCELED:
+      case ClientResponseType::FILLED: {
+        if (UNLIKELY(len < sizeof(OMOrderResponseMessage))) {
+          return 0;
+        }
+        const auto message = reinterpret_cast<const OMOrderResponseMessage *>(in);
+        *response = {message->type_, client_id, message->ticker_id_, message->client_order_id_, message->market_order_id_,
+                     message->side_, message->price_, message->exec_qty_, message->leaves_qty_};
+        return sizeof(OMOrderResponseMessage);
+      }
+      case ClientResponseType::CANCEL_REJECTED: {
+        if (UNLIKELY(len < sizeof(OMCancelRejectMessage))) {
+          return 0;
+        }
+        const auto message = reinterpret_cast<const OMCancelRejectMessage *>(in);
+        *response = {message->type_, client_id, message->ticker_id_, message->client_order_id_, OrderId_INVALID,
+                     Side::INVALID, Price_INVALID, Qty_INVALID, Qty_INVALID};
+        return sizeof(OMCancelRejectMessage);
+      }
+      default:
+        return 0;
+    }
+  }
+
+  /// Most messages a frame has room for, every message is at least as large as a cancel or a cancel reject.
+  constexpr size_t OM_MAX_FRAME_MESSAGES = (OM_MAX_FRAME_SIZE - sizeof(OMFrameHeader)) /
+                                           std::min(sizeof(OMCancelOrderMessage), sizeof(OMCancelRejectMessage));
+
+  /// Decode every message of the whole frame at in into messages, which has room for OM_MAX_FRAME_MESSAGES. Returns false if any of
+  /// them is of an unknown type or does not fit in the frame, in which case none of them are to be used.
+  template<typename Message>
+  inline auto omDecodeFrame(const char *in, Message *messages) noexcept -> bool {
+    const auto header = reinterpret_cast<const OMFrameHeader *>(in);
+    if (UNLIKELY(header->num_messages_ > OM_MAX_FRAME_MESSAGES)) {
+      return false;
+    }
+
+    size_t offset = sizeof(OMFrameHeader);
+    for (uint16_t m = 0; m < header->num_messages_; ++m) {
+      const auto message_size = (offset < header->size_) ? omDecode(in + offset, header->size_ - offset, header->client_id_, &messages[m]) : 0;
+      if (UNLIKELY(!message_size)) {
+        return false;
+      }
+      offset += message_size;
+    }
+    return true;
+  }
+
+  /// Builds one frame of consecutively sequenced messages and hands it to a socket's send ring.
+  class OMFrameWriter final {
+  public:
+    OMFrameWriter() = default;
+
+    auto empty() const noexcept {
+      return !num_messages_;
+    }
+
+    /// Append a request or a response with sequence number seq_num, false if the frame is full and has to be flushed first.
+    template<typename Message>
+    auto add(size_t seq_num, const Message &message) noexcept {
+      if (UNLIKELY(size_ + OM_MAX_MESSAGE_SIZE > OM_MAX_FRAME_SIZE)) {
+        return false;
+      }
+      if (!num_messages_) {
+        seq_num_ = seq_num;
+      }
+      size_ += omEncode(message, frame_ + size_);
+      ++num_messages_;
+      return true;
+    }
+
+    /// Write the header of the frame for client_id, queue it on socket and start a new one.
+    auto flush(ClientId client_id, Common::TCPSocket *socket) noexcept {
+      if (!num_messages_) {
+        return;
+      }
+      OMFrameHeader header;
+      header.size_ = static_cast<uint16_t>(size_);
+      header.num_messages_ = num_messages_;
+      header.client_id_ = client_id;
+      header.seq_num_ = seq_num_;
+      memcpy(frame_, &header, sizeof(header));
+      socket->send(frame_, size_);
+
+      clear();
+    }
+
+    /// Discard the frame.
+    auto clear() noexcept -> void {
+      size_ = sizeof(OMFrameHeader);
+      num_messages_ = 0;
+    }
+
+    /// Deleted copy & move constructors and assignment-operators.
+    OMFrameWriter(const OMFrameWriter &) = delete;
+
+    OMFrameWriter(const OMFrameWriter &&) = delete;
+
+    OMFrameWriter &operator=(const OMFrameWriter &) = delete;
+
+    OMFrameWriter &operator=(const OMFrameWriter &&) = delete;
+
+  private:
+    /// The frame being built, its header is written when it is flushed.
+    char frame_[OM_MAX_FRAME_SIZE];
+    size_t size_ = sizeof(OMFrameHeader);
+    uint16_t num_messages_ = 0;
+    size_t seq_num_ = 0;
+  };
+}
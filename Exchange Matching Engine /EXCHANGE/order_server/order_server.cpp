@@ -1,15 +1,25 @@
 #include "order_server.h"
 
 namespace Exchange {
-  OrderServer::OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, const std::string &iface, int port)
+  OrderServer::OrderServer(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, RequestJournal *journal,
+                           JournalRecordShmQueue *replication, const std::string &iface, int port, const Common::SendQueueCfg &send_queue_cfg,
+                           Common::TCPServerBackend tcp_backend, const Common::OrderServerCfg &cfg)
       : iface_(iface), port_(port), outgoing_responses_(client_responses), logger_("exchange_order_server.log"),
-        tcp_server_(logger_), fifo_sequencer_(client_requests, &logger_) {
-    cid_next_outgoing_seq_num_.fill(1);
-    cid_next_exp_seq_num_.fill(1);
-    cid_tcp_socket_.fill(nullptr);
+        fifo_sequencer_(client_requests, journal, replication, &logger_) {
+    ASSERT(cfg.num_io_threads_ >= 1, "OrderServer needs at least one I/O thread. " + cfg.toString());
 
-    tcp_server_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
-    tcp_server_.recv_finished_callback_ = [this]() { recvFinishedCallback(); };
+    if (cfg.num_io_threads_ == 1) { // the I/O thread does it all, on the order server's own logger.
+      shards_.push_back(new OrderServerShard(0, &clients_, &fifo_sequencer_, nullptr, client_responses, &logger_, send_queue_cfg, tcp_backend, cfg));
+      return;
+    }
+
+    for (size_t i = 0; i < cfg.num_io_threads_; ++i) {
+      shard_loggers_.push_back(new Logger("exchange_order_server_" + std::to_string(i) + ".log"));
+      shard_requests_.push_back(new SessionClientRequestLFQueue(ME_MAX_PENDING_REQUESTS));
+      shard_responses_.push_back(new ClientResponseLFQueue(ME_MAX_PENDING_REQUESTS));
+      shards_.push_back(new OrderServerShard(static_cast<int>(i), &clients_, nullptr, shard_requests_.back(), shard_responses_.back(),
+                                             shard_loggers_.back(), send_queue_cfg, tcp_backend, cfg));
+    }
   }
 
   OrderServer::~OrderServer() {
@@ -17,17 +27,37 @@ namespace Exchange {
 
     using namespace std::literals::chrono_literals;
     std::this_thread::sleep_for(1s);
+
+    for (auto shard : shards_) {
+      delete shard;
+    }
+    for (auto shard_responses : shard_responses_) {
+      delete shard_responses;
+    }
+    for (auto shard_requests : shard_requests_) {
+      delete shard_requests;
+    }
+    for (auto shard_logger : shard_loggers_) {
+      delete shard_logger;
+    }
   }
 
-  /// Start and stop the order server main thread.
+  /// Start and stop the order server threads, the I/O threads share the port and the kernel spreads the connections across them.
   auto OrderServer::start() -> void {
     run_ = true;
-    tcp_server_.listen(iface_, port_);
+    for (auto shard : shards_) {
+      shard->start(iface_, port_, shards_.size() > 1);
+    }
 
-    ASSERT(Common::createAndStartThread(-1, "Exchange/OrderServer", [this]() { run(); }) != nullptr, "Failed to start OrderServer thread.");
+    if (shards_.size() > 1) {
+      ASSERT(Common::createAndStartThread(-1, "Exchange/OrderSequencer", [this]() { run(); }) != nullptr, "Failed to start OrderSequencer thread.");
+    }
   }
 
   auto OrderServer::stop() -> void {
     run_ = false;
+    for (auto shard : shards_) {
+      shard->stop();
+    }
   }
 }
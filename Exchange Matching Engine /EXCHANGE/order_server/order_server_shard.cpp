@@ -0,0 +1,43 @@
+#include "order_server_shard.h"
+
+namespace Exchange {
+  OrderServerShard::OrderServerShard(int index, OrderServerClients *clients, FIFOSequencer *fifo_sequencer, SessionClientRequestLFQueue *client_requests,
+                                     ClientResponseLFQueue *client_responses, Logger *logger, const Common::SendQueueCfg &send_queue_cfg,
+                                     Common::TCPServerBackend tcp_backend, const Common::OrderServerCfg &cfg)
+      : index_(index), clients_(clients), fifo_sequencer_(fifo_sequencer), outgoing_requests_(client_requests), outgoing_responses_(client_responses),
+        logger_(logger), response_flush_budget_nanos_(cfg.response_flush_budget_nanos_), tcp_server_(*logger, ME_MAX_NUM_CLIENTS, tcp_backend),
+        shm_sessions_(cfg.shm_sessions_), num_io_threads_(cfg.num_io_threads_) {
+    ASSERT((fifo_sequencer_ != nullptr) != (outgoing_requests_ != nullptr), "OrderServerShard needs either a FIFOSequencer or a request queue.");
+    cid_tcp_socket_.fill(nullptr);
+    cid_response_frame_time_.fill(0);
+    response_frame_clients_.reserve(ME_MAX_NUM_CLIENTS);
+
+    tcp_server_.send_queue_cfg_ = send_queue_cfg;
+    tcp_server_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
+    tcp_server_.recv_finished_callback_ = [this]() { recvFinishedCallback(); };
+    tcp_server_.disconnected_callback_ = [this](auto socket) { disconnectedCallback(socket); };
+  }
+
+  OrderServerShard::~OrderServerShard() {
+    stop();
+
+    for (size_t client_id = 0; client_id < cid_shm_session_.size(); ++client_id) {
+      if (cid_shm_session_[client_id].requests_) {
+        closeShmSession(client_id, "order server stopped");
+      }
+    }
+  }
+
+  /// Start and stop this I/O thread.
+  auto OrderServerShard::start(const std::string &iface, int port, bool reuse_port) -> void {
+    run_ = true;
+    tcp_server_.listen(iface, port, reuse_port);
+
+    ASSERT(Common::createAndStartThread(-1, "Exchange/OrderServer/" + std::to_string(index_), [this]() { run(); }) != nullptr,
+           "Failed to start OrderServer thread.");
+  }
+
+  auto OrderServerShard::stop() -> void {
+    run_ = false;
+  }
+}
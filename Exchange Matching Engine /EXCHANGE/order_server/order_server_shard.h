@@ -0,0 +1,479 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "thread_utils.h"
+#include "macros.h"
+#include "tcp_server.h"
+
+#include "order_server/client_request.h"
+#include "order_server/client_response.h"
+#include "order_server/om_wire_format.h"
+#include "order_server/om_shm_session.h"
+#include "order_server/fifo_sequencer.h"
+
+namespace Exchange {
+  /// A client request read by one I/O thread of the order server, on its way to the sequencer stage.
+  struct SessionClientRequest {
+    size_t session_ = 0;
+    RecvTimeClientRequest client_request_;
+  };
+
+  typedef Common::LFQueue<SessionClientRequest> SessionClientRequestLFQueue;
+
+  /// Per ClientId state shared by the I/O threads of the order server. A client is bound to the I/O thread of the session it sent its first
+  /// frame on until that session closes, and only that thread touches the client's sequence numbers in the meantime.
+  struct OrderServerClients {
+    static constexpr int NO_SHARD = -1;
+
+    OrderServerClients() {
+      for (auto &shard : shard_) {
+        shard.store(NO_SHARD, std::memory_order_relaxed);
+      }
+      next_outgoing_seq_num_.fill(1);
+      next_exp_seq_num_.fill(1);
+    }
+
+    /// Hash map from ClientId -> the I/O thread serving it, NO_SHARD while it has no session.
+    std::array<std::atomic<int>, ME_MAX_NUM_CLIENTS> shard_;
+
+    /// Hash map from ClientId -> the next sequence number to be sent on outgoing client responses.
+    std::array<size_t, ME_MAX_NUM_CLIENTS> next_outgoing_seq_num_;
+
+    /// Hash map from ClientId -> the next sequence number expected on incoming client requests.
+    std::array<size_t, ME_MAX_NUM_CLIENTS> next_exp_seq_num_;
+  };
+
+  /// Sessions ids the FIFO sequencer keeps shared memory sessions under, socket fds stay far below it.
+  constexpr size_t OM_SHM_SESSION_BASE = 64 * 1024;
+
+  /// One I/O thread of the order server, with its own listener and epoll set: it accepts the connections the kernel hands its listener,
+  /// reads and checks their requests and writes their responses. With shared memory sessions enabled it also serves those of every
+  /// num_io_threads-th ClientId, starting at its index.
+  /// An order server with a single I/O thread sequences the requests right here, with several every thread hands its requests to the
+  /// order server's sequencer stage and takes its clients' responses from its own queue.
+  class OrderServerShard {
+  public:
+    /// fifo_sequencer is set for a single I/O thread, and client_requests otherwise.
+    OrderServerShard(int index, OrderServerClients *clients, FIFOSequencer *fifo_sequencer, SessionClientRequestLFQueue *client_requests,
+                     ClientResponseLFQueue *client_responses, Logger *logger, const Common::SendQueueCfg &send_queue_cfg,
+                     Common::TCPServerBackend tcp_backend, const Common::OrderServerCfg &cfg);
+
+    ~OrderServerShard();
+
+    /// Start and stop this I/O thread, listening with reuse_port alongside the other I/O threads.
+    auto start(const std::string &iface, int port, bool reuse_port) -> void;
+
+    auto stop() -> void;
+
+    /// Start time of the last loop that handed everything it read to the sequencer stage. Every request received before it has been handed
+    /// over, but for the rest of a frame that was still arriving, which keeps the receive time of its first bytes.
+    auto watermark() const noexcept {
+      return watermark_.load(std::memory_order_acquire);
+    }
+
+    /// Main run loop for this thread - accepts new client connections, receives client requests from them and sends client responses to them.
+    auto run() noexcept {
+      logger_->log("%:% %() % shard:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), index_);
+      while (run_) {
+        const auto now = Common::getCurrentNanos();
+        if (UNLIKELY(now >= next_rx_delay_log_time_)) {
+          next_rx_delay_log_time_ = now + RX_DELAY_LOG_INTERVAL_NANOS;
+          logRxDelays();
+        }
+
+        // Shared memory requests are read first, so that they are sequenced together with the TCP requests read below.
+        auto shm_received = false;
+        if (shm_sessions_) {
+          if (UNLIKELY(now >= next_shm_scan_time_)) {
+            next_shm_scan_time_ = now + OM_SHM_SCAN_INTERVAL_NANOS;
+            scanShmSessions();
+          }
+          shm_received = recvShmSessions();
+        }
+
+        tcp_server_.poll();
+
+        tcp_server_.sendAndRecv();
+
+        if (shm_received) {
+          recvFinishedCallback();
+        }
+
+        for (auto client_response = outgoing_responses_->getNextToRead(); outgoing_responses_->size() && client_response; client_response = outgoing_responses_->getNextToRead()) {
+          TTT_MEASURE(T5t_OrderServer_LFQueue_read, (*logger_));
+
+          const auto client_id = client_response->client_id_;
+          if (cid_shm_session_[client_id].bound_) {
+            sendShmResponse(client_id, *client_response);
+            outgoing_responses_->updateReadIndex();
+            continue;
+          }
+          if (UNLIKELY(cid_tcp_socket_[client_id] == nullptr)) { // the client disconnected since sending the request.
+            logger_->log("%:% %() % Dropping response for disconnected ClientId:% %\n", __FILE__, __LINE__, __FUNCTION__,
+                         Common::getCurrentTimeStr(&time_str_), client_id, client_response->toString());
+            outgoing_responses_->updateReadIndex();
+            continue;
+          }
+
+          auto &next_outgoing_seq_num = clients_->next_outgoing_seq_num_[client_id];
+          logger_->log("%:% %() % Processing cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       client_id, next_outgoing_seq_num, client_response->toString());
+
+          START_MEASURE(Exchange_TCPSocket_send);
+          auto &frame = cid_response_frame_[client_id];
+          if (frame.empty()) {
+            cid_response_frame_time_[client_id] = now;
+            response_frame_clients_.push_back(client_id);
+          }
+          if (UNLIKELY(!frame.add(next_outgoing_seq_num, *client_response))) { // a full frame goes out now, the response starts the next one.
+            frame.flush(client_id, cid_tcp_socket_[client_id]);
+            frame.add(next_outgoing_seq_num, *client_response);
+          }
+          END_MEASURE(Exchange_TCPSocket_send, (*logger_));
+
+          outgoing_responses_->updateReadIndex();
+          TTT_MEASURE(T6t_OrderServer_TCP_write, (*logger_));
+
+          ++next_outgoing_seq_num;
+        }
+
+        flushResponseFrames(now);
+
+        watermark_.store(now, std::memory_order_release);
+      }
+    }
+
+    /// Queue every client's response frame that has been held for the flush budget on the client's socket, the next sendAndRecv() then
+    /// hands everything queued for a client to the kernel with a single send.
+    auto flushResponseFrames(Nanos now) noexcept -> void {
+      size_t still_held = 0;
+      for (const auto client_id : response_frame_clients_) {
+        auto &frame = cid_response_frame_[client_id];
+        if (now - cid_response_frame_time_[client_id] < response_flush_budget_nanos_) {
+          response_frame_clients_[still_held++] = client_id;
+        } else if (LIKELY(cid_tcp_socket_[client_id] != nullptr)) {
+          frame.flush(client_id, cid_tcp_socket_[client_id]);
+        } else { // the client disconnected while its responses were held.
+          frame.clear();
+        }
+      }
+      response_frame_clients_.resize(still_held);
+    }
+
+    /// A closed session's socket is about to be reused, forget which clients were on it and let them connect to any I/O thread again.
+    auto disconnectedCallback(TCPSocket *socket) noexcept -> void {
+      logger_->log("%:% %() % Disconnected session rx-delay:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   socket->rx_delay_.toString());
+      for (size_t client_id = 0; client_id < cid_tcp_socket_.size(); ++client_id) {
+        if (cid_tcp_socket_[client_id] == socket) {
+          cid_tcp_socket_[client_id] = nullptr;
+          clients_->shard_[client_id].store(OrderServerClients::NO_SHARD, std::memory_order_release);
+        }
+      }
+    }
+
+    /// Attach to the request ring of every client in this I/O thread's share that created one, and close the sessions of clients that exited.
+    auto scanShmSessions() noexcept -> void {
+      for (auto client_id = static_cast<size_t>(index_); client_id < ME_MAX_NUM_CLIENTS; client_id += num_io_threads_) {
+        auto &session = cid_shm_session_[client_id];
+        if (session.requests_) {
+          if (UNLIKELY(!session.requests_->producerAlive())) {
+            closeShmSession(client_id, "client exited");
+          }
+          continue;
+        }
+
+        auto requests = new OMShmRequestQueue(omShmRequestsName(client_id));
+        if (!requests->valid() || !requests->producerAlive()) { // no client yet, or one that exited without removing its ring.
+          delete requests;
+          continue;
+        }
+        session.requests_ = requests;
+        session.responses_ = new OMShmResponseQueue(omShmResponsesName(client_id), OM_SHM_QUEUE_SIZE);
+        logger_->log("%:% %() % Accepted shared memory session ClientId:% pid:%\n", __FILE__, __LINE__, __FUNCTION__,
+                     Common::getCurrentTimeStr(&time_str_), client_id, requests->producerPid());
+      }
+    }
+
+    /// Read every request waiting on the shared memory sessions, returns true if there were any.
+    auto recvShmSessions() noexcept -> bool {
+      auto received = false;
+      for (auto client_id = static_cast<size_t>(index_); client_id < ME_MAX_NUM_CLIENTS; client_id += num_io_threads_) {
+        auto &session = cid_shm_session_[client_id];
+        if (!session.requests_ || !session.requests_->getNextToRead()) {
+          continue;
+        }
+
+        // Every request waiting on a session is sequenced by when the order server found it, as a TCP read is by the kernel receive time.
+        const auto rx_time = Common::getCurrentNanos();
+        for (auto shm_request = session.requests_->getNextToRead(); shm_request; shm_request = session.requests_->getNextToRead()) {
+          recvShmRequest(static_cast<ClientId>(client_id), *shm_request, rx_time);
+          session.requests_->updateReadIndex();
+        }
+        received = true;
+      }
+      return received;
+    }
+
+    /// Check a request read from client_id's shared memory session like one read from a TCP session, and forward it to the FIFO sequencer.
+    auto recvShmRequest(ClientId client_id, const OMShmRequest &shm_request, Nanos rx_time) noexcept -> void {
+      TTT_MEASURE(T1_OrderServer_TCP_read, (*logger_));
+      logger_->log("%:% %() % Received ClientId:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   client_id, shm_request.toString());
+
+      auto &session = cid_shm_session_[client_id];
+      if (UNLIKELY(shm_request.request_.client_id_ != client_id)) { // TODO - change this to send a reject back to the client.
+        logger_->log("%:% %() % Received ClientRequest from ClientId:% on the shared memory session of ClientId:%\n", __FILE__, __LINE__, __FUNCTION__,
+                     Common::getCurrentTimeStr(&time_str_), shm_request.request_.client_id_, client_id);
+        return;
+      }
+
+      if (UNLIKELY(!session.bound_)) { // first message from this ClientId, unless one of its TCP sessions is still open.
+        auto no_shard = OrderServerClients::NO_SHARD;
+        session.bound_ = clients_->shard_[client_id].compare_exchange_strong(no_shard, index_, std::memory_order_acq_rel);
+      }
+
+      if (!session.bound_) { // TODO - change this to send a reject back to the client.
+        logger_->log("%:% %() % Received ClientRequest from ClientId:% on shared memory while it has another session. shard:%\n", __FILE__, __LINE__, __FUNCTION__,
+                     Common::getCurrentTimeStr(&time_str_), client_id, clients_->shard_[client_id].load(std::memory_order_relaxed));
+        return;
+      }
+
+      auto &next_exp_seq_num = clients_->next_exp_seq_num_[client_id];
+      if (shm_request.seq_num_ != next_exp_seq_num) { // TODO - change this to send a reject back to the client.
+        logger_->log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
+                     Common::getCurrentTimeStr(&time_str_), client_id, next_exp_seq_num, shm_request.seq_num_);
+        return;
+      }
+
+      ++next_exp_seq_num;
+
+      START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+      addClientRequest(OM_SHM_SESSION_BASE + client_id, rx_time, shm_request.request_);
+      END_MEASURE(Exchange_FIFOSequencer_addClientRequest, (*logger_));
+    }
+
+    /// Write a response to client_id's shared memory session, applying the slow consumer policy if the client let its ring fill up.
+    auto sendShmResponse(ClientId client_id, const MEClientResponse &client_response) noexcept -> void {
+      auto &next_outgoing_seq_num = clients_->next_outgoing_seq_num_[client_id];
+      logger_->log("%:% %() % Processing cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   client_id, next_outgoing_seq_num, client_response.toString());
+
+      auto &responses = *cid_shm_session_[client_id].responses_;
+      auto next_write = responses.getNextToWriteTo();
+      if (UNLIKELY(!next_write)) {
+        if (tcp_server_.send_queue_cfg_.slow_consumer_policy_ == Common::SlowConsumerPolicy::DROP) {
+          logger_->log("%:% %() % Dropping response for slow ClientId:% seq:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       client_id, next_outgoing_seq_num);
+          ++next_outgoing_seq_num;
+        } else {
+          closeShmSession(client_id, "slow consumer");
+        }
+        return;
+      }
+      *next_write = OMShmResponse{next_outgoing_seq_num, client_response};
+      responses.updateWriteIndex();
+      TTT_MEASURE(T6t_OrderServer_TCP_write, (*logger_));
+
+      ++next_outgoing_seq_num;
+    }
+
+    /// Detach from a shared memory session, removing its response ring, and let the client start a session on any I/O thread again.
+    auto closeShmSession(size_t client_id, const char *reason) noexcept -> void {
+      auto &session = cid_shm_session_[client_id];
+      logger_->log("%:% %() % Closing shared memory session ClientId:% reason:%\n", __FILE__, __LINE__, __FUNCTION__,
+                   Common::getCurrentTimeStr(&time_str_), client_id, reason);
+      delete session.requests_;
+      session.requests_ = nullptr;
+      delete session.responses_;
+      session.responses_ = nullptr;
+      if (session.bound_) {
+        session.bound_ = false;
+        clients_->shard_[client_id].store(OrderServerClients::NO_SHARD, std::memory_order_release);
+      }
+    }
+
+    /// Log every session's histogram of the delay from the kernel receiving its requests to reading them.
+    auto logRxDelays() noexcept -> void {
+      for (const auto socket : tcp_server_.sessions_) {
+        if (socket->rx_delay_.count_) {
+          logger_->log("%:% %() % socket:% rx-delay:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       socket->socket_fd_, socket->rx_delay_.toString());
+        }
+      }
+    }
+
+    /// Read client request from the TCP receive buffer, check for sequence gaps and forward it to the FIFO sequencer.
+    auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept {
+      TTT_MEASURE(T1_OrderServer_TCP_read, (*logger_));
+      logger_->log("%:% %() % Received socket:% len:% rx:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                   socket->socket_fd_, socket->inbound_.size(), rx_time);
+
+      const auto data = socket->inbound_.readData();
+      size_t i = 0;
+      while (i + sizeof(OMFrameHeader) <= socket->inbound_.size()) {
+        const auto header = reinterpret_cast<const OMFrameHeader *>(data + i);
+        if (UNLIKELY(header->version_ != OM_VERSION || header->size_ < sizeof(OMFrameHeader) || header->size_ > OM_MAX_FRAME_SIZE ||
+                     header->client_id_ >= ME_MAX_NUM_CLIENTS)) {
+          logger_->log("%:% %() % ERROR Bad frame socket:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       socket->socket_fd_, header->toString());
+          socket->disconnect("bad frame");
+          return;
+        }
+        if (i + header->size_ > socket->inbound_.size()) {
+          break;
+        }
+        const auto frame_end = i + header->size_;
+        const auto client_id = header->client_id_;
+        logger_->log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), header->toString());
+
+        if (UNLIKELY(cid_tcp_socket_[client_id] == nullptr)) { // first message from this ClientId, unless another I/O thread serves it.
+          auto no_shard = OrderServerClients::NO_SHARD;
+          if (clients_->shard_[client_id].compare_exchange_strong(no_shard, index_, std::memory_order_acq_rel)) {
+            cid_tcp_socket_[client_id] = socket;
+          }
+        }
+
+        if (cid_tcp_socket_[client_id] != socket) { // TODO - change this to send a reject back to the client.
+          logger_->log("%:% %() % Received ClientRequest from ClientId:% on different socket:% expected:% shard:%\n", __FILE__, __LINE__, __FUNCTION__,
+                       Common::getCurrentTimeStr(&time_str_), client_id, socket->socket_fd_,
+                       cid_tcp_socket_[client_id] ? cid_tcp_socket_[client_id]->socket_fd_ : -1, clients_->shard_[client_id].load(std::memory_order_relaxed));
+          i = frame_end;
+          continue;
+        }
+
+        auto &next_exp_seq_num = clients_->next_exp_seq_num_[client_id];
+        if (header->seq_num_ != next_exp_seq_num) { // TODO - change this to send a reject back to the client.
+          logger_->log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
+                       Common::getCurrentTimeStr(&time_str_), client_id, next_exp_seq_num, header->seq_num_);
+          i = frame_end;
+          continue;
+        }
+
+        // A frame with a bad message is rejected whole, before any of its requests are sequenced.
+        if (UNLIKELY(!omDecodeFrame(data + i, frame_requests_.data()))) {
+          logger_->log("%:% %() % ERROR Bad message in frame socket:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       socket->socket_fd_, header->toString());
+          socket->disconnect("bad message");
+          return;
+        }
+
+        // Every request of a frame is sequenced by when the frame's first bytes were received, even if it started arriving in an earlier read.
+        const auto request_rx_time = socket->rxTime(i);
+        for (uint16_t m = 0; m < header->num_messages_; ++m) {
+          const auto &request = frame_requests_[m];
+          logger_->log("%:% %() % Received seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                       next_exp_seq_num, request.toString());
+
+          ++next_exp_seq_num;
+
+          START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+          addClientRequest(socket->socket_fd_, request_rx_time, request);
+          END_MEASURE(Exchange_FIFOSequencer_addClientRequest, (*logger_));
+        }
+        i = frame_end;
+      }
+      socket->inbound_.consume(i);
+    }
+
+    /// End of reading incoming messages across all the TCP connections, sequence and publish the client requests to the matching engine,
+    /// or hand them to the sequencer stage.
+    auto recvFinishedCallback() noexcept -> void {
+      if (fifo_sequencer_) {
+        START_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish);
+        fifo_sequencer_->sequenceAndPublish();
+        END_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish, (*logger_));
+      } else {
+        outgoing_requests_->commitWriteIndex();
+      }
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    OrderServerShard() = delete;
+
+    OrderServerShard(const OrderServerShard &) = delete;
+
+    OrderServerShard(const OrderServerShard &&) = delete;
+
+    OrderServerShard &operator=(const OrderServerShard &) = delete;
+
+    OrderServerShard &operator=(const OrderServerShard &&) = delete;
+
+  private:
+    /// Queue a request up in the FIFO sequencer, or for the sequencer stage to collect once recvFinishedCallback() publishes it.
+    auto addClientRequest(size_t session, Nanos rx_time, const MEClientRequest &request) noexcept -> void {
+      if (fifo_sequencer_) {
+        if (UNLIKELY(!fifo_sequencer_->addClientRequest(session, rx_time, request))) {
+          // Sequencer is full, publish what it holds now rather than waiting for the end of this poll.
+          logger_->log("%:% %() % FIFOSequencer full, publishing early.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
+          fifo_sequencer_->sequenceAndPublish();
+          fifo_sequencer_->addClientRequest(session, rx_time, request);
+        }
+        return;
+      }
+
+      auto next_write = outgoing_requests_->reserveNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // queue is full, hand over what was reserved and wait for the sequencer stage to catch up.
+        outgoing_requests_->commitWriteIndex();
+        std::this_thread::yield();
+        next_write = outgoing_requests_->reserveNextToWriteTo();
+      }
+      *next_write = SessionClientRequest{session, RecvTimeClientRequest{rx_time, request}};
+    }
+
+    const int index_;
+
+    /// State of every client, shared with the other I/O threads.
+    OrderServerClients *clients_ = nullptr;
+
+    /// Set for an order server with a single I/O thread, which sequences its own requests.
+    FIFOSequencer *fifo_sequencer_ = nullptr;
+
+    /// Otherwise requests go to the sequencer stage through this queue.
+    SessionClientRequestLFQueue *outgoing_requests_ = nullptr;
+
+    /// Lock free queue of outgoing client responses to be sent out to the clients connected to this I/O thread.
+    ClientResponseLFQueue *outgoing_responses_ = nullptr;
+
+    volatile bool run_ = false;
+
+    std::atomic<Nanos> watermark_ = {0};
+
+    /// How often every session's kernel to user receive delay histogram is logged.
+    static constexpr Nanos RX_DELAY_LOG_INTERVAL_NANOS = 10 * NANOS_TO_SECS;
+    Nanos next_rx_delay_log_time_ = 0;
+
+    std::string time_str_;
+    Logger *logger_ = nullptr;
+
+    /// The requests of the frame being read, decoded before any of them is sequenced.
+    std::array<MEClientRequest, OM_MAX_FRAME_MESSAGES> frame_requests_;
+
+    /// Hash map from ClientId -> TCP socket / client connection, for the clients served by this I/O thread.
+    std::array<Common::TCPSocket *, ME_MAX_NUM_CLIENTS> cid_tcp_socket_;
+
+    /// Hash map from ClientId -> the frame its responses are collected in and when the first one was added, and the clients with one open.
+    std::array<OMFrameWriter, ME_MAX_NUM_CLIENTS> cid_response_frame_;
+    std::array<Nanos, ME_MAX_NUM_CLIENTS> cid_response_frame_time_;
+    std::vector<ClientId> response_frame_clients_;
+    const Nanos response_flush_budget_nanos_;
+
+    /// TCP server instance listening for new client connections.
+    Common::TCPServer tcp_server_;
+
+    /// Shared memory sessions by ClientId, of the clients in this I/O thread's share when they are enabled.
+    struct ShmSession {
+      OMShmRequestQueue *requests_ = nullptr;
+      OMShmResponseQueue *responses_ = nullptr;
+
+      /// Set once the client's first request bound it to this session.
+      bool bound_ = false;
+    };
+    std::array<ShmSession, ME_MAX_NUM_CLIENTS> cid_shm_session_;
+    const bool shm_sessions_;
+    const size_t num_io_threads_;
+    Nanos next_shm_scan_time_ = 0;
+  };
+}
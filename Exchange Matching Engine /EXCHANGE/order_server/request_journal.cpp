@@ -0,0 +1,154 @@
+#include "request_journal.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Exchange {
+  RequestJournalReader::RequestJournalReader(const std::string &path, bool live)
+      : path_(path), live_(live) {
+    fd_ = open(path_.c_str(), O_RDONLY);
+    ASSERT(fd_ >= 0, "Could not open journal:" + path_ + " error:" + std::string(std::strerror(errno)));
+
+    struct stat file_stat;
+    ASSERT(fstat(fd_, &file_stat) == 0, "fstat() failed on journal:" + path_ + " error:" + std::string(std::strerror(errno)));
+    file_bytes_ = file_stat.st_size;
+    ASSERT(file_bytes_ >= sizeof(JournalFileHeader), "Journal:" + path_ + " is too short for a header.");
+
+    map_ = static_cast<const char *>(mmap(nullptr, file_bytes_, PROT_READ, MAP_SHARED | MAP_POPULATE, fd_, 0));
+    ASSERT(map_ != MAP_FAILED, "mmap() failed on journal:" + path_ + " error:" + std::string(std::strerror(errno)));
+    madvise(const_cast<char *>(map_), file_bytes_, MADV_SEQUENTIAL);
+
+    ASSERT(header()->magic_ == JOURNAL_MAGIC && header()->version_ == JOURNAL_VERSION && header()->record_size_ == sizeof(JournalRecord),
+           "Journal:" + path_ + " has an unknown header.");
+  }
+
+  RequestJournalReader::~RequestJournalReader() {
+    munmap(const_cast<char *>(map_), file_bytes_);
+    close(fd_);
+  }
+
+  RequestJournal::RequestJournal(const JournalCfg &cfg)
+      : cfg_(cfg), records_(ME_MAX_JOURNAL_RECORDS), logger_("exchange_request_journal.log") {
+    fd_ = open(cfg_.path_.c_str(), O_RDWR | O_CREAT, 0644);
+    ASSERT(fd_ >= 0, "Could not open journal:" + cfg_.path_ + " error:" + std::string(std::strerror(errno)));
+
+    struct stat file_stat;
+    ASSERT(fstat(fd_, &file_stat) == 0, "fstat() failed on journal:" + cfg_.path_ + " error:" + std::string(std::strerror(errno)));
+    file_bytes_ = file_stat.st_size;
+    ASSERT(file_bytes_ <= cfg_.max_bytes_, "Journal:" + cfg_.path_ + " is larger than max-bytes:" + std::to_string(cfg_.max_bytes_));
+
+    // Reserve the address space for the largest journal once so records never move and never straddle two mappings.
+    map_ = static_cast<char *>(mmap(nullptr, cfg_.max_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+    ASSERT(map_ != MAP_FAILED, "mmap() failed on journal:" + cfg_.path_ + " error:" + std::string(std::strerror(errno)));
+
+    if (!file_bytes_) {
+      ASSERT(ftruncate(fd_, cfg_.grow_bytes_) == 0, "ftruncate() failed on journal:" + cfg_.path_ + " error:" + std::string(std::strerror(errno)));
+      file_bytes_ = cfg_.grow_bytes_;
+
+      new(map_) JournalFileHeader;
+      header()->record_size_ = sizeof(JournalRecord);
+      write_offset_ = sizeof(JournalFileHeader);
+    } else {
+      // The file is grown ahead of the records, so after a crash it ends in zeroes or a torn record - stop at the first record out of sequence.
+      ASSERT(file_bytes_ >= sizeof(JournalFileHeader), "Journal:" + cfg_.path_ + " is too short for a header.");
+      ASSERT(header()->magic_ == JOURNAL_MAGIC && header()->version_ == JOURNAL_VERSION && header()->record_size_ == sizeof(JournalRecord),
+             "Journal:" + cfg_.path_ + " has an unknown header.");
+
+      write_offset_ = sizeof(JournalFileHeader);
+      while (write_offset_ + sizeof(JournalRecord) <= file_bytes_ &&
+             reinterpret_cast<const JournalRecord *>(map_ + write_offset_)->seq_num_ == last_seq_num_ + 1) {
+        ++last_seq_num_;
+        write_offset_ += sizeof(JournalRecord);
+      }
+    }
+    header()->committed_bytes_.store(write_offset_, std::memory_order_release);
+    synced_offset_ = write_offset_;
+    written_seq_num_ = last_seq_num_;
+    synced_seq_num_.store(last_seq_num_, std::memory_order_release);
+
+    logger_.log("%:% %() % Opened % last-seq:% offset:% file-bytes:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                cfg_.toString(), last_seq_num_, write_offset_, file_bytes_);
+  }
+
+  RequestJournal::~RequestJournal() {
+    stop();
+    if (writer_thread_) {
+      writer_thread_->join();
+      delete writer_thread_;
+      writer_thread_ = nullptr;
+    }
+
+    // Nothing else is appending at this point, write out whatever the writer thread did not get to.
+    writeQueuedRecords();
+    commit();
+
+    logger_.log("%:% %() % Closing last-offset:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                write_offset_, commitStats());
+
+    munmap(map_, cfg_.max_bytes_);
+    map_ = nullptr;
+    if (ftruncate(fd_, write_offset_) != 0) {
+      logger_.log("%:% %() % ftruncate() failed error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  std::strerror(errno));
+    }
+    close(fd_);
+    fd_ = -1;
+  }
+
+  /// Start and stop the journal writer thread.
+  auto RequestJournal::start() -> void {
+    run_ = true;
+    writer_thread_ = Common::createAndStartThread(-1, "Exchange/RequestJournal", [this]() { run(); });
+    ASSERT(writer_thread_ != nullptr, "Failed to start RequestJournal thread.");
+  }
+
+  auto RequestJournal::stop() -> void {
+    run_ = false;
+  }
+
+  auto RequestJournal::writeRecord(const JournalRecord &record) noexcept -> void {
+    if (UNLIKELY(write_offset_ + sizeof(JournalRecord) > file_bytes_)) {
+      const auto new_file_bytes = std::min(file_bytes_ + cfg_.grow_bytes_, cfg_.max_bytes_);
+      ASSERT(write_offset_ + sizeof(JournalRecord) <= new_file_bytes, "Journal:" + cfg_.path_ + " is full at max-bytes:" + std::to_string(cfg_.max_bytes_));
+      ASSERT(ftruncate(fd_, new_file_bytes) == 0, "ftruncate() failed on journal:" + cfg_.path_ + " error:" + std::string(std::strerror(errno)));
+      file_bytes_ = new_file_bytes;
+    }
+
+    memcpy(map_ + write_offset_, &record, sizeof(JournalRecord));
+    write_offset_ += sizeof(JournalRecord);
+    header()->committed_bytes_.store(write_offset_, std::memory_order_release);
+    written_seq_num_ = record.seq_num_;
+    ++num_records_;
+
+    if (!unsynced_records_++) {
+      first_unsynced_time_ = Common::getCurrentNanos();
+    }
+  }
+
+  auto RequestJournal::commit() noexcept -> void {
+    if (synced_offset_ == write_offset_) {
+      return;
+    }
+
+    // msync() wants a page aligned start address.
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+    const auto sync_start = synced_offset_ & ~(page_size - 1);
+
+    const auto start = Common::getCurrentNanos();
+    if (UNLIKELY(msync(map_ + sync_start, write_offset_ - sync_start, MS_SYNC) != 0)) {
+      logger_.log("%:% %() % msync() failed error:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  std::strerror(errno));
+      return;
+    }
+    commit_latency_.record_latency(Common::getCurrentNanos() - start);
+
+    synced_offset_ = write_offset_;
+    unsynced_records_ = 0;
+    synced_seq_num_.store(written_seq_num_, std::memory_order_release);
+
+    if (!(++num_commits_ % 4096)) {
+      logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), commitStats());
+    }
+  }
+}
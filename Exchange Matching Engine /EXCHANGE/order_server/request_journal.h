@@ -0,0 +1,319 @@
+#pragma once
+
+#include <sstream>
+
+#include "thread_utils.h"
+#include "lf_queue.h"
+#include "macros.h"
+#include "logging.h"
+#include "latency_tracker.h"
+#include "shm_queue.h"
+
+#include "order_server/client_request.h"
+
+namespace Exchange {
+  /// Capacity of the ring between the FIFO sequencer and the journal writer thread.
+  /// Must be power of 2 for efficient modulo operations in lock-free queues
+  constexpr size_t ME_MAX_JOURNAL_RECORDS = 262144; // 2^18 = 256K (power of 2)
+
+  /// Identifies a request journal file and the layout of the records in it.
+  constexpr uint64_t JOURNAL_MAGIC = 0x4c4e524a51455245; // "EREQJRNL"
+  constexpr uint32_t JOURNAL_VERSION = 2;
+
+  /// When the journal writer forces written records to stable storage.
+  enum class JournalSyncPolicy : uint8_t {
+    NONE = 0,         // leave write back to the kernel, records are only forced out when the journal is closed.
+    EVERY_RECORD = 1, // msync after every record.
+    GROUP_COMMIT = 2  // msync once group_commit_records_ records are pending or the oldest pending record is group_commit_nanos_ old.
+  };
+
+  inline std::string journalSyncPolicyToString(JournalSyncPolicy policy) {
+    switch (policy) {
+      case JournalSyncPolicy::NONE:
+        return "NONE";
+      case JournalSyncPolicy::EVERY_RECORD:
+        return "EVERY_RECORD";
+      case JournalSyncPolicy::GROUP_COMMIT:
+        return "GROUP_COMMIT";
+    }
+    return "UNKNOWN";
+  }
+
+  /// Written once at the start of the journal file. Laid out without padding on its own, and not packed so committed_bytes_ stays
+  /// aligned for atomic access from every process mapping the file.
+  struct JournalFileHeader {
+    uint64_t magic_ = JOURNAL_MAGIC;
+    uint32_t version_ = JOURNAL_VERSION;
+    uint32_t record_size_ = 0;
+
+    /// Bytes at the start of the file that hold the header and complete records, published after every record so a reader following
+    /// a live journal from another process never reads one the writer is still copying in. Not forced to disk with the records, so
+    /// after a crash the end of the journal is still found by scanning for the first record out of sequence.
+    std::atomic<uint64_t> committed_bytes_ = {0};
+  };
+
+  static_assert(sizeof(JournalFileHeader) == 24, "JournalFileHeader layout changed.");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "JournalFileHeader::committed_bytes_ is shared between processes.");
+
+  /// These structures are written to disk as is, so the binary structures are packed to remove system dependent extra padding.
+#pragma pack(push, 1)
+
+  /// A client request as sequenced by the FIFO sequencer.
+  /// Sequence numbers start at 1 and increase by 1 with every record, the journal ends at the first record that breaks the sequence.
+  struct JournalRecord {
+    size_t seq_num_ = 0;
+    Nanos recv_time_ = 0;
+    MEClientRequest request_;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "JournalRecord"
+         << " ["
+         << "seq:" << seq_num_
+         << " rx:" << recv_time_
+         << " " << request_.toString()
+         << "]";
+      return ss.str();
+    }
+  };
+
+#pragma pack(pop) // Undo the packed binary structure directive moving forward.
+
+  /// Lock free queue of sequenced client requests waiting to be journaled.
+  typedef LFQueue<JournalRecord> JournalRecordLFQueue;
+
+  /// Shared memory ring the FIFO sequencer replicates sequenced client requests to, for a standby exchange on the same box.
+  /// Sized like the journal ring, so a standby can always complete the journal from the records it has applied.
+  constexpr size_t ME_MAX_REPLICATION_RECORDS = ME_MAX_JOURNAL_RECORDS;
+  typedef ShmQueue<JournalRecord> JournalRecordShmQueue;
+
+  struct JournalCfg {
+    std::string path_ = "exchange_requests.journal";
+
+    JournalSyncPolicy sync_policy_ = JournalSyncPolicy::GROUP_COMMIT;
+
+    /// Group commit thresholds, see JournalSyncPolicy::GROUP_COMMIT.
+    size_t group_commit_records_ = 256;
+    Nanos group_commit_nanos_ = NANOS_TO_MILLIS;
+
+    /// The file is extended by this many bytes at a time, and mapped once for up to max_bytes_.
+    size_t grow_bytes_ = 64 * 1024 * 1024;
+    size_t max_bytes_ = 16ul * 1024 * 1024 * 1024;
+
+    auto toString() const {
+      std::stringstream ss;
+      ss << "JournalCfg{"
+         << "path:" << path_ << " "
+         << "sync:" << journalSyncPolicyToString(sync_policy_) << " "
+         << "group-records:" << group_commit_records_ << " "
+         << "group-nanos:" << group_commit_nanos_ << " "
+         << "grow-bytes:" << grow_bytes_ << " "
+         << "max-bytes:" << max_bytes_
+         << "}";
+
+      return ss.str();
+    }
+  };
+
+  /// Read only view of a request journal, returns records in sequence until the end of the file or the first record out of sequence.
+  /// A live reader follows a journal another process is still appending to, and also stops at the end of the records it has committed.
+  class RequestJournalReader final {
+  public:
+    explicit RequestJournalReader(const std::string &path, bool live = false);
+
+    ~RequestJournalReader();
+
+    auto next() noexcept -> const JournalRecord * {
+      const auto end_bytes = live_ ? std::min<size_t>(file_bytes_, header()->committed_bytes_.load(std::memory_order_acquire)) : file_bytes_;
+      if (offset_ + sizeof(JournalRecord) > end_bytes) {
+        return nullptr;
+      }
+
+      const auto record = reinterpret_cast<const JournalRecord *>(map_ + offset_);
+      if (record->seq_num_ != last_seq_num_ + 1) {
+        return nullptr;
+      }
+
+      offset_ += sizeof(JournalRecord);
+      ++last_seq_num_;
+      return record;
+    }
+
+    /// Position the reader so next() returns the record with sequence number seq_num, records are fixed size so this is O(1).
+    auto seek(size_t seq_num) noexcept {
+      offset_ = sizeof(JournalFileHeader) + (seq_num - 1) * sizeof(JournalRecord);
+      last_seq_num_ = seq_num - 1;
+    }
+
+    /// Sequence number of the last record returned by next().
+    auto lastSeqNum() const noexcept {
+      return last_seq_num_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    RequestJournalReader() = delete;
+
+    RequestJournalReader(const RequestJournalReader &) = delete;
+
+    RequestJournalReader(const RequestJournalReader &&) = delete;
+
+    RequestJournalReader &operator=(const RequestJournalReader &) = delete;
+
+    RequestJournalReader &operator=(const RequestJournalReader &&) = delete;
+
+  private:
+    const std::string path_;
+    const bool live_;
+
+    int fd_ = -1;
+    const char *map_ = nullptr;
+    size_t file_bytes_ = 0;
+
+    size_t offset_ = sizeof(JournalFileHeader);
+    size_t last_seq_num_ = 0;
+
+  private:
+    auto header() const noexcept -> const JournalFileHeader * {
+      return reinterpret_cast<const JournalFileHeader *>(map_);
+    }
+  };
+
+  /// Append only, memory mapped journal of every client request in the order in which it was sequenced.
+  /// The FIFO sequencer hands records over through a lock free queue and a dedicated thread copies them into the mapping
+  /// and forces them to disk according to the sync policy, so no I/O ever happens on the order server or matching engine threads.
+  class RequestJournal final {
+  public:
+    /// Opens the journal at cfg.path_, creating it if needed. An existing journal is appended to after its last valid record.
+    explicit RequestJournal(const JournalCfg &cfg);
+
+    /// Writes out every queued record, forces the journal to disk and trims the file to the records written.
+    ~RequestJournal();
+
+    /// Start and stop the journal writer thread.
+    auto start() -> void;
+
+    auto stop() -> void;
+
+    /// Sequence number of the last record appended, or in the journal when it was opened, 0 for a new journal.
+    auto lastSeqNum() const noexcept {
+      return last_seq_num_;
+    }
+
+    /// Sequence number of the last record as durable as the sync policy makes it - forced to disk, or only written into the mapping
+    /// with JournalSyncPolicy::NONE. Safe to call from any thread.
+    auto syncedSeqNum() const noexcept {
+      return synced_seq_num_.load(std::memory_order_acquire);
+    }
+
+    /// Called by the FIFO sequencer for every request it publishes, only waits if the writer has fallen a full ring behind.
+    auto append(size_t seq_num, Nanos recv_time, const MEClientRequest &request) noexcept {
+      auto next_write = records_.getNextToWriteTo();
+      while (UNLIKELY(!next_write)) { // ring is full, wait for the writer thread to catch up.
+        std::this_thread::yield();
+        next_write = records_.getNextToWriteTo();
+      }
+      next_write->seq_num_ = seq_num;
+      next_write->recv_time_ = recv_time;
+      next_write->request_ = request;
+      records_.updateWriteIndex();
+      last_seq_num_ = seq_num;
+    }
+
+    /// Main loop for this thread - copies queued records into the journal and commits them as the sync policy requires.
+    auto run() noexcept {
+      logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), cfg_.toString());
+      while (run_) {
+        if (!writeQueuedRecords()) {
+          std::this_thread::yield();
+        }
+
+        if (cfg_.sync_policy_ == JournalSyncPolicy::GROUP_COMMIT && unsynced_records_ &&
+            Common::getCurrentNanos() - first_unsynced_time_ >= cfg_.group_commit_nanos_) {
+          commit();
+        }
+      }
+    }
+
+    /// Per commit latency statistics.
+    auto commitStats() const {
+      return "JournalCommits{commits:" + std::to_string(num_commits_) + " records:" + std::to_string(num_records_) + " " +
+             commit_latency_.get_stats_string() + "}";
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    RequestJournal() = delete;
+
+    RequestJournal(const RequestJournal &) = delete;
+
+    RequestJournal(const RequestJournal &&) = delete;
+
+    RequestJournal &operator=(const RequestJournal &) = delete;
+
+    RequestJournal &operator=(const RequestJournal &&) = delete;
+
+  private:
+    const JournalCfg cfg_;
+
+    /// Lock free queue of records handed over by the FIFO sequencer.
+    JournalRecordLFQueue records_;
+
+    int fd_ = -1;
+
+    /// Mapping of the first cfg_.max_bytes_ of the file, of which file_bytes_ exist on disk.
+    char *map_ = nullptr;
+    size_t file_bytes_ = 0;
+
+    /// Offset of the next record, and of the first byte not yet forced to disk.
+    size_t write_offset_ = 0;
+    size_t synced_offset_ = 0;
+
+    size_t last_seq_num_ = 0;
+
+    /// Sequence number of the last record written into the mapping by the writer thread, and of the last one synced, see syncedSeqNum().
+    size_t written_seq_num_ = 0;
+    std::atomic<size_t> synced_seq_num_ = {0};
+
+    /// Records written since the last commit and the time the oldest of them was written.
+    size_t unsynced_records_ = 0;
+    Nanos first_unsynced_time_ = 0;
+
+    size_t num_records_ = 0;
+    size_t num_commits_ = 0;
+    LatencyTracker commit_latency_;
+
+    volatile bool run_ = false;
+    std::thread *writer_thread_ = nullptr;
+
+    std::string time_str_;
+    Logger logger_;
+
+  private:
+    /// Copy every queued record into the journal, returns the number of records written.
+    auto writeQueuedRecords() noexcept -> size_t {
+      size_t num_written = 0;
+      for (auto record = records_.getNextToRead(); record; record = records_.getNextToRead()) {
+        writeRecord(*record);
+        records_.updateReadIndex();
+        ++num_written;
+
+        if (cfg_.sync_policy_ == JournalSyncPolicy::EVERY_RECORD ||
+            (cfg_.sync_policy_ == JournalSyncPolicy::GROUP_COMMIT && unsynced_records_ >= cfg_.group_commit_records_)) {
+          commit();
+        }
+      }
+      if (cfg_.sync_policy_ == JournalSyncPolicy::NONE && num_written) {
+        synced_seq_num_.store(written_seq_num_, std::memory_order_release);
+      }
+      return num_written;
+    }
+
+    auto header() noexcept -> JournalFileHeader * {
+      return reinterpret_cast<JournalFileHeader *>(map_);
+    }
+
+    auto writeRecord(const JournalRecord &record) noexcept -> void;
+
+    /// Force everything written since the last commit to disk.
+    auto commit() noexcept -> void;
+  };
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include "macros.h"
+#include "time_utils.h"
+
+#include "order_server/client_request.h"
+
+namespace Exchange {
+  /// A client request and the time it was received at.
+  struct RecvTimeClientRequest {
+    Nanos recv_time_ = 0;
+    MEClientRequest request_;
+  };
+
+  /// Pending client requests kept as one run per session in the order the session delivered them,
+  /// and handed out across sessions in ascending receive time order with a k-way heap merge.
+  /// Each session's requests arrive in receive time order already, so this costs O(log k) per request for k sessions with pending requests,
+  /// instead of sorting every request on every poll. Requests with equal receive times go out in session order.
+  class SessionRunMerger final {
+  public:
+    /// At most max_pending requests are held across all sessions. Sessions are small dense integers - socket fds -
+    /// and the runs grow as needed, keeping their capacity between merges so the steady state does not allocate.
+    explicit SessionRunMerger(size_t max_pending)
+        : max_pending_(max_pending) {
+    }
+
+    auto size() const noexcept {
+      return pending_size_;
+    }
+
+    auto full() const noexcept {
+      return pending_size_ >= max_pending_;
+    }
+
+    /// Queue up a request at the end of its session's run, returns false without queueing it if max_pending requests are already held.
+    auto add(size_t session, Nanos recv_time, const MEClientRequest &request) noexcept {
+      if (UNLIKELY(full())) {
+        return false;
+      }
+
+      if (UNLIKELY(session >= runs_.size())) {
+        runs_.resize(session + 1);
+      }
+      auto &run = runs_[session];
+      if (run.empty()) {
+        active_sessions_.push_back(session);
+      }
+      run.push_back(RecvTimeClientRequest{recv_time, request});
+      ++pending_size_;
+
+      return true;
+    }
+
+    /// Call visit on every pending request received before the time limit in receive time order, and drop them from their runs.
+    /// Requests received at or after it stay pending, to be merged with requests other producers have not handed over yet.
+    /// Returns the number of requests visited.
+    template<typename F>
+    auto merge(F &&visit, Nanos before = std::numeric_limits<Nanos>::max()) noexcept {
+      const auto pending_before = pending_size_;
+      if (active_sessions_.size() == 1) { // a single session is in order already.
+        auto &run = runs_[active_sessions_.front()];
+        size_t index = 0;
+        for (; index < run.size() && run[index].recv_time_ < before; ++index) {
+          visit(run[index]);
+        }
+        pending_size_ -= index;
+        consume(active_sessions_.front(), index);
+      } else if (!active_sessions_.empty()) {
+        // Min-heap of the head of every run, ordered by receive time and then session.
+        heap_.clear();
+        for (const auto session : active_sessions_) {
+          heap_.push_back({runs_[session].front().recv_time_, session, 0});
+        }
+        std::make_heap(heap_.begin(), heap_.end(), std::greater<>());
+
+        while (!heap_.empty() && heap_.front().recv_time_ < before) {
+          std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+          auto head = heap_.back();
+          heap_.pop_back();
+          auto &run = runs_[head.session_];
+
+          // Keep taking from this run while it stays ahead of every other run, a burst read in one go shares a receive time
+          // and so costs a single heap operation.
+          do {
+            visit(run[head.index_]);
+            --pending_size_;
+            if (++head.index_ == run.size()) {
+              break;
+            }
+            head.recv_time_ = run[head.index_].recv_time_;
+          } while (head.recv_time_ < before && (heap_.empty() || !(head > heap_.front())));
+
+          if (head.index_ < run.size()) {
+            heap_.push_back(head);
+            std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+          } else {
+            run.clear();
+          }
+        }
+
+        // Runs left with requests at or after the limit give up the ones that were merged.
+        for (const auto &head : heap_) {
+          consume(head.session_, head.index_);
+        }
+      }
+
+      size_t still_active = 0;
+      for (const auto session : active_sessions_) {
+        if (!runs_[session].empty()) {
+          active_sessions_[still_active++] = session;
+        }
+      }
+      active_sessions_.resize(still_active);
+
+      return pending_before - pending_size_;
+    }
+
+    /// Deleted default, copy & move constructors and assignment-operators.
+    SessionRunMerger() = delete;
+
+    SessionRunMerger(const SessionRunMerger &) = delete;
+
+    SessionRunMerger(const SessionRunMerger &&) = delete;
+
+    SessionRunMerger &operator=(const SessionRunMerger &) = delete;
+
+    SessionRunMerger &operator=(const SessionRunMerger &&) = delete;
+
+  private:
+    const size_t max_pending_;
+
+    /// Pending requests of each session in arrival order, indexed by session.
+    std::vector<std::vector<RecvTimeClientRequest>> runs_;
+
+    /// Sessions with a non-empty run.
+    std::vector<size_t> active_sessions_;
+
+    size_t pending_size_ = 0;
+
+    /// Drop the first count requests of a session's run, once they were merged.
+    auto consume(size_t session, size_t count) noexcept -> void {
+      auto &run = runs_[session];
+      if (count == run.size()) {
+        run.clear();
+      } else {
+        run.erase(run.begin(), run.begin() + count);
+      }
+    }
+
+    /// Next request of a run during a merge.
+    struct RunHead {
+      Nanos recv_time_ = 0;
+      size_t session_ = 0;
+      size_t index_ = 0;
+
+      auto operator>(const RunHead &rhs) const noexcept {
+        return recv_time_ > rhs.recv_time_ || (recv_time_ == rhs.recv_time_ && session_ > rhs.session_);
+      }
+    };
+    std::vector<RunHead> heap_;
+  };
+}
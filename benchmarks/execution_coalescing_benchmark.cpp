@@ -0,0 +1,105 @@
+#include "matcher/matching_engine.h"
+#include "order_server/om_wire_format.h"
+
+/// Sweeps an aggressive order through a book of resting orders and reports how many client responses and market updates
+/// the matching engine produces per sweep under each MatchingEngineCfg execution reporting mode.
+
+using namespace Exchange;
+
+/// Shape of the book swept on every round.
+constexpr size_t NUM_LEVELS = 4;
+constexpr size_t ORDERS_PER_LEVEL = 5;
+constexpr size_t NUM_ROUNDS = 100;
+
+constexpr TickerId TICKER = 0;
+constexpr ClientId AGGRESSOR_CLIENT = 0;
+constexpr Price BASE_PRICE = 100;
+constexpr Qty PASSIVE_QTY = 10;
+
+struct SweepResult {
+  size_t responses_ = 0;
+  size_t updates_ = 0;
+  Nanos sweep_nanos_ = 0;
+};
+
+/// Discard everything the matching engine published so far.
+template<typename T>
+auto drain(Common::LFQueue<T> *queue) {
+  size_t n = 0;
+  while (queue->size()) {
+    queue->updateReadIndex();
+    ++n;
+  }
+  return n;
+}
+
+auto runMode(const std::string &name, const MatchingEngineCfg &cfg) {
+  ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+
+  // The matching engine thread is not started, requests are fed directly so only the sweep itself is timed.
+  auto matching_engine = new MatchingEngine(cfg, &client_requests, &client_responses, &market_updates);
+
+  SweepResult result;
+  OrderId next_order_id = 1;
+  for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+    for (size_t level = 0; level < NUM_LEVELS; ++level) {
+      for (size_t i = 0; i < ORDERS_PER_LEVEL; ++i) {
+        const MEClientRequest passive{ClientRequestType::NEW, static_cast<ClientId>(1 + level * ORDERS_PER_LEVEL + i), TICKER,
+                                      next_order_id++, Side::SELL, static_cast<Price>(BASE_PRICE + level), PASSIVE_QTY};
+        matching_engine->processClientRequest(&passive);
+      }
+    }
+    matching_engine->commitOutputs();
+    drain(&client_responses);
+    drain(&market_updates);
+
+    const MEClientRequest aggressor{ClientRequestType::NEW, AGGRESSOR_CLIENT, TICKER, next_order_id++, Side::BUY,
+                                    static_cast<Price>(BASE_PRICE + NUM_LEVELS), static_cast<Qty>(NUM_LEVELS * ORDERS_PER_LEVEL * PASSIVE_QTY)};
+    const auto start = Common::getCurrentNanos();
+    matching_engine->processClientRequest(&aggressor);
+    matching_engine->commitOutputs();
+    result.sweep_nanos_ += Common::getCurrentNanos() - start;
+
+    result.responses_ += drain(&client_responses);
+    result.updates_ += drain(&market_updates);
+  }
+
+  delete matching_engine;
+
+  const auto responses = static_cast<double>(result.responses_) / NUM_ROUNDS;
+  const auto updates = static_cast<double>(result.updates_) / NUM_ROUNDS;
+  std::cout << name
+            << " responses/sweep:" << responses
+            << " updates/sweep:" << updates
+            << " messages/sweep:" << (responses + updates)
+            << " wire-bytes/sweep:" << (responses * sizeof(OMOrderResponseMessage) + updates * sizeof(MDPMarketUpdate))
+            << " ns/sweep:" << (result.sweep_nanos_ / NUM_ROUNDS)
+            << std::endl;
+
+  return responses + updates;
+}
+
+int main(int, char **) {
+  std::cout << "Sweeping " << NUM_LEVELS * ORDERS_PER_LEVEL << " resting orders across " << NUM_LEVELS << " price levels, "
+            << NUM_ROUNDS << " rounds." << std::endl;
+
+  MatchingEngineCfg legacy_cfg;
+
+  MatchingEngineCfg coalesced_cfg;
+  coalesced_cfg.coalesce_executions_ = true;
+
+  MatchingEngineCfg aggregated_cfg;
+  aggregated_cfg.coalesce_executions_ = true;
+  aggregated_cfg.aggregate_aggressor_fills_ = true;
+
+  const auto legacy = runMode("TRADE+CANCEL/MODIFY     ", legacy_cfg);
+  const auto coalesced = runMode("EXECUTION               ", coalesced_cfg);
+  const auto aggregated = runMode("EXECUTION+LEVEL-FILLS   ", aggregated_cfg);
+
+  std::cout << "Message reduction vs legacy: EXECUTION " << 100.0 * (1.0 - coalesced / legacy) << "%"
+            << " EXECUTION+LEVEL-FILLS " << 100.0 * (1.0 - aggregated / legacy) << "%" << std::endl;
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <random>
+
+#include "time_utils.h"
+#include "logging.h"
+
+#include "market_data/price_level_publisher.h"
+
+/// Compares how many messages a consumer of the price level feeds processes against one of the order by order stream, over a synthetic
+/// stream of adds, cancels, modifies and executions around a fixed mid on every ticker, paced at one update per microsecond.
+/// Reports the updates published on the market by price feed for increasing depths and on the best bid and offer feed for increasing
+/// conflation intervals, and the nanoseconds per update the PriceLevelPublisher adds to the market data publisher's thread: keeping the
+/// price levels and encoding the changes, and publishing the datagrams.
+/// Usage: md_price_level_benchmark [NUM_UPDATES]
+
+using namespace Exchange;
+
+constexpr size_t DEFAULT_UPDATES = 1000 * 1000;
+constexpr Nanos NANOS_PER_UPDATE = 1000;
+const std::string MCAST_IP = "233.252.14.9";
+constexpr int MCAST_PORT = 20104;
+
+/// A consistent order by order stream: orders rest on their side of the mid, and every cancel, modify and execution is of a live order.
+auto generate(size_t num_updates) {
+  std::mt19937_64 rng(42);
+  std::vector<MEMarketUpdate> updates;
+  updates.reserve(num_updates);
+  std::vector<MEMarketUpdate> live_orders;
+  OrderId next_order_id = 0;
+
+  while (updates.size() < num_updates) {
+    const auto pick = rng() % 100;
+    if (pick < 45 || live_orders.empty()) {
+      MEMarketUpdate order{MarketUpdateType::ADD, next_order_id++, static_cast<TickerId>(rng() % ME_MAX_TICKERS), (rng() % 2) ? Side::BUY : Side::SELL,
+                           0, static_cast<Qty>(1 + rng() % 500), static_cast<Priority>(next_order_id)};
+      // Most orders close to the touch, a few further out.
+      const auto distance = static_cast<Price>(1 + ((rng() % 4) ? rng() % 8 : rng() % 64));
+      order.price_ = 10000 + static_cast<Price>(order.ticker_id_) * 1000 + (order.side_ == Side::BUY ? -distance : distance);
+      updates.push_back(order);
+      live_orders.push_back(order);
+      continue;
+    }
+
+    const auto index = rng() % live_orders.size();
+    auto &order = live_orders[index];
+    if (pick < 80 || (pick < 88 && order.qty_ == 1)) {
+      updates.push_back(MEMarketUpdate{MarketUpdateType::CANCEL, order.order_id_, order.ticker_id_, order.side_, order.price_, 0, order.priority_});
+      order = live_orders.back();
+      live_orders.pop_back();
+    } else if (pick < 88) {
+      order.qty_ = static_cast<Qty>(1 + rng() % (order.qty_ - 1));
+      updates.push_back(MEMarketUpdate{MarketUpdateType::MODIFY, order.order_id_, order.ticker_id_, order.side_, order.price_, order.qty_,
+                                       order.priority_});
+    } else {
+      const auto fill_qty = std::min<Qty>(order.qty_, static_cast<Qty>(1 + rng() % 200));
+      order.qty_ -= fill_qty;
+      updates.push_back(MEMarketUpdate{MarketUpdateType::EXECUTION, order.order_id_, order.ticker_id_,
+                                       order.side_ == Side::BUY ? Side::SELL : Side::BUY, order.price_, fill_qty, order.qty_});
+      if (!order.qty_) {
+        order = live_orders.back();
+        live_orders.pop_back();
+      }
+    }
+  }
+
+  return updates;
+}
+
+/// Feed the updates at the paced rate, returns the nanoseconds per update spent applying them and publishing the datagrams.
+auto run(PriceLevelPublisher &publisher, const std::vector<MEMarketUpdate> &updates) {
+  Nanos apply = 0, flush = 0;
+  const auto start = Common::getCurrentNanos();
+  for (size_t i = 0; i < updates.size(); ++i) {
+    while (Common::getCurrentNanos() < start + static_cast<Nanos>(i) * NANOS_PER_UPDATE);
+
+    const auto apply_start = Common::getCurrentNanos();
+    publisher.onMarketUpdate(updates[i]);
+    const auto flush_start = Common::getCurrentNanos();
+    publisher.flushIfDue();
+    apply += flush_start - apply_start;
+    flush += Common::getCurrentNanos() - flush_start;
+  }
+  return std::make_pair(apply / static_cast<Nanos>(updates.size()), flush / static_cast<Nanos>(updates.size()));
+}
+
+int main(int argc, char **argv) {
+  const size_t num_updates = (argc > 1) ? std::stoul(argv[1]) : DEFAULT_UPDATES;
+  const auto updates = generate(num_updates);
+  Logger logger("md_price_level_benchmark.log");
+
+  for (const size_t depth : {1, 5, 10}) {
+    MarketDataCfg cfg;
+    cfg.price_level_depth_ = depth;
+    PriceLevelPublisher publisher(logger, "lo", MCAST_IP, MCAST_PORT, cfg);
+    const auto [apply_nanos, flush_nanos] = run(publisher, updates);
+    std::cout << "mbo-updates:" << updates.size()
+              << " l2-depth:" << depth
+              << " l2-updates:" << publisher.numPriceLevelUpdates()
+              << " reduction:" << static_cast<double>(updates.size()) / static_cast<double>(std::max<size_t>(publisher.numPriceLevelUpdates(), 1))
+              << " apply-ns-per-update:" << apply_nanos
+              << " flush-ns-per-update:" << flush_nanos
+              << std::endl;
+  }
+
+  for (const Nanos interval : {Nanos{0}, 100 * NANOS_TO_MICROS, NANOS_TO_MILLIS, 10 * NANOS_TO_MILLIS}) {
+    MarketDataCfg cfg;
+    cfg.bbo_feed_ = true;
+    cfg.bbo_interval_nanos_ = interval;
+    PriceLevelPublisher publisher(logger, "lo", MCAST_IP, MCAST_PORT, cfg);
+    const auto [apply_nanos, flush_nanos] = run(publisher, updates);
+    std::cout << "mbo-updates:" << updates.size()
+              << " bbo-interval-ns:" << interval
+              << " bbo-updates:" << publisher.numBBOUpdates()
+              << " reduction:" << static_cast<double>(updates.size()) / static_cast<double>(std::max<size_t>(publisher.numBBOUpdates(), 1))
+              << " apply-ns-per-update:" << apply_nanos
+              << " flush-ns-per-update:" << flush_nanos
+              << std::endl;
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "time_utils.h"
+#include "logging.h"
+#include "tcp_socket.h"
+
+#include "market_data/retransmit_server.h"
+
+/// Times filling a gap in the incremental stream from the RetransmitServer over loopback TCP, for gaps of increasing length: a request
+/// from a consumer's socket, until the whole response is read. Server and consumer are driven from this one thread, so the figures are
+/// the CPU and kernel cost of a retransmission, without any scheduling delay. Recovering the same gap from the snapshot stream instead
+/// waits for the next snapshot cycle, up to a minute.
+/// Usage: md_retransmit_benchmark [ROUNDS]
+
+using namespace Exchange;
+
+constexpr size_t DEFAULT_ROUNDS = 2000;
+constexpr size_t NUM_UPDATES = 60 * 1000;
+constexpr int PORT = 20102;
+
+int main(int argc, char **argv) {
+  const size_t num_rounds = (argc > 1) ? std::stoul(argv[1]) : DEFAULT_ROUNDS;
+  MarketDataCfg cfg;
+
+  MDPMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+  RetransmitServer server(&market_updates, "lo", PORT, cfg);
+  server.listen();
+  for (size_t seq = 1; seq <= NUM_UPDATES; ++seq) {
+    *market_updates.getNextToWriteTo() = MDPMarketUpdate{seq, MEMarketUpdate{MarketUpdateType::ADD, seq, static_cast<TickerId>(seq % ME_MAX_TICKERS),
+                                                                             Side::BUY, 100, 10, seq}};
+    market_updates.updateWriteIndex();
+    if (market_updates.size() == ME_MAX_MARKET_UPDATES / 2) {
+      server.poll();
+    }
+  }
+
+  Logger logger("md_retransmit_benchmark.log");
+  Common::TCPSocket consumer(logger);
+  size_t received = 0;
+  consumer.recv_callback_ = [&received](Common::TCPSocket *socket, Nanos) {
+    const auto response = reinterpret_cast<const MDPRetransmitResponse *>(socket->inbound_.readData());
+    const auto size = sizeof(MDPRetransmitResponse) + (response->end_seq_ - response->begin_seq_) * sizeof(MDPMarketUpdate);
+    if (socket->inbound_.size() >= size) {
+      ASSERT(response->accepted_, "Request rejected: " + response->toString());
+      const auto last = reinterpret_cast<const MDPMarketUpdate *>(socket->inbound_.readData() + size) - 1;
+      ASSERT(last->seq_num_ == response->end_seq_ - 1 && last->me_market_update_.order_id_ == last->seq_num_, "Wrong update: " + last->toString());
+      socket->inbound_.consume(size);
+      ++received;
+    }
+  };
+  consumer.connect("127.0.0.1", "lo", PORT, false);
+  server.poll();
+
+  for (const size_t gap : {1, 16, 256, 4096}) {
+    std::vector<Nanos> latencies;
+    latencies.reserve(num_rounds);
+    for (size_t i = 0; i < num_rounds; ++i) {
+      const auto begin_seq = 1 + (i * 7919) % (NUM_UPDATES - gap);
+      const MDPRetransmitRequest request{begin_seq, begin_seq + gap};
+
+      const auto start = Common::getCurrentNanos();
+      consumer.send(&request, sizeof(request));
+      consumer.sendAndRecv();
+      while (received <= i) {
+        server.poll();
+        consumer.sendAndRecv();
+      }
+      latencies.push_back(Common::getCurrentNanos() - start);
+    }
+    received = 0;
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "gap:" << gap
+              << " fill-p50-ns:" << latencies[latencies.size() / 2]
+              << " fill-p90-ns:" << latencies[latencies.size() * 9 / 10]
+              << " fill-p99-ns:" << latencies[latencies.size() * 99 / 100]
+              << std::endl;
+  }
+
+  exit(EXIT_SUCCESS);
+}
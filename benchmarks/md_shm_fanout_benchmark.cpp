@@ -0,0 +1,174 @@
+#include <random>
+
+#include "time_utils.h"
+#include "logging.h"
+#include "mcast_socket.h"
+#include "shm_broadcast_ring.h"
+
+#include "market_data/md_packet_writer.h"
+
+/// Compares fanning the incremental stream out to consumers on the same box through multicast on loopback, where the kernel copies every
+/// datagram into each consumer's socket, against the shared memory ring the publisher can also write it to, read in place by every consumer.
+/// Publisher and consumers run on this one thread, so each figure is the total CPU cost of delivering and decoding the stream to all
+/// of them, in nanoseconds per update. Also checks that a consumer left behind by more than the ring detects that it was overrun.
+/// Usage: md_shm_fanout_benchmark [NUM_CONSUMERS]
+
+using namespace Exchange;
+
+constexpr size_t NUM_UPDATES = 1000 * 1000;
+constexpr size_t DEFAULT_NUM_CONSUMERS = 4;
+constexpr size_t UPDATES_PER_BATCH = 256;
+constexpr Nanos DRAIN_TIMEOUT_NANOS = NANOS_TO_MILLIS;
+const std::string MCAST_IP = "233.252.14.9";
+constexpr int MCAST_PORT = 20101;
+const std::string RING_NAME = "/md_shm_fanout_benchmark";
+
+/// Adds and cancels on every ticker, with their sequence numbers.
+auto generate() {
+  std::mt19937_64 rng(42);
+  std::vector<MDPMarketUpdate> updates;
+  updates.reserve(NUM_UPDATES);
+  for (size_t seq = 1; seq <= NUM_UPDATES; ++seq) {
+    MEMarketUpdate update;
+    update.type_ = (seq % 2) ? MarketUpdateType::ADD : MarketUpdateType::CANCEL;
+    update.ticker_id_ = rng() % ME_MAX_TICKERS;
+    update.side_ = (rng() % 2) ? Side::BUY : Side::SELL;
+    update.order_id_ = (seq + 1) / 2;
+    update.price_ = 10000 + static_cast<Price>(rng() % 64);
+    update.qty_ = (seq % 2) ? 1 + rng() % 500 : 0;
+    update.priority_ = (seq + 1) / 2;
+    updates.push_back(MDPMarketUpdate{seq, update});
+  }
+  return updates;
+}
+
+/// Counts the updates a consumer decoded, and those it never got.
+struct Consumer {
+  size_t next_seq_ = 1;
+  size_t lost_ = 0;
+  size_t next_packet_ = 0;
+
+  auto onUpdate(const MDPMarketUpdate &market_update) {
+    ASSERT(market_update.seq_num_ >= next_seq_, "Update out of order.");
+    lost_ += market_update.seq_num_ - next_seq_;
+    next_seq_ = market_update.seq_num_ + 1;
+  }
+};
+
+/// Publish every update through the writer, after each batch draining the consumers until they have all of it or it is given up as lost.
+/// Returns nanoseconds per update.
+template<typename D>
+auto fanOut(const std::vector<MDPMarketUpdate> &updates, MDPPacketWriter &writer, std::vector<Consumer> &consumers, D &&drain) {
+  const auto start = Common::getCurrentNanos();
+  for (size_t i = 0; i < updates.size(); i += UPDATES_PER_BATCH) {
+    const auto end = std::min(updates.size(), i + UPDATES_PER_BATCH);
+    for (size_t j = i; j < end; ++j) {
+      writer.add(updates[j]);
+    }
+    writer.flush();
+
+    const auto deadline = Common::getCurrentNanos() + DRAIN_TIMEOUT_NANOS;
+    for (auto &consumer: consumers) {
+      while (consumer.next_seq_ <= updates[end - 1].seq_num_ && Common::getCurrentNanos() < deadline) {
+        drain(consumer);
+      }
+    }
+  }
+  return static_cast<double>(Common::getCurrentNanos() - start) / updates.size();
+}
+
+/// Updates received and lost by all consumers.
+auto totals(const std::vector<Consumer> &consumers) {
+  size_t received = 0, lost = 0;
+  for (const auto &consumer: consumers) {
+    received += consumer.next_seq_ - 1 - consumer.lost_;
+    lost += consumer.lost_;
+  }
+  return std::make_pair(received, lost);
+}
+
+int main(int argc, char **argv) {
+  const size_t num_consumers = (argc > 1) ? std::stoul(argv[1]) : DEFAULT_NUM_CONSUMERS;
+  const auto updates = generate();
+  Common::Logger logger("md_shm_fanout_benchmark.log");
+  MarketDataCfg cfg;
+  cfg.shm_ring_slots_ = 1024;
+
+  // Multicast: every consumer joins the group and receives its own copy of every datagram.
+  {
+    Common::McastSocket publisher(logger);
+    ASSERT(publisher.init(MCAST_IP, "lo", MCAST_PORT, false) >= 0, "Unable to create publisher mcast socket.");
+    MDPPacketWriter writer(&publisher, cfg);
+
+    std::vector<Consumer> consumers(num_consumers);
+    std::vector<Common::McastSocket *> sockets;
+    for (auto &consumer: consumers) {
+      auto socket = new Common::McastSocket(logger);
+      ASSERT(socket->init(MCAST_IP, "lo", MCAST_PORT, true) >= 0 && socket->join(MCAST_IP), "Unable to join mcast group.");
+      socket->recv_callback_ = [&consumer](Common::McastSocket *s) {
+        size_t i = 0;
+        while (i + sizeof(MDPPacketHeader) <= s->inbound_.size()) {
+          const auto header = reinterpret_cast<const MDPPacketHeader *>(s->inbound_.readData() + i);
+          ASSERT(i + header->size_ + sizeof(MDPWireMessage) <= s->inbound_.capacity(), "Datagram too close to the end of the ring.");
+          mdpDecodePacket(s->inbound_.readData() + i, [&consumer](const MDPMarketUpdate &u) { consumer.onUpdate(u); });
+          i += header->size_;
+        }
+        s->inbound_.consume(i);
+      };
+      sockets.push_back(socket);
+    }
+
+    const auto nanos = fanOut(updates, writer, consumers, [&](Consumer &consumer) {
+      sockets[&consumer - consumers.data()]->sendAndRecv();
+    });
+    const auto [received, lost] = totals(consumers);
+    std::cout << "mcast consumers:" << num_consumers << " packets:" << writer.numPackets() << " ns-per-update:" << nanos
+              << " received:" << received << " lost:" << lost << std::endl;
+    for (auto socket: sockets) {
+      delete socket;
+    }
+  }
+
+  // Shared memory: the publisher writes each datagram once, every consumer decodes it in place at its own position.
+  {
+    Common::McastSocket publisher(logger);
+    ASSERT(publisher.init(MCAST_IP, "lo", MCAST_PORT, false) >= 0, "Unable to create publisher mcast socket.");
+    Common::ShmBroadcastRing ring(RING_NAME, cfg.shm_ring_slots_, MDPPacketWriter::maxPacketSize(cfg) + sizeof(MDPWireMessage));
+    MDPPacketWriter writer(&publisher, cfg, &ring);
+
+    Common::ShmBroadcastRing reader(RING_NAME);
+    ASSERT(reader.valid(), "Unable to attach to the ring.");
+    std::vector<Consumer> consumers(num_consumers);
+    size_t overruns = 0;
+    const auto drain = [&](Consumer &consumer) {
+      for (const auto published = reader.published(); consumer.next_packet_ < published; ++consumer.next_packet_) {
+        if (published - consumer.next_packet_ > reader.numSlots() ||
+            !reader.read(consumer.next_packet_, [&consumer](const char *data, size_t) {
+              mdpDecodePacket(data, [&consumer](const MDPMarketUpdate &u) { consumer.onUpdate(u); });
+            })) {
+          ++overruns;
+          return;
+        }
+      }
+    };
+
+    const auto nanos = fanOut(updates, writer, consumers, drain);
+    const auto [received, lost] = totals(consumers);
+    std::cout << "shm consumers:" << num_consumers << " packets:" << writer.numPackets() << " ns-per-update:" << nanos
+              << " received:" << received << " lost:" << lost << " overruns:" << overruns << std::endl;
+
+    // A consumer that does not read while the publisher laps the ring must find out rather than read newer datagrams as its own.
+    Consumer slow;
+    slow.next_packet_ = reader.published();
+    for (size_t seq = 1; seq <= (cfg.shm_ring_slots_ + 1) * 4; ++seq) {
+      writer.add(updates[seq - 1]);
+      writer.flush();
+    }
+    overruns = 0;
+    drain(slow);
+    std::cout << "slow consumer lapped by the ring, overrun detected:" << (overruns == 1) << " updates read:" << slow.next_seq_ - 1 << std::endl;
+    ASSERT(overruns == 1 && slow.next_seq_ == 1, "Overrun not detected.");
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,102 @@
+#include <algorithm>
+
+#include "time_utils.h"
+#include "logging.h"
+
+#include "market_data/snapshot_synthesizer.h"
+
+/// Times the SnapshotSynthesizer keeping up with incremental updates while it publishes snapshot cycles back to back, for books of
+/// increasing numbers of live orders: how long each round of draining the updates and publishing the next snapshot datagram takes, the
+/// worst of which bounds how far the queue from the publisher backs up, and how long a whole cycle takes. For reference, also times one scan
+/// of a table with a slot for every possible OrderId of every instrument, the way live orders used to be found for each snapshot.
+/// Usage: md_snapshot_benchmark [MAX_PACKETS_PER_SEC]
+
+using namespace Exchange;
+
+constexpr size_t UPDATES_PER_ROUND = 16;
+constexpr size_t NUM_ROUNDS = 20 * 1000;
+const std::string MCAST_IP = "233.252.14.9";
+constexpr int MCAST_PORT = 20103;
+
+/// Queue the next incremental update, numbered seq.
+auto enqueue(MDPMarketUpdateLFQueue &market_updates, size_t seq, const MEMarketUpdate &update) {
+  *market_updates.getNextToWriteTo() = MDPMarketUpdate{seq, update};
+  market_updates.updateWriteIndex();
+}
+
+int main(int argc, char **argv) {
+  MarketDataCfg cfg;
+  cfg.snapshot_period_nanos_ = 0;
+  cfg.snapshot_max_packets_per_sec_ = (argc > 1) ? std::stoul(argv[1]) : 0;
+
+  for (const size_t num_orders : {1000, 10 * 1000, 100 * 1000}) {
+    MDPMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+    SnapshotSynthesizer synthesizer(&market_updates, "lo", MCAST_IP, MCAST_PORT, cfg);
+
+    size_t seq = 1;
+    for (size_t order_id = 0; order_id < num_orders; ++order_id) {
+      enqueue(market_updates, seq++, MEMarketUpdate{MarketUpdateType::ADD, order_id, static_cast<TickerId>(order_id % ME_MAX_TICKERS),
+                                                    Side::BUY, 100, 10, order_id});
+      if (market_updates.size() == ME_MAX_MARKET_UPDATES / 2) {
+        synthesizer.poll();
+      }
+    }
+    while (market_updates.size()) {
+      synthesizer.poll();
+    }
+    while (synthesizer.publishing()) {
+      synthesizer.poll();
+    }
+
+    // Every round cancels live orders and adds them back under new OrderIds, so the book keeps its size while the cycles publish it.
+    std::vector<Nanos> latencies;
+    latencies.reserve(NUM_ROUNDS);
+    size_t cycles = 0;
+    const auto start = Common::getCurrentNanos();
+    for (size_t round = 0, next_order_id = num_orders; round < NUM_ROUNDS; ++round) {
+      for (size_t i = 0; i < UPDATES_PER_ROUND; i += 2, ++next_order_id) {
+        const auto order_id = next_order_id - num_orders;
+        const auto ticker_id = static_cast<TickerId>(order_id % ME_MAX_TICKERS);
+        enqueue(market_updates, seq++, MEMarketUpdate{MarketUpdateType::CANCEL, order_id % ME_MAX_ORDER_IDS, ticker_id, Side::BUY, 100, 0, order_id});
+        enqueue(market_updates, seq++, MEMarketUpdate{MarketUpdateType::ADD, next_order_id % ME_MAX_ORDER_IDS, ticker_id, Side::BUY, 100, 10, next_order_id});
+      }
+
+      const auto was_publishing = synthesizer.publishing();
+      const auto poll_start = Common::getCurrentNanos();
+      synthesizer.poll();
+      latencies.push_back(Common::getCurrentNanos() - poll_start);
+      cycles += (was_publishing && !synthesizer.publishing());
+    }
+    const auto elapsed = Common::getCurrentNanos() - start;
+
+    // Each live order in its own slot of a table indexed by TickerId and OrderId, found by scanning all of them.
+    auto table = new std::array<std::array<MEMarketUpdate *, ME_MAX_ORDER_IDS>, ME_MAX_TICKERS>();
+    MEMarketUpdate order;
+    for (size_t order_id = 0; order_id < num_orders; ++order_id) {
+      (*table)[order_id % ME_MAX_TICKERS][order_id] = &order;
+    }
+    const auto scan_start = Common::getCurrentNanos();
+    size_t found = 0;
+    for (const auto &orders: *table) {
+      for (const auto entry: orders) {
+        found += (entry != nullptr);
+      }
+    }
+    const auto scan_nanos = Common::getCurrentNanos() - scan_start;
+    ASSERT(found == num_orders, "Scan found " + std::to_string(found) + " orders.");
+    delete table;
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "live-orders:" << num_orders
+              << " max-packets-per-sec:" << cfg.snapshot_max_packets_per_sec_
+              << " round-p50-ns:" << latencies[latencies.size() / 2]
+              << " round-p99-ns:" << latencies[latencies.size() * 99 / 100]
+              << " round-max-ns:" << latencies.back()
+              << " cycles:" << cycles
+              << " cycle-ns:" << (cycles ? elapsed / static_cast<Nanos>(cycles) : 0)
+              << " full-table-scan-ns:" << scan_nanos
+              << std::endl;
+  }
+
+  exit(EXIT_SUCCESS);
+}
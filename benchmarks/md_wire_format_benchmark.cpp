@@ -0,0 +1,166 @@
+#include <random>
+
+#include "time_utils.h"
+
+#include "market_data/md_wire_format.h"
+
+/// Compares the market data wire formats over a synthetic incremental stream: the previous one sent every update as a whole
+/// MDPMarketUpdate behind an 18 byte packet header, the current one is md_wire_format.h.
+/// Reports the bytes per update each puts on the wire at a 1500 byte MTU, and the nanoseconds per update to decode them.
+
+using namespace Exchange;
+
+constexpr size_t NUM_UPDATES = 1000 * 1000;
+constexpr size_t MAX_PACKET_SIZE = 1500 - IP_UDP_HEADER_SIZE;
+constexpr size_t PREVIOUS_HEADER_SIZE = sizeof(size_t) + sizeof(uint16_t) + sizeof(Nanos);
+constexpr size_t NUM_ROUNDS = 20;
+
+/// Mostly adds and cancels close to the touch, with modifies, trades and executions, on every ticker.
+auto generate() {
+  std::mt19937_64 rng(42);
+  std::vector<MDPMarketUpdate> updates;
+  updates.reserve(NUM_UPDATES);
+  std::vector<OrderId> live_orders;
+  OrderId next_order_id = 1;
+  Priority next_priority = 1;
+
+  for (size_t seq = 1; seq <= NUM_UPDATES; ++seq) {
+    MEMarketUpdate update;
+    update.ticker_id_ = rng() % ME_MAX_TICKERS;
+    update.side_ = (rng() % 2) ? Side::BUY : Side::SELL;
+    update.price_ = 10000 + static_cast<Price>(update.ticker_id_ * 1000 + rng() % 64);
+
+    const auto pick = rng() % 100;
+    if (pick < 45 || live_orders.empty()) {
+      update.type_ = MarketUpdateType::ADD;
+      update.order_id_ = next_order_id++;
+      update.qty_ = 1 + rng() % 500;
+      update.priority_ = next_priority++;
+      live_orders.push_back(update.order_id_);
+    } else {
+      const auto index = rng() % live_orders.size();
+      update.order_id_ = live_orders[index];
+      if (pick < 80) {
+        update.type_ = MarketUpdateType::CANCEL;
+        update.qty_ = 0;
+        live_orders[index] = live_orders.back();
+        live_orders.pop_back();
+      } else if (pick < 88) {
+        update.type_ = MarketUpdateType::MODIFY;
+        update.qty_ = 1 + rng() % 500;
+      } else if (pick < 94) {
+        update.type_ = MarketUpdateType::TRADE;
+        update.order_id_ = OrderId_INVALID;
+        update.qty_ = 1 + rng() % 100;
+      } else {
+        update.type_ = MarketUpdateType::EXECUTION;
+        update.qty_ = 1 + rng() % 100;
+        update.priority_ = rng() % 400;
+      }
+    }
+    updates.push_back(MDPMarketUpdate{seq, update});
+  }
+
+  return updates;
+}
+
+/// Pack the updates into datagrams following the rules of MDPPacketWriter.
+auto encode(const std::vector<MDPMarketUpdate> &updates) {
+  std::vector<std::vector<char>> packets;
+  std::vector<char> packet(MAX_PACKET_SIZE + sizeof(MDPWireMessage));
+  size_t packet_size = sizeof(MDPPacketHeader);
+  MDPPacketHeader header;
+  MDPPacketBases bases;
+
+  const auto close = [&]() {
+    header.size_ = static_cast<uint16_t>(packet_size);
+#define MDP_COPY_BASE(name, wire_type, member, absent) header.name##_base_ = bases.name##_base_;
+    MDP_WIRE_FIELDS(MDP_IGNORE_FIELD, MDP_COPY_BASE)
+#undef MDP_COPY_BASE
+    memcpy(packet.data(), &header, sizeof(header));
+    packets.emplace_back(packet.begin(), packet.begin() + packet_size);
+    packet_size = sizeof(MDPPacketHeader);
+    header.num_updates_ = 0;
+    bases = {};
+  };
+
+  for (const auto &update : updates) {
+    if (header.num_updates_ && packet_size + MDP_MESSAGE_SIZES[static_cast<uint8_t>(update.me_market_update_.type_)] > MAX_PACKET_SIZE) {
+      close();
+    }
+    auto size = mdpEncode(update.me_market_update_, &bases, packet.data() + packet_size);
+    if (!size) {
+      close();
+      size = mdpEncode(update.me_market_update_, &bases, packet.data() + packet_size);
+    }
+    if (!header.num_updates_) {
+      header.seq_num_ = update.seq_num_;
+    }
+    packet_size += size;
+    ++header.num_updates_;
+  }
+  close();
+
+  // Decoding reads a whole MDPWireMessage past the last update, as it would past the end of a datagram in a receive ring.
+  for (auto &p : packets) {
+    p.resize(p.size() + sizeof(MDPWireMessage));
+  }
+  return packets;
+}
+
+int main(int, char **) {
+  const auto updates = generate();
+  const auto packets = encode(updates);
+
+  const size_t updates_per_previous_packet = (MAX_PACKET_SIZE - PREVIOUS_HEADER_SIZE) / sizeof(MDPMarketUpdate);
+  const size_t previous_bytes = (NUM_UPDATES + updates_per_previous_packet - 1) / updates_per_previous_packet * PREVIOUS_HEADER_SIZE +
+                                NUM_UPDATES * sizeof(MDPMarketUpdate);
+  size_t bytes = 0;
+  for (const auto &packet : packets) {
+    bytes += packet.size() - sizeof(MDPWireMessage);
+  }
+
+  // Check the round trip, then time decoding every packet into MDPMarketUpdates as the consumer does.
+  size_t i = 0;
+  for (const auto &packet : packets) {
+    mdpDecodePacket(packet.data(), [&](const MDPMarketUpdate &update) {
+      ASSERT(!memcmp(&update, &updates[i], sizeof(update)), "Round trip mismatch at update:" + std::to_string(i));
+      ++i;
+    });
+  }
+  ASSERT(i == NUM_UPDATES, "Decoded " + std::to_string(i) + " updates.");
+
+  size_t checksum = 0;
+  const auto start = Common::getCurrentNanos();
+  for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+    for (const auto &packet : packets) {
+      mdpDecodePacket(packet.data(), [&](const MDPMarketUpdate &update) {
+        checksum += update.me_market_update_.order_id_ + update.me_market_update_.qty_;
+      });
+    }
+  }
+  const auto decode_nanos = Common::getCurrentNanos() - start;
+
+  // The previous format is read in place, so its decoding is the copy out of the datagram.
+  std::vector<char> previous(NUM_UPDATES * sizeof(MDPMarketUpdate));
+  memcpy(previous.data(), updates.data(), previous.size());
+  const auto previous_start = Common::getCurrentNanos();
+  for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+    for (size_t offset = 0; offset < previous.size(); offset += sizeof(MDPMarketUpdate)) {
+      MDPMarketUpdate update;
+      memcpy(&update, previous.data() + offset, sizeof(update));
+      checksum += update.me_market_update_.order_id_ + update.me_market_update_.qty_;
+    }
+  }
+  const auto previous_decode_nanos = Common::getCurrentNanos() - previous_start;
+
+  std::cout << "updates:" << NUM_UPDATES << " packet-budget:" << MAX_PACKET_SIZE << " checksum:" << checksum << std::endl;
+  std::cout << "previous packets:" << (NUM_UPDATES + updates_per_previous_packet - 1) / updates_per_previous_packet
+            << " bytes/update:" << static_cast<double>(previous_bytes) / NUM_UPDATES
+            << " decode-ns/update:" << static_cast<double>(previous_decode_nanos) / (NUM_ROUNDS * NUM_UPDATES) << std::endl;
+  std::cout << "v" << static_cast<int>(MDP_VERSION) << " packets:" << packets.size()
+            << " bytes/update:" << static_cast<double>(bytes) / NUM_UPDATES
+            << " decode-ns/update:" << static_cast<double>(decode_nanos) / (NUM_ROUNDS * NUM_UPDATES) << std::endl;
+
+  exit(EXIT_SUCCESS);
+}
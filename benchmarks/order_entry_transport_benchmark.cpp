@@ -0,0 +1,183 @@
+#include <algorithm>
+
+#include "order_server/order_server.h"
+#include "order_gw/order_gateway.h"
+
+/// Compares the round trip through OrderGateway and OrderServer over loopback TCP and over shared memory rings.
+/// One client on each transport sends a request, waits for its response and sends the next, against a stand-in matching engine thread
+/// that accepts every request as soon as it is sequenced. Reports the round trip latency percentiles from the trade engine side.
+/// Those need a core per thread to mean anything, so the transports alone are also timed on a single thread: a request frame to a
+/// TCPServer and its response frame back, against a request and a response through the two rings of a shared memory session.
+/// Usage: order_entry_transport_benchmark [ROUND_TRIPS]
+
+using namespace Exchange;
+
+constexpr size_t DEFAULT_ROUND_TRIPS = 20 * 1000;
+constexpr int PORT = 12500;
+
+/// Accept every request.
+auto runMatchingEngine(ClientRequestLFQueue *requests, ClientResponseLFQueue *responses, const volatile bool *run) {
+  OrderId market_order_id = 1;
+  while (*run) {
+    for (auto request = requests->getNextToRead(); request; request = requests->getNextToRead()) {
+      auto next_write = responses->getNextToWriteTo();
+      *next_write = {ClientResponseType::ACCEPTED, request->client_id_, request->ticker_id_, request->order_id_, market_order_id++,
+                     request->side_, request->price_, 0, request->qty_};
+      responses->updateWriteIndex();
+      requests->updateReadIndex();
+    }
+    std::this_thread::yield();
+  }
+}
+
+/// Send requests one at a time through the gateway's queues, returns the sorted round trip latencies after the warmup.
+auto roundTrips(ClientId client_id, ClientRequestLFQueue *requests, ClientResponseLFQueue *responses, size_t num_round_trips) {
+  const auto num_warmup = num_round_trips / 20;
+  std::vector<Nanos> latencies;
+  latencies.reserve(num_round_trips);
+  for (size_t i = 0; i < num_warmup + num_round_trips; ++i) {
+    const auto start = Common::getCurrentNanos();
+    *requests->getNextToWriteTo() = {ClientRequestType::NEW, client_id, static_cast<TickerId>(i % ME_MAX_TICKERS), i + 1, Side::BUY, 100, 10};
+    requests->updateWriteIndex();
+
+    auto response = responses->getNextToRead();
+    while (!response) {
+      std::this_thread::yield();
+      response = responses->getNextToRead();
+    }
+    ASSERT(response->client_order_id_ == i + 1, "Response out of order: " + response->toString());
+    responses->updateReadIndex();
+    if (i >= num_warmup) {
+      latencies.push_back(Common::getCurrentNanos() - start);
+    }
+  }
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+/// Both ends of either transport driven from this thread, returns the sorted round trip latencies.
+auto transportRoundTrips(bool use_shm, size_t num_round_trips, Logger &logger) {
+  std::vector<Nanos> latencies;
+  latencies.reserve(num_round_trips);
+  const MEClientRequest request{ClientRequestType::NEW, 3, 1, 1, Side::BUY, 100, 10};
+  const MEClientResponse response{ClientResponseType::ACCEPTED, 3, 1, 1, 1, Side::BUY, 100, 0, 10};
+
+  if (use_shm) {
+    OMShmRequestQueue client_requests(omShmRequestsName(3), OM_SHM_QUEUE_SIZE);
+    OMShmRequestQueue server_requests(omShmRequestsName(3));
+    OMShmResponseQueue server_responses(omShmResponsesName(3), OM_SHM_QUEUE_SIZE);
+    OMShmResponseQueue client_responses(omShmResponsesName(3));
+    for (size_t i = 1; i <= num_round_trips; ++i) {
+      const auto start = Common::getCurrentNanos();
+      *client_requests.getNextToWriteTo() = OMShmRequest{i, request};
+      client_requests.updateWriteIndex();
+
+      const auto server_request = server_requests.getNextToRead();
+      ASSERT(server_request && server_request->seq_num_ == i, "Request lost.");
+      server_requests.updateReadIndex();
+      *server_responses.getNextToWriteTo() = OMShmResponse{i, response};
+      server_responses.updateWriteIndex();
+
+      const auto client_response = client_responses.getNextToRead();
+      ASSERT(client_response && client_response->seq_num_ == i, "Response lost.");
+      client_responses.updateReadIndex();
+      latencies.push_back(Common::getCurrentNanos() - start);
+    }
+  } else {
+    Common::TCPServer server(logger, 1);
+    server.recv_callback_ = [&response](TCPSocket *socket, Nanos) {
+      const auto header = reinterpret_cast<const OMFrameHeader *>(socket->inbound_.readData());
+      if (socket->inbound_.size() < sizeof(OMFrameHeader) || socket->inbound_.size() < header->size_) {
+        return;
+      }
+      OMFrameWriter frame;
+      frame.add(header->seq_num_, response);
+      socket->inbound_.consume(header->size_);
+      frame.flush(3, socket);
+    };
+    server.recv_finished_callback_ = []() {};
+    server.listen("lo", PORT + 1);
+
+    Common::TCPSocket client(logger);
+    size_t responses = 0;
+    client.recv_callback_ = [&responses](TCPSocket *socket, Nanos) {
+      const auto header = reinterpret_cast<const OMFrameHeader *>(socket->inbound_.readData());
+      if (socket->inbound_.size() >= sizeof(OMFrameHeader) && socket->inbound_.size() >= header->size_) {
+        socket->inbound_.consume(header->size_);
+        ++responses;
+      }
+    };
+    ASSERT(client.connect("127.0.0.1", "lo", PORT + 1, false) >= 0, "Client failed to connect.");
+    while (server.sessions_.empty()) {
+      server.poll();
+    }
+
+    OMFrameWriter frame;
+    for (size_t i = 1; i <= num_round_trips; ++i) {
+      const auto start = Common::getCurrentNanos();
+      frame.add(i, request);
+      frame.flush(3, &client);
+      client.sendAndRecv();
+      while (responses < i) {
+        server.poll();
+        server.sendAndRecv();
+        client.sendAndRecv();
+      }
+      latencies.push_back(Common::getCurrentNanos() - start);
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+int main(int argc, char **argv) {
+  const size_t num_round_trips = (argc > 1) ? std::stoul(argv[1]) : DEFAULT_ROUND_TRIPS;
+
+  {
+    Logger logger("order_entry_transport_benchmark.log");
+    for (const auto use_shm : {false, true}) {
+      const auto latencies = transportRoundTrips(use_shm, std::max<size_t>(num_round_trips, DEFAULT_ROUND_TRIPS), logger);
+      std::cout << (use_shm ? "shm" : "tcp") << " transport only"
+                << " rtt-p50-ns:" << latencies[latencies.size() / 2]
+                << " rtt-p90-ns:" << latencies[latencies.size() * 9 / 10]
+                << " rtt-p99-ns:" << latencies[latencies.size() * 99 / 100]
+                << std::endl;
+    }
+  }
+
+  ClientRequestLFQueue server_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue server_responses(ME_MAX_CLIENT_UPDATES);
+  Common::OrderServerCfg cfg;
+  cfg.shm_sessions_ = true;
+  auto order_server = new OrderServer(&server_requests, &server_responses, nullptr, nullptr, "lo", PORT, Common::SendQueueCfg(),
+                                      Common::TCPServerBackend::EPOLL, cfg);
+  order_server->start();
+
+  volatile bool run = true;
+  auto matching_engine = Common::createAndStartThread(-1, "Benchmark/MatchingEngine", [&]() { runMatchingEngine(&server_requests, &server_responses, &run); });
+
+  std::cout << num_round_trips << " round trips per transport on " << std::thread::hardware_concurrency() << " cores." << std::endl;
+  for (const auto use_shm : {false, true}) {
+    const ClientId client_id = use_shm ? 2 : 1;
+    ClientRequestLFQueue requests(ME_MAX_CLIENT_UPDATES);
+    ClientResponseLFQueue responses(ME_MAX_CLIENT_UPDATES);
+    auto order_gateway = new Trading::OrderGateway(client_id, &requests, &responses, "127.0.0.1", "lo", PORT, use_shm);
+    order_gateway->start();
+
+    const auto latencies = roundTrips(client_id, &requests, &responses, num_round_trips);
+    std::cout << (use_shm ? "shm" : "tcp")
+              << " rtt-p50-ns:" << latencies[latencies.size() / 2]
+              << " rtt-p90-ns:" << latencies[latencies.size() * 9 / 10]
+              << " rtt-p99-ns:" << latencies[latencies.size() * 99 / 100]
+              << std::endl;
+
+    delete order_gateway;
+  }
+
+  run = false;
+  matching_engine->join();
+  delete order_server;
+
+  exit(EXIT_SUCCESS);
+}
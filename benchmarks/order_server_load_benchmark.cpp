@@ -0,0 +1,162 @@
+#include <atomic>
+
+#include "order_server/order_server.h"
+
+/// Loopback load test of the order server with 1, 2 and 4 I/O threads. NUM_CLIENTS clients, spread across NUM_LOAD_THREADS threads,
+/// each keep WINDOW new orders in flight, and a stand-in matching engine thread accepts every request as soon as it is sequenced.
+/// Reports the requests per second acknowledged end to end, and checks that every client's requests reached the matching engine and
+/// its responses came back in order.
+
+using namespace Exchange;
+
+constexpr size_t NUM_CLIENTS = ME_MAX_NUM_CLIENTS;
+constexpr size_t NUM_LOAD_THREADS = 4;
+constexpr size_t WINDOW = 8;
+constexpr Nanos WARMUP_NANOS = NANOS_TO_SECS / 2;
+constexpr Nanos DURATION_NANOS = 2 * NANOS_TO_SECS;
+constexpr int BASE_PORT = 12400;
+
+/// One client session, with the requests it sent but has no response for yet.
+struct LoadClient {
+  LoadClient(ClientId client_id, Logger &logger)
+      : client_id_(client_id), socket_(logger) {
+  }
+
+  const ClientId client_id_;
+  TCPSocket socket_;
+  OMFrameWriter frame_;
+  size_t next_seq_num_ = 1;
+  size_t next_exp_seq_num_ = 1;
+  size_t in_flight_ = 0;
+  size_t errors_ = 0;
+};
+
+/// Run the clients of one load thread until stop is set, counting the acknowledged requests into acked.
+auto runLoad(std::vector<LoadClient *> clients, int port, const std::atomic<bool> &stop, std::atomic<size_t> &acked, std::atomic<size_t> &errors) {
+  for (auto client : clients) {
+    client->socket_.recv_callback_ = [client, &acked](TCPSocket *socket, Nanos) {
+      const auto data = socket->inbound_.readData();
+      size_t i = 0;
+      while (i + sizeof(OMFrameHeader) <= socket->inbound_.size()) {
+        const auto header = reinterpret_cast<const OMFrameHeader *>(data + i);
+        if (i + header->size_ > socket->inbound_.size()) {
+          break;
+        }
+        if (header->client_id_ != client->client_id_ || header->seq_num_ != client->next_exp_seq_num_) {
+          ++client->errors_;
+        }
+        client->next_exp_seq_num_ = header->seq_num_ + header->num_messages_;
+        client->in_flight_ -= std::min<size_t>(client->in_flight_, header->num_messages_);
+        acked.fetch_add(header->num_messages_, std::memory_order_relaxed);
+        i += header->size_;
+      }
+      socket->inbound_.consume(i);
+    };
+    ASSERT(client->socket_.connect("127.0.0.1", "lo", port, false) >= 0, "Client failed to connect.");
+  }
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    for (auto client : clients) {
+      for (; client->in_flight_ < WINDOW; ++client->in_flight_) {
+        const auto order_id = client->next_seq_num_;
+        const MEClientRequest request{ClientRequestType::NEW, client->client_id_, static_cast<TickerId>(order_id % ME_MAX_TICKERS), order_id,
+                                      (order_id % 2) ? Side::BUY : Side::SELL, static_cast<Price>(100 + order_id % 50), 10};
+        client->frame_.add(client->next_seq_num_++, request);
+      }
+      client->frame_.flush(client->client_id_, &client->socket_);
+      client->socket_.sendAndRecv();
+    }
+  }
+
+  for (auto client : clients) {
+    errors.fetch_add(client->errors_, std::memory_order_relaxed);
+  }
+}
+
+/// Accept every request, checking that each client's requests arrive in the order it sent them.
+auto runMatchingEngine(ClientRequestLFQueue *requests, ClientResponseLFQueue *responses, const std::atomic<bool> &stop, std::atomic<size_t> &errors) {
+  std::vector<OrderId> last_order_id(NUM_CLIENTS, 0);
+  OrderId market_order_id = 1;
+  while (!stop.load(std::memory_order_relaxed)) {
+    for (auto request = requests->getNextToRead(); request; request = requests->getNextToRead()) {
+      if (request->order_id_ != last_order_id[request->client_id_] + 1) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+      }
+      last_order_id[request->client_id_] = request->order_id_;
+
+      auto next_write = responses->getNextToWriteTo();
+      while (!next_write) {
+        std::this_thread::yield();
+        next_write = responses->getNextToWriteTo();
+      }
+      *next_write = {ClientResponseType::ACCEPTED, request->client_id_, request->ticker_id_, request->order_id_, market_order_id++,
+                     request->side_, request->price_, 0, request->qty_};
+      responses->updateWriteIndex();
+      requests->updateReadIndex();
+    }
+    std::this_thread::yield();
+  }
+}
+
+int main(int, char **) {
+  std::cout << "Loopback order entry with " << NUM_CLIENTS << " clients on " << NUM_LOAD_THREADS << " threads, " << WINDOW
+            << " requests in flight each, for " << DURATION_NANOS / NANOS_TO_SECS << "s per run on " << std::thread::hardware_concurrency()
+            << " cores." << std::endl;
+
+  auto port = BASE_PORT; // a TCPServer does not close its listener, every run listens on a port of its own.
+  for (const size_t num_io_threads : {1, 2, 4}) {
+    ClientRequestLFQueue requests(ME_MAX_CLIENT_UPDATES);
+    ClientResponseLFQueue responses(ME_MAX_CLIENT_UPDATES);
+    Common::OrderServerCfg cfg;
+    cfg.num_io_threads_ = num_io_threads;
+    auto order_server = new OrderServer(&requests, &responses, nullptr, nullptr, "lo", port, Common::SendQueueCfg(), Common::TCPServerBackend::EPOLL, cfg);
+    order_server->start();
+
+    std::atomic<bool> stop = {false};
+    std::atomic<size_t> acked = {0}, errors = {0};
+    auto matching_engine = Common::createAndStartThread(-1, "Benchmark/MatchingEngine", [&]() { runMatchingEngine(&requests, &responses, stop, errors); });
+
+    std::vector<Logger *> loggers;
+    std::vector<LoadClient *> clients;
+    std::vector<std::thread *> load_threads;
+    for (size_t t = 0; t < NUM_LOAD_THREADS; ++t) {
+      loggers.push_back(new Logger("order_server_load_benchmark_" + std::to_string(t) + ".log"));
+      std::vector<LoadClient *> thread_clients;
+      for (auto client_id = t; client_id < NUM_CLIENTS; client_id += NUM_LOAD_THREADS) {
+        clients.push_back(new LoadClient(static_cast<ClientId>(client_id), *loggers.back()));
+        thread_clients.push_back(clients.back());
+      }
+      load_threads.push_back(Common::createAndStartThread(-1, "Benchmark/Load/" + std::to_string(t),
+                                                          [&, thread_clients]() { runLoad(thread_clients, port, stop, acked, errors); }));
+    }
+
+    using namespace std::literals::chrono_literals;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(WARMUP_NANOS));
+    const auto start_acked = acked.load();
+    const auto start = Common::getCurrentNanos();
+    std::this_thread::sleep_for(std::chrono::nanoseconds(DURATION_NANOS));
+    const auto num_acked = acked.load() - start_acked;
+    const auto elapsed = Common::getCurrentNanos() - start;
+
+    stop = true;
+    for (auto load_thread : load_threads) {
+      load_thread->join();
+    }
+    matching_engine->join();
+
+    std::cout << "io-threads:" << num_io_threads
+              << " requests/s:" << static_cast<double>(num_acked) * NANOS_TO_SECS / elapsed
+              << " errors:" << errors.load() << std::endl;
+
+    delete order_server;
+    for (auto client : clients) {
+      delete client;
+    }
+    for (auto logger : loggers) {
+      delete logger;
+    }
+    ++port;
+  }
+
+  exit(EXIT_SUCCESS);
+}
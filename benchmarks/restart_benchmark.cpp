@@ -0,0 +1,81 @@
+#include "matcher/matching_engine.h"
+
+/// Measures how long the matching engine takes to come back after a restart as a function of the number of live orders,
+/// rebuilding the books by replaying the whole request journal versus restoring them from checkpoints.
+
+using namespace Exchange;
+
+/// Resting orders are spread over every ticker and this many price levels per side, bids below asks so nothing matches.
+constexpr size_t NUM_PRICES = 100;
+constexpr Price BEST_BID = 100;
+constexpr Price BEST_ASK = 101;
+
+/// The i-th resting order, client order ids are unique per ticker and client.
+auto restingOrder(size_t i) {
+  const auto n = i / ME_MAX_TICKERS;
+  const auto side = (n % 2 ? Side::SELL : Side::BUY);
+  const auto level = static_cast<Price>((n / 2) % NUM_PRICES);
+  return MEClientRequest{ClientRequestType::NEW, static_cast<ClientId>(n % ME_MAX_NUM_CLIENTS), static_cast<TickerId>(i % ME_MAX_TICKERS),
+                         static_cast<OrderId>(n / ME_MAX_NUM_CLIENTS), side, (side == Side::BUY ? BEST_BID - level : BEST_ASK + level), 10};
+}
+
+/// Construct a matching engine and recover it, returns the time spent in recover().
+auto restart(const MatchingEngineCfg &cfg, const std::string &journal_path, bool write_checkpoint) {
+  ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
+  ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
+  MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+
+  auto matching_engine = new MatchingEngine(cfg, &client_requests, &client_responses, &market_updates);
+
+  const auto start = Common::getCurrentNanos();
+  matching_engine->recover(journal_path);
+  const auto elapsed = Common::getCurrentNanos() - start;
+
+  if (write_checkpoint) {
+    matching_engine->checkpoint();
+  }
+  delete matching_engine;
+
+  return elapsed;
+}
+
+int main(int, char **) {
+  std::cout << "Restart time by live order count, books rebuilt from the full journal vs from checkpoints." << std::endl;
+
+  for (const size_t num_orders : {10000, 50000, 200000}) {
+    const auto journal_path = "restart_benchmark_" + std::to_string(num_orders) + ".journal";
+    const auto checkpoint_dir = "restart_benchmark_" + std::to_string(num_orders) + ".ckpt";
+    unlink(journal_path.c_str());
+    for (size_t i = 0; i < ME_MAX_TICKERS; ++i) {
+      unlink(checkpointPath(checkpoint_dir, i).c_str());
+    }
+
+    {
+      JournalCfg journal_cfg;
+      journal_cfg.path_ = journal_path;
+      journal_cfg.sync_policy_ = JournalSyncPolicy::NONE;
+      RequestJournal journal(journal_cfg);
+      journal.start();
+      for (size_t i = 0; i < num_orders; ++i) {
+        journal.append(i + 1, static_cast<Nanos>(i), restingOrder(i));
+      }
+    }
+
+    MatchingEngineCfg journal_only_cfg;
+    const auto journal_nanos = restart(journal_only_cfg, journal_path, false);
+
+    MatchingEngineCfg checkpoint_cfg;
+    checkpoint_cfg.checkpoint_dir_ = checkpoint_dir;
+    restart(checkpoint_cfg, journal_path, true);
+    const auto checkpoint_nanos = restart(checkpoint_cfg, journal_path, false);
+
+    std::cout << "live-orders:" << num_orders
+              << " journal-replay-ms:" << journal_nanos / NANOS_TO_MILLIS
+              << " checkpoint-restore-ms:" << checkpoint_nanos / NANOS_TO_MILLIS
+              << " checkpoint-restore-ns/order:" << checkpoint_nanos / num_orders
+              << " speedup:" << static_cast<double>(journal_nanos) / checkpoint_nanos
+              << std::endl;
+  }
+
+  exit(EXIT_SUCCESS);
+}
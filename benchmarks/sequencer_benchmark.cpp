@@ -0,0 +1,162 @@
+#include <random>
+#include <numeric>
+
+#include "order_server/session_run_merger.h"
+
+/// Compares ordering one poll's worth of client requests by sorting every request against merging per session runs,
+/// for 10, 100 and 1000 sessions with bursty arrivals, and checks both produce a receive time ordered, per session FIFO stream.
+
+using namespace Exchange;
+
+constexpr size_t NUM_ROUNDS = 2000;
+
+/// Every poll a session sends a burst with this probability, burst sizes are geometric with this mean and capped.
+constexpr double BURST_PROBABILITY = 0.2;
+constexpr double MEAN_BURST_SIZE = 8;
+constexpr size_t MAX_BURST_SIZE = 64;
+
+/// Receive times within one poll are spread over this window.
+constexpr Nanos POLL_WINDOW_NANOS = 50 * NANOS_TO_MICROS;
+
+/// A burst read from one socket in one poll, all requests in a read share the kernel receive timestamp.
+struct Burst {
+  size_t session_ = 0;
+  Nanos recv_time_ = 0;
+  size_t size_ = 0;
+};
+
+/// The sequencer before per session runs, every pending request sorted by receive time on every poll.
+class SortingSequencer {
+public:
+  auto add(size_t session, Nanos recv_time, const MEClientRequest &request) {
+    pending_.push_back({recv_time, session, request});
+  }
+
+  template<typename F>
+  auto sequence(F &&visit) {
+    std::sort(pending_.begin(), pending_.end(), [](const auto &lhs, const auto &rhs) { return lhs.recv_time_ < rhs.recv_time_; });
+    for (const auto &pending : pending_) {
+      visit(RecvTimeClientRequest{pending.recv_time_, pending.request_});
+    }
+    pending_.clear();
+  }
+
+private:
+  struct Pending {
+    Nanos recv_time_;
+    size_t session_;
+    MEClientRequest request_;
+  };
+  std::vector<Pending> pending_;
+};
+
+/// Output of the sequencer under test for the current poll.
+std::vector<RecvTimeClientRequest> outputs;
+
+struct Result {
+  size_t requests_ = 0;
+  size_t session_reorders_ = 0;
+  std::vector<Nanos> round_nanos_;
+};
+
+/// Checks requests come out in receive time order, and counts requests that overtook an earlier request of the same session.
+/// Requests from one read share a receive time, so an unstable sort is free to reorder them.
+struct OrderChecker {
+  Nanos last_recv_time_ = 0;
+  std::vector<OrderId> next_order_id_;
+  size_t session_reorders_ = 0;
+
+  auto operator()(const RecvTimeClientRequest &request) {
+    ASSERT(request.recv_time_ >= last_recv_time_, "Requests out of receive time order.");
+    auto &next_order_id = next_order_id_[request.request_.client_id_];
+    if (request.request_.order_id_ != next_order_id) {
+      ++session_reorders_;
+    }
+    last_recv_time_ = request.recv_time_;
+    next_order_id = request.request_.order_id_ + 1;
+  }
+};
+
+template<typename Sequencer>
+auto run(Sequencer &sequencer, const std::vector<std::vector<Burst>> &rounds, size_t num_sessions) {
+  Result result;
+  std::vector<OrderId> next_order_id(num_sessions, 0);
+  OrderChecker checker;
+  checker.next_order_id_.assign(num_sessions, 0);
+
+  for (const auto &bursts : rounds) {
+    const auto start = Common::getCurrentNanos();
+    for (const auto &burst : bursts) {
+      for (size_t i = 0; i < burst.size_; ++i) {
+        // The session index doubles as the client id so the checker can follow each session.
+        const MEClientRequest request{ClientRequestType::NEW, static_cast<ClientId>(burst.session_), 0, next_order_id[burst.session_]++,
+                                      Side::BUY, 100, 10};
+        sequencer.add(burst.session_, burst.recv_time_, request);
+      }
+      result.requests_ += burst.size_;
+    }
+
+    // Only the ordering is timed, the checker runs afterwards over a copy of the output.
+    outputs.clear();
+    if constexpr (std::is_same_v<Sequencer, SessionRunMerger>) {
+      sequencer.merge([](const RecvTimeClientRequest &request) { outputs.push_back(request); });
+    } else {
+      sequencer.sequence([](const RecvTimeClientRequest &request) { outputs.push_back(request); });
+    }
+    result.round_nanos_.push_back(Common::getCurrentNanos() - start);
+
+    for (const auto &request : outputs) {
+      checker(request);
+    }
+  }
+  result.session_reorders_ = checker.session_reorders_;
+
+  return result;
+}
+
+int main(int, char **) {
+  outputs.reserve(1024 * 1024);
+  std::cout << "Sequencing " << NUM_ROUNDS << " polls with burst-probability:" << BURST_PROBABILITY << " mean-burst:" << MEAN_BURST_SIZE
+            << " max-burst:" << MAX_BURST_SIZE << std::endl;
+
+  for (const size_t num_sessions : {10, 100, 1000}) {
+    // The same arrivals for both sequencers, sessions are read in a random order within a poll but receive times increase per session.
+    std::mt19937_64 rng(num_sessions);
+    std::bernoulli_distribution bursts(BURST_PROBABILITY);
+    std::geometric_distribution<size_t> burst_size(1.0 / MEAN_BURST_SIZE);
+    std::uniform_int_distribution<Nanos> offset(0, POLL_WINDOW_NANOS - 1);
+
+    std::vector<size_t> sessions(num_sessions);
+    std::iota(sessions.begin(), sessions.end(), 0);
+    std::vector<std::vector<Burst>> rounds(NUM_ROUNDS);
+    for (size_t round = 0; round < NUM_ROUNDS; ++round) {
+      std::shuffle(sessions.begin(), sessions.end(), rng);
+      for (const auto session : sessions) {
+        if (bursts(rng)) {
+          rounds[round].push_back({session, static_cast<Nanos>(round) * POLL_WINDOW_NANOS + offset(rng), std::min(1 + burst_size(rng), MAX_BURST_SIZE)});
+        }
+      }
+    }
+
+    SortingSequencer sorting;
+    const auto sorted = run(sorting, rounds, num_sessions);
+    SessionRunMerger merger(outputs.capacity());
+    const auto merged = run(merger, rounds, num_sessions);
+    ASSERT(!merged.session_reorders_, "Merged requests out of session order.");
+
+    for (const auto &[name, result] : {std::make_pair("sort", &sorted), std::make_pair("merge", &merged)}) {
+      auto round_nanos = result->round_nanos_;
+      std::sort(round_nanos.begin(), round_nanos.end());
+      const auto total = std::accumulate(round_nanos.begin(), round_nanos.end(), static_cast<Nanos>(0));
+      std::cout << "sessions:" << num_sessions << " " << name
+                << " requests/poll:" << result->requests_ / NUM_ROUNDS
+                << " ns/request:" << static_cast<double>(total) / result->requests_
+                << " poll-p50-ns:" << round_nanos[round_nanos.size() / 2]
+                << " poll-p99-ns:" << round_nanos[round_nanos.size() * 99 / 100]
+                << " session-reorders:" << result->session_reorders_
+                << std::endl;
+    }
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,166 @@
+#include <dlfcn.h>
+#include <cstdarg>
+#include <numeric>
+
+#include "tcp_server.h"
+
+/// Compares the epoll and io_uring TCPServer backends over loopback with 1 to 256 sessions. Every round each client sends one timestamped
+/// frame, the server echoes it back from its receive callback, and the round ends once every client read its echo.
+/// Reports the system calls the server thread makes per message and the round trip latency percentiles.
+
+using namespace Common;
+
+constexpr size_t TOTAL_MESSAGES = 200 * 1000;
+constexpr size_t MIN_ROUNDS = 1000;
+constexpr size_t WARMUP_ROUNDS = 100;
+constexpr int BASE_PORT = 12300;
+
+struct Frame {
+  uint64_t seq_ = 0;
+  Nanos send_time_ = 0;
+};
+
+/// System calls made by the server are counted by wrapping the libc functions it uses, only while count_syscalls is set on this thread.
+thread_local bool count_syscalls = false;
+size_t num_syscalls = 0;
+
+template<typename F>
+auto real(const char *name) {
+  static auto fn = reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+  return fn;
+}
+
+#define COUNT_SYSCALL() if (count_syscalls) ++num_syscalls
+
+extern "C" {
+ssize_t recvmsg(int fd, msghdr *msg, int flags) {
+  COUNT_SYSCALL();
+  return real<ssize_t (*)(int, msghdr *, int)>("recvmsg")(fd, msg, flags);
+}
+
+ssize_t send(int fd, const void *buf, size_t len, int flags) {
+  COUNT_SYSCALL();
+  return real<ssize_t (*)(int, const void *, size_t, int)>("send")(fd, buf, len, flags);
+}
+
+int epoll_wait(int epfd, epoll_event *events, int max_events, int timeout) {
+  COUNT_SYSCALL();
+  return real<int (*)(int, epoll_event *, int, int)>("epoll_wait")(epfd, events, max_events, timeout);
+}
+
+int epoll_ctl(int epfd, int op, int fd, epoll_event *event) noexcept {
+  COUNT_SYSCALL();
+  return real<int (*)(int, int, int, epoll_event *)>("epoll_ctl")(epfd, op, fd, event);
+}
+
+long syscall(long number, ...) noexcept {
+  COUNT_SYSCALL();
+  va_list args;
+  va_start(args, number);
+  long arg[6];
+  for (auto &a : arg) {
+    a = va_arg(args, long);
+  }
+  va_end(args);
+  return real<long (*)(long, ...)>("syscall")(number, arg[0], arg[1], arg[2], arg[3], arg[4], arg[5]);
+}
+}
+
+struct Result {
+  size_t messages_ = 0;
+  size_t syscalls_ = 0;
+  std::vector<Nanos> latencies_;
+};
+
+auto run(TCPServerBackend backend, size_t num_sessions, int port, Logger &logger) {
+  TCPServer server(logger, num_sessions, backend);
+  server.recv_callback_ = [](TCPSocket *socket, Nanos) {
+    const auto len = socket->inbound_.size() - socket->inbound_.size() % sizeof(Frame);
+    socket->send(socket->inbound_.readData(), len);
+    socket->inbound_.consume(len);
+  };
+  server.recv_finished_callback_ = []() {};
+  server.listen("lo", port);
+
+  const auto server_loop = [&]() {
+    count_syscalls = true;
+    server.poll();
+    server.sendAndRecv();
+    count_syscalls = false;
+  };
+
+  std::vector<int> clients;
+  for (size_t i = 0; i < num_sessions; ++i) {
+    const auto fd = createSocket(logger, SocketCfg{"127.0.0.1", "", port, false, false, false});
+    ASSERT(fd >= 0, "Client failed to connect.");
+    clients.push_back(fd);
+  }
+  while (server.sessions_.size() < num_sessions) {
+    server_loop();
+  }
+
+  Result result;
+  const auto num_rounds = std::max(TOTAL_MESSAGES / num_sessions, MIN_ROUNDS);
+  result.latencies_.reserve(num_rounds * num_sessions);
+  std::vector<size_t> pending(num_sessions);
+  for (size_t round = 0; round < WARMUP_ROUNDS + num_rounds; ++round) {
+    if (round == WARMUP_ROUNDS) {
+      num_syscalls = 0;
+    }
+
+    for (auto fd : clients) {
+      const Frame frame{round, getCurrentNanos()};
+      ASSERT(::send(fd, &frame, sizeof(frame), MSG_NOSIGNAL) == sizeof(frame), "Client send failed.");
+    }
+
+    size_t outstanding = num_sessions;
+    std::fill(pending.begin(), pending.end(), 1);
+    while (outstanding) {
+      server_loop();
+      for (size_t i = 0; i < num_sessions; ++i) {
+        Frame frame;
+        if (pending[i] && ::recv(clients[i], &frame, sizeof(frame), MSG_DONTWAIT) == sizeof(frame)) {
+          ASSERT(frame.seq_ == round, "Echo out of order.");
+          if (round >= WARMUP_ROUNDS) {
+            result.latencies_.push_back(getCurrentNanos() - frame.send_time_);
+          }
+          pending[i] = 0;
+          --outstanding;
+        }
+      }
+    }
+  }
+  result.messages_ = num_rounds * num_sessions;
+  result.syscalls_ = num_syscalls;
+
+  for (auto fd : clients) {
+    close(fd);
+  }
+  // Let the server see every client go before it is destroyed.
+  while (!server.sessions_.empty()) {
+    server_loop();
+  }
+
+  return result;
+}
+
+int main(int, char **) {
+  Logger logger("tcp_backend_benchmark.log");
+  std::cout << "Echoing " << TOTAL_MESSAGES << " messages (at least " << MIN_ROUNDS << " rounds) over loopback per backend and session count." << std::endl;
+
+  auto port = BASE_PORT; // a TCPServer does not close its listener, every run listens on a port of its own.
+  for (const size_t num_sessions : {1, 4, 16, 64, 256}) {
+    for (const auto backend : {TCPServerBackend::EPOLL, TCPServerBackend::IO_URING}) {
+      auto result = run(backend, num_sessions, port++, logger);
+      std::sort(result.latencies_.begin(), result.latencies_.end());
+      std::cout << "sessions:" << num_sessions << " " << tcpServerBackendToString(backend)
+                << " messages:" << result.messages_
+                << " syscalls/message:" << static_cast<double>(result.syscalls_) / result.messages_
+                << " rtt-p50-ns:" << result.latencies_[result.latencies_.size() / 2]
+                << " rtt-p99-ns:" << result.latencies_[result.latencies_.size() * 99 / 100]
+                << std::endl;
+    }
+  }
+
+  exit(EXIT_SUCCESS);
+}
@@ -4,172 +4,421 @@ namespace Trading {
   MarketDataConsumer::MarketDataConsumer(Common::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates,
                                          const std::string &iface,
                                          const std::string &snapshot_ip, int snapshot_port,
-                                         const std::string &incremental_ip, int incremental_port)
+                                         const std::string &incremental_ip, int incremental_port,
+                                         const std::string &retransmit_ip, int retransmit_port, bool use_shm,
+                                         size_t incremental_channels, size_t snapshot_channels, const std::vector<Common::TickerId> &tickers)
       : incoming_md_updates_(market_updates), run_(false),
         logger_("trading_market_data_consumer_" + std::to_string(client_id) + ".log"),
-        incremental_mcast_socket_(logger_), snapshot_mcast_socket_(logger_),
-        iface_(iface), snapshot_ip_(snapshot_ip), snapshot_port_(snapshot_port) {
-    auto recv_callback = [this](auto socket) {
-      recvCallback(socket);
-    };
+        use_shm_(use_shm), iface_(iface), snapshot_ip_(snapshot_ip),
+        retransmit_ip_(retransmit_ip), retransmit_port_(retransmit_port) {
+    // Snapshot cycles are split the same way as the incremental stream whenever it is split.
+    if (incremental_channels) {
+      snapshot_channels = incremental_channels;
+    }
 
-    incremental_mcast_socket_.recv_callback_ = recv_callback;
-    ASSERT(incremental_mcast_socket_.init(incremental_ip, iface, incremental_port, /*is_listening*/ true) >= 0,
-           "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+    // Every instrument kept is read from the incremental channel it is on and recovered from the snapshot channel it is on, all of them
+    // from the incremental and snapshot ports without channels.
+    ticker_snapshot_channel_.fill(nullptr);
+    std::array<IncrementalChannel *, ME_MAX_TICKERS> channels{};
+    std::array<SnapshotChannel *, ME_MAX_TICKERS> snapshot_channels_by_index{};
+    for (TickerId ticker_id = 0; ticker_id < ME_MAX_TICKERS; ++ticker_id) {
+      if (!tickers.empty() && std::find(tickers.begin(), tickers.end(), ticker_id) == tickers.end()) {
+        continue;
+      }
 
-    ASSERT(incremental_mcast_socket_.join(incremental_ip),
-           "Join failed on:" + std::to_string(incremental_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+      const auto index = incremental_channels ? Exchange::mdpChannel(ticker_id, incremental_channels) : 0;
+      auto &channel = channels.at(index);
+      if (!channel) {
+        channel = new IncrementalChannel(logger_, index,
+                                         incremental_channels ? Exchange::mdpIncrementalChannelPort(incremental_port, index) : incremental_port,
+                                         Exchange::mdpShmRingName(incremental_channels, index));
+        channel->mcast_socket_.recv_callback_ = [this, channel](auto socket) { recvCallback(channel, nullptr, socket); };
+        channel->retransmit_socket_.recv_callback_ = [this, channel](auto socket, auto) { retransmitCallback(channel, socket); };
+        if (!use_shm_) {
+          ASSERT(channel->mcast_socket_.init(incremental_ip, iface, channel->port_, /*is_listening*/ true) >= 0,
+                 "Unable to create incremental mcast socket. error:" + std::string(std::strerror(errno)));
+
+          ASSERT(channel->mcast_socket_.join(incremental_ip),
+                 "Join failed on:" + std::to_string(channel->mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+        }
+        incremental_channels_.push_back(channel);
+      }
 
-    snapshot_mcast_socket_.recv_callback_ = recv_callback;
+      const auto snapshot_index = snapshot_channels ? Exchange::mdpChannel(ticker_id, snapshot_channels) : 0;
+      auto &snapshot_channel = snapshot_channels_by_index.at(snapshot_index);
+      if (!snapshot_channel) {
+        snapshot_channel = new SnapshotChannel(logger_, snapshot_channels ? Exchange::mdpSnapshotChannelPort(snapshot_port, snapshot_index) : snapshot_port);
+        snapshot_channel->mcast_socket_.recv_callback_ = [this, channel, snapshot_channel](auto socket) { recvCallback(channel, snapshot_channel, socket); };
+        channel->snapshot_channels_.push_back(snapshot_channel);
+      }
+      ticker_snapshot_channel_[ticker_id] = snapshot_channel;
+    }
+    ASSERT(!incremental_channels_.empty(), "No instruments to keep the books of.");
+    shm_updates_.reserve(1024);
   }
 
   /// Main loop for this thread - reads and processes messages from the multicast sockets - the heavy lifting is in the recvCallback() and checkSnapshotSync() methods.
   auto MarketDataConsumer::run() noexcept -> void {
     logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
     while (run_) {
-      incremental_mcast_socket_.sendAndRecv();
-      snapshot_mcast_socket_.sendAndRecv();
+      for (auto channel: incremental_channels_) {
+        if (use_shm_) {
+          recvShmIncremental(channel);
+        } else {
+          channel->mcast_socket_.sendAndRecv();
+        }
+        for (auto snapshot_channel: channel->snapshot_channels_) {
+          snapshot_channel->mcast_socket_.sendAndRecv();
+        }
+
+        if (UNLIKELY(channel->retransmit_pending_)) {
+          channel->retransmit_socket_.sendAndRecv();
+          if (channel->retransmit_pending_ && channel->retransmit_socket_.disconnected()) {
+            abandonRetransmit(channel, "retransmit server disconnected");
+          } else if (channel->retransmit_pending_ && Common::getCurrentNanos() > channel->retransmit_deadline_) {
+            abandonRetransmit(channel, "retransmit request timed out");
+          }
+        }
+
+        // Closed here rather than from inside its recv callback, before this channel can ask for anything again.
+        if (UNLIKELY(channel->retransmit_disconnect_reason_)) {
+          channel->retransmit_socket_.disconnect(channel->retransmit_disconnect_reason_);
+          channel->retransmit_disconnect_reason_ = nullptr;
+        }
+      }
     }
   }
 
-  /// Start the process of snapshot synchronization by subscribing to the snapshot multicast stream.
-  auto MarketDataConsumer::startSnapshotSync() -> void {
-    snapshot_queued_msgs_.clear();
-    incremental_queued_msgs_.clear();
+  /// Recover the updates of a channel missed before seq_num: ask the retransmit server for them if there are few enough, else start
+  /// snapshot synchronization.
+  auto MarketDataConsumer::startRecovery(IncrementalChannel *channel, size_t seq_num) -> void {
+    const auto next_exp_inc_seq_num = channel->next_exp_inc_seq_num_;
+    if (seq_num > next_exp_inc_seq_num && seq_num - next_exp_inc_seq_num <= Exchange::MDP_MAX_RETRANSMIT_UPDATES &&
+        requestRetransmit(channel, next_exp_inc_seq_num, seq_num)) {
+      return;
+    }
+
+    startSnapshotSync(channel);
+  }
+
+  /// Ask the retransmit server for the updates of a channel numbered [begin_seq, end_seq), returns false if it cannot be reached.
+  auto MarketDataConsumer::requestRetransmit(IncrementalChannel *channel, size_t begin_seq, size_t end_seq) -> bool {
+    auto &retransmit_socket = channel->retransmit_socket_;
+    if (retransmit_socket.disconnected()) {
+      retransmit_socket.reset();
+      if (retransmit_socket.connect(retransmit_ip_, iface_, retransmit_port_, /*is_listening*/ false) < 0) {
+        logger_.log("%:% %() % Unable to connect to retransmit server %:% error:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), retransmit_ip_, retransmit_port_, std::strerror(errno));
+        return false;
+      }
+    }
+
+    // Sent from the main loop, which also reads the response: the update that revealed the gap is queued up first.
+    const Exchange::MDPRetransmitRequest request{begin_seq, end_seq, channel->index_};
+    logger_.log("%:% %() % Requesting %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), request.toString());
+    retransmit_socket.send(&request, sizeof(request));
 
-    ASSERT(snapshot_mcast_socket_.init(snapshot_ip_, iface_, snapshot_port_, /*is_listening*/ true) >= 0,
-           "Unable to create snapshot mcast socket. error:" + std::string(std::strerror(errno)));
-    ASSERT(snapshot_mcast_socket_.join(snapshot_ip_), // IGMP multicast subscription.
-           "Join failed on:" + std::to_string(snapshot_mcast_socket_.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+    channel->retransmit_pending_ = true;
+    channel->retransmit_deadline_ = Common::getCurrentNanos() + MD_RETRANSMIT_TIMEOUT_NANOS;
+    return true;
   }
 
-  /// Check if a recovery / synchronization is possible from the queued up market data updates from the snapshot and incremental market data streams.
-  auto MarketDataConsumer::checkSnapshotSync() -> void {
-    if (snapshot_queued_msgs_.empty()) {
+  /// Read the retransmit server's response to a channel's request, queueing up the updates it sent.
+  auto MarketDataConsumer::retransmitCallback(IncrementalChannel *channel, Common::TCPSocket *socket) noexcept -> void {
+    if (UNLIKELY(!channel->retransmit_pending_ || socket->inbound_.size() < sizeof(Exchange::MDPRetransmitResponse))) {
       return;
     }
 
-    const auto &first_snapshot_msg = snapshot_queued_msgs_.begin()->second;
-    if (first_snapshot_msg.type_ != Exchange::MarketUpdateType::SNAPSHOT_START) {
-      logger_.log("%:% %() % Returning because have not seen a SNAPSHOT_START yet.\n",
-                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
-      snapshot_queued_msgs_.clear();
+    const auto response = reinterpret_cast<const Exchange::MDPRetransmitResponse *>(socket->inbound_.readData());
+    if (!response->accepted_) {
+      logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
+      socket->inbound_.consume(sizeof(Exchange::MDPRetransmitResponse));
+      abandonRetransmit(channel, "retransmit request rejected");
       return;
     }
 
-    std::vector<Exchange::MEMarketUpdate> final_events;
+    const auto num_updates = response->end_seq_ - response->begin_seq_;
+    if (socket->inbound_.size() < sizeof(Exchange::MDPRetransmitResponse) + num_updates * sizeof(Exchange::MDPMarketUpdate)) {
+      return; // the rest of the updates are still on their way.
+    }
+    logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
 
-    auto have_complete_snapshot = true;
-    size_t next_snapshot_seq = 0;
-    for (auto &snapshot_itr: snapshot_queued_msgs_) {
-      logger_.log("%:% %() % % => %\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), snapshot_itr.first, snapshot_itr.second.toString());
-      if (snapshot_itr.first != next_snapshot_seq) {
-        have_complete_snapshot = false;
-        logger_.log("%:% %() % Detected gap in snapshot stream expected:% found:% %.\n", __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str_), next_snapshot_seq, snapshot_itr.first, snapshot_itr.second.toString());
-        break;
+    const auto updates = reinterpret_cast<const Exchange::MDPMarketUpdate *>(socket->inbound_.readData() + sizeof(Exchange::MDPRetransmitResponse));
+    for (size_t i = 0; i < num_updates; ++i) {
+      channel->queued_msgs_[updates[i].seq_num_] = updates[i].me_market_update_;
+    }
+    socket->inbound_.consume(sizeof(Exchange::MDPRetransmitResponse) + num_updates * sizeof(Exchange::MDPMarketUpdate));
+
+    channel->retransmit_pending_ = false;
+    checkRetransmitSync(channel);
+  }
+
+  /// Give up on a channel's pending retransmit request, closing its connection from run(), and start snapshot synchronization.
+  auto MarketDataConsumer::abandonRetransmit(IncrementalChannel *channel, const char *reason) -> void {
+    logger_.log("%:% %() % % channel:% SeqNum expected:%, recovering from snapshots.\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), reason, channel->index_, channel->next_exp_inc_seq_num_);
+    channel->retransmit_pending_ = false;
+    if (!channel->retransmit_socket_.disconnected()) { // a late response to this request must not be taken for the next one's.
+      channel->retransmit_disconnect_reason_ = reason;
+    }
+
+    startSnapshotSync(channel);
+  }
+
+  /// Check if a channel's queued up incremental updates complete its stream now that the retransmitted ones are in, forwarding them if they do.
+  auto MarketDataConsumer::checkRetransmitSync(IncrementalChannel *channel) -> void {
+    auto &queued_msgs = channel->queued_msgs_;
+    size_t num_incrementals = 0;
+    auto inc_itr = queued_msgs.begin();
+    for (; inc_itr != queued_msgs.end() && inc_itr->first <= channel->next_exp_inc_seq_num_; ++inc_itr) {
+      if (inc_itr->first < channel->next_exp_inc_seq_num_) {
+        continue;
       }
 
-      if (snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_START &&
-          snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_END)
-        final_events.push_back(snapshot_itr.second);
+      forward(inc_itr->second);
 
-      ++next_snapshot_seq;
+      ++channel->next_exp_inc_seq_num_;
+      ++num_incrementals;
     }
+    queued_msgs.erase(queued_msgs.begin(), inc_itr);
 
-    if (!have_complete_snapshot) {
-      logger_.log("%:% %() % Returning because found gaps in snapshot stream.\n",
-                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
-      snapshot_queued_msgs_.clear();
-      return;
+    logger_.log("%:% %() % Recovered % incremental updates on channel:%, still queued:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), num_incrementals, channel->index_, queued_msgs.size());
+
+    if (queued_msgs.empty()) {
+      channel->in_recovery_ = false;
+    } else { // another gap opened up while waiting for the retransmission.
+      startRecovery(channel, queued_msgs.begin()->first);
     }
+  }
 
-    const auto &last_snapshot_msg = snapshot_queued_msgs_.rbegin()->second;
-    if (last_snapshot_msg.type_ != Exchange::MarketUpdateType::SNAPSHOT_END) {
-      logger_.log("%:% %() % Returning because have not seen a SNAPSHOT_END yet.\n",
-                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
-      return;
+  /// Process the datagrams published to a channel's shared memory ring since the last call, attaching to it first if need be.
+  auto MarketDataConsumer::recvShmIncremental(IncrementalChannel *channel) noexcept -> void {
+    auto &shm_ring = channel->shm_ring_;
+    if (UNLIKELY(!shm_ring || !shm_ring->producerAlive())) {
+      // Either the publisher has not created its ring yet, or it exited and a restarted one may have replaced it.
+      const auto now = Common::getCurrentNanos();
+      if (now < channel->next_shm_attach_time_) {
+        return;
+      }
+      channel->next_shm_attach_time_ = now + MD_SHM_ATTACH_INTERVAL_NANOS;
+
+      delete shm_ring;
+      shm_ring = new Common::ShmBroadcastRing(channel->shm_ring_name_);
+      if (!shm_ring->valid() || !shm_ring->producerAlive()) {
+        delete shm_ring;
+        shm_ring = nullptr;
+        return;
+      }
+
+      // Like joining the multicast group, reading starts with whatever is published next, the sequence numbers then call for a recovery.
+      channel->next_shm_packet_ = shm_ring->published();
+      logger_.log("%:% %() % Attached to incremental ring % pid:% slots:% next:%\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), channel->shm_ring_name_, shm_ring->producerPid(),
+                  shm_ring->numSlots(), channel->next_shm_packet_);
     }
 
-    auto have_complete_incremental = true;
-    size_t num_incrementals = 0;
-    next_exp_inc_seq_num_ = last_snapshot_msg.order_id_ + 1;
-    for (auto inc_itr = incremental_queued_msgs_.begin(); inc_itr != incremental_queued_msgs_.end(); ++inc_itr) {
-      logger_.log("%:% %() % Checking next_exp:% vs. seq:% %.\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_, inc_itr->first, inc_itr->second.toString());
+    const auto published = shm_ring->published();
+    auto &next_shm_packet = channel->next_shm_packet_;
+    if (UNLIKELY(published - next_shm_packet > shm_ring->numSlots())) {
+      shmOverrun(channel, published);
+      return;
+    }
 
-      if (inc_itr->first < next_exp_inc_seq_num_)
+    for (; next_shm_packet < published; ++next_shm_packet) {
+      TTT_MEASURE(T7_MarketDataConsumer_UDP_read, logger_);
+
+      // Decoded straight out of the ring, but only used once the ring confirms the publisher did not overwrite the slot meanwhile.
+      Exchange::MDPPacketHeader header;
+      shm_updates_.clear();
+      const auto intact = shm_ring->read(next_shm_packet, [this, &header](const char *data, size_t len) {
+        memcpy(&header, data, sizeof(header));
+        if (len >= sizeof(Exchange::MDPPacketHeader) && header.version_ == Exchange::MDP_VERSION && header.size_ <= len) {
+          Exchange::mdpDecodePacket(data, [this](const Exchange::MDPMarketUpdate &market_update) {
+            shm_updates_.push_back(market_update);
+          });
+        }
+      });
+      if (UNLIKELY(!intact)) {
+        shmOverrun(channel, shm_ring->published());
+        return;
+      }
+      if (UNLIKELY(header.version_ != Exchange::MDP_VERSION || header.size_ < sizeof(Exchange::MDPPacketHeader))) {
+        logger_.log("%:% %() % ERROR Dropping incremental data of unknown wire format %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), header.toString());
         continue;
+      }
+      logger_.log("%:% %() % Received incremental packet % delay:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  header.toString(), Common::getCurrentNanos() - header.send_time_);
 
-      if (inc_itr->first != next_exp_inc_seq_num_) {
-        logger_.log("%:% %() % Detected gap in incremental stream expected:% found:% %.\n", __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num_, inc_itr->first, inc_itr->second.toString());
-        have_complete_incremental = false;
-        break;
+      for (const auto &market_update: shm_updates_) {
+        onMarketUpdate(channel, nullptr, market_update);
       }
+    }
+  }
 
-      logger_.log("%:% %() % % => %\n", __FILE__, __LINE__, __FUNCTION__,
-                  Common::getCurrentTimeStr(&time_str_), inc_itr->first, inc_itr->second.toString());
+  /// Skip past everything published to a channel's shared memory ring, having lost datagrams that were overwritten before they were read.
+  auto MarketDataConsumer::shmOverrun(IncrementalChannel *channel, size_t published) noexcept -> void {
+    logger_.log("%:% %() % Overrun on incremental ring %, lost packets:% SeqNum expected:%\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), channel->shm_ring_name_, published - channel->next_shm_packet_, channel->next_exp_inc_seq_num_);
+    channel->next_shm_packet_ = published;
 
-      if (inc_itr->second.type_ != Exchange::MarketUpdateType::SNAPSHOT_START &&
-          inc_itr->second.type_ != Exchange::MarketUpdateType::SNAPSHOT_END)
-        final_events.push_back(inc_itr->second);
+    // Recover right away rather than on the next update's sequence number, the publisher may have nothing more to send for a while.
+    if (!channel->in_recovery_) {
+      channel->in_recovery_ = true;
+      startSnapshotSync(channel);
+    }
+  }
 
-      ++next_exp_inc_seq_num_;
-      ++num_incrementals;
+  /// Start the process of snapshot synchronization of a channel by subscribing to its snapshot multicast streams.
+  auto MarketDataConsumer::startSnapshotSync(IncrementalChannel *channel) -> void {
+    channel->queued_msgs_.clear();
+
+    for (auto snapshot_channel: channel->snapshot_channels_) {
+      snapshot_channel->queued_msgs_.clear();
+
+      auto &socket = snapshot_channel->mcast_socket_;
+      ASSERT(socket.init(snapshot_ip_, iface_, snapshot_channel->port_, /*is_listening*/ true) >= 0,
+             "Unable to create snapshot mcast socket. error:" + std::string(std::strerror(errno)));
+      ASSERT(socket.join(snapshot_ip_), // IGMP multicast subscription.
+             "Join failed on:" + std::to_string(socket.socket_fd_) + " error:" + std::string(std::strerror(errno)));
+    }
+  }
+
+  /// Check if a snapshot stream's queued up updates are a whole snapshot cycle, clearing them if they cannot become one.
+  auto MarketDataConsumer::checkSnapshotCycle(SnapshotChannel *snapshot_channel) -> bool {
+    auto &queued_msgs = snapshot_channel->queued_msgs_;
+    if (queued_msgs.empty()) {
+      return false;
+    }
+
+    const auto &first_snapshot_msg = queued_msgs.begin()->second;
+    if (first_snapshot_msg.type_ != Exchange::MarketUpdateType::SNAPSHOT_START) {
+      logger_.log("%:% %() % Returning because have not seen a SNAPSHOT_START yet on port:%.\n",
+                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), snapshot_channel->port_);
+      queued_msgs.clear();
+      return false;
+    }
+
+    // Snapshot sequence numbers count from 0 at the SNAPSHOT_START, so the cycle has no gaps if the last one matches their count.
+    const auto &last_snapshot_itr = *queued_msgs.rbegin();
+    if (last_snapshot_itr.first != queued_msgs.size() - 1) {
+      logger_.log("%:% %() % Returning because found gaps in snapshot stream on port:%.\n",
+                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), snapshot_channel->port_);
+      queued_msgs.clear();
+      return false;
+    }
+
+    if (last_snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_END) {
+      logger_.log("%:% %() % Returning because have not seen a SNAPSHOT_END yet on port:%.\n",
+                  __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), snapshot_channel->port_);
+      return false;
+    }
+
+    return true;
+  }
+
+  /// Check if a recovery / synchronization of a channel is possible from the queued up market data updates from its snapshot and incremental market data streams.
+  auto MarketDataConsumer::checkSnapshotSync(IncrementalChannel *channel) -> void {
+    // Every snapshot stream needs a whole cycle, each one's SNAPSHOT_END carries the last incremental sequence number it includes.
+    const auto &snapshot_channels = channel->snapshot_channels_;
+    auto &incremental_queued_msgs = channel->queued_msgs_;
+    auto first_inc_seq_num = std::numeric_limits<size_t>::max();
+    for (auto snapshot_channel: snapshot_channels) {
+      if (!checkSnapshotCycle(snapshot_channel)) {
+        return;
+      }
+      first_inc_seq_num = std::min(first_inc_seq_num, snapshot_channel->queued_msgs_.rbegin()->second.order_id_ + 1);
+    }
+
+    // The incremental updates from the oldest snapshot on, without gaps.
+    auto have_complete_incremental = true;
+    auto &next_exp_inc_seq_num = channel->next_exp_inc_seq_num_;
+    next_exp_inc_seq_num = first_inc_seq_num;
+    for (auto inc_itr = incremental_queued_msgs.lower_bound(first_inc_seq_num); inc_itr != incremental_queued_msgs.end(); ++inc_itr) {
+      if (inc_itr->first != next_exp_inc_seq_num) {
+        logger_.log("%:% %() % Detected gap in incremental stream expected:% found:% %.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), next_exp_inc_seq_num, inc_itr->first, inc_itr->second.toString());
+        have_complete_incremental = false;
+        break;
+      }
+      ++next_exp_inc_seq_num;
     }
 
     if (!have_complete_incremental) {
       logger_.log("%:% %() % Returning because have gaps in queued incrementals.\n",
                   __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
-      snapshot_queued_msgs_.clear();
+      for (auto snapshot_channel: snapshot_channels) {
+        snapshot_channel->queued_msgs_.clear();
+      }
       return;
     }
 
-    for (const auto &itr: final_events) {
-      auto next_write = incoming_md_updates_->getNextToWriteTo();
-      *next_write = itr;
-      incoming_md_updates_->updateWriteIndex();
+    // Each instrument's book from its snapshot, then the incremental updates to it past that snapshot.
+    size_t num_snapshots = 0, num_incrementals = 0;
+    for (auto snapshot_channel: snapshot_channels) {
+      for (const auto &snapshot_itr: snapshot_channel->queued_msgs_) {
+        if (snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_START &&
+            snapshot_itr.second.type_ != Exchange::MarketUpdateType::SNAPSHOT_END) {
+          num_snapshots += forward(snapshot_itr.second);
+        }
+      }
+    }
+
+    for (auto inc_itr = incremental_queued_msgs.lower_bound(first_inc_seq_num); inc_itr != incremental_queued_msgs.end(); ++inc_itr) {
+      const auto &market_update = inc_itr->second;
+      if (market_update.type_ == Exchange::MarketUpdateType::SNAPSHOT_START || market_update.type_ == Exchange::MarketUpdateType::SNAPSHOT_END) {
+        continue;
+      }
+
+      const auto snapshot_channel = (market_update.ticker_id_ < ME_MAX_TICKERS) ? ticker_snapshot_channel_[market_update.ticker_id_] : nullptr;
+      if (snapshot_channel && inc_itr->first <= snapshot_channel->queued_msgs_.rbegin()->second.order_id_) {
+        continue; // already in the instrument's snapshot.
+      }
+      num_incrementals += forward(market_update);
     }
 
-    logger_.log("%:% %() % Recovered % snapshot and % incremental orders.\n", __FILE__, __LINE__, __FUNCTION__,
-                Common::getCurrentTimeStr(&time_str_), snapshot_queued_msgs_.size() - 2, num_incrementals);
+    logger_.log("%:% %() % Recovered channel:% from % snapshot and % incremental updates from % snapshot channels.\n", __FILE__, __LINE__,
+                __FUNCTION__, Common::getCurrentTimeStr(&time_str_), channel->index_, num_snapshots, num_incrementals, snapshot_channels.size());
 
-    snapshot_queued_msgs_.clear();
-    incremental_queued_msgs_.clear();
-    in_recovery_ = false;
+    incremental_queued_msgs.clear();
+    channel->in_recovery_ = false;
 
-    snapshot_mcast_socket_.leave(snapshot_ip_, snapshot_port_);;
+    for (auto snapshot_channel: snapshot_channels) {
+      snapshot_channel->queued_msgs_.clear();
+      snapshot_channel->mcast_socket_.leave(snapshot_ip_, snapshot_channel->port_);
+    }
   }
 
-  /// Queue up a message in the *_queued_msgs_ containers, first parameter specifies if this update came from the snapshot or the incremental streams.
-  auto MarketDataConsumer::queueMessage(bool is_snapshot, const Exchange::MDPMarketUpdate *request) {
-    if (is_snapshot) {
-      if (snapshot_queued_msgs_.find(request->seq_num_) != snapshot_queued_msgs_.end()) {
+  /// Queue up a message in the *queued_msgs_ containers, snapshot_channel is the snapshot stream it came from or nullptr for the incremental stream.
+  auto MarketDataConsumer::queueMessage(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, const Exchange::MDPMarketUpdate *request) {
+    if (snapshot_channel) {
+      auto &queued_msgs = snapshot_channel->queued_msgs_;
+      if (queued_msgs.find(request->seq_num_) != queued_msgs.end()) {
         logger_.log("%:% %() % Packet drops on snapshot socket. Received for a 2nd time:%\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), request->toString());
-        snapshot_queued_msgs_.clear();
+        queued_msgs.clear();
       }
-      snapshot_queued_msgs_[request->seq_num_] = request->me_market_update_;
+      queued_msgs[request->seq_num_] = request->me_market_update_;
     } else {
-      incremental_queued_msgs_[request->seq_num_] = request->me_market_update_;
+      channel->queued_msgs_[request->seq_num_] = request->me_market_update_;
     }
 
-    logger_.log("%:% %() % size snapshot:% incremental:% % => %\n", __FILE__, __LINE__, __FUNCTION__,
-                Common::getCurrentTimeStr(&time_str_), snapshot_queued_msgs_.size(), incremental_queued_msgs_.size(), request->seq_num_, request->toString());
+    logger_.log("%:% %() % channel:% size snapshot:% incremental:% % => %\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_), channel->index_, (snapshot_channel ? snapshot_channel->queued_msgs_.size() : 0),
+                channel->queued_msgs_.size(), request->seq_num_, request->toString());
 
-    checkSnapshotSync();
+    checkSnapshotSync(channel);
   }
 
-  /// Process a market data update, the consumer needs to use the socket parameter to figure out whether this came from the snapshot or the incremental stream.
-  auto MarketDataConsumer::recvCallback(McastSocket *socket) noexcept -> void {
+  /// Process the datagrams read on an incremental channel's socket, or on one of its snapshot channels' if snapshot_channel is set.
+  auto MarketDataConsumer::recvCallback(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, McastSocket *socket) noexcept -> void {
     TTT_MEASURE(T7_MarketDataConsumer_UDP_read, logger_);
 
     START_MEASURE(Trading_MarketDataConsumer_recvCallback);
-    const auto is_snapshot = (socket->socket_fd_ == snapshot_mcast_socket_.socket_fd_);
-    if (UNLIKELY(is_snapshot && !in_recovery_)) { // market update was read from the snapshot market data stream and we are not in recovery, so we dont need it and discard it.
-      socket->next_rcv_valid_index_ = 0;
+    const auto is_snapshot = (snapshot_channel != nullptr);
+    if (UNLIKELY(is_snapshot && !channel->in_recovery_)) { // market update was read from the snapshot market data stream and we are not in recovery, so we dont need it and discard it.
+      socket->inbound_.clear();
 
       logger_.log("%:% %() % WARN Not expecting snapshot messages.\n",
                   __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
@@ -177,40 +426,68 @@ namespace Trading {
       return;
     }
 
-    if (socket->next_rcv_valid_index_ >= sizeof(Exchange::MDPMarketUpdate)) {
-      size_t i = 0;
-      for (; i + sizeof(Exchange::MDPMarketUpdate) <= socket->next_rcv_valid_index_; i += sizeof(Exchange::MDPMarketUpdate)) {
-        auto request = reinterpret_cast<const Exchange::MDPMarketUpdate *>(socket->inbound_data_.data() + i);
-        logger_.log("%:% %() % Received % socket len:% %\n", __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str_),
-                    (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate), request->toString());
+    // Every datagram is an MDPPacketHeader followed by its encoded market updates, a read returns whole datagrams.
+    const auto data = socket->inbound_.readData();
+    size_t i = 0;
+    while (i + sizeof(Exchange::MDPPacketHeader) <= socket->inbound_.size()) {
+      const auto header = reinterpret_cast<const Exchange::MDPPacketHeader *>(data + i);
+      if (UNLIKELY(header->version_ != Exchange::MDP_VERSION || header->size_ < sizeof(Exchange::MDPPacketHeader))) {
+        logger_.log("%:% %() % ERROR Dropping % data of unknown wire format %\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"), header->toString());
+        i = socket->inbound_.size();
+        break;
+      }
+      const size_t packet_size = header->size_;
+      if (UNLIKELY(i + packet_size > socket->inbound_.size())) {
+        break;
+      }
+      logger_.log("%:% %() % Received % packet % delay:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                  (is_snapshot ? "snapshot" : "incremental"), header->toString(), Common::getCurrentNanos() - header->send_time_);
+
+      // Decoding reads a whole MDPWireMessage for every update, the last one can run past the mirrored ring's mapping.
+      auto packet = data + i;
+      if (UNLIKELY(i + packet_size + sizeof(Exchange::MDPWireMessage) > socket->inbound_.capacity())) {
+        memcpy(packet_copy_, packet, packet_size);
+        packet = packet_copy_;
+      }
 
-        const bool already_in_recovery = in_recovery_;
-        in_recovery_ = (already_in_recovery || request->seq_num_ != next_exp_inc_seq_num_);
+      Exchange::mdpDecodePacket(packet, [this, channel, snapshot_channel](const Exchange::MDPMarketUpdate &market_update) {
+        onMarketUpdate(channel, snapshot_channel, market_update);
+      });
+      i += packet_size;
+    }
+    socket->inbound_.consume(i);
+    END_MEASURE(Trading_MarketDataConsumer_recvCallback, logger_);
+  }
 
-        if (UNLIKELY(in_recovery_)) {
-          if (UNLIKELY(!already_in_recovery)) { // if we just entered recovery, start the snapshot synchonization process by subscribing to the snapshot multicast stream.
-            logger_.log("%:% %() % Packet drops on % socket. SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
-                        Common::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"), next_exp_inc_seq_num_, request->seq_num_);
-            startSnapshotSync();
-          }
+  /// Check the sequence number of a decoded update, and either forward it to the trade engine or queue it up for recovery.
+  auto MarketDataConsumer::onMarketUpdate(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, const Exchange::MDPMarketUpdate &market_update) noexcept -> void {
+    const auto request = &market_update;
+    const auto is_snapshot = (snapshot_channel != nullptr);
+    logger_.log("%:% %() % Received % %\n", __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str_),
+                (is_snapshot ? "snapshot" : "incremental"), request->toString());
+
+    const bool already_in_recovery = channel->in_recovery_;
+    channel->in_recovery_ = (already_in_recovery || request->seq_num_ != channel->next_exp_inc_seq_num_);
+
+    if (UNLIKELY(channel->in_recovery_)) {
+      if (UNLIKELY(!already_in_recovery)) { // if we just entered recovery, ask for the missed updates to be retransmitted or else subscribe to the snapshot multicast stream.
+        logger_.log("%:% %() % Packet drops on % socket of channel:%. SeqNum expected:% received:%\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), (is_snapshot ? "snapshot" : "incremental"), channel->index_,
+                    channel->next_exp_inc_seq_num_, request->seq_num_);
+        startRecovery(channel, request->seq_num_);
+      }
 
-          queueMessage(is_snapshot, request); // queue up the market data update message and check if snapshot recovery / synchronization can be completed successfully.
-        } else if (!is_snapshot) { // not in recovery and received a packet in the correct order and without gaps, process it.
-          logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__,
-                      Common::getCurrentTimeStr(&time_str_), request->toString());
+      queueMessage(channel, snapshot_channel, request); // queue up the market data update message and check if snapshot recovery / synchronization can be completed successfully.
+    } else if (!is_snapshot) { // not in recovery and received a packet in the correct order and without gaps, process it.
+      logger_.log("%:% %() % %\n", __FILE__, __LINE__, __FUNCTION__,
+                  Common::getCurrentTimeStr(&time_str_), request->toString());
 
-          ++next_exp_inc_seq_num_;
+      ++channel->next_exp_inc_seq_num_;
 
-          auto next_write = incoming_md_updates_->getNextToWriteTo();
-          *next_write = std::move(request->me_market_update_);
-          incoming_md_updates_->updateWriteIndex();
-          TTT_MEASURE(T8_MarketDataConsumer_LFQueue_write, logger_);
-        }
-      }
-      memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
-      socket->next_rcv_valid_index_ -= i;
+      forward(request->me_market_update_);
+      TTT_MEASURE(T8_MarketDataConsumer_LFQueue_write, logger_);
     }
-    END_MEASURE(Trading_MarketDataConsumer_recvCallback, logger_);
   }
 }
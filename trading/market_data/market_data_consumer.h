@@ -1,27 +1,61 @@
 #pragma once
 
 #include <functional>
+#include <algorithm>
 #include <map>
+#include <vector>
 
 #include "thread_utils.h"
 #include "lf_queue.h"
 #include "macros.h"
 #include "mcast_socket.h"
+#include "tcp_socket.h"
+#include "shm_broadcast_ring.h"
 
 #include "market_data/market_update.h"
+#include "market_data/md_wire_format.h"
+#include "market_data/md_retransmit.h"
 
 namespace Trading {
+  /// How often a consumer reading the incremental stream from shared memory looks for the publisher's ring, and checks it is still alive.
+  constexpr Nanos MD_SHM_ATTACH_INTERVAL_NANOS = 10 * NANOS_TO_MILLIS;
+
+  /// Longest a consumer waits for the retransmit server to fill a gap before recovering from the snapshot stream instead.
+  constexpr Nanos MD_RETRANSMIT_TIMEOUT_NANOS = 100 * NANOS_TO_MILLIS;
+
   class MarketDataConsumer {
   public:
+    /// Gaps in the incremental stream are filled from the retransmit server at retransmit_ip:retransmit_port if it still has them,
+    /// and recovered from the snapshot stream otherwise.
+    /// With use_shm the incremental stream is read from the publisher's shared memory ring, for an exchange on the same box, instead of
+    /// joining its multicast group. The snapshot stream used to recover is multicast either way.
+    /// Only the books of tickers are kept, every instrument's if empty. With the exchange's incremental_channels and snapshot_channels set
+    /// the same as its MarketDataCfg, only the incremental channels of those are read and the snapshot channels of those recovered from,
+    /// each incremental channel recovering from gaps in its own sequence independently of the others.
     MarketDataConsumer(Common::ClientId client_id, Exchange::MEMarketUpdateLFQueue *market_updates, const std::string &iface,
                        const std::string &snapshot_ip, int snapshot_port,
-                       const std::string &incremental_ip, int incremental_port);
+                       const std::string &incremental_ip, int incremental_port,
+                       const std::string &retransmit_ip, int retransmit_port, bool use_shm = false,
+                       size_t incremental_channels = 0, size_t snapshot_channels = 0, const std::vector<Common::TickerId> &tickers = {});
 
     ~MarketDataConsumer() {
       stop();
 
       using namespace std::literals::chrono_literals;
       std::this_thread::sleep_for(5s);
+
+      for (auto incremental_channel: incremental_channels_) {
+        delete incremental_channel->shm_ring_;
+        incremental_channel->shm_ring_ = nullptr;
+
+        for (auto snapshot_channel: incremental_channel->snapshot_channels_) {
+          delete snapshot_channel;
+        }
+        incremental_channel->snapshot_channels_.clear();
+
+        delete incremental_channel;
+      }
+      incremental_channels_.clear();
     }
 
     /// Start and stop the market data consumer main thread.
@@ -46,9 +80,6 @@ namespace Trading {
     MarketDataConsumer &operator=(const MarketDataConsumer &&) = delete;
 
   private:
-    /// Track the next expected sequence number on the incremental market data stream, used to detect gaps / drops.
-    size_t next_exp_inc_seq_num_ = 1;
-
     /// Lock free queue on which decoded market data updates are pushed to, to be consumed by the trade engine.
     Exchange::MEMarketUpdateLFQueue *incoming_md_updates_ = nullptr;
 
@@ -57,34 +88,138 @@ namespace Trading {
     std::string time_str_;
     Logger logger_;
 
-    /// Multicast subscriber sockets for the incremental and market data streams.
-    Common::McastSocket incremental_mcast_socket_, snapshot_mcast_socket_;
-
-    /// Tracks if we are currently in the process of recovering / synchronizing with the snapshot market data stream either because we just started up or we dropped a packet.
-    bool in_recovery_ = false;
+    /// Read the incremental streams from the publisher's shared memory rings instead of their multicast groups, and the updates of the
+    /// datagram being read from one - only used once the ring confirms it was not overwritten meanwhile.
+    const bool use_shm_;
+    std::vector<Exchange::MDPMarketUpdate> shm_updates_;
 
     /// Information for the snapshot multicast stream.
     const std::string iface_, snapshot_ip_;
-    const int snapshot_port_;
+
+    /// Information for the retransmit server.
+    const std::string retransmit_ip_;
+    const int retransmit_port_;
 
     /// Containers to queue up market data updates from the snapshot and incremental channels, queued up in order of increasing sequence numbers.
     typedef std::map<size_t, Exchange::MEMarketUpdate> QueuedMarketUpdates;
-    QueuedMarketUpdates snapshot_queued_msgs_, incremental_queued_msgs_;
+
+    /// A snapshot stream recovered from, the whole snapshot cycle or one snapshot channel's: its multicast subscriber socket and port, and the
+    /// updates queued up from it.
+    struct SnapshotChannel {
+      SnapshotChannel(Logger &logger, int port)
+          : mcast_socket_(logger), port_(port) {
+      }
+
+      Common::McastSocket mcast_socket_;
+      const int port_;
+      QueuedMarketUpdates queued_msgs_;
+    };
+
+    /// An incremental stream read, the whole incremental stream or one incremental channel's, see Exchange::mdpChannel(), with its own
+    /// sequence numbers and recovery from gaps in them.
+    struct IncrementalChannel {
+      IncrementalChannel(Logger &logger, size_t index, int port, const std::string &shm_ring_name)
+          : index_(index), mcast_socket_(logger), port_(port), shm_ring_name_(shm_ring_name), retransmit_socket_(logger) {
+      }
+
+      /// Channel number in retransmit requests, 0 without incremental channels.
+      const size_t index_;
+
+      /// Multicast subscriber socket for the incremental stream and its port.
+      Common::McastSocket mcast_socket_;
+      const int port_;
+
+      /// The publisher's shared memory ring the incremental stream is read from instead when use_shm_ is set, once it exists, and the next
+      /// datagram in it to read.
+      const std::string shm_ring_name_;
+      Common::ShmBroadcastRing *shm_ring_ = nullptr;
+      size_t next_shm_packet_ = 0;
+      Nanos next_shm_attach_time_ = 0;
+
+      /// Track the next expected sequence number on the incremental stream, used to detect gaps / drops.
+      size_t next_exp_inc_seq_num_ = 1;
+
+      /// Tracks if we are currently in the process of recovering / synchronizing with the snapshot market data stream either because we just started up or we dropped a packet.
+      bool in_recovery_ = false;
+
+      /// Incremental updates queued up during recovery.
+      QueuedMarketUpdates queued_msgs_;
+
+      /// The snapshot streams covering the instruments of this channel that are kept, recovered from together.
+      std::vector<SnapshotChannel *> snapshot_channels_;
+
+      /// Connection to the retransmit server, made when the first gap needs filling, and whether and until when a request on it is pending.
+      Common::TCPSocket retransmit_socket_;
+      bool retransmit_pending_ = false;
+      Nanos retransmit_deadline_ = 0;
+
+      /// Why the connection is to be closed once its recv callback returns, after giving up on a request, nullptr if it is not.
+      const char *retransmit_disconnect_reason_ = nullptr;
+    };
+
+    /// The incremental streams of the instruments whose books are kept, and the snapshot stream each instrument is on - nullptr for the
+    /// instruments whose updates are dropped.
+    std::vector<IncrementalChannel *> incremental_channels_;
+    std::array<SnapshotChannel *, ME_MAX_TICKERS> ticker_snapshot_channel_;
+
+    /// A datagram at the very end of a socket's receive ring is decoded from here, with room for the decoder to read past its last update.
+    char packet_copy_[std::numeric_limits<uint16_t>::max() + sizeof(Exchange::MDPWireMessage)];
 
   private:
     /// Main loop for this thread - reads and processes messages from the multicast sockets - the heavy lifting is in the recvCallback() and checkSnapshotSync() methods.
     auto run() noexcept -> void;
 
-    /// Process a market data update, the consumer needs to use the socket parameter to figure out whether this came from the snapshot or the incremental stream.
-    auto recvCallback(McastSocket *socket) noexcept -> void;
+    /// Process the datagrams read on an incremental channel's socket, or on one of its snapshot channels' if snapshot_channel is set.
+    auto recvCallback(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, McastSocket *socket) noexcept -> void;
+
+    /// Forward an update to the trade engine, unless it is for an instrument whose book is not kept, returns whether it did.
+    auto forward(const Exchange::MEMarketUpdate &market_update) noexcept {
+      if (market_update.ticker_id_ < ME_MAX_TICKERS && !ticker_snapshot_channel_[market_update.ticker_id_]) {
+        return false;
+      }
+
+      auto next_write = incoming_md_updates_->getNextToWriteTo();
+      *next_write = market_update;
+      incoming_md_updates_->updateWriteIndex();
+      return true;
+    }
+
+    /// Process the datagrams published to a channel's shared memory ring since the last call, attaching to it first if need be.
+    auto recvShmIncremental(IncrementalChannel *channel) noexcept -> void;
+
+    /// Skip past everything published to a channel's shared memory ring, having lost datagrams that were overwritten before they were read.
+    auto shmOverrun(IncrementalChannel *channel, size_t published) noexcept -> void;
+
+    /// Check the sequence number of a decoded update, and either forward it to the trade engine or queue it up for recovery.
+    /// snapshot_channel is the snapshot stream it came from, nullptr if it came from the channel's incremental stream.
+    auto onMarketUpdate(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, const Exchange::MDPMarketUpdate &market_update) noexcept -> void;
+
+    /// Queue up a message in the *queued_msgs_ containers, snapshot_channel is the snapshot stream it came from or nullptr for the incremental stream.
+    auto queueMessage(IncrementalChannel *channel, SnapshotChannel *snapshot_channel, const Exchange::MDPMarketUpdate *request);
+
+    /// Recover the updates of a channel missed before seq_num: ask the retransmit server for them if there are few enough, else start
+    /// snapshot synchronization.
+    auto startRecovery(IncrementalChannel *channel, size_t seq_num) -> void;
+
+    /// Ask the retransmit server for the updates of a channel numbered [begin_seq, end_seq), returns false if it cannot be reached.
+    auto requestRetransmit(IncrementalChannel *channel, size_t begin_seq, size_t end_seq) -> bool;
+
+    /// Read the retransmit server's response to a channel's request, queueing up the updates it sent.
+    auto retransmitCallback(IncrementalChannel *channel, Common::TCPSocket *socket) noexcept -> void;
+
+    /// Give up on a channel's pending retransmit request, closing its connection from run(), and start snapshot synchronization.
+    auto abandonRetransmit(IncrementalChannel *channel, const char *reason) -> void;
+
+    /// Check if a channel's queued up incremental updates complete its stream now that the retransmitted ones are in, forwarding them if they do.
+    auto checkRetransmitSync(IncrementalChannel *channel) -> void;
 
-    /// Queue up a message in the *_queued_msgs_ containers, first parameter specifies if this update came from the snapshot or the incremental streams.
-    auto queueMessage(bool is_snapshot, const Exchange::MDPMarketUpdate *request);
+    /// Start the process of snapshot synchronization of a channel by subscribing to its snapshot multicast streams.
+    auto startSnapshotSync(IncrementalChannel *channel) -> void;
 
-    /// Start the process of snapshot synchronization by subscribing to the snapshot multicast stream.
-    auto startSnapshotSync() -> void;
+    /// Check if a recovery / synchronization of a channel is possible from the queued up market data updates from its snapshot and incremental market data streams.
+    auto checkSnapshotSync(IncrementalChannel *channel) -> void;
 
-    /// Check if a recovery / synchronization is possible from the queued up market data updates from the snapshot and incremental market data streams.
-    auto checkSnapshotSync() -> void;
+    /// Check if a snapshot stream's queued up updates are a whole snapshot cycle, clearing them if they cannot become one.
+    auto checkSnapshotCycle(SnapshotChannel *snapshot_channel) -> bool;
   };
 }
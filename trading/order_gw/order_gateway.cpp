@@ -4,9 +4,9 @@ namespace Trading {
   OrderGateway::OrderGateway(ClientId client_id,
                              Exchange::ClientRequestLFQueue *client_requests,
                              Exchange::ClientResponseLFQueue *client_responses,
-                             std::string ip, const std::string &iface, int port)
+                             std::string ip, const std::string &iface, int port, bool use_shm)
       : client_id_(client_id), ip_(ip), iface_(iface), port_(port), outgoing_requests_(client_requests), incoming_responses_(client_responses),
-      logger_("trading_order_gateway_" + std::to_string(client_id) + ".log"), tcp_socket_(logger_) {
+      logger_("trading_order_gateway_" + std::to_string(client_id) + ".log"), tcp_socket_(logger_), use_shm_(use_shm) {
     tcp_socket_.recv_callback_ = [this](auto socket, auto rx_time) { recvCallback(socket, rx_time); };
   }
 
@@ -14,7 +14,11 @@ namespace Trading {
   auto OrderGateway::run() noexcept -> void {
     logger_.log("%:% %() %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_));
     while (run_) {
-      tcp_socket_.sendAndRecv();
+      if (use_shm_) {
+        recvShmResponses();
+      } else {
+        tcp_socket_.sendAndRecv();
+      }
 
       for(auto client_request = outgoing_requests_->getNextToRead(); client_request; client_request = outgoing_requests_->getNextToRead()) {
         TTT_MEASURE(T11_OrderGateway_LFQueue_read, logger_);
@@ -22,14 +26,79 @@ namespace Trading {
         logger_.log("%:% %() % Sending cid:% seq:% %\n", __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str_), client_id_, next_outgoing_seq_num_, client_request->toString());
         START_MEASURE(Trading_TCPSocket_send);
-        tcp_socket_.send(&next_outgoing_seq_num_, sizeof(next_outgoing_seq_num_));
-        tcp_socket_.send(client_request, sizeof(Exchange::MEClientRequest));
+        if (use_shm_) {
+          auto next_write = shm_requests_->reserveNextToWriteTo();
+          while (UNLIKELY(!next_write)) { // ring is full, publish what was reserved and wait for the order server to catch up.
+            shm_requests_->commitWriteIndex();
+            std::this_thread::yield();
+            next_write = shm_requests_->reserveNextToWriteTo();
+          }
+          *next_write = Exchange::OMShmRequest{next_outgoing_seq_num_, *client_request};
+        } else if (UNLIKELY(!request_frame_.add(next_outgoing_seq_num_, *client_request))) {
+          request_frame_.flush(client_id_, &tcp_socket_);
+          request_frame_.add(next_outgoing_seq_num_, *client_request);
+        }
         END_MEASURE(Trading_TCPSocket_send, logger_);
         outgoing_requests_->updateReadIndex();
         TTT_MEASURE(T12_OrderGateway_TCP_write, logger_);
 
         next_outgoing_seq_num_++;
       }
+      // Everything the trade engine queued since the last loop goes out as one frame, or is published to the request ring at once.
+      if (use_shm_) {
+        shm_requests_->commitWriteIndex();
+      } else {
+        request_frame_.flush(client_id_, &tcp_socket_);
+      }
+    }
+  }
+
+  /// Attach to the order server's response ring once it exists, and read, check and forward the responses waiting on it.
+  auto OrderGateway::recvShmResponses() noexcept -> void {
+    const auto now = Common::getCurrentNanos();
+    if (UNLIKELY(now >= next_shm_scan_time_)) {
+      next_shm_scan_time_ = now + Exchange::OM_SHM_SCAN_INTERVAL_NANOS;
+      if (shm_responses_ && !shm_responses_->producerAlive()) {
+        logger_.log("%:% %() % Order server pid:% exited.\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    shm_responses_->producerPid());
+        delete shm_responses_;
+        shm_responses_ = nullptr;
+      }
+      if (!shm_responses_) {
+        // The ring is created with its heartbeat at the creation time, an order server does not heartbeat it after that.
+        auto responses = new Exchange::OMShmResponseQueue(Exchange::omShmResponsesName(client_id_));
+        if (responses->valid() && responses->producerAlive() && responses->lastHeartbeat() >= shm_session_start_time_) {
+          logger_.log("%:% %() % Attached to order server pid:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                      responses->producerPid());
+          shm_responses_ = responses;
+        } else {
+          delete responses;
+        }
+      }
+    }
+    if (!shm_responses_) {
+      return;
+    }
+
+    for (auto shm_response = shm_responses_->getNextToRead(); shm_response; shm_response = shm_responses_->getNextToRead()) {
+      TTT_MEASURE(T7t_OrderGateway_TCP_read, logger_);
+      logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), shm_response->toString());
+
+      if (shm_response->response_.client_id_ != client_id_) { // this should never happen unless there is a bug at the exchange.
+        logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id_, shm_response->response_.client_id_);
+      } else if (shm_response->seq_num_ != next_exp_seq_num_) { // this should never happen unless there is a bug at the exchange.
+        logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, shm_response->seq_num_);
+      } else {
+        ++next_exp_seq_num_;
+
+        auto next_write = incoming_responses_->getNextToWriteTo();
+        *next_write = shm_response->response_;
+        incoming_responses_->updateWriteIndex();
+        TTT_MEASURE(T8t_OrderGateway_LFQueue_write, logger_);
+      }
+      shm_responses_->updateReadIndex();
     }
   }
 
@@ -38,35 +107,62 @@ namespace Trading {
     TTT_MEASURE(T7t_OrderGateway_TCP_read, logger_);
 
     START_MEASURE(Trading_OrderGateway_recvCallback);
-    logger_.log("%:% %() % Received socket:% len:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, socket->next_rcv_valid_index_, rx_time);
-
-    if (socket->next_rcv_valid_index_ >= sizeof(Exchange::OMClientResponse)) {
-      size_t i = 0;
-      for (; i + sizeof(Exchange::OMClientResponse) <= socket->next_rcv_valid_index_; i += sizeof(Exchange::OMClientResponse)) {
-        auto response = reinterpret_cast<const Exchange::OMClientResponse *>(socket->inbound_data_.data() + i);
-        logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), response->toString());
-
-        if(response->me_client_response_.client_id_ != client_id_) { // this should never happen unless there is a bug at the exchange.
-          logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
-                      Common::getCurrentTimeStr(&time_str_), client_id_, response->me_client_response_.client_id_);
-          continue;
-        }
-        if(response->seq_num_ != next_exp_seq_num_) { // this should never happen since we use a reliable TCP protocol, unless there is a bug at the exchange.
-          logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
-                      Common::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, response->seq_num_);
-          continue;
-        }
+    logger_.log("%:% %() % Received socket:% len:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), socket->socket_fd_, socket->inbound_.size(), rx_time);
+
+    const auto data = socket->inbound_.readData();
+    size_t i = 0;
+    while (i + sizeof(Exchange::OMFrameHeader) <= socket->inbound_.size()) {
+      const auto header = reinterpret_cast<const Exchange::OMFrameHeader *>(data + i);
+      if (UNLIKELY(header->version_ != Exchange::OM_VERSION || header->size_ < sizeof(Exchange::OMFrameHeader) ||
+                   header->size_ > Exchange::OM_MAX_FRAME_SIZE)) { // this should never happen unless there is a bug at the exchange.
+        logger_.log("%:% %() % ERROR Bad frame %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), header->toString());
+        socket->disconnect("bad frame");
+        END_MEASURE(Trading_OrderGateway_recvCallback, logger_);
+        return;
+      }
+      if (i + header->size_ > socket->inbound_.size()) {
+        break;
+      }
+      const auto frame_end = i + header->size_;
+      logger_.log("%:% %() % Received %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_), header->toString());
+
+      if (header->client_id_ != client_id_) { // this should never happen unless there is a bug at the exchange.
+        logger_.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id_, header->client_id_);
+        i = frame_end;
+        continue;
+      }
+      if (header->seq_num_ != next_exp_seq_num_) { // this should never happen since we use a reliable TCP protocol, unless there is a bug at the exchange.
+        logger_.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n", __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str_), client_id_, next_exp_seq_num_, header->seq_num_);
+        i = frame_end;
+        continue;
+      }
+
+      // A frame with a bad message is rejected whole, before any of its responses reach the trade engine.
+      if (UNLIKELY(!Exchange::omDecodeFrame(data + i, frame_responses_.data()))) {
+        logger_.log("%:% %() % ERROR Bad message in frame %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    header->toString());
+        socket->disconnect("bad message");
+        END_MEASURE(Trading_OrderGateway_recvCallback, logger_);
+        return;
+      }
+
+      for (uint16_t m = 0; m < header->num_messages_; ++m) {
+        const auto &response = frame_responses_[m];
+        logger_.log("%:% %() % Received seq:% %\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str_),
+                    next_exp_seq_num_, response.toString());
 
         ++next_exp_seq_num_;
 
         auto next_write = incoming_responses_->getNextToWriteTo();
-        *next_write = std::move(response->me_client_response_);
+        *next_write = response;
         incoming_responses_->updateWriteIndex();
         TTT_MEASURE(T8t_OrderGateway_LFQueue_write, logger_);
       }
-      memcpy(socket->inbound_data_.data(), socket->inbound_data_.data() + i, socket->next_rcv_valid_index_ - i);
-      socket->next_rcv_valid_index_ -= i;
+      i = frame_end;
     }
+    socket->inbound_.consume(i);
     END_MEASURE(Trading_OrderGateway_recvCallback, logger_);
   }
 }
@@ -8,6 +8,8 @@
 
 #include "order_server/client_request.h"
 #include "order_server/client_response.h"
+#include "order_server/om_wire_format.h"
+#include "order_server/om_shm_session.h"
 
 namespace Trading {
   class OrderGateway {
@@ -15,20 +17,30 @@ namespace Trading {
     OrderGateway(ClientId client_id,
                  Exchange::ClientRequestLFQueue *client_requests,
                  Exchange::ClientResponseLFQueue *client_responses,
-                 std::string ip, const std::string &iface, int port);
+                 std::string ip, const std::string &iface, int port, bool use_shm = false);
 
     ~OrderGateway() {
       stop();
 
       using namespace std::literals::chrono_literals;
       std::this_thread::sleep_for(5s);
+
+      delete shm_responses_;
+      shm_responses_ = nullptr;
+      delete shm_requests_;
+      shm_requests_ = nullptr;
     }
 
     /// Start and stop the order gateway main thread.
     auto start() {
       run_ = true;
-      ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0,
-             "Unable to connect to ip:" + ip_ + " port:" + std::to_string(port_) + " on iface:" + iface_ + " error:" + std::string(std::strerror(errno)));
+      if (use_shm_) { // the order server finds the request ring on its next scan, and answers with a response ring of its own.
+        shm_requests_ = new Exchange::OMShmRequestQueue(Exchange::omShmRequestsName(client_id_), Exchange::OM_SHM_QUEUE_SIZE);
+        shm_session_start_time_ = shm_requests_->lastHeartbeat();
+      } else {
+        ASSERT(tcp_socket_.connect(ip_, iface_, port_, false) >= 0,
+               "Unable to connect to ip:" + ip_ + " port:" + std::to_string(port_) + " on iface:" + iface_ + " error:" + std::string(std::strerror(errno)));
+      }
       ASSERT(Common::createAndStartThread(-1, "Trading/OrderGateway", [this]() { run(); }) != nullptr, "Failed to start OrderGateway thread.");
     }
 
@@ -70,14 +82,32 @@ namespace Trading {
     size_t next_outgoing_seq_num_ = 1;
     size_t next_exp_seq_num_ = 1;
 
+    /// The responses of the frame being read, decoded before any of them is forwarded.
+    std::array<Exchange::MEClientResponse, Exchange::OM_MAX_FRAME_MESSAGES> frame_responses_;
+
+    /// Frame the client requests read in one loop are encoded into, queued on the socket as one.
+    Exchange::OMFrameWriter request_frame_;
+
     /// TCP connection to the exchange's order server.
     Common::TCPSocket tcp_socket_;
 
+    /// Set to reach an order server on the same box through a pair of shared memory rings instead of the TCP connection.
+    const bool use_shm_;
+    Exchange::OMShmRequestQueue *shm_requests_ = nullptr;
+    Exchange::OMShmResponseQueue *shm_responses_ = nullptr;
+
+    /// When the request ring was created, a response ring older than that belongs to an earlier session.
+    Nanos shm_session_start_time_ = 0;
+    Nanos next_shm_scan_time_ = 0;
+
   private:
     /// Main thread loop - sends out client requests to the exchange and reads and dispatches incoming client responses.
     auto run() noexcept -> void;
 
     /// Callback when an incoming client response is read, we perform some checks and forward it to the lock free queue connected to the trade engine.
     auto recvCallback(TCPSocket *socket, Nanos rx_time) noexcept -> void;
+
+    /// Attach to the order server's response ring once it exists, and read, check and forward the responses waiting on it.
+    auto recvShmResponses() noexcept -> void;
   };
 }
@@ -18,8 +18,10 @@ namespace Trading {
 
   /// Process market data update and update the limit order book.
   auto MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *market_update) noexcept -> void {
-    const auto bid_updated = (bids_by_price_ && market_update->side_ == Side::BUY && market_update->price_ >= bids_by_price_->price_);
-    const auto ask_updated = (asks_by_price_ && market_update->side_ == Side::SELL && market_update->price_ <= asks_by_price_->price_);
+    // EXECUTION messages carry the aggressor side, the book change happens on the opposite (passive) side.
+    const auto book_side = (market_update->type_ == Exchange::MarketUpdateType::EXECUTION ? market_update->passiveSide() : market_update->side_);
+    const auto bid_updated = (bids_by_price_ && book_side == Side::BUY && market_update->price_ >= bids_by_price_->price_);
+    const auto ask_updated = (asks_by_price_ && book_side == Side::SELL && market_update->price_ <= asks_by_price_->price_);
 
     switch (market_update->type_) {
       case Exchange::MarketUpdateType::ADD: {
@@ -47,6 +49,19 @@ namespace Trading {
         return;
       }
         break;
+      case Exchange::MarketUpdateType::EXECUTION: { // a TRADE and the resulting MODIFY / CANCEL of the passive order, applied in one step.
+        trade_engine_->onTradeUpdate(market_update, this);
+
+        auto order = oid_to_order_.at(market_update->order_id_);
+        if (market_update->passiveLeavesQty()) {
+          order->qty_ = market_update->passiveLeavesQty();
+        } else {
+          START_MEASURE(Trading_MarketOrderBook_removeOrder);
+          removeOrder(order);
+          END_MEASURE(Trading_MarketOrderBook_removeOrder, (*logger_));
+        }
+      }
+        break;
       case Exchange::MarketUpdateType::CLEAR: { // Clear the full limit order book and deallocate MarketOrdersAtPrice and MarketOrder objects.
         for (auto &order: oid_to_order_) {
           if (order)
@@ -72,6 +87,8 @@ namespace Trading {
       case Exchange::MarketUpdateType::INVALID:
       case Exchange::MarketUpdateType::SNAPSHOT_START:
       case Exchange::MarketUpdateType::SNAPSHOT_END:
+      case Exchange::MarketUpdateType::PRICE_LEVEL:
+      case Exchange::MarketUpdateType::BBO:
         break;
     }
 
@@ -82,7 +99,7 @@ namespace Trading {
     logger_->log("%:% %() % % %", __FILE__, __LINE__, __FUNCTION__,
                  Common::getCurrentTimeStr(&time_str_), market_update->toString(), bbo_.toString());
 
-    trade_engine_->onOrderBookUpdate(market_update->ticker_id_, market_update->price_, market_update->side_, this);
+    trade_engine_->onOrderBookUpdate(market_update->ticker_id_, market_update->price_, book_side, this);
   }
 
   auto MarketOrderBook::toString(bool detailed, bool validity_check) const -> std::string {
@@ -14,10 +14,34 @@ Trading::TradeEngine *trade_engine = nullptr;
 Trading::MarketDataConsumer *market_data_consumer = nullptr;
 Trading::OrderGateway *order_gateway = nullptr;
 
-/// ./trading_main CLIENT_ID ALGO_TYPE [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] [CLIP_2 THRESH_2 MAX_ORDER_SIZE_2 MAX_POS_2 MAX_LOSS_2] ...
+/// ./trading_main CLIENT_ID ALGO_TYPE [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] [CLIP_2 THRESH_2 MAX_ORDER_SIZE_2 MAX_POS_2 MAX_LOSS_2] ... [--order-shm] [--md-shm] [--md-incremental-channels N] [--md-snapshot-channels N]
+/// With --order-shm orders go to an exchange on the same box, started with --order-shm as well, through shared memory instead of TCP.
+/// With --md-shm the incremental market data comes from an exchange on the same box, started with --md-shm as well, through shared memory.
+/// With --md-incremental-channels N, the same as the exchange's, only the incremental channels of the instruments configured above are read
+/// and recovered, and only their books are kept. With --md-snapshot-channels N, the same as the exchange's, only the snapshot channels of
+/// those instruments are recovered from.
 int main(int argc, char **argv) {
+  bool order_shm = false, md_shm = false;
+  size_t md_incremental_channels = 0, md_snapshot_channels = 0;
+  for (; argc > 1; --argc) {
+    const std::string arg = argv[argc - 1];
+    if (arg == "--order-shm") {
+      order_shm = true;
+    } else if (arg == "--md-shm") {
+      md_shm = true;
+    } else if (argc > 2 && std::string(argv[argc - 2]) == "--md-incremental-channels") {
+      md_incremental_channels = std::stoul(arg);
+      --argc;
+    } else if (argc > 2 && std::string(argv[argc - 2]) == "--md-snapshot-channels") {
+      md_snapshot_channels = std::stoul(arg);
+      --argc;
+    } else {
+      break;
+    }
+  }
+
   if(argc < 3) {
-    FATAL("USAGE trading_main CLIENT_ID ALGO_TYPE [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] [CLIP_2 THRESH_2 MAX_ORDER_SIZE_2 MAX_POS_2 MAX_LOSS_2] ...");
+    FATAL("USAGE trading_main CLIENT_ID ALGO_TYPE [CLIP_1 THRESH_1 MAX_ORDER_SIZE_1 MAX_POS_1 MAX_LOSS_1] [CLIP_2 THRESH_2 MAX_ORDER_SIZE_2 MAX_POS_2 MAX_LOSS_2] ... [--order-shm] [--md-shm] [--md-incremental-channels N] [--md-snapshot-channels N]");
   }
 
   const Common::ClientId client_id = atoi(argv[1]);
@@ -60,8 +84,8 @@ int main(int argc, char **argv) {
   const std::string order_gw_iface = "lo";
   const int order_gw_port = 12345;
 
-  logger->log("%:% %() % Starting Order Gateway...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port);
+  logger->log("%:% %() % Starting Order Gateway... shm:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), order_shm);
+  order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gw_ip, order_gw_iface, order_gw_port, order_shm);
   order_gateway->start();
 
   const std::string mkt_data_iface = "lo";
@@ -69,9 +93,22 @@ int main(int argc, char **argv) {
   const int snapshot_port = 20000;
   const std::string incremental_ip = "233.252.14.3";
   const int incremental_port = 20001;
+  const std::string retransmit_ip = "127.0.0.1";
+  const int retransmit_port = 20002;
+
+  // The random algorithm trades every instrument, the others those configured on the command line.
+  std::vector<Common::TickerId> md_tickers;
+  if (algo_type != AlgoType::RANDOM) {
+    for (Common::TickerId ticker_id = 0; ticker_id < next_ticker_id; ++ticker_id) {
+      md_tickers.push_back(ticker_id);
+    }
+  }
 
-  logger->log("%:% %() % Starting Market Data Consumer...\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
-  market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
+  logger->log("%:% %() % Starting Market Data Consumer... shm:% incremental-channels:% snapshot-channels:% tickers:%\n", __FILE__, __LINE__,
+              __FUNCTION__, Common::getCurrentTimeStr(&time_str), md_shm, md_incremental_channels, md_snapshot_channels, md_tickers.size());
+  market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_iface, snapshot_ip, snapshot_port, incremental_ip, incremental_port,
+                                                         retransmit_ip, retransmit_port, md_shm, md_incremental_channels, md_snapshot_channels,
+                                                         md_tickers);
   market_data_consumer->start();
 
   // Removed 10 second sleep - using event-driven initialization